@@ -285,8 +285,8 @@ done:
    return ret;
 }
 
-/* _hmac_with_algorithm computes an HMAC of @in with the algorithm specified by
- * @hAlgorithm.
+/* _hmac_with_algorithm computes an HMAC of the concatenation of the @num_in
+ * buffers in @in with the algorithm specified by @hAlgorithm.
  * @key is the input key.
  * @out is the output. @out must be allocated by the caller with
  * the expected length @expect_out_len for the output.
@@ -295,6 +295,7 @@ bool
 _hmac_with_algorithm (BCRYPT_ALG_HANDLE hAlgorithm,
                       const _mongocrypt_buffer_t *key,
                       const _mongocrypt_buffer_t *in,
+                      uint32_t num_in,
                       _mongocrypt_buffer_t *out,
                       uint32_t expect_out_len,
                       mongocrypt_status_t *status)
@@ -302,6 +303,7 @@ _hmac_with_algorithm (BCRYPT_ALG_HANDLE hAlgorithm,
    bool ret = false;
    BCRYPT_HASH_HANDLE hHash;
    NTSTATUS nt_status;
+   uint32_t i;
 
    if (out->len != expect_out_len) {
       CLIENT_ERR ("out does not contain " PRIu32 " bytes", expect_out_len);
@@ -316,10 +318,13 @@ _hmac_with_algorithm (BCRYPT_ALG_HANDLE hAlgorithm,
       return false;
    }
 
-   nt_status = BCryptHashData (hHash, (PUCHAR) in->data, (ULONG) in->len, 0);
-   if (nt_status != STATUS_SUCCESS) {
-      CLIENT_ERR ("error hashing data: 0x%x", (int) nt_status);
-      goto done;
+   for (i = 0; i < num_in; i++) {
+      nt_status = BCryptHashData (
+         hHash, (PUCHAR) in[i].data, (ULONG) in[i].len, 0);
+      if (nt_status != STATUS_SUCCESS) {
+         CLIENT_ERR ("error hashing data: 0x%x", (int) nt_status);
+         goto done;
+      }
    }
 
    nt_status = BCryptFinishHash (hHash, out->data, out->len, 0);
@@ -341,7 +346,23 @@ _native_crypto_hmac_sha_512 (const _mongocrypt_buffer_t *key,
                              mongocrypt_status_t *status)
 {
    return _hmac_with_algorithm (
-      _algo_sha512_hmac, key, in, out, MONGOCRYPT_HMAC_SHA512_LEN, status);
+      _algo_sha512_hmac, key, in, 1, out, MONGOCRYPT_HMAC_SHA512_LEN, status);
+}
+
+bool
+_native_crypto_hmac_sha_512_parts (const _mongocrypt_buffer_t *key,
+                                   const _mongocrypt_buffer_t *in,
+                                   uint32_t num_in,
+                                   _mongocrypt_buffer_t *out,
+                                   mongocrypt_status_t *status)
+{
+   return _hmac_with_algorithm (_algo_sha512_hmac,
+                                key,
+                                in,
+                                num_in,
+                                out,
+                                MONGOCRYPT_HMAC_SHA512_LEN,
+                                status);
 }
 
 
@@ -604,7 +625,61 @@ _native_crypto_hmac_sha_256 (const _mongocrypt_buffer_t *key,
                              mongocrypt_status_t *status)
 {
    return _hmac_with_algorithm (
-      _algo_sha256_hmac, key, in, out, MONGOCRYPT_HMAC_SHA256_LEN, status);
+      _algo_sha256_hmac, key, in, 1, out, MONGOCRYPT_HMAC_SHA256_LEN, status);
+}
+
+bool
+_native_crypto_hmac_sha_256_parts (const _mongocrypt_buffer_t *key,
+                                   const _mongocrypt_buffer_t *in,
+                                   uint32_t num_in,
+                                   _mongocrypt_buffer_t *out,
+                                   mongocrypt_status_t *status)
+{
+   return _hmac_with_algorithm (_algo_sha256_hmac,
+                                key,
+                                in,
+                                num_in,
+                                out,
+                                MONGOCRYPT_HMAC_SHA256_LEN,
+                                status);
+}
+
+
+/* CNG does not support precomputed keys. Callers fall back to passing the raw
+ * key on every call. */
+_native_crypto_aes_key_t *
+_native_crypto_aes_256_cbc_key_new (const _mongocrypt_buffer_t *key)
+{
+   return NULL;
+}
+
+void
+_native_crypto_aes_256_cbc_key_destroy (_native_crypto_aes_key_t *key)
+{
+   BSON_ASSERT (!key);
+}
+
+_native_crypto_hmac_key_t *
+_native_crypto_hmac_sha_512_key_new (const _mongocrypt_buffer_t *key)
+{
+   return NULL;
+}
+
+void
+_native_crypto_hmac_sha_512_key_destroy (_native_crypto_hmac_key_t *key)
+{
+   BSON_ASSERT (!key);
+}
+
+bool
+_native_crypto_hmac_sha_512_with_key (const _native_crypto_hmac_key_t *key,
+                                      const _mongocrypt_buffer_t *in,
+                                      uint32_t num_in,
+                                      _mongocrypt_buffer_t *out,
+                                      mongocrypt_status_t *status)
+{
+   CLIENT_ERR ("precomputed keys are not supported");
+   return false;
 }
 
 #endif /* MONGOCRYPT_ENABLE_CRYPTO_CNG */
\ No newline at end of file
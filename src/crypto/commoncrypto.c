@@ -176,8 +176,8 @@ _native_crypto_aes_256_ctr_decrypt (aes_256_args_t args)
 }
 
 
-/* _hmac_with_algorithm computes an HMAC of @in with the algorithm specified by
- * @algorithm.
+/* _hmac_with_algorithm computes an HMAC of the concatenation of the @num_in
+ * buffers in @in with the algorithm specified by @algorithm.
  * @key is the input key.
  * @out is the output. @out must be allocated by the caller with
  * the expected length @expect_out_len for the output.
@@ -186,11 +186,13 @@ bool
 _hmac_with_algorithm (CCHmacAlgorithm algorithm,
                       const _mongocrypt_buffer_t *key,
                       const _mongocrypt_buffer_t *in,
+                      uint32_t num_in,
                       _mongocrypt_buffer_t *out,
                       uint32_t expect_out_len,
                       mongocrypt_status_t *status)
 {
    CCHmacContext *ctx;
+   uint32_t i;
 
    if (out->len != expect_out_len) {
       CLIENT_ERR ("out does not contain %" PRIu32 " bytes", expect_out_len);
@@ -202,7 +204,9 @@ _hmac_with_algorithm (CCHmacAlgorithm algorithm,
 
 
    CCHmacInit (ctx, algorithm, key->data, key->len);
-   CCHmacUpdate (ctx, in->data, in->len);
+   for (i = 0; i < num_in; i++) {
+      CCHmacUpdate (ctx, in[i].data, in[i].len);
+   }
    CCHmacFinal (ctx, out->data);
    bson_free (ctx);
    return true;
@@ -215,7 +219,23 @@ _native_crypto_hmac_sha_512 (const _mongocrypt_buffer_t *key,
                              mongocrypt_status_t *status)
 {
    return _hmac_with_algorithm (
-      kCCHmacAlgSHA512, key, in, out, MONGOCRYPT_HMAC_SHA512_LEN, status);
+      kCCHmacAlgSHA512, key, in, 1, out, MONGOCRYPT_HMAC_SHA512_LEN, status);
+}
+
+bool
+_native_crypto_hmac_sha_512_parts (const _mongocrypt_buffer_t *key,
+                                   const _mongocrypt_buffer_t *in,
+                                   uint32_t num_in,
+                                   _mongocrypt_buffer_t *out,
+                                   mongocrypt_status_t *status)
+{
+   return _hmac_with_algorithm (kCCHmacAlgSHA512,
+                                key,
+                                in,
+                                num_in,
+                                out,
+                                MONGOCRYPT_HMAC_SHA512_LEN,
+                                status);
 }
 
 
@@ -239,7 +259,61 @@ _native_crypto_hmac_sha_256 (const _mongocrypt_buffer_t *key,
                              mongocrypt_status_t *status)
 {
    return _hmac_with_algorithm (
-      kCCHmacAlgSHA256, key, in, out, MONGOCRYPT_HMAC_SHA256_LEN, status);
+      kCCHmacAlgSHA256, key, in, 1, out, MONGOCRYPT_HMAC_SHA256_LEN, status);
+}
+
+bool
+_native_crypto_hmac_sha_256_parts (const _mongocrypt_buffer_t *key,
+                                   const _mongocrypt_buffer_t *in,
+                                   uint32_t num_in,
+                                   _mongocrypt_buffer_t *out,
+                                   mongocrypt_status_t *status)
+{
+   return _hmac_with_algorithm (kCCHmacAlgSHA256,
+                                key,
+                                in,
+                                num_in,
+                                out,
+                                MONGOCRYPT_HMAC_SHA256_LEN,
+                                status);
+}
+
+
+/* Common Crypto does not support precomputed keys. Callers fall back to passing the raw
+ * key on every call. */
+_native_crypto_aes_key_t *
+_native_crypto_aes_256_cbc_key_new (const _mongocrypt_buffer_t *key)
+{
+   return NULL;
+}
+
+void
+_native_crypto_aes_256_cbc_key_destroy (_native_crypto_aes_key_t *key)
+{
+   BSON_ASSERT (!key);
+}
+
+_native_crypto_hmac_key_t *
+_native_crypto_hmac_sha_512_key_new (const _mongocrypt_buffer_t *key)
+{
+   return NULL;
+}
+
+void
+_native_crypto_hmac_sha_512_key_destroy (_native_crypto_hmac_key_t *key)
+{
+   BSON_ASSERT (!key);
+}
+
+bool
+_native_crypto_hmac_sha_512_with_key (const _native_crypto_hmac_key_t *key,
+                                      const _mongocrypt_buffer_t *in,
+                                      uint32_t num_in,
+                                      _mongocrypt_buffer_t *out,
+                                      mongocrypt_status_t *status)
+{
+   CLIENT_ERR ("precomputed keys are not supported");
+   return false;
 }
 
 #endif /* MONGOCRYPT_ENABLE_CRYPTO_COMMON_CRYPTO */
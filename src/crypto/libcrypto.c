@@ -33,6 +33,8 @@
 #include <openssl/hmac.h>
 #include <openssl/rand.h>
 
+#include <stdlib.h>
+
 #if OPENSSL_VERSION_NUMBER < 0x10100000L || \
    (defined(LIBRESSL_VERSION_NUMBER) && LIBRESSL_VERSION_NUMBER < 0x20700000L)
 
@@ -48,16 +50,419 @@ HMAC_CTX_free (HMAC_CTX *ctx)
    HMAC_CTX_cleanup (ctx);
    bson_free (ctx);
 }
+
+#define EVP_CIPHER_CTX_reset EVP_CIPHER_CTX_cleanup
+#endif
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L && !defined(LIBRESSL_VERSION_NUMBER)
+/* OpenSSL 3 looks up algorithm implementations in providers. Fetch them once
+ * instead of on every call. */
+#define LIBCRYPTO_HAS_FETCH
+#include <openssl/core_names.h>
+#include <openssl/params.h>
+#endif
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#include "../mlib/atomic.h"
+
+static const EVP_CIPHER *_aes_256_cbc;
+static const EVP_CIPHER *_aes_256_ecb;
+static const EVP_CIPHER *_aes_256_ctr;
+#ifdef LIBCRYPTO_HAS_FETCH
+static EVP_MAC *_hmac;
+typedef EVP_MAC_CTX _hmac_ctx_t;
+#else
+typedef HMAC_CTX _hmac_ctx_t;
+#endif
+
+/* Precomputed keys are copied into a thread's context before use. Each is
+ * given a unique id so the thread can tell whether it already holds the key.
+ * Ids are never reused, so a freed key cannot be mistaken for a new one at the
+ * same address. */
+static volatile int64_t _next_key_id;
+
+/* An AES-256-CBC key with the key schedule expanded for each direction. */
+struct _native_crypto_aes_key_t {
+   int64_t encrypt_id;
+   int64_t decrypt_id;
+   EVP_CIPHER_CTX *encrypt;
+   EVP_CIPHER_CTX *decrypt;
+};
+
+/* An HMAC SHA-512 key with the inner and outer pads already hashed. */
+struct _native_crypto_hmac_key_t {
+   int64_t id;
+   _hmac_ctx_t *ctx;
+};
+
+/* The number of precomputed keys of each kind a thread keeps copied in. A data
+ * key uses up to two of each, so several data keys can be used in turn without
+ * copying. Slots are replaced round robin. */
+#define THREAD_KEY_SLOTS 8
+
+typedef struct {
+   int64_t id; /* 0 if unused. */
+   EVP_CIPHER_CTX *ctx;
+} _cipher_slot_t;
+
+typedef struct {
+   int64_t id; /* 0 if unused. */
+   _hmac_ctx_t *ctx;
+} _hmac_slot_t;
+
+/* Cipher and MAC contexts, allocated once per thread and reused by every call
+ * on that thread. Calls with a raw key re-key the context, so no state carries
+ * over. Calls with a precomputed key use a slot holding a copy of it. */
+typedef struct _thread_ctx_t {
+   EVP_CIPHER_CTX *cipher;
+#ifdef LIBCRYPTO_HAS_FETCH
+   EVP_MAC_CTX *hmac_sha_256;
+   EVP_MAC_CTX *hmac_sha_512;
+#else
+   HMAC_CTX *hmac;
+#endif
+   _cipher_slot_t cipher_slots[THREAD_KEY_SLOTS];
+   uint32_t next_cipher_slot;
+   _hmac_slot_t hmac_slots[THREAD_KEY_SLOTS];
+   uint32_t next_hmac_slot;
+   /* Guards the slots. The owning thread holds it to look up or replace a
+    * slot. Destroying a precomputed key holds it to clear the copies. */
+   mongocrypt_mutex_t slots_mutex;
+   /* Links in _thread_ctxs. */
+   struct _thread_ctx_t *prev;
+   struct _thread_ctx_t *next;
+} _thread_ctx_t;
+
+/* Every thread's contexts, so destroying a precomputed key can clear the
+ * copies of it right away. Guarded by _thread_ctxs_mutex. */
+static _thread_ctx_t *_thread_ctxs;
+static mongocrypt_mutex_t _thread_ctxs_mutex;
+
+#ifdef _WIN32
+static DWORD _thread_ctx_key = FLS_OUT_OF_INDEXES;
+#else
+static pthread_key_t _thread_ctx_key;
+#endif
+
+static void
+_hmac_ctx_free (_hmac_ctx_t *ctx)
+{
+   if (!ctx) {
+      return;
+   }
+#ifdef LIBCRYPTO_HAS_FETCH
+   EVP_MAC_CTX_free (ctx);
+#else
+   HMAC_CTX_free (ctx);
+#endif
+}
+
+static void
+_thread_ctx_destroy (void *arg)
+{
+   _thread_ctx_t *tctx = arg;
+   uint32_t i;
+
+   if (!tctx) {
+      return;
+   }
+
+   MONGOCRYPT_WITH_MUTEX (_thread_ctxs_mutex)
+   {
+      if (tctx->prev) {
+         tctx->prev->next = tctx->next;
+      } else {
+         _thread_ctxs = tctx->next;
+      }
+      if (tctx->next) {
+         tctx->next->prev = tctx->prev;
+      }
+   }
+
+   EVP_CIPHER_CTX_free (tctx->cipher);
+#ifdef LIBCRYPTO_HAS_FETCH
+   EVP_MAC_CTX_free (tctx->hmac_sha_256);
+   EVP_MAC_CTX_free (tctx->hmac_sha_512);
+#else
+   HMAC_CTX_free (tctx->hmac);
+#endif
+   for (i = 0; i < THREAD_KEY_SLOTS; i++) {
+      EVP_CIPHER_CTX_free (tctx->cipher_slots[i].ctx);
+      _hmac_ctx_free (tctx->hmac_slots[i].ctx);
+   }
+   _mongocrypt_mutex_cleanup (&tctx->slots_mutex);
+   bson_free (tctx);
+}
+
+#ifdef _WIN32
+static VOID NTAPI
+_thread_ctx_destroy_fls (PVOID arg)
+{
+   _thread_ctx_destroy (arg);
+}
+#endif
+
+#ifdef LIBCRYPTO_HAS_FETCH
+static EVP_MAC_CTX *
+_hmac_ctx_new (const char *digest)
+{
+   EVP_MAC_CTX *ctx;
+   OSSL_PARAM params[2];
+
+   ctx = EVP_MAC_CTX_new (_hmac);
+   BSON_ASSERT (ctx);
+   params[0] = OSSL_PARAM_construct_utf8_string (
+      OSSL_MAC_PARAM_DIGEST, (char *) digest, 0);
+   params[1] = OSSL_PARAM_construct_end ();
+   BSON_ASSERT (EVP_MAC_CTX_set_params (ctx, params));
+   return ctx;
+}
+#endif
+
+/* Returns the calling thread's contexts, or NULL if it has none yet. */
+static _thread_ctx_t *
+_thread_ctx_get (void)
+{
+#ifdef _WIN32
+   return FlsGetValue (_thread_ctx_key);
+#else
+   return pthread_getspecific (_thread_ctx_key);
+#endif
+}
+
+/* Returns the calling thread's contexts, creating them on first use. */
+static _thread_ctx_t *
+_thread_ctx (void)
+{
+   _thread_ctx_t *tctx;
+
+   tctx = _thread_ctx_get ();
+   if (tctx) {
+      return tctx;
+   }
+
+   tctx = bson_malloc0 (sizeof (*tctx));
+   BSON_ASSERT (tctx);
+   _mongocrypt_mutex_init (&tctx->slots_mutex);
+   tctx->cipher = EVP_CIPHER_CTX_new ();
+   BSON_ASSERT (tctx->cipher);
+#ifdef LIBCRYPTO_HAS_FETCH
+   tctx->hmac_sha_256 = _hmac_ctx_new ("SHA256");
+   tctx->hmac_sha_512 = _hmac_ctx_new ("SHA512");
+#else
+   tctx->hmac = HMAC_CTX_new ();
+   BSON_ASSERT (tctx->hmac);
+#endif
+
+#ifdef _WIN32
+   BSON_ASSERT (FlsSetValue (_thread_ctx_key, tctx));
+#else
+   BSON_ASSERT (0 == pthread_setspecific (_thread_ctx_key, tctx));
 #endif
 
+   MONGOCRYPT_WITH_MUTEX (_thread_ctxs_mutex)
+   {
+      tctx->next = _thread_ctxs;
+      if (_thread_ctxs) {
+         _thread_ctxs->prev = tctx;
+      }
+      _thread_ctxs = tctx;
+   }
+   return tctx;
+}
+
 bool _native_crypto_initialized = false;
 
+#ifdef LIBCRYPTO_HAS_FETCH
+/* Frees the fetched algorithms. Registered with atexit after the first fetch,
+ * so it runs before OpenSSL's own exit handler. */
+static void
+_native_crypto_cleanup (void)
+{
+   EVP_CIPHER_free ((EVP_CIPHER *) _aes_256_cbc);
+   EVP_CIPHER_free ((EVP_CIPHER *) _aes_256_ecb);
+   EVP_CIPHER_free ((EVP_CIPHER *) _aes_256_ctr);
+   EVP_MAC_free (_hmac);
+   _aes_256_cbc = NULL;
+   _aes_256_ecb = NULL;
+   _aes_256_ctr = NULL;
+   _hmac = NULL;
+}
+#endif
+
 void
 _native_crypto_init ()
 {
+#ifdef LIBCRYPTO_HAS_FETCH
+   _aes_256_cbc = EVP_CIPHER_fetch (NULL, "AES-256-CBC", NULL);
+   _aes_256_ecb = EVP_CIPHER_fetch (NULL, "AES-256-ECB", NULL);
+   _aes_256_ctr = EVP_CIPHER_fetch (NULL, "AES-256-CTR", NULL);
+   _hmac = EVP_MAC_fetch (NULL, "HMAC", NULL);
+   if (0 != atexit (_native_crypto_cleanup)) {
+      _native_crypto_cleanup ();
+      return;
+   }
+   if (!_hmac) {
+      return;
+   }
+#else
+   _aes_256_cbc = EVP_aes_256_cbc ();
+   _aes_256_ecb = EVP_aes_256_ecb ();
+   _aes_256_ctr = EVP_aes_256_ctr ();
+#endif
+   if (!_aes_256_cbc || !_aes_256_ecb || !_aes_256_ctr) {
+      return;
+   }
+
+   _mongocrypt_mutex_init (&_thread_ctxs_mutex);
+
+#ifdef _WIN32
+   _thread_ctx_key = FlsAlloc (_thread_ctx_destroy_fls);
+   if (_thread_ctx_key == FLS_OUT_OF_INDEXES) {
+      return;
+   }
+#else
+   if (0 != pthread_key_create (&_thread_ctx_key, _thread_ctx_destroy)) {
+      return;
+   }
+#endif
+
    _native_crypto_initialized = true;
 }
 
+/* Clears every thread's copy of the precomputed key with id @key_id.
+ * Resetting a cipher context and freeing an HMAC context zero the copied key
+ * material. The key must not be in use. */
+static void
+_clear_key_copies (int64_t key_id)
+{
+   _thread_ctx_t *tctx;
+   uint32_t i;
+
+   MONGOCRYPT_WITH_MUTEX (_thread_ctxs_mutex)
+   {
+      for (tctx = _thread_ctxs; tctx; tctx = tctx->next) {
+         _mongocrypt_mutex_lock (&tctx->slots_mutex);
+         for (i = 0; i < THREAD_KEY_SLOTS; i++) {
+            if (tctx->cipher_slots[i].id == key_id) {
+               EVP_CIPHER_CTX_reset (tctx->cipher_slots[i].ctx);
+               tctx->cipher_slots[i].id = 0;
+            }
+            if (tctx->hmac_slots[i].id == key_id) {
+               _hmac_ctx_free (tctx->hmac_slots[i].ctx);
+               tctx->hmac_slots[i].ctx = NULL;
+               tctx->hmac_slots[i].id = 0;
+            }
+         }
+         _mongocrypt_mutex_unlock (&tctx->slots_mutex);
+      }
+   }
+}
+
+/* Returns the calling thread's copy of the precomputed cipher context
+ * @key_ctx with id @key_id, copying it into a slot if the thread does not
+ * hold it. Returns NULL and sets @status on error. */
+static EVP_CIPHER_CTX *
+_cipher_slot (int64_t key_id,
+              const EVP_CIPHER_CTX *key_ctx,
+              mongocrypt_status_t *status)
+{
+   _thread_ctx_t *tctx = _thread_ctx ();
+   _cipher_slot_t *slot;
+   EVP_CIPHER_CTX *ctx = NULL;
+   uint32_t i;
+
+   _mongocrypt_mutex_lock (&tctx->slots_mutex);
+   for (i = 0; i < THREAD_KEY_SLOTS; i++) {
+      if (tctx->cipher_slots[i].id == key_id) {
+         ctx = tctx->cipher_slots[i].ctx;
+         break;
+      }
+   }
+
+   if (!ctx) {
+      slot = &tctx->cipher_slots[tctx->next_cipher_slot];
+      tctx->next_cipher_slot =
+         (tctx->next_cipher_slot + 1) % THREAD_KEY_SLOTS;
+      slot->id = 0;
+      if (!slot->ctx) {
+         slot->ctx = EVP_CIPHER_CTX_new ();
+         BSON_ASSERT (slot->ctx);
+      }
+      if (EVP_CIPHER_CTX_copy (slot->ctx, key_ctx)) {
+         slot->id = key_id;
+         ctx = slot->ctx;
+      } else {
+         CLIENT_ERR ("error in EVP_CIPHER_CTX_copy: %s",
+                     ERR_error_string (ERR_get_error (), NULL));
+         EVP_CIPHER_CTX_reset (slot->ctx);
+      }
+   }
+   _mongocrypt_mutex_unlock (&tctx->slots_mutex);
+   return ctx;
+}
+
+/* _reset_cipher resets @ctx after a failed call so that no partial operation
+ * is left for the next call. */
+static void
+_reset_cipher (EVP_CIPHER_CTX *ctx)
+{
+   _thread_ctx_t *tctx = _thread_ctx ();
+   uint32_t i;
+
+   _mongocrypt_mutex_lock (&tctx->slots_mutex);
+   for (i = 0; i < THREAD_KEY_SLOTS; i++) {
+      if (tctx->cipher_slots[i].ctx == ctx) {
+         tctx->cipher_slots[i].id = 0;
+      }
+   }
+   EVP_CIPHER_CTX_reset (ctx);
+   _mongocrypt_mutex_unlock (&tctx->slots_mutex);
+}
+
+/* _init_cipher returns a cipher context of the calling thread keyed for
+ * @cipher, with the IV set. If @args.native_key is set, it must be a
+ * precomputed key for @cipher, and its key schedule is reused.
+ * @enc is 1 to encrypt and 0 to decrypt.
+ * Returns NULL and sets @status on error. */
+static EVP_CIPHER_CTX *
+_init_cipher (const EVP_CIPHER *cipher, aes_256_args_t args, int enc)
+{
+   const _native_crypto_aes_key_t *native_key = args.native_key;
+   const unsigned char *iv = NULL == args.iv ? NULL : args.iv->data;
+   mongocrypt_status_t *status = args.status;
+   EVP_CIPHER_CTX *ctx;
+   int ok;
+
+   if (native_key) {
+      ctx = _cipher_slot (enc ? native_key->encrypt_id : native_key->decrypt_id,
+                          enc ? native_key->encrypt : native_key->decrypt,
+                          status);
+      if (!ctx) {
+         return NULL;
+      }
+      /* A NULL cipher and key keep the expanded key and only set the IV. */
+      ok = EVP_CipherInit_ex (ctx, NULL, NULL /* engine */, NULL, iv, enc);
+   } else {
+      ctx = _thread_ctx ()->cipher;
+      ok = EVP_CipherInit_ex (
+         ctx, cipher, NULL /* engine */, args.key->data, iv, enc);
+   }
+
+   if (!ok) {
+      CLIENT_ERR ("error in EVP_CipherInit_ex: %s",
+                  ERR_error_string (ERR_get_error (), NULL));
+      _reset_cipher (ctx);
+      return NULL;
+   }
+   return ctx;
+}
+
 /* _encrypt_with_cipher encrypts @in with the OpenSSL cipher specified by
  * @cipher.
  * @key is the input key. @iv is the input IV.
@@ -73,22 +478,14 @@ _encrypt_with_cipher (const EVP_CIPHER *cipher, aes_256_args_t args)
    int intermediate_bytes_written;
    mongocrypt_status_t *status = args.status;
 
-   ctx = EVP_CIPHER_CTX_new ();
-
-   BSON_ASSERT (ctx);
    BSON_ASSERT (cipher);
    BSON_ASSERT (NULL == args.iv ||
                 EVP_CIPHER_iv_length (cipher) == args.iv->len);
    BSON_ASSERT (EVP_CIPHER_key_length (cipher) == args.key->len);
 
-   if (!EVP_EncryptInit_ex (ctx,
-                            cipher,
-                            NULL /* engine */,
-                            args.key->data,
-                            NULL == args.iv ? NULL : args.iv->data)) {
-      CLIENT_ERR ("error in EVP_EncryptInit_ex: %s",
-                  ERR_error_string (ERR_get_error (), NULL));
-      goto done;
+   ctx = _init_cipher (cipher, args, 1);
+   if (!ctx) {
+      return false;
    }
 
    /* Disable the default OpenSSL padding. */
@@ -118,7 +515,9 @@ _encrypt_with_cipher (const EVP_CIPHER *cipher, aes_256_args_t args)
 
    ret = true;
 done:
-   EVP_CIPHER_CTX_free (ctx);
+   if (!ret) {
+      _reset_cipher (ctx);
+   }
    return ret;
 }
 
@@ -137,16 +536,12 @@ _decrypt_with_cipher (const EVP_CIPHER *cipher, aes_256_args_t args)
    int intermediate_bytes_written;
    mongocrypt_status_t *status = args.status;
 
-   ctx = EVP_CIPHER_CTX_new ();
-
    BSON_ASSERT (EVP_CIPHER_iv_length (cipher) == args.iv->len);
    BSON_ASSERT (EVP_CIPHER_key_length (cipher) == args.key->len);
 
-   if (!EVP_DecryptInit_ex (
-          ctx, cipher, NULL /* engine */, args.key->data, args.iv->data)) {
-      CLIENT_ERR ("error in EVP_DecryptInit_ex: %s",
-                  ERR_error_string (ERR_get_error (), NULL));
-      goto done;
+   ctx = _init_cipher (cipher, args, 0);
+   if (!ctx) {
+      return false;
    }
 
    /* Disable padding. */
@@ -177,88 +572,111 @@ _decrypt_with_cipher (const EVP_CIPHER *cipher, aes_256_args_t args)
 
    ret = true;
 done:
-   EVP_CIPHER_CTX_free (ctx);
+   if (!ret) {
+      _reset_cipher (ctx);
+   }
    return ret;
 }
 
 bool
 _native_crypto_aes_256_cbc_encrypt (aes_256_args_t args)
 {
-   return _encrypt_with_cipher (EVP_aes_256_cbc (), args);
+   return _encrypt_with_cipher (_aes_256_cbc, args);
 }
 
 bool
 _native_crypto_aes_256_cbc_decrypt (aes_256_args_t args)
 {
-   return _decrypt_with_cipher (EVP_aes_256_cbc (), args);
+   return _decrypt_with_cipher (_aes_256_cbc, args);
 }
 
 bool
 _native_crypto_aes_256_ecb_encrypt (aes_256_args_t args)
 {
-   return _encrypt_with_cipher (EVP_aes_256_ecb (), args);
+   return _encrypt_with_cipher (_aes_256_ecb, args);
 }
 
 
-/* _hmac_with_hash computes an HMAC of @in with the OpenSSL hash specified by
- * @hash.
+/* The digests _hmac_with_hash supports. */
+typedef enum { HMAC_SHA_256, HMAC_SHA_512 } _hmac_digest_t;
+
+static const EVP_MD *
+_hmac_digest_md (_hmac_digest_t digest)
+{
+   return digest == HMAC_SHA_512 ? EVP_sha512 () : EVP_sha256 ();
+}
+
+/* _hmac_with_hash computes an HMAC of the concatenation of the @num_in buffers
+ * in @in with the digest @digest, using the calling thread's MAC context.
  * @key is the input key.
  * @out is the output. @out must be allocated by the caller with
  * the exact length for the output. E.g. for HMAC 256, @out->len must be 32.
  * Returns false and sets @status on error. @status is required. */
-bool
-_hmac_with_hash (const EVP_MD *hash,
+static bool
+_hmac_with_hash (_hmac_digest_t digest,
                  const _mongocrypt_buffer_t *key,
                  const _mongocrypt_buffer_t *in,
+                 uint32_t num_in,
                  _mongocrypt_buffer_t *out,
                  mongocrypt_status_t *status)
 {
-#if OPENSSL_VERSION_NUMBER >= 0x10100000L
-   if (!HMAC (hash,
-              key->data,
-              key->len,
-              in->data,
-              in->len,
-              out->data,
-              NULL /* unused out len */)) {
+   const EVP_MD *hash = _hmac_digest_md (digest);
+   uint32_t i;
+
+   if (out->len != EVP_MD_size (hash)) {
+      CLIENT_ERR ("out does not contain %d bytes", EVP_MD_size (hash));
+      return false;
+   }
+
+#ifdef LIBCRYPTO_HAS_FETCH
+   _thread_ctx_t *tctx = _thread_ctx ();
+   EVP_MAC_CTX *ctx =
+      digest == HMAC_SHA_512 ? tctx->hmac_sha_512 : tctx->hmac_sha_256;
+   size_t out_len;
+
+   if (!EVP_MAC_init (ctx, key->data, key->len, NULL /* params */)) {
       CLIENT_ERR ("error initializing HMAC: %s",
                   ERR_error_string (ERR_get_error (), NULL));
       return false;
    }
-   return true;
-#else
-   HMAC_CTX *ctx;
-   bool ret = false;
 
-   ctx = HMAC_CTX_new ();
+   for (i = 0; i < num_in; i++) {
+      if (!EVP_MAC_update (ctx, in[i].data, in[i].len)) {
+         CLIENT_ERR ("error updating HMAC: %s",
+                     ERR_error_string (ERR_get_error (), NULL));
+         return false;
+      }
+   }
 
-   if (out->len != EVP_MD_size (hash)) {
-      CLIENT_ERR ("out does not contain %d bytes", EVP_MD_size (hash));
+   if (!EVP_MAC_final (ctx, out->data, &out_len, out->len)) {
+      CLIENT_ERR ("error finalizing: %s",
+                  ERR_error_string (ERR_get_error (), NULL));
       return false;
    }
+   return true;
+#else
+   HMAC_CTX *ctx = _thread_ctx ()->hmac;
 
    if (!HMAC_Init_ex (ctx, key->data, key->len, hash, NULL /* engine */)) {
       CLIENT_ERR ("error initializing HMAC: %s",
                   ERR_error_string (ERR_get_error (), NULL));
-      goto done;
+      return false;
    }
 
-   if (!HMAC_Update (ctx, in->data, in->len)) {
-      CLIENT_ERR ("error updating HMAC: %s",
-                  ERR_error_string (ERR_get_error (), NULL));
-      goto done;
+   for (i = 0; i < num_in; i++) {
+      if (!HMAC_Update (ctx, in[i].data, in[i].len)) {
+         CLIENT_ERR ("error updating HMAC: %s",
+                     ERR_error_string (ERR_get_error (), NULL));
+         return false;
+      }
    }
 
    if (!HMAC_Final (ctx, out->data, NULL /* unused out len */)) {
       CLIENT_ERR ("error finalizing: %s",
                   ERR_error_string (ERR_get_error (), NULL));
-      goto done;
+      return false;
    }
-
-   ret = true;
-done:
-   HMAC_CTX_free (ctx);
-   return ret;
+   return true;
 #endif
 }
 
@@ -268,7 +686,138 @@ _native_crypto_hmac_sha_512 (const _mongocrypt_buffer_t *key,
                              _mongocrypt_buffer_t *out,
                              mongocrypt_status_t *status)
 {
-   return _hmac_with_hash (EVP_sha512 (), key, in, out, status);
+   return _hmac_with_hash (HMAC_SHA_512, key, in, 1, out, status);
+}
+
+bool
+_native_crypto_hmac_sha_512_parts (const _mongocrypt_buffer_t *key,
+                                   const _mongocrypt_buffer_t *in,
+                                   uint32_t num_in,
+                                   _mongocrypt_buffer_t *out,
+                                   mongocrypt_status_t *status)
+{
+   return _hmac_with_hash (HMAC_SHA_512, key, in, num_in, out, status);
+}
+
+
+/* Returns the calling thread's copy of the precomputed HMAC @key, copying it
+ * into a slot if the thread does not hold it. Returns NULL and sets @status on
+ * error. */
+static _hmac_ctx_t *
+_hmac_slot (const _native_crypto_hmac_key_t *key, mongocrypt_status_t *status)
+{
+   _thread_ctx_t *tctx = _thread_ctx ();
+   _hmac_slot_t *slot;
+   _hmac_ctx_t *ctx = NULL;
+   uint32_t i;
+
+   _mongocrypt_mutex_lock (&tctx->slots_mutex);
+   for (i = 0; i < THREAD_KEY_SLOTS; i++) {
+      if (tctx->hmac_slots[i].id == key->id) {
+         ctx = tctx->hmac_slots[i].ctx;
+         break;
+      }
+   }
+   _mongocrypt_mutex_unlock (&tctx->slots_mutex);
+   if (ctx) {
+      return ctx;
+   }
+
+#ifdef LIBCRYPTO_HAS_FETCH
+   ctx = EVP_MAC_CTX_dup (key->ctx);
+#else
+   /* Copy into a fresh context. Older versions of HMAC_CTX_copy leak the
+    * digest state of a context that is already in use. */
+   ctx = HMAC_CTX_new ();
+   BSON_ASSERT (ctx);
+   if (!HMAC_CTX_copy (ctx, (HMAC_CTX *) key->ctx)) {
+      HMAC_CTX_free (ctx);
+      ctx = NULL;
+   }
+#endif
+   if (!ctx) {
+      CLIENT_ERR ("error copying HMAC key: %s",
+                  ERR_error_string (ERR_get_error (), NULL));
+      return NULL;
+   }
+
+   _mongocrypt_mutex_lock (&tctx->slots_mutex);
+   slot = &tctx->hmac_slots[tctx->next_hmac_slot];
+   tctx->next_hmac_slot = (tctx->next_hmac_slot + 1) % THREAD_KEY_SLOTS;
+   _hmac_ctx_free (slot->ctx);
+   slot->ctx = ctx;
+   slot->id = key->id;
+   _mongocrypt_mutex_unlock (&tctx->slots_mutex);
+   return ctx;
+}
+
+bool
+_native_crypto_hmac_sha_512_with_key (const _native_crypto_hmac_key_t *key,
+                                      const _mongocrypt_buffer_t *in,
+                                      uint32_t num_in,
+                                      _mongocrypt_buffer_t *out,
+                                      mongocrypt_status_t *status)
+{
+   _hmac_ctx_t *ctx;
+   uint32_t i;
+
+   if (out->len != MONGOCRYPT_HMAC_SHA512_LEN) {
+      CLIENT_ERR ("out does not contain %d bytes", MONGOCRYPT_HMAC_SHA512_LEN);
+      return false;
+   }
+
+   ctx = _hmac_slot (key, status);
+   if (!ctx) {
+      return false;
+   }
+
+#ifdef LIBCRYPTO_HAS_FETCH
+   size_t out_len;
+
+   /* A NULL key restarts with the pads already hashed. */
+   if (!EVP_MAC_init (ctx, NULL, 0, NULL /* params */)) {
+      CLIENT_ERR ("error initializing HMAC: %s",
+                  ERR_error_string (ERR_get_error (), NULL));
+      return false;
+   }
+
+   for (i = 0; i < num_in; i++) {
+      if (!EVP_MAC_update (ctx, in[i].data, in[i].len)) {
+         CLIENT_ERR ("error updating HMAC: %s",
+                     ERR_error_string (ERR_get_error (), NULL));
+         return false;
+      }
+   }
+
+   if (!EVP_MAC_final (ctx, out->data, &out_len, out->len)) {
+      CLIENT_ERR ("error finalizing: %s",
+                  ERR_error_string (ERR_get_error (), NULL));
+      return false;
+   }
+   return true;
+#else
+   /* A NULL key and hash restart with the pads already hashed. */
+   if (!HMAC_Init_ex (ctx, NULL, 0, NULL, NULL /* engine */)) {
+      CLIENT_ERR ("error initializing HMAC: %s",
+                  ERR_error_string (ERR_get_error (), NULL));
+      return false;
+   }
+
+   for (i = 0; i < num_in; i++) {
+      if (!HMAC_Update (ctx, in[i].data, in[i].len)) {
+         CLIENT_ERR ("error updating HMAC: %s",
+                     ERR_error_string (ERR_get_error (), NULL));
+         return false;
+      }
+   }
+
+   if (!HMAC_Final (ctx, out->data, NULL /* unused out len */)) {
+      CLIENT_ERR ("error finalizing: %s",
+                  ERR_error_string (ERR_get_error (), NULL));
+      return false;
+   }
+   return true;
+#endif
 }
 
 
@@ -296,13 +845,13 @@ _native_crypto_random (_mongocrypt_buffer_t *out,
 bool
 _native_crypto_aes_256_ctr_encrypt (aes_256_args_t args)
 {
-   return _encrypt_with_cipher (EVP_aes_256_ctr (), args);
+   return _encrypt_with_cipher (_aes_256_ctr, args);
 }
 
 bool
 _native_crypto_aes_256_ctr_decrypt (aes_256_args_t args)
 {
-   return _decrypt_with_cipher (EVP_aes_256_ctr (), args);
+   return _decrypt_with_cipher (_aes_256_ctr, args);
 }
 
 bool
@@ -311,7 +860,112 @@ _native_crypto_hmac_sha_256 (const _mongocrypt_buffer_t *key,
                              _mongocrypt_buffer_t *out,
                              mongocrypt_status_t *status)
 {
-   return _hmac_with_hash (EVP_sha256 (), key, in, out, status);
+   return _hmac_with_hash (HMAC_SHA_256, key, in, 1, out, status);
+}
+
+bool
+_native_crypto_hmac_sha_256_parts (const _mongocrypt_buffer_t *key,
+                                   const _mongocrypt_buffer_t *in,
+                                   uint32_t num_in,
+                                   _mongocrypt_buffer_t *out,
+                                   mongocrypt_status_t *status)
+{
+   return _hmac_with_hash (HMAC_SHA_256, key, in, num_in, out, status);
+}
+
+_native_crypto_aes_key_t *
+_native_crypto_aes_256_cbc_key_new (const _mongocrypt_buffer_t *key)
+{
+   _native_crypto_aes_key_t *aes_key;
+
+   if (key->len != (uint32_t) EVP_CIPHER_key_length (_aes_256_cbc)) {
+      return NULL;
+   }
+
+   aes_key = bson_malloc0 (sizeof (*aes_key));
+   BSON_ASSERT (aes_key);
+   aes_key->encrypt = EVP_CIPHER_CTX_new ();
+   aes_key->decrypt = EVP_CIPHER_CTX_new ();
+   if (!aes_key->encrypt || !aes_key->decrypt ||
+       !EVP_EncryptInit_ex (aes_key->encrypt,
+                            _aes_256_cbc,
+                            NULL /* engine */,
+                            key->data,
+                            NULL /* iv */) ||
+       !EVP_DecryptInit_ex (aes_key->decrypt,
+                            _aes_256_cbc,
+                            NULL /* engine */,
+                            key->data,
+                            NULL /* iv */)) {
+      /* Callers fall back to keying each call. */
+      ERR_clear_error ();
+      _native_crypto_aes_256_cbc_key_destroy (aes_key);
+      return NULL;
+   }
+   EVP_CIPHER_CTX_set_padding (aes_key->encrypt, 0);
+   EVP_CIPHER_CTX_set_padding (aes_key->decrypt, 0);
+   aes_key->encrypt_id = mlib_atomic_add_i64 (&_next_key_id, 1);
+   aes_key->decrypt_id = mlib_atomic_add_i64 (&_next_key_id, 1);
+   return aes_key;
+}
+
+void
+_native_crypto_aes_256_cbc_key_destroy (_native_crypto_aes_key_t *key)
+{
+   if (!key) {
+      return;
+   }
+
+   if (key->encrypt_id) {
+      _clear_key_copies (key->encrypt_id);
+      _clear_key_copies (key->decrypt_id);
+   }
+   /* Freeing a cipher context zeroes the key schedule. */
+   EVP_CIPHER_CTX_free (key->encrypt);
+   EVP_CIPHER_CTX_free (key->decrypt);
+   bson_free (key);
+}
+
+_native_crypto_hmac_key_t *
+_native_crypto_hmac_sha_512_key_new (const _mongocrypt_buffer_t *key)
+{
+   _native_crypto_hmac_key_t *hmac_key;
+   int ok;
+
+   hmac_key = bson_malloc0 (sizeof (*hmac_key));
+   BSON_ASSERT (hmac_key);
+#ifdef LIBCRYPTO_HAS_FETCH
+   hmac_key->ctx = _hmac_ctx_new ("SHA512");
+   ok = EVP_MAC_init (hmac_key->ctx, key->data, key->len, NULL /* params */);
+#else
+   hmac_key->ctx = HMAC_CTX_new ();
+   BSON_ASSERT (hmac_key->ctx);
+   ok = HMAC_Init_ex (
+      hmac_key->ctx, key->data, key->len, EVP_sha512 (), NULL /* engine */);
+#endif
+   if (!ok) {
+      /* Callers fall back to keying each call. */
+      ERR_clear_error ();
+      _native_crypto_hmac_sha_512_key_destroy (hmac_key);
+      return NULL;
+   }
+   hmac_key->id = mlib_atomic_add_i64 (&_next_key_id, 1);
+   return hmac_key;
+}
+
+void
+_native_crypto_hmac_sha_512_key_destroy (_native_crypto_hmac_key_t *key)
+{
+   if (!key) {
+      return;
+   }
+
+   if (key->id) {
+      _clear_key_copies (key->id);
+   }
+   /* Freeing an HMAC context zeroes the hashed pads. */
+   _hmac_ctx_free (key->ctx);
+   bson_free (key);
 }
 
 #endif /* MONGOCRYPT_ENABLE_CRYPTO_LIBCRYPTO */
@@ -58,6 +58,17 @@ _native_crypto_hmac_sha_512 (const _mongocrypt_buffer_t *key,
    return false;
 }
 
+bool
+_native_crypto_hmac_sha_512_parts (const _mongocrypt_buffer_t *key,
+                                   const _mongocrypt_buffer_t *in,
+                                   uint32_t num_in,
+                                   _mongocrypt_buffer_t *out,
+                                   mongocrypt_status_t *status)
+{
+   CLIENT_ERR ("hook not set for hmac_sha_512");
+   return false;
+}
+
 
 bool
 _native_crypto_random (_mongocrypt_buffer_t *out,
@@ -93,4 +104,51 @@ _native_crypto_hmac_sha_256 (const _mongocrypt_buffer_t *key,
    return false;
 }
 
+bool
+_native_crypto_hmac_sha_256_parts (const _mongocrypt_buffer_t *key,
+                                   const _mongocrypt_buffer_t *in,
+                                   uint32_t num_in,
+                                   _mongocrypt_buffer_t *out,
+                                   mongocrypt_status_t *status)
+{
+   CLIENT_ERR ("hook not set for _native_crypto_hmac_sha_256");
+   return false;
+}
+
+
+_native_crypto_aes_key_t *
+_native_crypto_aes_256_cbc_key_new (const _mongocrypt_buffer_t *key)
+{
+   return NULL;
+}
+
+void
+_native_crypto_aes_256_cbc_key_destroy (_native_crypto_aes_key_t *key)
+{
+   BSON_ASSERT (!key);
+}
+
+_native_crypto_hmac_key_t *
+_native_crypto_hmac_sha_512_key_new (const _mongocrypt_buffer_t *key)
+{
+   return NULL;
+}
+
+void
+_native_crypto_hmac_sha_512_key_destroy (_native_crypto_hmac_key_t *key)
+{
+   BSON_ASSERT (!key);
+}
+
+bool
+_native_crypto_hmac_sha_512_with_key (const _native_crypto_hmac_key_t *key,
+                                      const _mongocrypt_buffer_t *in,
+                                      uint32_t num_in,
+                                      _mongocrypt_buffer_t *out,
+                                      mongocrypt_status_t *status)
+{
+   CLIENT_ERR ("precomputed keys are not supported");
+   return false;
+}
+
 #endif /* MONGOCRYPT_ENABLE_CRYPTO */
\ No newline at end of file
@@ -110,4 +110,26 @@ DECL_TOKEN_TYPE (mc_ECCDerivedFromDataTokenAndCounter,
 #undef DECL_TOKEN_TYPE
 #undef DECL_TOKEN_TYPE_1
 
+/* The tokens derived from an index key that do not depend on the value being
+ * encrypted. They are immutable once created, so they may be computed once per
+ * key and shared. */
+typedef struct {
+   mc_CollectionsLevel1Token_t *collectionsLevel1Token;
+   mc_ServerDataEncryptionLevel1Token_t *serverDataEncryptionLevel1Token;
+   mc_EDCToken_t *edcToken;
+   mc_ESCToken_t *escToken;
+   mc_ECCToken_t *eccToken;
+   mc_ECOCToken_t *ecocToken;
+} mc_IndexKeyTokens_t;
+
+/* Derives the tokens from the TokenKey of a MONGOCRYPT_KEY_LEN byte
+ * @indexKey. Returns NULL and sets @status on error. */
+mc_IndexKeyTokens_t *
+mc_IndexKeyTokens_new (_mongocrypt_crypto_t *crypto,
+                       const _mongocrypt_buffer_t *indexKey,
+                       mongocrypt_status_t *status);
+
+void
+mc_IndexKeyTokens_destroy (mc_IndexKeyTokens_t *tokens);
+
 #endif /* MONGOCRYPT_TOKENS_PRIVATE_H */
\ No newline at end of file
@@ -15,6 +15,7 @@
  */
 
 #include "mc-tokens-private.h"
+#include "mongocrypt-private.h"
 
 /// Define a token type of the given name, with constructor parameters given as
 /// the remaining arguments. This macro usage should be followed by the
@@ -141,3 +142,92 @@ DEF_TOKEN_TYPE (mc_ECCDerivedFromDataTokenAndCounter,
 IMPL_TOKEN_NEW_CONST (mc_ECCDerivedFromDataTokenAndCounter,
                       mc_ECCDerivedFromDataToken_get (ECCDerivedFromDataToken),
                       u)
+
+mc_IndexKeyTokens_t *
+mc_IndexKeyTokens_new (_mongocrypt_crypto_t *crypto,
+                       const _mongocrypt_buffer_t *indexKey,
+                       mongocrypt_status_t *status)
+{
+   mc_IndexKeyTokens_t *tokens;
+   _mongocrypt_buffer_t tokenKey;
+
+   BSON_ASSERT_PARAM (crypto);
+   BSON_ASSERT_PARAM (indexKey);
+
+   if (indexKey->len != MONGOCRYPT_KEY_LEN) {
+      CLIENT_ERR ("invalid indexKey, expected len=%" PRIu32
+                  ", got len=%" PRIu32,
+                  MONGOCRYPT_KEY_LEN,
+                  indexKey->len);
+      return NULL;
+   }
+
+   // indexKey is 3 equal sized keys: [Ke][Km][TokenKey]
+   BSON_ASSERT (MONGOCRYPT_KEY_LEN == (3 * MONGOCRYPT_TOKEN_KEY_LEN));
+   BSON_ASSERT (_mongocrypt_buffer_from_subrange (&tokenKey,
+                                                  indexKey,
+                                                  2 * MONGOCRYPT_TOKEN_KEY_LEN,
+                                                  MONGOCRYPT_TOKEN_KEY_LEN));
+
+   tokens = bson_malloc0 (sizeof (*tokens));
+   BSON_ASSERT (tokens);
+
+   tokens->collectionsLevel1Token =
+      mc_CollectionsLevel1Token_new (crypto, &tokenKey, status);
+   if (!tokens->collectionsLevel1Token) {
+      goto fail;
+   }
+
+   tokens->serverDataEncryptionLevel1Token =
+      mc_ServerDataEncryptionLevel1Token_new (crypto, &tokenKey, status);
+   if (!tokens->serverDataEncryptionLevel1Token) {
+      goto fail;
+   }
+
+   tokens->edcToken =
+      mc_EDCToken_new (crypto, tokens->collectionsLevel1Token, status);
+   if (!tokens->edcToken) {
+      goto fail;
+   }
+
+   tokens->escToken =
+      mc_ESCToken_new (crypto, tokens->collectionsLevel1Token, status);
+   if (!tokens->escToken) {
+      goto fail;
+   }
+
+   tokens->eccToken =
+      mc_ECCToken_new (crypto, tokens->collectionsLevel1Token, status);
+   if (!tokens->eccToken) {
+      goto fail;
+   }
+
+   tokens->ecocToken =
+      mc_ECOCToken_new (crypto, tokens->collectionsLevel1Token, status);
+   if (!tokens->ecocToken) {
+      goto fail;
+   }
+
+   return tokens;
+
+fail:
+   mc_IndexKeyTokens_destroy (tokens);
+   return NULL;
+}
+
+void
+mc_IndexKeyTokens_destroy (mc_IndexKeyTokens_t *tokens)
+{
+   if (!tokens) {
+      return;
+   }
+
+   mc_CollectionsLevel1Token_destroy (tokens->collectionsLevel1Token);
+   mc_ServerDataEncryptionLevel1Token_destroy (
+      tokens->serverDataEncryptionLevel1Token);
+   mc_EDCToken_destroy (tokens->edcToken);
+   mc_ESCToken_destroy (tokens->escToken);
+   mc_ECCToken_destroy (tokens->eccToken);
+   mc_ECOCToken_destroy (tokens->ecocToken);
+   bson_free (tokens);
+}
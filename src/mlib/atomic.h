@@ -0,0 +1,84 @@
+#ifndef MLIB_ATOMIC_H
+#define MLIB_ATOMIC_H
+
+#include "./user-check.h"
+
+#ifdef _MSC_VER
+#include "./windows-lean.h"
+#endif
+
+#include <stdint.h>
+
+/**
+ * @brief Atomically add to a 32-bit integer with sequentially consistent
+ * ordering.
+ *
+ * @param p The integer to modify. Should only be accessed atomically.
+ * @param n The amount to add. May be negative.
+ * @return int32_t The value of the integer after the addition.
+ */
+static inline int32_t
+mlib_atomic_add_i32 (volatile int32_t *p, int32_t n)
+{
+#ifdef _MSC_VER
+   return (int32_t) InterlockedExchangeAdd ((volatile LONG *) p, (LONG) n) + n;
+#else
+   return __atomic_add_fetch (p, n, __ATOMIC_SEQ_CST);
+#endif
+}
+
+/**
+ * @brief Atomically add to a 64-bit integer with sequentially consistent
+ * ordering.
+ *
+ * @param p The integer to modify. Should only be accessed atomically.
+ * @param n The amount to add. May be negative.
+ * @return int64_t The value of the integer after the addition.
+ */
+static inline int64_t
+mlib_atomic_add_i64 (volatile int64_t *p, int64_t n)
+{
+#ifdef _MSC_VER
+   return (int64_t) InterlockedExchangeAdd64 ((volatile LONG64 *) p,
+                                              (LONG64) n) +
+          n;
+#else
+   return __atomic_add_fetch (p, n, __ATOMIC_SEQ_CST);
+#endif
+}
+
+/**
+ * @brief Atomically store to a 32-bit integer with sequentially consistent
+ * ordering.
+ *
+ * @param p The integer to modify. Should only be accessed atomically.
+ * @param v The value to store.
+ */
+static inline void
+mlib_atomic_store_i32 (volatile int32_t *p, int32_t v)
+{
+#ifdef _MSC_VER
+   (void) InterlockedExchange ((volatile LONG *) p, (LONG) v);
+#else
+   __atomic_store_n (p, v, __ATOMIC_SEQ_CST);
+#endif
+}
+
+/**
+ * @brief Atomically load a 32-bit integer with sequentially consistent
+ * ordering.
+ *
+ * @param p The integer to read. Should only be accessed atomically.
+ * @return int32_t The value of the integer.
+ */
+static inline int32_t
+mlib_atomic_load_i32 (volatile int32_t *p)
+{
+#ifdef _MSC_VER
+   return (int32_t) InterlockedCompareExchange ((volatile LONG *) p, 0, 0);
+#else
+   return __atomic_load_n (p, __ATOMIC_SEQ_CST);
+#endif
+}
+
+#endif // MLIB_ATOMIC_H
@@ -21,4 +21,15 @@
 void
 _mongocrypt_cache_collinfo_init (_mongocrypt_cache_t *cache);
 
+/* Caches @collinfo, a listCollections result for @ns. If @plaintext_expiration
+ * is nonzero, a collection that needs no encryption is cached as an empty
+ * document expiring after @plaintext_expiration milliseconds. */
+bool
+_mongocrypt_cache_collinfo_add (_mongocrypt_cache_t *cache,
+                                const char *ns,
+                                const bson_t *collinfo,
+                                uint64_t plaintext_expiration,
+                                mongocrypt_status_t *status)
+   MONGOCRYPT_WARN_UNUSED_RESULT;
+
 #endif /* MONGOCRYPT_CACHE_COLLINFO_PRIVATE_H */
\ No newline at end of file
@@ -14,7 +14,7 @@
  * limitations under the License.
  */
 
-#include "mongocrypt-cache-private.h"
+#include "mongocrypt-cache-collinfo-private.h"
 /* The collinfo cache.
  *
  * Attribute is a null terminated namespace.
@@ -30,6 +30,18 @@ _cmp_attr (void *a, void *b, int *out)
 }
 
 
+static bool
+_hash_attr (void *ns, uint32_t n, uint32_t *out)
+{
+   if (n > 0) {
+      return false;
+   }
+   *out = _mongocrypt_cache_hash_bytes (
+      ns, strlen ((const char *) ns), CACHE_HASH_SEED);
+   return true;
+}
+
+
 static void *
 _copy_attr (void *ns)
 {
@@ -64,9 +76,58 @@ _mongocrypt_cache_collinfo_init (_mongocrypt_cache_t *cache)
    cache->cmp_attr = _cmp_attr;
    cache->copy_attr = _copy_attr;
    cache->destroy_attr = _destroy_attr;
+   cache->hash_attr = _hash_attr;
    cache->copy_value = _copy_value;
    cache->destroy_value = _destroy_value;
-   _mongocrypt_mutex_init (&cache->mutex);
-   cache->pair = NULL;
-   cache->expiration = CACHE_EXPIRATION_MS;
-}
\ No newline at end of file
+   _mongocrypt_cache_init (cache);
+}
+
+/* Returns true if @collinfo shows the collection needs no encryption: it is
+ * not a view, and has no JSON schema validator and no encryptedFields. */
+static bool
+_collinfo_is_plaintext (const bson_t *collinfo)
+{
+   bson_iter_t iter;
+
+   if (bson_iter_init_find (&iter, collinfo, "type") &&
+       BSON_ITER_HOLDS_UTF8 (&iter) &&
+       0 == strcmp ("view", bson_iter_utf8 (&iter, NULL))) {
+      return false;
+   }
+   if (bson_iter_init (&iter, collinfo) &&
+       bson_iter_find_descendant (&iter, "options.encryptedFields", &iter)) {
+      return false;
+   }
+   if (bson_iter_init (&iter, collinfo) &&
+       bson_iter_find_descendant (
+          &iter, "options.validator.$jsonSchema", &iter)) {
+      return false;
+   }
+   return true;
+}
+
+
+bool
+_mongocrypt_cache_collinfo_add (_mongocrypt_cache_t *cache,
+                                const char *ns,
+                                const bson_t *collinfo,
+                                uint64_t plaintext_expiration,
+                                mongocrypt_status_t *status)
+{
+   bson_t empty = BSON_INITIALIZER;
+   bool ret;
+
+   BSON_ASSERT_PARAM (cache);
+   BSON_ASSERT_PARAM (ns);
+   BSON_ASSERT_PARAM (collinfo);
+
+   if (plaintext_expiration > 0 && _collinfo_is_plaintext (collinfo)) {
+      ret = _mongocrypt_cache_add_copy_with_expiration (
+         cache, (void *) ns, &empty, plaintext_expiration, status);
+   } else {
+      ret = _mongocrypt_cache_add_copy (
+         cache, (void *) ns, (void *) collinfo, status);
+   }
+   bson_destroy (&empty);
+   return ret;
+}
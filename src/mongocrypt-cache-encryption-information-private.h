@@ -0,0 +1,53 @@
+/*
+ * Copyright 2022-present MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MONGOCRYPT_CACHE_ENCRYPTION_INFORMATION_PRIVATE_H
+#define MONGOCRYPT_CACHE_ENCRYPTION_INFORMATION_PRIVATE_H
+
+#include "mongocrypt-buffer-private.h"
+#include "mongocrypt-cache-private.h"
+
+/* A finished 'encryptionInformation' for a namespace, as appended to FLE2
+ * commands. A value is immutable once created and is shared by reference.
+ *
+ * The documents are only valid for @encrypted_field_config. The 'deleteTokens'
+ * also depend on the material of the keys it names, which never changes for a
+ * key id. */
+typedef struct {
+   _mongocrypt_buffer_t encrypted_field_config;
+   /* { "encryptionInformation": { "type", "schema" } } */
+   _mongocrypt_buffer_t encryption_information;
+   /* The same with "deleteTokens". Empty if not yet generated. */
+   _mongocrypt_buffer_t encryption_information_with_delete_tokens;
+   volatile int32_t refcount;
+} _mongocrypt_cache_encryption_information_value_t;
+
+void
+_mongocrypt_cache_encryption_information_init (_mongocrypt_cache_t *cache);
+
+/* Returns a new value with one reference. Copies the buffers.
+ * @encryption_information_with_delete_tokens may be NULL. */
+_mongocrypt_cache_encryption_information_value_t *
+_mongocrypt_cache_encryption_information_value_new (
+   const _mongocrypt_buffer_t *encrypted_field_config,
+   const _mongocrypt_buffer_t *encryption_information,
+   const _mongocrypt_buffer_t *encryption_information_with_delete_tokens);
+
+/* Releases a reference. The value is freed when the last is released. */
+void
+_mongocrypt_cache_encryption_information_value_destroy (void *value);
+
+#endif /* MONGOCRYPT_CACHE_ENCRYPTION_INFORMATION_PRIVATE_H */
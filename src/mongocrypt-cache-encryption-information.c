@@ -0,0 +1,130 @@
+/*
+ * Copyright 2022-present MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mongocrypt-cache-encryption-information-private.h"
+
+#include "mlib/atomic.h"
+/* The encryptionInformation cache.
+ *
+ * Attribute is a null terminated namespace.
+ * Value is a _mongocrypt_cache_encryption_information_value_t.
+ */
+
+
+static bool
+_cmp_attr (void *a, void *b, int *out)
+{
+   *out = strcmp ((char *) a, (char *) b);
+   return true;
+}
+
+
+static bool
+_hash_attr (void *ns, uint32_t n, uint32_t *out)
+{
+   if (n > 0) {
+      return false;
+   }
+   *out = _mongocrypt_cache_hash_bytes (
+      ns, strlen ((const char *) ns), CACHE_HASH_SEED);
+   return true;
+}
+
+
+static void *
+_copy_attr (void *ns)
+{
+   return bson_strdup ((const char *) ns);
+}
+
+
+static void
+_destroy_attr (void *ns)
+{
+   bson_free (ns);
+}
+
+
+/* Values are immutable, so a copy is another reference. */
+static void *
+_copy_value (void *value)
+{
+   _mongocrypt_cache_encryption_information_value_t *ei_value = value;
+
+   mlib_atomic_add_i32 (&ei_value->refcount, 1);
+   return ei_value;
+}
+
+
+_mongocrypt_cache_encryption_information_value_t *
+_mongocrypt_cache_encryption_information_value_new (
+   const _mongocrypt_buffer_t *encrypted_field_config,
+   const _mongocrypt_buffer_t *encryption_information,
+   const _mongocrypt_buffer_t *encryption_information_with_delete_tokens)
+{
+   _mongocrypt_cache_encryption_information_value_t *ei_value;
+
+   BSON_ASSERT_PARAM (encrypted_field_config);
+   BSON_ASSERT_PARAM (encryption_information);
+
+   ei_value = bson_malloc0 (sizeof (*ei_value));
+   BSON_ASSERT (ei_value);
+
+   _mongocrypt_buffer_copy_to (encrypted_field_config,
+                               &ei_value->encrypted_field_config);
+   _mongocrypt_buffer_copy_to (encryption_information,
+                               &ei_value->encryption_information);
+   if (encryption_information_with_delete_tokens) {
+      _mongocrypt_buffer_copy_to (
+         encryption_information_with_delete_tokens,
+         &ei_value->encryption_information_with_delete_tokens);
+   }
+   ei_value->refcount = 1;
+
+   return ei_value;
+}
+
+
+void
+_mongocrypt_cache_encryption_information_value_destroy (void *value)
+{
+   _mongocrypt_cache_encryption_information_value_t *ei_value = value;
+
+   if (!ei_value) {
+      return;
+   }
+   if (mlib_atomic_add_i32 (&ei_value->refcount, -1) > 0) {
+      return;
+   }
+   _mongocrypt_buffer_cleanup (&ei_value->encrypted_field_config);
+   _mongocrypt_buffer_cleanup (&ei_value->encryption_information);
+   _mongocrypt_buffer_cleanup (
+      &ei_value->encryption_information_with_delete_tokens);
+   bson_free (ei_value);
+}
+
+
+void
+_mongocrypt_cache_encryption_information_init (_mongocrypt_cache_t *cache)
+{
+   cache->cmp_attr = _cmp_attr;
+   cache->copy_attr = _copy_attr;
+   cache->destroy_attr = _destroy_attr;
+   cache->hash_attr = _hash_attr;
+   cache->copy_value = _copy_value;
+   cache->destroy_value = _mongocrypt_cache_encryption_information_value_destroy;
+   _mongocrypt_cache_init (cache);
+}
@@ -17,16 +17,26 @@
 #ifndef MONGOCRYPT_CACHE_KEY_PRIVATE_H
 #define MONGOCRYPT_CACHE_KEY_PRIVATE_H
 
+#include "mc-tokens-private.h"
 #include "mongocrypt-buffer-private.h"
 #include "mongocrypt-cache-private.h"
+#include "mongocrypt-crypto-private.h"
 #include "mongocrypt-key-private.h"
 #include "mongocrypt-mutex-private.h"
 #include "mongocrypt-opts-private.h"
 #include "mongocrypt-status-private.h"
 
+/* A key cache value is immutable once created and is shared by reference.
+ * The cache and each key broker that pins it hold one reference. The only
+ * exceptions are @key_state and @tokens, which are built on first use under
+ * @mutex. */
 typedef struct {
    _mongocrypt_key_doc_t *key_doc;
    _mongocrypt_buffer_t decrypted_key_material;
+   volatile int32_t refcount;
+   mongocrypt_mutex_t mutex;
+   _mongocrypt_key_state_t *key_state;
+   mc_IndexKeyTokens_t *tokens;
 } _mongocrypt_cache_key_value_t;
 
 typedef struct {
@@ -41,15 +51,74 @@ _mongocrypt_cache_key_attr_t *
 _mongocrypt_cache_key_attr_new (_mongocrypt_buffer_t *id,
                                 _mongocrypt_key_alt_name_t *alt_names);
 
+/* Returns a new value with one reference. Copies @key_doc and
+ * @decrypted_key_material. */
 _mongocrypt_cache_key_value_t *
 _mongocrypt_cache_key_value_new (_mongocrypt_key_doc_t *key_doc,
                                  _mongocrypt_buffer_t *decrypted_key_material);
 
+/* Adds a reference and returns @value. */
+_mongocrypt_cache_key_value_t *
+_mongocrypt_cache_key_value_ref (_mongocrypt_cache_key_value_t *value);
+
+/* Returns the precomputed crypto state of the decrypted key material, building
+ * it on first use. Returns NULL if the key material is malformed. The state is
+ * owned by @value and zeroed when @value is freed, so that an evicted key does
+ * not leave key schedules behind. */
+const _mongocrypt_key_state_t *
+_mongocrypt_cache_key_value_key_state (_mongocrypt_cache_key_value_t *value,
+                                       _mongocrypt_crypto_t *crypto);
+
+/* Returns the FLE2 tokens derived from the decrypted key material that do not
+ * depend on a value, deriving them on first use. Returns NULL and sets @status
+ * on error. The tokens are owned by @value. */
+const mc_IndexKeyTokens_t *
+_mongocrypt_cache_key_value_tokens (_mongocrypt_cache_key_value_t *value,
+                                    _mongocrypt_crypto_t *crypto,
+                                    mongocrypt_status_t *status);
+
+/* Releases a reference. The value is freed when the last is released. */
 void
 _mongocrypt_cache_key_value_destroy (void *value);
 
 void
 _mongocrypt_cache_key_attr_destroy (_mongocrypt_cache_key_attr_t *attr);
 
+/* A snapshot of the key cache, for a later process to import instead of
+ * fetching and decrypting the keys again. It has the form:
+ * {
+ *    "keys": [
+ *       {
+ *          "keyDocument": <the key document>,
+ *          "keyMaterial": <the decrypted key material wrapped with the KEK>,
+ *          "expiresAt": <UTC datetime>
+ *       }, ...
+ *    ],
+ *    "mac": <HMAC-SHA-256 of "keys" with a key derived from the KEK>
+ * }
+ * The MAC prevents key material being moved between keys. */
+
+/* Initializes @out with a snapshot of the unexpired keys in @cache, sealed
+ * with @kek. @out is always initialized. */
+bool
+_mongocrypt_cache_key_export (_mongocrypt_cache_t *cache,
+                              _mongocrypt_crypto_t *crypto,
+                              _mongocrypt_buffer_t *kek,
+                              bson_t *out,
+                              mongocrypt_status_t *status)
+   MONGOCRYPT_WARN_UNUSED_RESULT;
+
+/* Adds the keys in @snapshot that have not expired to @cache. Each expires
+ * when it would have in the exporting process, or after the cache expiration
+ * if sooner. Sets @imported to the number of keys added. */
+bool
+_mongocrypt_cache_key_import (_mongocrypt_cache_t *cache,
+                              _mongocrypt_crypto_t *crypto,
+                              _mongocrypt_buffer_t *kek,
+                              const bson_t *snapshot,
+                              uint32_t *imported,
+                              mongocrypt_status_t *status)
+   MONGOCRYPT_WARN_UNUSED_RESULT;
+
 
 #endif /* MONGOCRYPT_CACHE_KEY_PRIVATE_H */
@@ -15,6 +15,9 @@
  */
 
 #include "mongocrypt-cache-key-private.h"
+#include "mongocrypt-private.h"
+
+#include "mlib/atomic.h"
 /* The key cache.
  *
  * Attribute is a UUID in the form of a _mongocrypt_buffer_t.
@@ -49,6 +52,43 @@ _cmp_attr (void *a, void *b, int *out)
 }
 
 
+/* An attribute is indexed by its _id (if set) and by each keyAltName. */
+static bool
+_hash_attr (void *attr_in, uint32_t n, uint32_t *out)
+{
+   _mongocrypt_cache_key_attr_t *attr;
+   _mongocrypt_key_alt_name_t *altname;
+   const char *str;
+
+   attr = (_mongocrypt_cache_key_attr_t *) attr_in;
+
+   if (!_mongocrypt_buffer_empty (&attr->id)) {
+      if (n == 0) {
+         *out = _mongocrypt_cache_hash_bytes (
+            attr->id.data, attr->id.len, CACHE_HASH_SEED);
+         return true;
+      }
+      n--;
+   }
+
+   for (altname = attr->alt_names; NULL != altname && n > 0;
+        altname = altname->next) {
+      n--;
+   }
+
+   if (!altname) {
+      return false;
+   }
+
+   /* Seed alt names differently so an _id and a name with the same bytes do
+    * not share a hash. */
+   str = _mongocrypt_key_alt_name_get_string (altname);
+   *out = _mongocrypt_cache_hash_bytes (
+      str, strlen (str), _mongocrypt_cache_hash_bytes ("n", 1, CACHE_HASH_SEED));
+   return true;
+}
+
+
 static void *
 _copy_attr (void *attr)
 {
@@ -67,14 +107,26 @@ _destroy_attr (void *attr)
 }
 
 
+/* Values are immutable, so a copy is another reference. */
 static void *
 _copy_contents (void *value)
+{
+   return _mongocrypt_cache_key_value_ref (
+      (_mongocrypt_cache_key_value_t *) value);
+}
+
+static size_t
+_size_value (void *value)
 {
    _mongocrypt_cache_key_value_t *key_value;
+   _mongocrypt_key_doc_t *key_doc;
 
    key_value = (_mongocrypt_cache_key_value_t *) value;
-   return _mongocrypt_cache_key_value_new (key_value->key_doc,
-                                           &key_value->decrypted_key_material);
+   key_doc = key_value->key_doc;
+   /* Ignore the small allocations of the keyAltName list and KEK. */
+   return sizeof (*key_value) + sizeof (*key_doc) + key_doc->bson.len +
+          key_doc->id.len + key_doc->key_material.len +
+          key_value->decrypted_key_material.len;
 }
 
 static void
@@ -111,11 +163,66 @@ _mongocrypt_cache_key_value_new (_mongocrypt_key_doc_t *key_doc,
 
    key_value->key_doc = _mongocrypt_key_new ();
    _mongocrypt_key_doc_copy_to (key_doc, key_value->key_doc);
+   key_value->refcount = 1;
+   _mongocrypt_mutex_init (&key_value->mutex);
 
    return key_value;
 }
 
 
+_mongocrypt_cache_key_value_t *
+_mongocrypt_cache_key_value_ref (_mongocrypt_cache_key_value_t *value)
+{
+   BSON_ASSERT_PARAM (value);
+
+   mlib_atomic_add_i32 (&value->refcount, 1);
+   return value;
+}
+
+
+const _mongocrypt_key_state_t *
+_mongocrypt_cache_key_value_key_state (_mongocrypt_cache_key_value_t *value,
+                                       _mongocrypt_crypto_t *crypto)
+{
+   const _mongocrypt_key_state_t *key_state;
+
+   BSON_ASSERT_PARAM (value);
+   BSON_ASSERT_PARAM (crypto);
+
+   MONGOCRYPT_WITH_MUTEX (value->mutex)
+   {
+      if (!value->key_state) {
+         value->key_state =
+            _mongocrypt_key_state_new (crypto, &value->decrypted_key_material);
+      }
+      key_state = value->key_state;
+   }
+   return key_state;
+}
+
+
+const mc_IndexKeyTokens_t *
+_mongocrypt_cache_key_value_tokens (_mongocrypt_cache_key_value_t *value,
+                                    _mongocrypt_crypto_t *crypto,
+                                    mongocrypt_status_t *status)
+{
+   const mc_IndexKeyTokens_t *tokens;
+
+   BSON_ASSERT_PARAM (value);
+   BSON_ASSERT_PARAM (crypto);
+
+   MONGOCRYPT_WITH_MUTEX (value->mutex)
+   {
+      if (!value->tokens) {
+         value->tokens = mc_IndexKeyTokens_new (
+            crypto, &value->decrypted_key_material, status);
+      }
+      tokens = value->tokens;
+   }
+   return tokens;
+}
+
+
 void
 _mongocrypt_cache_key_value_destroy (void *value)
 {
@@ -125,6 +232,12 @@ _mongocrypt_cache_key_value_destroy (void *value)
       return;
    }
    key_value = (_mongocrypt_cache_key_value_t *) value;
+   if (mlib_atomic_add_i32 (&key_value->refcount, -1) > 0) {
+      return;
+   }
+   _mongocrypt_key_state_destroy (key_value->key_state);
+   mc_IndexKeyTokens_destroy (key_value->tokens);
+   _mongocrypt_mutex_cleanup (&key_value->mutex);
    _mongocrypt_key_destroy (key_value->key_doc);
    _mongocrypt_buffer_cleanup (&key_value->decrypted_key_material);
    bson_free (key_value);
@@ -136,12 +249,12 @@ _mongocrypt_cache_key_init (_mongocrypt_cache_t *cache)
    cache->cmp_attr = _cmp_attr;
    cache->copy_attr = _copy_attr;
    cache->destroy_attr = _destroy_attr;
+   cache->hash_attr = _hash_attr;
    cache->copy_value = _copy_contents;
    cache->destroy_value = _mongocrypt_cache_key_value_destroy;
+   cache->size_value = _size_value;
    cache->dump_attr = _dump_attr;
-   _mongocrypt_mutex_init (&cache->mutex);
-   cache->pair = NULL;
-   cache->expiration = CACHE_EXPIRATION_MS;
+   _mongocrypt_cache_init (cache);
 }
 
 /* Since key cache may be looked up by either _id or keyAltName,
@@ -176,3 +289,327 @@ _mongocrypt_cache_key_attr_destroy (_mongocrypt_cache_key_attr_t *attr)
    _mongocrypt_key_alt_name_destroy_all (attr->alt_names);
    bson_free (attr);
 }
+
+
+/* Returns the current time in milliseconds since the Unix epoch. Unlike the
+ * monotonic time used for cache expiration, it is comparable across
+ * processes. */
+static int64_t
+_now_real_ms (void)
+{
+   struct timeval tp;
+
+   bson_gettimeofday (&tp);
+   return (int64_t) tp.tv_sec * 1000 + (int64_t) tp.tv_usec / 1000;
+}
+
+
+/* Computes the MAC of the "keys" of a snapshot. The MAC key is derived from
+ * @kek rather than reusing a part of it. */
+static bool
+_snapshot_mac (_mongocrypt_crypto_t *crypto,
+               _mongocrypt_buffer_t *kek,
+               const uint8_t *data,
+               uint32_t len,
+               _mongocrypt_buffer_t *mac,
+               mongocrypt_status_t *status)
+{
+   static const char label[] = "mongocrypt key cache snapshot";
+   _mongocrypt_buffer_t label_buf;
+   _mongocrypt_buffer_t mac_key;
+   _mongocrypt_buffer_t in;
+   bool ret;
+
+   _mongocrypt_buffer_init (&label_buf);
+   label_buf.data = (uint8_t *) label;
+   label_buf.len = (uint32_t) strlen (label);
+   _mongocrypt_buffer_init (&in);
+   in.data = (uint8_t *) data;
+   in.len = len;
+
+   _mongocrypt_buffer_init_size (&mac_key, MONGOCRYPT_HMAC_SHA256_LEN);
+   _mongocrypt_buffer_init_size (mac, MONGOCRYPT_HMAC_SHA256_LEN);
+   ret = _mongocrypt_hmac_sha_256 (crypto, kek, &label_buf, &mac_key, status) &&
+         _mongocrypt_hmac_sha_256 (crypto, &mac_key, &in, mac, status);
+   _mongocrypt_buffer_cleanup (&mac_key);
+   return ret;
+}
+
+
+typedef struct {
+   _mongocrypt_cache_key_value_t **values;
+   uint64_t *remaining;
+   uint32_t len;
+   uint32_t cap;
+} _snapshot_entries_t;
+
+
+static bool
+_collect_entry (void *ctx, void *attr, void *value, uint64_t remaining)
+{
+   _snapshot_entries_t *entries = (_snapshot_entries_t *) ctx;
+
+   (void) attr;
+
+   if (entries->len == entries->cap) {
+      entries->cap = entries->cap ? entries->cap * 2 : 16;
+      entries->values = bson_realloc (
+         entries->values, entries->cap * sizeof (*entries->values));
+      entries->remaining = bson_realloc (
+         entries->remaining, entries->cap * sizeof (*entries->remaining));
+   }
+   entries->values[entries->len] =
+      _mongocrypt_cache_key_value_ref ((_mongocrypt_cache_key_value_t *) value);
+   entries->remaining[entries->len] = remaining;
+   entries->len++;
+   return true;
+}
+
+
+bool
+_mongocrypt_cache_key_export (_mongocrypt_cache_t *cache,
+                              _mongocrypt_crypto_t *crypto,
+                              _mongocrypt_buffer_t *kek,
+                              bson_t *out,
+                              mongocrypt_status_t *status)
+{
+   _snapshot_entries_t entries = {0};
+   _mongocrypt_buffer_t mac;
+   bson_t keys;
+   int64_t now;
+   uint32_t i;
+   bool ret = false;
+
+   BSON_ASSERT_PARAM (cache);
+   BSON_ASSERT_PARAM (kek);
+   BSON_ASSERT_PARAM (out);
+
+   /* Take references under the cache lock, and wrap the keys after. */
+   (void) _mongocrypt_cache_for_each (cache, _collect_entry, &entries);
+
+   _mongocrypt_buffer_init (&mac);
+   bson_init (out);
+   bson_init (&keys);
+   now = _now_real_ms ();
+   for (i = 0; i < entries.len; i++) {
+      _mongocrypt_cache_key_value_t *value = entries.values[i];
+      _mongocrypt_buffer_t wrapped;
+      bson_t entry;
+      char *idx;
+      bool ok;
+
+      if (!_mongocrypt_wrap_key (crypto,
+                                 kek,
+                                 &value->decrypted_key_material,
+                                 &wrapped,
+                                 status)) {
+         _mongocrypt_buffer_cleanup (&wrapped);
+         goto done;
+      }
+      idx = bson_strdup_printf ("%" PRIu32, i);
+      BSON_APPEND_DOCUMENT_BEGIN (&keys, idx, &entry);
+      BSON_APPEND_DOCUMENT (&entry, "keyDocument", &value->key_doc->bson);
+      ok = _mongocrypt_buffer_append (&wrapped, &entry, "keyMaterial", 11);
+      BSON_APPEND_DATE_TIME (
+         &entry, "expiresAt", now + (int64_t) entries.remaining[i]);
+      bson_append_document_end (&keys, &entry);
+      bson_free (idx);
+      _mongocrypt_buffer_cleanup (&wrapped);
+      if (!ok) {
+         CLIENT_ERR ("could not append keyMaterial");
+         goto done;
+      }
+   }
+
+   if (!_snapshot_mac (
+          crypto, kek, bson_get_data (&keys), keys.len, &mac, status)) {
+      goto done;
+   }
+   BSON_APPEND_ARRAY (out, "keys", &keys);
+   if (!_mongocrypt_buffer_append (&mac, out, "mac", 3)) {
+      CLIENT_ERR ("could not append mac");
+      goto done;
+   }
+
+   ret = true;
+done:
+   for (i = 0; i < entries.len; i++) {
+      _mongocrypt_cache_key_value_destroy (entries.values[i]);
+   }
+   bson_free (entries.values);
+   bson_free (entries.remaining);
+   bson_destroy (&keys);
+   _mongocrypt_buffer_cleanup (&mac);
+   return ret;
+}
+
+
+/* Adds one "keys" element of a snapshot to @cache. Sets @added to false if
+ * the key has expired. */
+static bool
+_import_entry (_mongocrypt_cache_t *cache,
+               _mongocrypt_crypto_t *crypto,
+               _mongocrypt_buffer_t *kek,
+               bson_iter_t *entry_iter,
+               int64_t now,
+               bool *added,
+               mongocrypt_status_t *status)
+{
+   _mongocrypt_key_doc_t *key_doc = NULL;
+   _mongocrypt_cache_key_value_t *value = NULL;
+   _mongocrypt_cache_key_attr_t *attr = NULL;
+   _mongocrypt_buffer_t wrapped;
+   _mongocrypt_buffer_t decrypted;
+   bson_iter_t iter;
+   bson_t entry;
+   bson_t doc;
+   const uint8_t *data;
+   uint32_t len;
+   int64_t remaining;
+   bool ret = false;
+
+   *added = false;
+   _mongocrypt_buffer_init (&decrypted);
+
+   if (!BSON_ITER_HOLDS_DOCUMENT (entry_iter)) {
+      CLIENT_ERR ("invalid key cache snapshot, 'keys' must hold documents");
+      goto done;
+   }
+   bson_iter_document (entry_iter, &len, &data);
+   if (!bson_init_static (&entry, data, len)) {
+      CLIENT_ERR ("invalid key cache snapshot, malformed entry");
+      goto done;
+   }
+
+   if (!bson_iter_init_find (&iter, &entry, "expiresAt") ||
+       !BSON_ITER_HOLDS_DATE_TIME (&iter)) {
+      CLIENT_ERR ("invalid key cache snapshot, expected 'expiresAt' date");
+      goto done;
+   }
+   remaining = bson_iter_date_time (&iter) - now;
+   if (remaining <= 0) {
+      ret = true;
+      goto done;
+   }
+   if ((uint64_t) remaining > cache->expiration) {
+      remaining = (int64_t) cache->expiration;
+   }
+
+   if (!bson_iter_init_find (&iter, &entry, "keyDocument") ||
+       !BSON_ITER_HOLDS_DOCUMENT (&iter)) {
+      CLIENT_ERR ("invalid key cache snapshot, expected 'keyDocument'");
+      goto done;
+   }
+   bson_iter_document (&iter, &len, &data);
+   if (!bson_init_static (&doc, data, len)) {
+      CLIENT_ERR ("invalid key cache snapshot, malformed 'keyDocument'");
+      goto done;
+   }
+   key_doc = _mongocrypt_key_new ();
+   if (!_mongocrypt_key_parse_owned (&doc, key_doc, status)) {
+      goto done;
+   }
+
+   if (!bson_iter_init_find (&iter, &entry, "keyMaterial") ||
+       !_mongocrypt_buffer_from_binary_iter (&wrapped, &iter)) {
+      CLIENT_ERR ("invalid key cache snapshot, expected 'keyMaterial'");
+      goto done;
+   }
+   if (!_mongocrypt_unwrap_key (crypto, kek, &wrapped, &decrypted, status)) {
+      goto done;
+   }
+
+   attr = _mongocrypt_cache_key_attr_new (&key_doc->id, key_doc->key_alt_names);
+   if (!attr) {
+      CLIENT_ERR ("could not create key cache attribute");
+      goto done;
+   }
+   value = _mongocrypt_cache_key_value_new (key_doc, &decrypted);
+   if (!_mongocrypt_cache_add_copy_with_expiration (
+          cache, attr, value, (uint64_t) remaining, status)) {
+      goto done;
+   }
+
+   *added = true;
+   ret = true;
+done:
+   _mongocrypt_cache_key_value_destroy (value);
+   _mongocrypt_cache_key_attr_destroy (attr);
+   _mongocrypt_key_destroy (key_doc);
+   _mongocrypt_buffer_cleanup (&decrypted);
+   return ret;
+}
+
+
+bool
+_mongocrypt_cache_key_import (_mongocrypt_cache_t *cache,
+                              _mongocrypt_crypto_t *crypto,
+                              _mongocrypt_buffer_t *kek,
+                              const bson_t *snapshot,
+                              uint32_t *imported,
+                              mongocrypt_status_t *status)
+{
+   _mongocrypt_buffer_t expected_mac;
+   _mongocrypt_buffer_t mac;
+   const uint8_t *keys_data;
+   uint32_t keys_len;
+   bson_iter_t iter;
+   bson_iter_t keys_iter;
+   int64_t now;
+   bool ret = false;
+
+   BSON_ASSERT_PARAM (cache);
+   BSON_ASSERT_PARAM (kek);
+   BSON_ASSERT_PARAM (snapshot);
+   BSON_ASSERT_PARAM (imported);
+
+   *imported = 0;
+   _mongocrypt_buffer_init (&expected_mac);
+
+   if (!bson_iter_init_find (&iter, snapshot, "mac") ||
+       !_mongocrypt_buffer_from_binary_iter (&mac, &iter) ||
+       mac.len != MONGOCRYPT_HMAC_SHA256_LEN) {
+      CLIENT_ERR ("invalid key cache snapshot, expected 'mac'");
+      goto done;
+   }
+
+   if (!bson_iter_init_find (&iter, snapshot, "keys") ||
+       !BSON_ITER_HOLDS_ARRAY (&iter)) {
+      CLIENT_ERR ("invalid key cache snapshot, expected 'keys' array");
+      goto done;
+   }
+   bson_iter_array (&iter, &keys_len, &keys_data);
+
+   /* Check the MAC before unwrapping anything. */
+   if (!_snapshot_mac (
+          crypto, kek, keys_data, keys_len, &expected_mac, status)) {
+      goto done;
+   }
+   if (0 != _mongocrypt_memequal (
+               expected_mac.data, mac.data, MONGOCRYPT_HMAC_SHA256_LEN)) {
+      CLIENT_ERR ("key cache snapshot failed authentication");
+      goto done;
+   }
+
+   if (!bson_iter_recurse (&iter, &keys_iter)) {
+      CLIENT_ERR ("invalid key cache snapshot, malformed 'keys'");
+      goto done;
+   }
+   now = _now_real_ms ();
+   while (bson_iter_next (&keys_iter)) {
+      bool added;
+
+      if (!_import_entry (
+             cache, crypto, kek, &keys_iter, now, &added, status)) {
+         goto done;
+      }
+      if (added) {
+         (*imported)++;
+      }
+   }
+
+   ret = true;
+done:
+   _mongocrypt_buffer_cleanup (&expected_mac);
+   return ret;
+}
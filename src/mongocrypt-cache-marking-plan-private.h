@@ -0,0 +1,76 @@
+/*
+ * Copyright 2022-present MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MONGOCRYPT_CACHE_MARKING_PLAN_PRIVATE_H
+#define MONGOCRYPT_CACHE_MARKING_PLAN_PRIVATE_H
+
+#include "mongocrypt-buffer-private.h"
+#include "mongocrypt-cache-private.h"
+
+/* A cache of query analysis replies, reused for commands that differ only in
+ * their values.
+ *
+ * A plan records a query analysis command (the command with its jsonSchema or
+ * encryptionInformation appended), the paths of the markings in the reply, and
+ * the reply itself. The reply of query analysis echoes the command, with
+ * markings in place of the values to encrypt. Another command matches the plan
+ * if it has the same keys in the same order and, at each marking path and each
+ * path the reply echoes, a value of the same BSON type. The reply for the
+ * command is then the recorded reply with the value of the command at each of
+ * those paths.
+ *
+ * Top-level session fields set by the driver on each operation (lsid,
+ * txnNumber, autocommit, startTransaction, $clusterTime and $readPreference)
+ * need only have the same type even if the reply does not echo them. Values
+ * the reply does not echo, including the schema, must be equal. So a plan is
+ * never used after the schema or encryptedFieldConfig changes.
+ *
+ * Plans are only recorded when each marking encrypts the value found at the
+ * same path in the command. A JSON schema with a JSON pointer keyId makes the
+ * markings depend on another value of the command, so replies for it are
+ * never recorded.
+ *
+ * This assumes the result of query analysis depends only on the schema and
+ * the types of the values, not on the values themselves.
+ */
+
+void
+_mongocrypt_cache_marking_plan_init (_mongocrypt_cache_t *cache);
+
+/* Looks for a plan matching @cmd, the query analysis command for @ns. If one
+ * is found, sets @hit to true and initializes @reply with the query analysis
+ * reply for @cmd. Otherwise sets @hit to false and leaves @reply
+ * uninitialized. */
+bool
+_mongocrypt_cache_marking_plan_get (_mongocrypt_cache_t *cache,
+                                    const char *ns,
+                                    const _mongocrypt_buffer_t *cmd,
+                                    bool *hit,
+                                    bson_t *reply,
+                                    mongocrypt_status_t *status)
+   MONGOCRYPT_WARN_UNUSED_RESULT;
+
+/* Records @reply, the query analysis reply to @cmd. Does nothing if @reply
+ * cannot be reused for other values. */
+bool
+_mongocrypt_cache_marking_plan_add (_mongocrypt_cache_t *cache,
+                                    const char *ns,
+                                    const _mongocrypt_buffer_t *cmd,
+                                    const bson_t *reply,
+                                    mongocrypt_status_t *status)
+   MONGOCRYPT_WARN_UNUSED_RESULT;
+
+#endif /* MONGOCRYPT_CACHE_MARKING_PLAN_PRIVATE_H */
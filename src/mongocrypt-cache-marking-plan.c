@@ -0,0 +1,797 @@
+/*
+ * Copyright 2022-present MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mongocrypt-cache-marking-plan-private.h"
+
+#include "mc-fle-blob-subtype-private.h"
+#include "mlib/atomic.h"
+#include "mongocrypt-private.h"
+
+/* The marking plan cache.
+ *
+ * Attribute is a _marking_plan_attr_t: a namespace and a hash of the shape of
+ * a query analysis command (its keys and types, ignoring values).
+ * Value is a _marking_plans_t: the plans recorded for commands of that shape,
+ * most recent first. Values and plans are immutable and shared by reference.
+ */
+
+/* Commands of one shape only need separate plans if they differ in their
+ * schema, or in values that query analysis does not echo. Bound how many are
+ * kept. */
+#define MARKING_PLANS_PER_SHAPE 8
+
+/* Top-level fields of the query analysis command holding the schema. They
+ * determine the markings, so they must be equal for a plan to match. */
+static const char *const _schema_fields[] = {
+   "jsonSchema", "isRemoteSchema", "encryptionInformation"};
+
+/* Top-level fields set per operation by the driver. They do not affect query
+ * analysis, so a plan matches any value of the same type and replays the value
+ * of the command. */
+static const char *const _session_fields[] = {"lsid",
+                                              "txnNumber",
+                                              "autocommit",
+                                              "startTransaction",
+                                              "$clusterTime",
+                                              "$readPreference"};
+
+typedef struct {
+   char *ns;
+   uint32_t shape;
+} _marking_plan_attr_t;
+
+typedef struct {
+   /* The query analysis command. */
+   _mongocrypt_buffer_t cmd;
+   /* The paths of @cmd whose values need only have the same type, as nested
+    * documents. A path has the value true for a marking, and false for a
+    * value the reply echoes or a session field. e.g.
+    * { "find": false, "filter": { "ssn": true, "name": false } }. */
+   _mongocrypt_buffer_t paths;
+   /* The query analysis reply to @cmd. */
+   _mongocrypt_buffer_t reply;
+   volatile int32_t refcount;
+} _marking_plan_t;
+
+typedef struct {
+   _marking_plan_t *plans[MARKING_PLANS_PER_SHAPE];
+   uint32_t len;
+   volatile int32_t refcount;
+} _marking_plans_t;
+
+
+static void
+_plan_destroy (_marking_plan_t *plan)
+{
+   if (!plan || mlib_atomic_add_i32 (&plan->refcount, -1) > 0) {
+      return;
+   }
+   _mongocrypt_buffer_cleanup (&plan->cmd);
+   _mongocrypt_buffer_cleanup (&plan->paths);
+   _mongocrypt_buffer_cleanup (&plan->reply);
+   bson_free (plan);
+}
+
+
+static bool
+_cmp_attr (void *a, void *b, int *out)
+{
+   _marking_plan_attr_t *attr_a = a;
+   _marking_plan_attr_t *attr_b = b;
+
+   *out = strcmp (attr_a->ns, attr_b->ns);
+   if (*out == 0 && attr_a->shape != attr_b->shape) {
+      *out = attr_a->shape < attr_b->shape ? -1 : 1;
+   }
+   return true;
+}
+
+
+static bool
+_hash_attr (void *a, uint32_t n, uint32_t *out)
+{
+   _marking_plan_attr_t *attr = a;
+
+   if (n > 0) {
+      return false;
+   }
+   *out =
+      _mongocrypt_cache_hash_bytes (attr->ns, strlen (attr->ns), attr->shape);
+   return true;
+}
+
+
+static void *
+_copy_attr (void *a)
+{
+   _marking_plan_attr_t *attr = a;
+   _marking_plan_attr_t *copy;
+
+   copy = bson_malloc0 (sizeof (*copy));
+   BSON_ASSERT (copy);
+   copy->ns = bson_strdup (attr->ns);
+   copy->shape = attr->shape;
+   return copy;
+}
+
+
+static void
+_destroy_attr (void *a)
+{
+   _marking_plan_attr_t *attr = a;
+
+   if (!attr) {
+      return;
+   }
+   bson_free (attr->ns);
+   bson_free (attr);
+}
+
+
+/* Values are immutable, so a copy is another reference. */
+static void *
+_copy_value (void *value)
+{
+   _marking_plans_t *plans = value;
+
+   mlib_atomic_add_i32 (&plans->refcount, 1);
+   return plans;
+}
+
+
+static void
+_destroy_value (void *value)
+{
+   _marking_plans_t *plans = value;
+   uint32_t i;
+
+   if (!plans) {
+      return;
+   }
+   if (mlib_atomic_add_i32 (&plans->refcount, -1) > 0) {
+      return;
+   }
+   for (i = 0; i < plans->len; i++) {
+      _plan_destroy (plans->plans[i]);
+   }
+   bson_free (plans);
+}
+
+
+void
+_mongocrypt_cache_marking_plan_init (_mongocrypt_cache_t *cache)
+{
+   cache->cmp_attr = _cmp_attr;
+   cache->copy_attr = _copy_attr;
+   cache->destroy_attr = _destroy_attr;
+   cache->hash_attr = _hash_attr;
+   cache->copy_value = _copy_value;
+   cache->destroy_value = _destroy_value;
+   _mongocrypt_cache_init (cache);
+}
+
+
+/* Hashes the keys and types of the elements of @iter, recursively. */
+static uint32_t
+_shape_hash (bson_iter_t *iter, uint32_t hash)
+{
+   while (bson_iter_next (iter)) {
+      const char *key = bson_iter_key (iter);
+      uint8_t type = (uint8_t) bson_iter_type (iter);
+      bson_iter_t child;
+
+      hash = _mongocrypt_cache_hash_bytes (key, strlen (key) + 1, hash);
+      hash = _mongocrypt_cache_hash_bytes (&type, 1, hash);
+      if ((BSON_ITER_HOLDS_DOCUMENT (iter) || BSON_ITER_HOLDS_ARRAY (iter)) &&
+          bson_iter_recurse (iter, &child)) {
+         /* Hash the end of the document, so { a: {}, b: 1 } and
+          * { a: { b: 1 } } differ. */
+         uint8_t end = 0;
+
+         hash = _shape_hash (&child, hash);
+         hash = _mongocrypt_cache_hash_bytes (&end, 1, hash);
+      }
+   }
+   return hash;
+}
+
+
+static bool
+_is_marking (const bson_iter_t *iter)
+{
+   bson_subtype_t subtype;
+   uint32_t len;
+   const uint8_t *data;
+
+   if (!BSON_ITER_HOLDS_BINARY (iter)) {
+      return false;
+   }
+   bson_iter_binary (iter, &subtype, &len, &data);
+   return subtype == BSON_SUBTYPE_ENCRYPTED && len > 0 &&
+          (data[0] == MC_SUBTYPE_FLE1EncryptionPlaceholder ||
+           data[0] == MC_SUBTYPE_FLE2EncryptionPlaceholder);
+}
+
+
+/* Compares whole elements, including keys. */
+static bool
+_element_equal (const bson_iter_t *a, const bson_iter_t *b)
+{
+   uint32_t len = a->next_off - a->off;
+
+   return len == b->next_off - b->off &&
+          0 == memcmp (a->raw + a->off, b->raw + b->off, len);
+}
+
+
+/* Compares the types and values of elements, ignoring keys. */
+static bool
+_value_equal (const bson_iter_t *a, const bson_iter_t *b)
+{
+   uint32_t len = a->next_off - a->d1;
+
+   return bson_iter_type (a) == bson_iter_type (b) &&
+          len == b->next_off - b->d1 &&
+          0 == memcmp (a->raw + a->d1, b->raw + b->d1, len);
+}
+
+
+/* Finds @key in the document @doc iterates. Fails if @key occurs more than
+ * once. */
+static bool
+_find_unique (const bson_iter_t *doc, const char *key, bson_iter_t *out)
+{
+   bson_iter_t iter = *doc;
+   bool found = false;
+
+   while (bson_iter_next (&iter)) {
+      if (0 == strcmp (bson_iter_key (&iter), key)) {
+         if (found) {
+            return false;
+         }
+         *out = iter;
+         found = true;
+      }
+   }
+   return found;
+}
+
+
+static bool
+_is_schema_field (const char *key)
+{
+   size_t i;
+
+   for (i = 0; i < sizeof (_schema_fields) / sizeof (_schema_fields[0]); i++) {
+      if (0 == strcmp (key, _schema_fields[i])) {
+         return true;
+      }
+   }
+   return false;
+}
+
+
+/* Returns true if the JSON schema @iter iterates has a JSON pointer keyId.
+ * Markings for such a schema depend on another value of the command. */
+static bool
+_has_pointer_key_id (bson_iter_t *iter)
+{
+   while (bson_iter_next (iter)) {
+      bson_iter_t child;
+
+      if (0 == strcmp (bson_iter_key (iter), "keyId") &&
+          BSON_ITER_HOLDS_UTF8 (iter)) {
+         return true;
+      }
+      if ((BSON_ITER_HOLDS_DOCUMENT (iter) || BSON_ITER_HOLDS_ARRAY (iter)) &&
+          bson_iter_recurse (iter, &child) && _has_pointer_key_id (&child)) {
+         return true;
+      }
+   }
+   return false;
+}
+
+
+/* Appends to @paths the path of each marking in @result, checking that the
+ * marking encrypts the value at the same path of @cmd, and the path of each
+ * value of @result equal to the value at the same path of @cmd. @cmd is NULL
+ * if the path of @result does not exist in the command. Schema fields are
+ * skipped at the @top_level. Returns false if @result cannot be reused for
+ * other values. */
+static bool
+_collect_paths (bson_iter_t *result,
+                const bson_iter_t *cmd,
+                bool top_level,
+                bson_t *paths)
+{
+   while (bson_iter_next (result)) {
+      const char *key = bson_iter_key (result);
+      bson_iter_t cmd_value;
+      bson_iter_t existing;
+      bool in_cmd;
+
+      if (top_level && _is_schema_field (key)) {
+         continue;
+      }
+
+      in_cmd = cmd && _find_unique (cmd, key, &cmd_value);
+
+      if (_is_marking (result)) {
+         bson_subtype_t subtype;
+         uint32_t len;
+         const uint8_t *data;
+         bson_t marking;
+         bson_iter_t marking_value;
+
+         bson_iter_binary (result, &subtype, &len, &data);
+         if (!in_cmd || !bson_init_static (&marking, data + 1, len - 1) ||
+             !bson_iter_init_find (&marking_value, &marking, "v") ||
+             !_value_equal (&marking_value, &cmd_value) ||
+             bson_iter_init_find (&existing, paths, key)) {
+            return false;
+         }
+         if (!BSON_APPEND_BOOL (paths, key, true)) {
+            return false;
+         }
+         continue;
+      }
+
+      if (BSON_ITER_HOLDS_DOCUMENT (result) || BSON_ITER_HOLDS_ARRAY (result)) {
+         bson_iter_t result_child;
+         bson_iter_t cmd_child;
+         bson_t child_paths = BSON_INITIALIZER;
+         bool descend;
+         bool ok;
+
+         descend = in_cmd &&
+                   bson_iter_type (&cmd_value) == bson_iter_type (result) &&
+                   bson_iter_recurse (&cmd_value, &cmd_child);
+         ok = bson_iter_recurse (result, &result_child) &&
+              _collect_paths (&result_child,
+                              descend ? &cmd_child : NULL,
+                              false,
+                              &child_paths);
+         if (ok && !bson_empty (&child_paths)) {
+            ok = !bson_iter_init_find (&existing, paths, key) &&
+                 BSON_APPEND_DOCUMENT (paths, key, &child_paths);
+         }
+         bson_destroy (&child_paths);
+         if (!ok) {
+            return false;
+         }
+         continue;
+      }
+
+      /* A value echoed from the command is replayed from the command. Other
+       * values must be equal to match. */
+      if (in_cmd && _value_equal (result, &cmd_value)) {
+         if (bson_iter_init_find (&existing, paths, key) ||
+             !BSON_APPEND_BOOL (paths, key, false)) {
+            return false;
+         }
+      }
+   }
+   return true;
+}
+
+
+/* Appends false to @paths for each session field of @cmd not already in
+ * @paths. */
+static bool
+_append_session_fields (const bson_t *cmd, bson_t *paths)
+{
+   bson_iter_t iter;
+   bson_iter_t existing;
+   size_t i;
+
+   if (!bson_iter_init (&iter, cmd)) {
+      return false;
+   }
+   while (bson_iter_next (&iter)) {
+      const char *key = bson_iter_key (&iter);
+
+      for (i = 0; i < sizeof (_session_fields) / sizeof (_session_fields[0]);
+           i++) {
+         if (0 != strcmp (key, _session_fields[i]) ||
+             bson_iter_init_find (&existing, paths, key)) {
+            continue;
+         }
+         if (!BSON_APPEND_BOOL (paths, key, false)) {
+            return false;
+         }
+      }
+   }
+   return true;
+}
+
+
+/* Returns true if @cmd is equal to @plan_cmd, except for the values at
+ * @paths, which need only have equal types. */
+static bool
+_matches (bson_iter_t *cmd, bson_iter_t *plan_cmd, const bson_iter_t *paths)
+{
+   for (;;) {
+      bool more = bson_iter_next (cmd);
+      bson_iter_t node = *paths;
+
+      if (more != bson_iter_next (plan_cmd)) {
+         return false;
+      }
+      if (!more) {
+         return true;
+      }
+
+      if (!bson_iter_find (&node, bson_iter_key (cmd))) {
+         if (!_element_equal (cmd, plan_cmd)) {
+            return false;
+         }
+         continue;
+      }
+
+      if (0 != strcmp (bson_iter_key (cmd), bson_iter_key (plan_cmd)) ||
+          bson_iter_type (cmd) != bson_iter_type (plan_cmd)) {
+         return false;
+      }
+
+      if (!BSON_ITER_HOLDS_BOOL (&node)) {
+         bson_iter_t cmd_child;
+         bson_iter_t plan_child;
+         bson_iter_t paths_child;
+
+         if (!(BSON_ITER_HOLDS_DOCUMENT (cmd) || BSON_ITER_HOLDS_ARRAY (cmd)) ||
+             !bson_iter_recurse (cmd, &cmd_child) ||
+             !bson_iter_recurse (plan_cmd, &plan_child) ||
+             !bson_iter_recurse (&node, &paths_child) ||
+             !_matches (&cmd_child, &plan_child, &paths_child)) {
+            return false;
+         }
+      }
+   }
+}
+
+
+/* Appends the marking @result with its value replaced by @value. */
+static bool
+_append_replaced_marking (bson_t *out,
+                          const bson_iter_t *result,
+                          const bson_iter_t *value)
+{
+   bson_subtype_t subtype;
+   uint32_t len;
+   const uint8_t *data;
+   bson_t marking;
+   bson_t replaced = BSON_INITIALIZER;
+   bson_iter_t iter;
+   uint8_t *bytes;
+   bool ok = true;
+
+   bson_iter_binary (result, &subtype, &len, &data);
+   if (!bson_init_static (&marking, data + 1, len - 1) ||
+       !bson_iter_init (&iter, &marking)) {
+      return false;
+   }
+
+   while (ok && bson_iter_next (&iter)) {
+      if (0 == strcmp (bson_iter_key (&iter), "v")) {
+         ok = bson_append_iter (&replaced, "v", 1, value);
+      } else {
+         ok = bson_append_iter (&replaced, NULL, 0, &iter);
+      }
+   }
+
+   if (ok) {
+      bytes = bson_malloc (replaced.len + 1u);
+      BSON_ASSERT (bytes);
+      bytes[0] = data[0];
+      memcpy (bytes + 1, bson_get_data (&replaced), replaced.len);
+      ok = bson_append_binary (out,
+                               bson_iter_key (result),
+                               -1,
+                               BSON_SUBTYPE_ENCRYPTED,
+                               bytes,
+                               replaced.len + 1u);
+      bson_free (bytes);
+   }
+   bson_destroy (&replaced);
+   return ok;
+}
+
+
+/* Copies @result to @out, replacing the value of the marking at each of
+ * @paths with the value at the same path of @cmd. */
+static bool
+_replay (bson_iter_t *result,
+         const bson_iter_t *cmd,
+         const bson_iter_t *paths,
+         bson_t *out)
+{
+   while (bson_iter_next (result)) {
+      const char *key = bson_iter_key (result);
+      bson_iter_t node = *paths;
+      bson_iter_t value = *cmd;
+
+      if (!bson_iter_find (&node, key) || !bson_iter_find (&value, key)) {
+         if (!bson_append_iter (out, NULL, 0, result)) {
+            return false;
+         }
+         continue;
+      }
+
+      if (BSON_ITER_HOLDS_BOOL (&node) && !bson_iter_bool (&node)) {
+         /* An echoed value or a session field. */
+         if (!bson_append_iter (out, key, -1, &value)) {
+            return false;
+         }
+         continue;
+      }
+
+      if (BSON_ITER_HOLDS_BOOL (&node)) {
+         if (!_is_marking (result) ||
+             !_append_replaced_marking (out, result, &value)) {
+            return false;
+         }
+         continue;
+      }
+
+      if (BSON_ITER_HOLDS_DOCUMENT (result) || BSON_ITER_HOLDS_ARRAY (result)) {
+         bson_iter_t result_child;
+         bson_iter_t cmd_child;
+         bson_iter_t paths_child;
+         bson_t child;
+         bool ok;
+
+         if (!bson_iter_recurse (result, &result_child) ||
+             !bson_iter_recurse (&value, &cmd_child) ||
+             !bson_iter_recurse (&node, &paths_child)) {
+            return false;
+         }
+         if (BSON_ITER_HOLDS_ARRAY (result)) {
+            ok = bson_append_array_begin (out, key, -1, &child) &&
+                 _replay (&result_child, &cmd_child, &paths_child, &child) &&
+                 bson_append_array_end (out, &child);
+         } else {
+            ok = bson_append_document_begin (out, key, -1, &child) &&
+                 _replay (&result_child, &cmd_child, &paths_child, &child) &&
+                 bson_append_document_end (out, &child);
+         }
+         if (!ok) {
+            return false;
+         }
+         continue;
+      }
+
+      if (!bson_append_iter (out, NULL, 0, result)) {
+         return false;
+      }
+   }
+   return true;
+}
+
+
+static bool
+_plan_matches (const _marking_plan_t *plan, const bson_t *cmd)
+{
+   bson_t plan_cmd;
+   bson_t paths;
+   bson_iter_t cmd_iter;
+   bson_iter_t plan_iter;
+   bson_iter_t paths_iter;
+
+   return _mongocrypt_buffer_to_bson (&plan->cmd, &plan_cmd) &&
+          _mongocrypt_buffer_to_bson (&plan->paths, &paths) &&
+          bson_iter_init (&cmd_iter, cmd) &&
+          bson_iter_init (&plan_iter, &plan_cmd) &&
+          bson_iter_init (&paths_iter, &paths) &&
+          _matches (&cmd_iter, &plan_iter, &paths_iter);
+}
+
+
+/* Initializes @out with the reply of @plan, replayed for @cmd. */
+static bool
+_plan_replay (const _marking_plan_t *plan, const bson_t *cmd, bson_t *out)
+{
+   bson_t reply;
+   bson_t paths;
+   bson_iter_t iter;
+   bool ok = true;
+
+   bson_init (out);
+   if (!_mongocrypt_buffer_to_bson (&plan->reply, &reply) ||
+       !_mongocrypt_buffer_to_bson (&plan->paths, &paths) ||
+       !bson_iter_init (&iter, &reply)) {
+      bson_destroy (out);
+      return false;
+   }
+
+   while (ok && bson_iter_next (&iter)) {
+      bson_iter_t result;
+      bson_iter_t cmd_iter;
+      bson_iter_t paths_iter;
+      bson_t child;
+
+      if (0 != strcmp (bson_iter_key (&iter), "result") ||
+          !BSON_ITER_HOLDS_DOCUMENT (&iter)) {
+         ok = bson_append_iter (out, NULL, 0, &iter);
+         continue;
+      }
+
+      ok = bson_iter_recurse (&iter, &result) &&
+           bson_iter_init (&cmd_iter, cmd) &&
+           bson_iter_init (&paths_iter, &paths) &&
+           bson_append_document_begin (out, "result", -1, &child);
+      if (ok) {
+         ok = _replay (&result, &cmd_iter, &paths_iter, &child);
+         ok = bson_append_document_end (out, &child) && ok;
+      }
+   }
+
+   if (!ok) {
+      bson_destroy (out);
+   }
+   return ok;
+}
+
+
+bool
+_mongocrypt_cache_marking_plan_get (_mongocrypt_cache_t *cache,
+                                    const char *ns,
+                                    const _mongocrypt_buffer_t *cmd,
+                                    bool *hit,
+                                    bson_t *reply,
+                                    mongocrypt_status_t *status)
+{
+   _marking_plan_attr_t attr;
+   _marking_plans_t *plans;
+   bson_t cmd_bson;
+   bson_iter_t iter;
+   uint32_t i;
+   bool ret = true;
+
+   BSON_ASSERT_PARAM (cache);
+   BSON_ASSERT_PARAM (ns);
+   BSON_ASSERT_PARAM (cmd);
+   BSON_ASSERT_PARAM (hit);
+   BSON_ASSERT_PARAM (reply);
+
+   *hit = false;
+   if (!_mongocrypt_buffer_to_bson (cmd, &cmd_bson) ||
+       !bson_iter_init (&iter, &cmd_bson)) {
+      CLIENT_ERR ("invalid BSON command");
+      return false;
+   }
+
+   attr.ns = (char *) ns;
+   attr.shape = _shape_hash (&iter, CACHE_HASH_SEED);
+   if (!_mongocrypt_cache_get (cache, &attr, (void **) &plans)) {
+      CLIENT_ERR ("failed to retrieve from marking cache");
+      return false;
+   }
+   if (!plans) {
+      return true;
+   }
+
+   for (i = 0; i < plans->len; i++) {
+      if (!_plan_matches (plans->plans[i], &cmd_bson)) {
+         continue;
+      }
+      if (!_plan_replay (plans->plans[i], &cmd_bson, reply)) {
+         CLIENT_ERR ("failed to replay marking plan");
+         ret = false;
+         break;
+      }
+      *hit = true;
+      break;
+   }
+
+   _destroy_value (plans);
+   return ret;
+}
+
+
+bool
+_mongocrypt_cache_marking_plan_add (_mongocrypt_cache_t *cache,
+                                    const char *ns,
+                                    const _mongocrypt_buffer_t *cmd,
+                                    const bson_t *reply,
+                                    mongocrypt_status_t *status)
+{
+   _marking_plan_attr_t attr;
+   _marking_plans_t *existing;
+   _marking_plans_t *plans;
+   _marking_plan_t *plan;
+   _mongocrypt_buffer_t reply_buf;
+   bson_t cmd_bson;
+   bson_t paths = BSON_INITIALIZER;
+   bson_iter_t iter;
+   bson_iter_t result;
+   bson_iter_t schema;
+   uint32_t i;
+
+   BSON_ASSERT_PARAM (cache);
+   BSON_ASSERT_PARAM (ns);
+   BSON_ASSERT_PARAM (cmd);
+   BSON_ASSERT_PARAM (reply);
+
+   if (!_mongocrypt_buffer_to_bson (cmd, &cmd_bson) ||
+       !bson_iter_init (&iter, &cmd_bson)) {
+      bson_destroy (&paths);
+      CLIENT_ERR ("invalid BSON command");
+      return false;
+   }
+
+   attr.ns = (char *) ns;
+   attr.shape = _shape_hash (&iter, CACHE_HASH_SEED);
+   if (!_mongocrypt_cache_get (cache, &attr, (void **) &existing)) {
+      bson_destroy (&paths);
+      CLIENT_ERR ("failed to retrieve from marking cache");
+      return false;
+   }
+
+   /* Another context may have recorded a matching plan since the lookup. */
+   for (i = 0; existing && i < existing->len; i++) {
+      if (_plan_matches (existing->plans[i], &cmd_bson)) {
+         goto done;
+      }
+   }
+
+   if (bson_iter_init_find (&schema, &cmd_bson, "jsonSchema") &&
+       BSON_ITER_HOLDS_DOCUMENT (&schema) &&
+       bson_iter_recurse (&schema, &schema) && _has_pointer_key_id (&schema)) {
+      goto done;
+   }
+
+   BSON_ASSERT (bson_iter_init (&iter, &cmd_bson));
+   if (bson_iter_init_find (&result, reply, "result")) {
+      if (!BSON_ITER_HOLDS_DOCUMENT (&result) ||
+          !bson_iter_recurse (&result, &result) ||
+          !_collect_paths (&result, &iter, true, &paths)) {
+         /* The reply cannot be reused for other values. */
+         goto done;
+      }
+   }
+   if (!_append_session_fields (&cmd_bson, &paths)) {
+      goto done;
+   }
+
+   plan = bson_malloc0 (sizeof (*plan));
+   BSON_ASSERT (plan);
+   plan->refcount = 1;
+   _mongocrypt_buffer_copy_to (cmd, &plan->cmd);
+   _mongocrypt_buffer_steal_from_bson (&plan->paths, &paths);
+   _mongocrypt_buffer_from_bson (&reply_buf, reply);
+   _mongocrypt_buffer_copy_to (&reply_buf, &plan->reply);
+
+   /* Values are immutable. Add a new value with the new plan first, sharing
+    * the existing plans. */
+   plans = bson_malloc0 (sizeof (*plans));
+   BSON_ASSERT (plans);
+   plans->refcount = 1;
+   plans->plans[plans->len++] = plan;
+   for (i = 0; existing && i < existing->len &&
+               plans->len < MARKING_PLANS_PER_SHAPE;
+        i++) {
+      mlib_atomic_add_i32 (&existing->plans[i]->refcount, 1);
+      plans->plans[plans->len++] = existing->plans[i];
+   }
+   _destroy_value (existing);
+
+   return _mongocrypt_cache_add_stolen (cache, &attr, plans, status);
+
+done:
+   bson_destroy (&paths);
+   _destroy_value (existing);
+   return true;
+}
@@ -22,36 +22,113 @@
 
 #define CACHE_EXPIRATION_MS 60000
 
+/* The number of mutexes guarding a cache. Must be a power of two. */
+#define CACHE_NUM_STRIPES 16
+/* The initial number of hash buckets. Must be a power of two and at least
+ * CACHE_NUM_STRIPES. */
+#define CACHE_INITIAL_BUCKETS 64
+
 /* A generic simple cache.
  * To avoid overusing the names "key" or "id", the cache contains
  * "attribute-value" pairs.
  * https://en.wikipedia.org/wiki/Attribute%E2%80%93value_pair
+ *
+ * Pairs are indexed in a hash table. An attribute may be indexed under more
+ * than one hash (e.g. a key is found by its _id or by any of its keyAltNames),
+ * so each bucket holds links to pairs rather than the pairs themselves.
+ *
+ * Locking is striped: bucket i is guarded by stripes[i % CACHE_NUM_STRIPES].
+ * Lookups only take the stripes of the hashes they probe. Anything that
+ * modifies the cache takes every stripe in ascending order.
+ *
+ * Pairs are also kept in a binary min-heap ordered by expiration time, so
+ * eviction only visits pairs that have expired.
+ *
+ * A cache may be bounded by a number of entries and by a number of bytes. When
+ * an add exceeds a bound, the least recently used entries are evicted. Recency
+ * is approximated with the CLOCK algorithm so lookups need not reorder a
+ * shared list: a lookup sets the pair's referenced flag, and eviction sweeps
+ * the pair list from oldest to newest, clearing set flags and evicting the
+ * first pair found unset.
+ *
+ * A cache may also have a refresh window. A lookup of a pair within the
+ * refresh window of its expiration still returns the pair, and reports that a
+ * refresh is due to exactly one caller, so that caller can replace the pair
+ * before it expires.
  */
 typedef bool (*cache_compare_fn) (void *thing_a, void *thing_b, int *out);
 typedef void (*cache_destroy_fn) (void *thing);
 typedef void *(*cache_copy_fn) (void *thing);
 typedef void (*cache_dump_fn) (void *thing);
+/* Returns the approximate number of bytes owned by a value. */
+typedef size_t (*cache_size_fn) (void *thing);
+/* Sets @out to the @n-th hash of @attr (starting at 0). Returns false if @attr
+ * has fewer than @n + 1 hashes. Attributes that compare equal must share at
+ * least one hash. */
+typedef bool (*cache_hash_fn) (void *attr, uint32_t n, uint32_t *out);
 
 typedef struct __mongocrypt_cache_pair_t {
    void *attr;
    void *value;
+   /* A list of all pairs, most recently added first. */
    struct __mongocrypt_cache_pair_t *next;
+   struct __mongocrypt_cache_pair_t *prev;
    int64_t last_updated;
+   /* The expiration of this pair, or 0 for the expiration of the cache. */
+   uint64_t expiration;
+   int64_t expires_at; /* last_updated + expiration, in milliseconds. */
+   uint32_t heap_index;
+   size_t size;                  /* from size_value, fixed at insertion. */
+   volatile int32_t referenced; /* set by lookups, cleared by eviction. */
+   volatile int32_t refresh_claimed; /* nonzero once a refresh is reported. */
 } _mongocrypt_cache_pair_t;
 
+/* An entry in a hash bucket. */
+typedef struct __mongocrypt_cache_link_t {
+   uint32_t hash;
+   _mongocrypt_cache_pair_t *pair;
+   struct __mongocrypt_cache_link_t *next;
+} _mongocrypt_cache_link_t;
+
 typedef struct {
    cache_dump_fn dump_attr;
    cache_compare_fn cmp_attr;
    cache_copy_fn copy_attr;
    cache_destroy_fn destroy_attr;
+   cache_hash_fn hash_attr;
    cache_copy_fn copy_value;
    cache_destroy_fn destroy_value;
+   cache_size_fn size_value; /* may be NULL if the cache is not size bound. */
    _mongocrypt_cache_pair_t *pair;
-   mongocrypt_mutex_t mutex; /* global lock of cache. */
+   _mongocrypt_cache_pair_t *tail;
+   _mongocrypt_cache_pair_t *clock_hand;
+   _mongocrypt_cache_link_t **buckets;
+   uint32_t num_buckets;
+   uint32_t num_links;
+   uint32_t num_pairs;
+   /* A min-heap of all pairs keyed on expires_at. */
+   _mongocrypt_cache_pair_t **heap;
+   uint32_t heap_cap;
+   mongocrypt_mutex_t stripes[CACHE_NUM_STRIPES];
    uint64_t expiration;
+   uint64_t refresh_window; /* 0 to disable refresh-ahead. */
+   uint32_t max_entries; /* 0 for no limit. */
+   uint64_t max_bytes;   /* 0 for no limit. */
+   uint64_t num_bytes;
 } _mongocrypt_cache_t;
 
 
+/* Initialize the storage and locks of a cache. Callers set the attribute and
+ * value callbacks before or after calling. */
+void
+_mongocrypt_cache_init (_mongocrypt_cache_t *cache);
+
+/* A 32 bit FNV-1a hash of @len bytes, continued from @seed. Pass
+ * CACHE_HASH_SEED to start a new hash. */
+#define CACHE_HASH_SEED 2166136261u
+uint32_t
+_mongocrypt_cache_hash_bytes (const void *data, size_t len, uint32_t seed);
+
 /* Attempt to get an entry.
  * Returns boolean indicating success.
  */
@@ -60,6 +137,16 @@ _mongocrypt_cache_get (_mongocrypt_cache_t *cache,
                        void *attr,
                        void **value) MONGOCRYPT_WARN_UNUSED_RESULT;
 
+/* Like _mongocrypt_cache_get. Additionally sets @refresh_due to true if the
+ * entry found is within the refresh window of its expiration and no previous
+ * lookup was told so. The caller is then expected to replace the entry. */
+bool
+_mongocrypt_cache_get_refresh (_mongocrypt_cache_t *cache,
+                               void *attr,
+                               void **value,
+                               bool *refresh_due)
+   MONGOCRYPT_WARN_UNUSED_RESULT;
+
 bool
 _mongocrypt_cache_add_copy (_mongocrypt_cache_t *cache,
                             void *attr,
@@ -68,6 +155,18 @@ _mongocrypt_cache_add_copy (_mongocrypt_cache_t *cache,
    MONGOCRYPT_WARN_UNUSED_RESULT;
 
 
+/* Like _mongocrypt_cache_add_copy, but the entry expires @expiration
+ * milliseconds after being added instead of after the cache expiration.
+ * _mongocrypt_cache_set_expiration does not apply to the entry. */
+bool
+_mongocrypt_cache_add_copy_with_expiration (_mongocrypt_cache_t *cache,
+                                            void *attr,
+                                            void *value,
+                                            uint64_t expiration,
+                                            mongocrypt_status_t *status)
+   MONGOCRYPT_WARN_UNUSED_RESULT;
+
+
 /* Steals the value instead of copying. Caller relinquishes value when calling.
  */
 bool
@@ -85,12 +184,44 @@ _mongocrypt_cache_cleanup (_mongocrypt_cache_t *cache);
 void
 _mongocrypt_cache_dump (_mongocrypt_cache_t *cache);
 
-/* Tests may override the default expiration */
+/* Withdraws the refresh reported by a previous lookup of @attr, so the next
+ * lookup within the refresh window reports it again. Used when a refresh is
+ * abandoned before the entry is replaced. */
+void
+_mongocrypt_cache_release_refresh (_mongocrypt_cache_t *cache, void *attr);
+
+/* Tests may override the default expiration. Applies to existing entries. */
 void
 _mongocrypt_cache_set_expiration (_mongocrypt_cache_t *cache, uint64_t milli);
 
+/* Report entries within @milli of expiration as due for a refresh. Pass 0 to
+ * disable. Must be less than the expiration. */
+void
+_mongocrypt_cache_set_refresh_window (_mongocrypt_cache_t *cache,
+                                      uint64_t milli);
+
 uint32_t
 _mongocrypt_cache_num_entries (_mongocrypt_cache_t *cache);
 
+/* Called with the cache locked, so must not use the cache. @remaining is the
+ * number of milliseconds until the pair expires. Return false to stop. */
+typedef bool (*cache_visit_fn) (void *ctx,
+                                void *attr,
+                                void *value,
+                                uint64_t remaining);
+
+/* Calls @fn for each unexpired pair. Returns false if @fn returned false. */
+bool
+_mongocrypt_cache_for_each (_mongocrypt_cache_t *cache,
+                            cache_visit_fn fn,
+                            void *ctx);
+
+/* Bound the number of entries and the total size of values. Pass 0 for no
+ * limit. Evicts immediately if the cache exceeds the new limits. */
+void
+_mongocrypt_cache_set_limits (_mongocrypt_cache_t *cache,
+                              uint32_t max_entries,
+                              uint64_t max_bytes);
+
 
 #endif /* MONGOCRYPT_CACHE_PRIVATE */
\ No newline at end of file
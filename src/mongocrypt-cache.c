@@ -18,81 +18,377 @@
 
 #include "mongocrypt-private.h"
 
+#include "mlib/atomic.h"
 
-/* Did the cache pair expire? Caller must hold lock. */
+
+/* Did the cache pair expire? @now is in milliseconds. Caller must hold at
+ * least one lock. */
 static bool
-_pair_expired (_mongocrypt_cache_t *cache, _mongocrypt_cache_pair_t *pair)
+_pair_expired (_mongocrypt_cache_pair_t *pair, int64_t now)
 {
-   int64_t current;
-
-   current = bson_get_monotonic_time () / 1000;
-   return (current - pair->last_updated) > (int64_t) cache->expiration;
+   return now > pair->expires_at;
 }
 
 
-/* Return the pair after the one being destroyed. */
-static _mongocrypt_cache_pair_t *
-_destroy_pair (_mongocrypt_cache_t *cache,
-               _mongocrypt_cache_pair_t *prev,
-               _mongocrypt_cache_pair_t *pair)
+static void
+_heap_swap (_mongocrypt_cache_t *cache, uint32_t a, uint32_t b)
 {
    _mongocrypt_cache_pair_t *tmp;
-   tmp = pair->next;
 
-   /* Unlink */
-   if (!prev) {
-      cache->pair = cache->pair->next;
+   tmp = cache->heap[a];
+   cache->heap[a] = cache->heap[b];
+   cache->heap[b] = tmp;
+   cache->heap[a]->heap_index = a;
+   cache->heap[b]->heap_index = b;
+}
+
+
+static void
+_heap_sift_up (_mongocrypt_cache_t *cache, uint32_t i)
+{
+   while (i > 0) {
+      uint32_t parent = (i - 1) / 2;
+
+      if (cache->heap[parent]->expires_at <= cache->heap[i]->expires_at) {
+         break;
+      }
+      _heap_swap (cache, parent, i);
+      i = parent;
+   }
+}
+
+
+static void
+_heap_sift_down (_mongocrypt_cache_t *cache, uint32_t i)
+{
+   for (;;) {
+      uint32_t left = 2 * i + 1;
+      uint32_t right = left + 1;
+      uint32_t smallest = i;
+
+      if (left < cache->num_pairs &&
+          cache->heap[left]->expires_at < cache->heap[smallest]->expires_at) {
+         smallest = left;
+      }
+      if (right < cache->num_pairs &&
+          cache->heap[right]->expires_at < cache->heap[smallest]->expires_at) {
+         smallest = right;
+      }
+      if (smallest == i) {
+         break;
+      }
+      _heap_swap (cache, i, smallest);
+      i = smallest;
+   }
+}
+
+
+/* Add @pair to the heap. The heap holds num_pairs entries. Caller must hold
+ * all stripes. */
+static void
+_heap_push (_mongocrypt_cache_t *cache, _mongocrypt_cache_pair_t *pair)
+{
+   uint32_t i = cache->num_pairs++;
+
+   if (cache->num_pairs > cache->heap_cap) {
+      cache->heap_cap = cache->heap_cap ? cache->heap_cap * 2 : 16;
+      cache->heap = bson_realloc (
+         cache->heap, sizeof (_mongocrypt_cache_pair_t *) * cache->heap_cap);
+      BSON_ASSERT (cache->heap);
+   }
+   cache->heap[i] = pair;
+   pair->heap_index = i;
+   _heap_sift_up (cache, i);
+}
+
+
+/* Remove @pair from the heap. Caller must hold all stripes. */
+static void
+_heap_remove (_mongocrypt_cache_t *cache, _mongocrypt_cache_pair_t *pair)
+{
+   uint32_t i = pair->heap_index;
+   uint32_t last = --cache->num_pairs;
+
+   BSON_ASSERT (cache->heap[i] == pair);
+   if (i != last) {
+      _heap_swap (cache, i, last);
+      _heap_sift_down (cache, i);
+      _heap_sift_up (cache, i);
+   }
+}
+
+
+uint32_t
+_mongocrypt_cache_hash_bytes (const void *data, size_t len, uint32_t seed)
+{
+   const uint8_t *bytes = (const uint8_t *) data;
+   uint32_t hash = seed;
+   size_t i;
+
+   for (i = 0; i < len; i++) {
+      hash ^= bytes[i];
+      hash *= 16777619u;
+   }
+   return hash;
+}
+
+
+static mongocrypt_mutex_t *
+_stripe (_mongocrypt_cache_t *cache, uint32_t hash)
+{
+   return &cache->stripes[hash & (CACHE_NUM_STRIPES - 1)];
+}
+
+
+static _mongocrypt_cache_link_t **
+_bucket (_mongocrypt_cache_t *cache, uint32_t hash)
+{
+   return &cache->buckets[hash & (cache->num_buckets - 1)];
+}
+
+
+/* Take every stripe. Stripes are always taken in ascending order. */
+static void
+_lock_all (_mongocrypt_cache_t *cache)
+{
+   int i;
+
+   for (i = 0; i < CACHE_NUM_STRIPES; i++) {
+      _mongocrypt_mutex_lock (&cache->stripes[i]);
+   }
+}
+
+
+static void
+_unlock_all (_mongocrypt_cache_t *cache)
+{
+   int i;
+
+   for (i = CACHE_NUM_STRIPES - 1; i >= 0; i--) {
+      _mongocrypt_mutex_unlock (&cache->stripes[i]);
+   }
+}
+
+
+/* Double the number of buckets. Caller must hold all stripes. */
+static void
+_grow (_mongocrypt_cache_t *cache)
+{
+   _mongocrypt_cache_link_t **old_buckets;
+   uint32_t old_num_buckets;
+   uint32_t i;
+
+   old_buckets = cache->buckets;
+   old_num_buckets = cache->num_buckets;
+
+   cache->num_buckets = old_num_buckets * 2;
+   cache->buckets =
+      bson_malloc0 (sizeof (_mongocrypt_cache_link_t *) * cache->num_buckets);
+   BSON_ASSERT (cache->buckets);
+
+   for (i = 0; i < old_num_buckets; i++) {
+      _mongocrypt_cache_link_t *link, *tmp;
+
+      for (link = old_buckets[i]; NULL != link; link = tmp) {
+         _mongocrypt_cache_link_t **bucket;
+
+         tmp = link->next;
+         bucket = _bucket (cache, link->hash);
+         link->next = *bucket;
+         *bucket = link;
+      }
+   }
+   bson_free (old_buckets);
+}
+
+
+/* Remove every link to @pair from the index. Caller must hold all stripes. */
+static void
+_unindex_pair (_mongocrypt_cache_t *cache, _mongocrypt_cache_pair_t *pair)
+{
+   uint32_t n;
+   uint32_t hash;
+
+   for (n = 0; cache->hash_attr (pair->attr, n, &hash); n++) {
+      _mongocrypt_cache_link_t **link;
+
+      link = _bucket (cache, hash);
+      while (*link) {
+         if ((*link)->pair == pair) {
+            _mongocrypt_cache_link_t *tmp = *link;
+
+            *link = tmp->next;
+            bson_free (tmp);
+            cache->num_links--;
+            continue;
+         }
+         link = &(*link)->next;
+      }
+   }
+}
+
+
+/* Add a link to @pair for each hash of its attribute. Caller must hold all
+ * stripes. */
+static void
+_index_pair (_mongocrypt_cache_t *cache, _mongocrypt_cache_pair_t *pair)
+{
+   uint32_t n;
+   uint32_t hash;
+
+   for (n = 0; cache->hash_attr (pair->attr, n, &hash); n++) {
+      _mongocrypt_cache_link_t **bucket;
+      _mongocrypt_cache_link_t *link;
+
+      /* An attribute may produce the same hash twice. One link suffices. */
+      for (link = *_bucket (cache, hash); NULL != link; link = link->next) {
+         if (link->pair == pair) {
+            break;
+         }
+      }
+      if (link) {
+         continue;
+      }
+
+      link = bson_malloc0 (sizeof (*link));
+      BSON_ASSERT (link);
+      link->hash = hash;
+      link->pair = pair;
+      bucket = _bucket (cache, hash);
+      link->next = *bucket;
+      *bucket = link;
+      cache->num_links++;
+   }
+
+   if (cache->num_links > cache->num_buckets * 2) {
+      _grow (cache);
+   }
+}
+
+
+/* Unlink and destroy a pair. Caller must hold all stripes. */
+static void
+_destroy_pair (_mongocrypt_cache_t *cache, _mongocrypt_cache_pair_t *pair)
+{
+   _unindex_pair (cache, pair);
+
+   if (pair->prev) {
+      pair->prev->next = pair->next;
+   } else {
+      cache->pair = pair->next;
+   }
+   if (pair->next) {
+      pair->next->prev = pair->prev;
    } else {
-      prev->next = pair->next;
+      cache->tail = pair->prev;
    }
+   if (cache->clock_hand == pair) {
+      cache->clock_hand = pair->prev;
+   }
+   _heap_remove (cache, pair);
+   cache->num_bytes -= pair->size;
 
-   /* Destroy pair */
    cache->destroy_attr (pair->attr);
    cache->destroy_value (pair->value);
    bson_free (pair);
-
-   return tmp;
 }
 
-/* Caller must hold mutex. */
+/* Destroy expired pairs. Only expired pairs are visited. Caller must hold all
+ * stripes. */
 void
-_mongocrypt_cache_evict (_mongocrypt_cache_t *cache)
+_mongocrypt_cache_evict (_mongocrypt_cache_t *cache, int64_t now)
 {
-   _mongocrypt_cache_pair_t *pair, *prev;
-
-   prev = NULL;
-   pair = cache->pair;
-   while (pair) {
-      if (_pair_expired (cache, pair)) {
-         pair = _destroy_pair (cache, prev, pair);
-         continue;
-      }
-      prev = pair;
-      pair = pair->next;
+   while (cache->num_pairs > 0 && _pair_expired (cache->heap[0], now)) {
+      _destroy_pair (cache, cache->heap[0]);
    }
 }
 
-/* Caller must hold mutex. */
 static bool
-_mongocrypt_remove_matches (_mongocrypt_cache_t *cache, void *attr)
+_over_limits (_mongocrypt_cache_t *cache)
 {
-   _mongocrypt_cache_pair_t *pair, *prev;
+   if (cache->max_entries && cache->num_pairs > cache->max_entries) {
+      return true;
+   }
+   if (cache->max_bytes && cache->num_bytes > cache->max_bytes) {
+      return true;
+   }
+   return false;
+}
 
-   prev = NULL;
-   pair = cache->pair;
-   while (pair) {
-      int res;
 
-      if (!cache->cmp_attr (pair->attr, attr, &res)) {
-         return false;
+/* Evict least recently used pairs until the cache is within its limits. @keep
+ * is never evicted. Caller must hold all stripes. */
+static void
+_evict_lru (_mongocrypt_cache_t *cache, _mongocrypt_cache_pair_t *keep)
+{
+   while (_over_limits (cache) && cache->num_pairs > (keep ? 1u : 0u)) {
+      _mongocrypt_cache_pair_t *pair;
+
+      /* The hand moves from the oldest pair (the tail) toward the newest,
+       * then wraps around. */
+      if (!cache->clock_hand) {
+         cache->clock_hand = cache->tail;
       }
+      pair = cache->clock_hand;
+      cache->clock_hand = pair->prev;
 
-      if (0 == res) {
-         pair = _destroy_pair (cache, prev, pair);
+      if (pair == keep) {
+         continue;
+      }
+      if (pair->referenced) {
+         pair->referenced = 0;
          continue;
       }
-      prev = pair;
-      pair = pair->next;
+      _destroy_pair (cache, pair);
+   }
+}
+
+
+void
+_mongocrypt_cache_set_limits (_mongocrypt_cache_t *cache,
+                              uint32_t max_entries,
+                              uint64_t max_bytes)
+{
+   _lock_all (cache);
+   cache->max_entries = max_entries;
+   cache->max_bytes = max_bytes;
+   _evict_lru (cache, NULL);
+   _unlock_all (cache);
+}
+
+
+/* Caller must hold all stripes. */
+static bool
+_mongocrypt_remove_matches (_mongocrypt_cache_t *cache, void *attr)
+{
+   uint32_t n;
+   uint32_t hash;
+
+   for (n = 0; cache->hash_attr (attr, n, &hash); n++) {
+      _mongocrypt_cache_link_t *link;
+
+      link = *_bucket (cache, hash);
+      while (link) {
+         int res;
+
+         if (link->hash != hash) {
+            link = link->next;
+            continue;
+         }
+
+         if (!cache->cmp_attr (link->pair->attr, attr, &res)) {
+            return false;
+         }
+
+         if (0 == res) {
+            /* Destroying the pair may remove links from this bucket. Start
+             * over from the head. */
+            _destroy_pair (cache, link->pair);
+            link = *_bucket (cache, hash);
+            continue;
+         }
+         link = link->next;
+      }
    }
 
    return true;
@@ -102,42 +398,101 @@ _mongocrypt_remove_matches (_mongocrypt_cache_t *cache, void *attr)
 void
 _mongocrypt_cache_set_expiration (_mongocrypt_cache_t *cache, uint64_t milli)
 {
+   _mongocrypt_cache_pair_t *pair;
+   uint32_t i;
+
+   _lock_all (cache);
    cache->expiration = milli;
+   for (pair = cache->pair; NULL != pair; pair = pair->next) {
+      if (pair->expiration == 0) {
+         pair->expires_at = pair->last_updated + (int64_t) milli;
+      }
+   }
+   /* Pairs with their own expiration did not change. Rebuild. */
+   for (i = cache->num_pairs / 2; i > 0; i--) {
+      _heap_sift_down (cache, i - 1);
+   }
+   _unlock_all (cache);
+}
+
+
+void
+_mongocrypt_cache_set_refresh_window (_mongocrypt_cache_t *cache,
+                                      uint64_t milli)
+{
+   _lock_all (cache);
+   cache->refresh_window = milli;
+   _unlock_all (cache);
+}
+
+
+void
+_mongocrypt_cache_init (_mongocrypt_cache_t *cache)
+{
+   int i;
+
+   for (i = 0; i < CACHE_NUM_STRIPES; i++) {
+      _mongocrypt_mutex_init (&cache->stripes[i]);
+   }
+   cache->pair = NULL;
+   cache->tail = NULL;
+   cache->clock_hand = NULL;
+   cache->num_buckets = CACHE_INITIAL_BUCKETS;
+   cache->buckets =
+      bson_malloc0 (sizeof (_mongocrypt_cache_link_t *) * cache->num_buckets);
+   BSON_ASSERT (cache->buckets);
+   cache->num_links = 0;
+   cache->num_pairs = 0;
+   cache->heap = NULL;
+   cache->heap_cap = 0;
+   cache->expiration = CACHE_EXPIRATION_MS;
+   cache->refresh_window = 0;
+   cache->max_entries = 0;
+   cache->max_bytes = 0;
+   cache->num_bytes = 0;
 }
 
 
-/* caller must hold lock. */
+/* Find an unexpired pair matching @attr in the bucket for @hash. Caller must
+ * hold the stripe for @hash. */
 static bool
 _find_pair (_mongocrypt_cache_t *cache,
             void *attr,
+            uint32_t hash,
+            int64_t now,
             _mongocrypt_cache_pair_t **out)
 {
-   _mongocrypt_cache_pair_t *pair;
+   _mongocrypt_cache_link_t *link;
 
    *out = NULL;
 
-   pair = cache->pair;
-   while (pair) {
+   for (link = *_bucket (cache, hash); NULL != link; link = link->next) {
       int res;
-      /* TODO: this is a naive O(n) lookup. Consider optimizing
-         with a hash map (possibly vendor one). */
-      if (!cache->cmp_attr (pair->attr, attr, &res)) {
+
+      if (link->hash != hash) {
+         continue;
+      }
+
+      if (!cache->cmp_attr (link->pair->attr, attr, &res)) {
          return false;
       }
 
-      if (res == 0) {
-         *out = pair;
+      /* Expired pairs are removed on the next add. */
+      if (res == 0 && !_pair_expired (link->pair, now)) {
+         *out = link->pair;
          return true;
       }
-      pair = pair->next;
    }
    return true;
 }
 
 
-/* Create a new pair on linked list. Caller must hold lock. */
+/* Create a new pair at the head of the list. Caller must hold all stripes. */
 static _mongocrypt_cache_pair_t *
-_pair_new (_mongocrypt_cache_t *cache, void *attr)
+_pair_new (_mongocrypt_cache_t *cache,
+           void *attr,
+           int64_t now,
+           uint64_t expiration)
 {
    _mongocrypt_cache_pair_t *pair;
 
@@ -146,74 +501,140 @@ _pair_new (_mongocrypt_cache_t *cache, void *attr)
 
    pair->attr = cache->copy_attr (attr);
    /* add rest of values. */
+   pair->expiration = expiration;
    pair->next = cache->pair;
-   pair->last_updated = bson_get_monotonic_time () / 1000;
+   if (cache->pair) {
+      cache->pair->prev = pair;
+   } else {
+      cache->tail = pair;
+   }
+   pair->last_updated = now;
+   pair->expires_at =
+      now + (int64_t) (expiration ? expiration : cache->expiration);
    cache->pair = pair;
+   _heap_push (cache, pair);
    return pair;
 }
 
 
-/* Caller must hold lock. */
-static void
-_cache_pair_destroy (_mongocrypt_cache_t *cache, _mongocrypt_cache_pair_t *pair)
+bool
+_mongocrypt_cache_get (_mongocrypt_cache_t *cache,
+                       void *attr, /* attr of cache item */
+                       void **value /* copied to. */)
 {
-   cache->destroy_attr (pair->attr);
-   cache->destroy_value (pair->value);
-   bson_free (pair);
+   return _mongocrypt_cache_get_refresh (cache, attr, value, NULL);
 }
 
 
 bool
-_mongocrypt_cache_get (_mongocrypt_cache_t *cache,
-                       void *attr, /* attr of cache item */
-                       void **value /* copied to. */)
+_mongocrypt_cache_get_refresh (_mongocrypt_cache_t *cache,
+                               void *attr,
+                               void **value,
+                               bool *refresh_due /* NULLable */)
 {
-   _mongocrypt_cache_pair_t *match;
+   uint32_t n;
+   uint32_t hash;
+   int64_t now;
 
    *value = NULL;
-
-   _mongocrypt_mutex_lock (&cache->mutex);
-   /* TODO CDRIVER-3120: optimize the eviction algorithm to avoid unnecessary
-    * O(n) traversal */
-   _mongocrypt_cache_evict (cache);
-   if (!_find_pair (cache, attr, &match)) {
-      _mongocrypt_mutex_unlock (&cache->mutex);
-      return false;
+   if (refresh_due) {
+      *refresh_due = false;
    }
+   now = bson_get_monotonic_time () / 1000;
 
-   if (match) {
-      *value = cache->copy_value (match->value);
+   for (n = 0; cache->hash_attr (attr, n, &hash); n++) {
+      _mongocrypt_cache_pair_t *match;
+      mongocrypt_mutex_t *stripe;
+
+      stripe = _stripe (cache, hash);
+      _mongocrypt_mutex_lock (stripe);
+      if (!_find_pair (cache, attr, hash, now, &match)) {
+         _mongocrypt_mutex_unlock (stripe);
+         return false;
+      }
+
+      if (match) {
+         mlib_atomic_store_i32 (&match->referenced, 1);
+         if (refresh_due && cache->refresh_window > 0 &&
+             now >= match->expires_at - (int64_t) cache->refresh_window) {
+            /* Only the first caller to see the pair as due is told. */
+            *refresh_due =
+               mlib_atomic_add_i32 (&match->refresh_claimed, 1) == 1;
+         }
+         *value = cache->copy_value (match->value);
+         _mongocrypt_mutex_unlock (stripe);
+         return true;
+      }
+      _mongocrypt_mutex_unlock (stripe);
    }
-   _mongocrypt_mutex_unlock (&cache->mutex);
    return true;
 }
 
 
+void
+_mongocrypt_cache_release_refresh (_mongocrypt_cache_t *cache, void *attr)
+{
+   uint32_t n;
+   uint32_t hash;
+   int64_t now;
+
+   now = bson_get_monotonic_time () / 1000;
+
+   for (n = 0; cache->hash_attr (attr, n, &hash); n++) {
+      _mongocrypt_cache_pair_t *match;
+      mongocrypt_mutex_t *stripe;
+
+      stripe = _stripe (cache, hash);
+      _mongocrypt_mutex_lock (stripe);
+      if (!_find_pair (cache, attr, hash, now, &match)) {
+         _mongocrypt_mutex_unlock (stripe);
+         return;
+      }
+
+      if (match) {
+         mlib_atomic_store_i32 (&match->refresh_claimed, 0);
+         _mongocrypt_mutex_unlock (stripe);
+         return;
+      }
+      _mongocrypt_mutex_unlock (stripe);
+   }
+}
+
+
 static bool
 _cache_add (_mongocrypt_cache_t *cache,
             void *attr,
             void *value,
+            uint64_t expiration,
             mongocrypt_status_t *status,
             bool steal_value)
 {
    _mongocrypt_cache_pair_t *pair;
+   int64_t now;
 
-   _mongocrypt_mutex_lock (&cache->mutex);
-   _mongocrypt_cache_evict (cache);
+   now = bson_get_monotonic_time () / 1000;
+   _lock_all (cache);
+   _mongocrypt_cache_evict (cache, now);
    if (!_mongocrypt_remove_matches (cache, attr)) {
       CLIENT_ERR ("error removing from cache");
-      _mongocrypt_mutex_unlock (&cache->mutex);
+      _unlock_all (cache);
       return false;
    }
 
-   pair = _pair_new (cache, attr);
+   pair = _pair_new (cache, attr, now, expiration);
 
    if (steal_value) {
       pair->value = value;
    } else {
       pair->value = cache->copy_value (value);
    }
-   _mongocrypt_mutex_unlock (&cache->mutex);
+   if (cache->size_value) {
+      pair->size = cache->size_value (pair->value);
+      cache->num_bytes += pair->size;
+   }
+   _index_pair (cache, pair);
+   _evict_lru (cache, pair);
+   _unlock_all (cache);
    return true;
 }
 
@@ -224,7 +645,18 @@ _mongocrypt_cache_add_copy (_mongocrypt_cache_t *cache,
                             void *value,
                             mongocrypt_status_t *status)
 {
-   return _cache_add (cache, attr, value, status, false);
+   return _cache_add (cache, attr, value, 0, status, false);
+}
+
+
+bool
+_mongocrypt_cache_add_copy_with_expiration (_mongocrypt_cache_t *cache,
+                                            void *attr,
+                                            void *value,
+                                            uint64_t expiration,
+                                            mongocrypt_status_t *status)
+{
+   return _cache_add (cache, attr, value, expiration, status, false);
 }
 
 
@@ -234,20 +666,44 @@ _mongocrypt_cache_add_stolen (_mongocrypt_cache_t *cache,
                               void *value,
                               mongocrypt_status_t *status)
 {
-   return _cache_add (cache, attr, value, status, true);
+   return _cache_add (cache, attr, value, 0, status, true);
 }
 
 void
 _mongocrypt_cache_cleanup (_mongocrypt_cache_t *cache)
 {
    _mongocrypt_cache_pair_t *pair, *tmp;
+   uint32_t i;
+   int j;
 
    pair = cache->pair;
    while (pair) {
       tmp = pair->next;
-      _cache_pair_destroy (cache, pair);
+      cache->destroy_attr (pair->attr);
+      cache->destroy_value (pair->value);
+      bson_free (pair);
       pair = tmp;
    }
+   cache->pair = NULL;
+   cache->tail = NULL;
+   cache->clock_hand = NULL;
+
+   for (i = 0; i < cache->num_buckets; i++) {
+      _mongocrypt_cache_link_t *link, *next;
+
+      for (link = cache->buckets[i]; NULL != link; link = next) {
+         next = link->next;
+         bson_free (link);
+      }
+   }
+   bson_free (cache->buckets);
+   cache->buckets = NULL;
+   bson_free (cache->heap);
+   cache->heap = NULL;
+
+   for (j = 0; j < CACHE_NUM_STRIPES; j++) {
+      _mongocrypt_mutex_cleanup (&cache->stripes[j]);
+   }
 }
 
 /* Print the contents of the cache (for debugging purposes) */
@@ -257,7 +713,7 @@ _mongocrypt_cache_dump (_mongocrypt_cache_t *cache)
    _mongocrypt_cache_pair_t *pair;
    int count;
 
-   _mongocrypt_mutex_lock (&cache->mutex);
+   _lock_all (cache);
    count = 0;
    for (pair = cache->pair; pair != NULL; pair = pair->next) {
       printf ("entry:%d last_updated:%d\n", count, (int) pair->last_updated);
@@ -268,22 +724,45 @@ _mongocrypt_cache_dump (_mongocrypt_cache_t *cache)
       count++;
    }
 
-   _mongocrypt_mutex_unlock (&cache->mutex);
+   _unlock_all (cache);
 }
 
 
 uint32_t
 _mongocrypt_cache_num_entries (_mongocrypt_cache_t *cache)
 {
-   _mongocrypt_cache_pair_t *pair;
    uint32_t count;
 
-   _mongocrypt_mutex_lock (&cache->mutex);
-   count = 0;
-   for (pair = cache->pair; pair != NULL; pair = pair->next) {
-      count++;
-   }
-
-   _mongocrypt_mutex_unlock (&cache->mutex);
+   _lock_all (cache);
+   count = cache->num_pairs;
+   _unlock_all (cache);
    return count;
-}
\ No newline at end of file
+}
+
+
+bool
+_mongocrypt_cache_for_each (_mongocrypt_cache_t *cache,
+                            cache_visit_fn fn,
+                            void *ctx)
+{
+   _mongocrypt_cache_pair_t *pair;
+   int64_t now;
+   bool ret = true;
+
+   now = bson_get_monotonic_time () / 1000;
+   _lock_all (cache);
+   for (pair = cache->pair; NULL != pair; pair = pair->next) {
+      if (_pair_expired (pair, now)) {
+         continue;
+      }
+      if (!fn (ctx,
+               pair->attr,
+               pair->value,
+               (uint64_t) (pair->expires_at - now))) {
+         ret = false;
+         break;
+      }
+   }
+   _unlock_all (cache);
+   return ret;
+}
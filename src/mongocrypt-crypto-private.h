@@ -42,8 +42,43 @@ typedef struct {
    mongocrypt_hmac_fn hmac_sha_256;
    mongocrypt_hash_fn sha_256;
    void *ctx;
+   /* Optional. Set with mongocrypt_setopt_crypto_hooks_iov. */
+   mongocrypt_crypto_iov_fn aes_256_cbc_encrypt_iov;
+   mongocrypt_hmac_iov_fn hmac_sha_512_iov;
+   mongocrypt_hmac_iov_fn hmac_sha_256_iov;
+   void *iov_ctx;
 } _mongocrypt_crypto_t;
 
+/* Opaque key state precomputed by the native crypto library. */
+typedef struct _native_crypto_aes_key_t _native_crypto_aes_key_t;
+typedef struct _native_crypto_hmac_key_t _native_crypto_hmac_key_t;
+
+/* Per-key state for a 96 byte data key. The key is split once into its
+ * MAC_KEY, ENC_KEY, and IV key. If the native crypto library supports it, the
+ * AES key schedule and HMAC pads are also computed once. A key state is
+ * immutable, so it may be used by several threads at once. */
+typedef struct {
+   /* Views into the key passed to _mongocrypt_key_state_new. */
+   _mongocrypt_buffer_t mac_key;
+   _mongocrypt_buffer_t enc_key;
+   _mongocrypt_buffer_t iv_key;
+   /* NULL if crypto hooks are set or the native crypto library does not
+    * support precomputed key state. */
+   _native_crypto_aes_key_t *native_enc_key;
+   _native_crypto_hmac_key_t *native_mac_key;
+   _native_crypto_hmac_key_t *native_iv_key;
+} _mongocrypt_key_state_t;
+
+/* Returns NULL if @key is not MONGOCRYPT_KEY_LEN bytes. @key must outlive the
+ * returned state. */
+_mongocrypt_key_state_t *
+_mongocrypt_key_state_new (_mongocrypt_crypto_t *crypto,
+                           const _mongocrypt_buffer_t *key);
+
+/* Frees @key_state and zeroes the native key state. */
+void
+_mongocrypt_key_state_destroy (_mongocrypt_key_state_t *key_state);
+
 uint32_t
 _mongocrypt_calculate_ciphertext_len (uint32_t plaintext_len);
 
@@ -81,6 +116,18 @@ _mongocrypt_do_encryption (_mongocrypt_crypto_t *crypto,
                            mongocrypt_status_t *status)
    MONGOCRYPT_WARN_UNUSED_RESULT;
 
+/* Like _mongocrypt_do_encryption, but takes precomputed key state. */
+bool
+_mongocrypt_do_encryption_with_key_state (
+   _mongocrypt_crypto_t *crypto,
+   const _mongocrypt_buffer_t *iv,
+   const _mongocrypt_buffer_t *associated_data,
+   const _mongocrypt_key_state_t *key_state,
+   const _mongocrypt_buffer_t *plaintext,
+   _mongocrypt_buffer_t *ciphertext,
+   uint32_t *bytes_written,
+   mongocrypt_status_t *status) MONGOCRYPT_WARN_UNUSED_RESULT;
+
 bool
 _mongocrypt_do_decryption (_mongocrypt_crypto_t *crypto,
                            const _mongocrypt_buffer_t *associated_data,
@@ -91,6 +138,17 @@ _mongocrypt_do_decryption (_mongocrypt_crypto_t *crypto,
                            mongocrypt_status_t *status)
    MONGOCRYPT_WARN_UNUSED_RESULT;
 
+/* Like _mongocrypt_do_decryption, but takes precomputed key state. */
+bool
+_mongocrypt_do_decryption_with_key_state (
+   _mongocrypt_crypto_t *crypto,
+   const _mongocrypt_buffer_t *associated_data,
+   const _mongocrypt_key_state_t *key_state,
+   const _mongocrypt_buffer_t *ciphertext,
+   _mongocrypt_buffer_t *plaintext,
+   uint32_t *bytes_written,
+   mongocrypt_status_t *status) MONGOCRYPT_WARN_UNUSED_RESULT;
+
 /* _mongocrypt_fle2aead_do_encryption does AEAD encryption.
  * It follows the construction described in the [AEAD with
  * CTR](https://docs.google.com/document/d/1eCU7R8Kjr-mdyz6eKvhNIDVmhyYQcAaLtTfHeK7a_vE/)
@@ -221,6 +279,17 @@ _mongocrypt_calculate_deterministic_iv (
    _mongocrypt_buffer_t *out,
    mongocrypt_status_t *status) MONGOCRYPT_WARN_UNUSED_RESULT;
 
+/* Like _mongocrypt_calculate_deterministic_iv, but takes precomputed key
+ * state. */
+bool
+_mongocrypt_calculate_deterministic_iv_with_key_state (
+   _mongocrypt_crypto_t *crypto,
+   const _mongocrypt_key_state_t *key_state,
+   const _mongocrypt_buffer_t *plaintext,
+   const _mongocrypt_buffer_t *associated_data,
+   _mongocrypt_buffer_t *out,
+   mongocrypt_status_t *status) MONGOCRYPT_WARN_UNUSED_RESULT;
+
 /*
  * _mongocrypt_hmac_sha_256 computes the HMAC SHA-256.
  *
@@ -256,6 +325,8 @@ typedef struct {
    _mongocrypt_buffer_t *out;
    uint32_t *bytes_written;
    mongocrypt_status_t *status;
+   /* Optional. If set, the precomputed state of @key. */
+   const _native_crypto_aes_key_t *native_key;
 } aes_256_args_t;
 
 bool
@@ -273,6 +344,26 @@ _native_crypto_hmac_sha_512 (const _mongocrypt_buffer_t *key,
                              mongocrypt_status_t *status)
    MONGOCRYPT_WARN_UNUSED_RESULT;
 
+/* Computes the HMAC SHA-512 of the concatenation of the @num_in buffers in
+ * @in, without copying them into one buffer. */
+bool
+_native_crypto_hmac_sha_512_parts (const _mongocrypt_buffer_t *key,
+                                   const _mongocrypt_buffer_t *in,
+                                   uint32_t num_in,
+                                   _mongocrypt_buffer_t *out,
+                                   mongocrypt_status_t *status)
+   MONGOCRYPT_WARN_UNUSED_RESULT;
+
+/* Computes the HMAC SHA-512 of the concatenation of the @num_in buffers in
+ * @in with a key precomputed by _native_crypto_hmac_sha_512_key_new. */
+bool
+_native_crypto_hmac_sha_512_with_key (const _native_crypto_hmac_key_t *key,
+                                      const _mongocrypt_buffer_t *in,
+                                      uint32_t num_in,
+                                      _mongocrypt_buffer_t *out,
+                                      mongocrypt_status_t *status)
+   MONGOCRYPT_WARN_UNUSED_RESULT;
+
 bool
 _native_crypto_random (_mongocrypt_buffer_t *out,
                        uint32_t count,
@@ -294,4 +385,31 @@ _native_crypto_hmac_sha_256 (const _mongocrypt_buffer_t *key,
                              mongocrypt_status_t *status)
    MONGOCRYPT_WARN_UNUSED_RESULT;
 
+/* Computes the HMAC SHA-256 of the concatenation of the @num_in buffers in
+ * @in, without copying them into one buffer. */
+bool
+_native_crypto_hmac_sha_256_parts (const _mongocrypt_buffer_t *key,
+                                   const _mongocrypt_buffer_t *in,
+                                   uint32_t num_in,
+                                   _mongocrypt_buffer_t *out,
+                                   mongocrypt_status_t *status)
+   MONGOCRYPT_WARN_UNUSED_RESULT;
+
+/* Precompute the AES-256-CBC key schedule for @key, for both directions. Pass
+ * the result as aes_256_args_t.native_key. Returns NULL if the crypto library
+ * does not support precomputed keys. */
+_native_crypto_aes_key_t *
+_native_crypto_aes_256_cbc_key_new (const _mongocrypt_buffer_t *key);
+
+void
+_native_crypto_aes_256_cbc_key_destroy (_native_crypto_aes_key_t *key);
+
+/* Precompute the HMAC SHA-512 pads for @key. Returns NULL if the crypto
+ * library does not support precomputed keys. */
+_native_crypto_hmac_key_t *
+_native_crypto_hmac_sha_512_key_new (const _mongocrypt_buffer_t *key);
+
+void
+_native_crypto_hmac_sha_512_key_destroy (_native_crypto_hmac_key_t *key);
+
 #endif /* MONGOCRYPT_CRYPTO_PRIVATE_H */
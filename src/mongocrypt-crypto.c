@@ -30,10 +30,49 @@
 
 #include <inttypes.h>
 
+/* The most counter blocks passed to the ECB callback in one call. */
+#define CTR_VIA_ECB_MAX_BLOCKS 4096
+
+/* Increments a big-endian counter block. */
+static void
+_increment_ctr (uint8_t *ctr)
+{
+   uint32_t carry = 1;
+   for (int i = MONGOCRYPT_BLOCK_SIZE - 1; i >= 0 && carry != 0; --i) {
+      uint32_t bpp = carry + ctr[i];
+      carry = bpp >> 8;
+      ctr[i] = bpp & 0xFF;
+   }
+}
+
+/* Sets @out to @in XOR @keystream, eight bytes at a time. @out may be @in. */
+static void
+_xor_keystream (uint8_t *out,
+                const uint8_t *in,
+                const uint8_t *keystream,
+                uint32_t len)
+{
+   uint32_t i = 0;
+
+   for (; i + sizeof (uint64_t) <= len; i += sizeof (uint64_t)) {
+      uint64_t a, b;
+      memcpy (&a, in + i, sizeof (a));
+      memcpy (&b, keystream + i, sizeof (b));
+      a ^= b;
+      memcpy (out + i, &a, sizeof (a));
+   }
+   for (; i < len; i++) {
+      out[i] = in[i] ^ keystream[i];
+   }
+}
+
 /* This function uses ECB callback to simulate CTR encrypt and decrypt
  *
  * Note: the same function performs both encrypt and decrypt using same ECB
  * encryption function
+ *
+ * The counter blocks for up to CTR_VIA_ECB_MAX_BLOCKS blocks are encrypted in
+ * one call to the callback, rather than calling it once per block.
  */
 
 static bool
@@ -43,7 +82,7 @@ _crypto_aes_256_ctr_encrypt_decrypt_via_ecb (
    aes_256_args_t args,
    mongocrypt_status_t *status)
 {
-   BSON_ASSERT (args.iv && args.iv->len);
+   BSON_ASSERT (args.iv && args.iv->len == MONGOCRYPT_BLOCK_SIZE);
    BSON_ASSERT (args.out);
 
    if (args.out->len < args.in->len) {
@@ -51,47 +90,64 @@ _crypto_aes_256_ctr_encrypt_decrypt_via_ecb (
       return false;
    }
 
-   _mongocrypt_buffer_t ctr, tmp;
-   mongocrypt_binary_t key_bin, out_bin, in_bin, ctr_bin, tmp_bin;
+   _mongocrypt_buffer_t ctrs, keystream;
+   mongocrypt_binary_t key_bin, ctrs_bin, keystream_bin;
+   uint8_t ctr[MONGOCRYPT_BLOCK_SIZE];
+   uint32_t num_blocks, max_blocks;
    bool ret;
 
+   num_blocks = args.in->len / MONGOCRYPT_BLOCK_SIZE +
+                (args.in->len % MONGOCRYPT_BLOCK_SIZE != 0);
+   max_blocks = BSON_MIN (num_blocks, CTR_VIA_ECB_MAX_BLOCKS);
+
    _mongocrypt_buffer_to_binary (args.key, &key_bin);
-   _mongocrypt_buffer_init (&ctr);
-   _mongocrypt_buffer_copy_to (args.iv, &ctr);
-   _mongocrypt_buffer_to_binary (&ctr, &ctr_bin);
-   _mongocrypt_buffer_to_binary (args.out, &out_bin);
-   _mongocrypt_buffer_to_binary (args.in, &in_bin);
-   _mongocrypt_buffer_init_size (&tmp, args.iv->len);
-   _mongocrypt_buffer_to_binary (&tmp, &tmp_bin);
+   memcpy (ctr, args.iv->data, MONGOCRYPT_BLOCK_SIZE);
+   _mongocrypt_buffer_init_size (&ctrs, max_blocks * MONGOCRYPT_BLOCK_SIZE);
+   _mongocrypt_buffer_init_size (&keystream,
+                                 max_blocks * MONGOCRYPT_BLOCK_SIZE);
 
    for (uint32_t ptr = 0; ptr < args.in->len;) {
-      /* Encrypt value in CTR buffer */
+      uint32_t blocks = BSON_MIN (num_blocks, max_blocks);
+      uint32_t len = BSON_MIN (blocks * MONGOCRYPT_BLOCK_SIZE,
+                               args.in->len - ptr);
       uint32_t bytes_written = 0;
-      if (!aes_256_ecb_encrypt (
-             ctx, &key_bin, NULL, &ctr_bin, &tmp_bin, &bytes_written, status)) {
+
+      /* Lay out the next counter values. */
+      for (uint32_t i = 0; i < blocks; i++) {
+         memcpy (ctrs.data + i * MONGOCRYPT_BLOCK_SIZE,
+                 ctr,
+                 MONGOCRYPT_BLOCK_SIZE);
+         _increment_ctr (ctr);
+      }
+
+      /* Encrypt them to get the key stream. */
+      ctrs_bin.data = ctrs.data;
+      ctrs_bin.len = blocks * MONGOCRYPT_BLOCK_SIZE;
+      keystream_bin.data = keystream.data;
+      keystream_bin.len = blocks * MONGOCRYPT_BLOCK_SIZE;
+      if (!aes_256_ecb_encrypt (ctx,
+                                &key_bin,
+                                NULL,
+                                &ctrs_bin,
+                                &keystream_bin,
+                                &bytes_written,
+                                status)) {
          ret = false;
          goto cleanup;
       }
 
-      if (bytes_written != tmp_bin.len) {
+      if (bytes_written != keystream_bin.len) {
          CLIENT_ERR ("encryption hook returned unexpected length");
          ret = false;
          goto cleanup;
       }
 
       /* XOR resulting stream with original data */
-      for (uint32_t i = 0; i < bytes_written && ptr < args.in->len;
-           i++, ptr++) {
-         out_bin.data[ptr] = in_bin.data[ptr] ^ tmp_bin.data[i];
-      }
+      _xor_keystream (
+         args.out->data + ptr, args.in->data + ptr, keystream.data, len);
 
-      /* Increment value in CTR buffer */
-      uint32_t carry = 1;
-      for (int i = ctr_bin.len - 1; i >= 0 && carry != 0; --i) {
-         uint32_t bpp = carry + ctr_bin.data[i];
-         carry = bpp >> 8;
-         ctr_bin.data[i] = bpp & 0xFF;
-      }
+      ptr += len;
+      num_blocks -= blocks;
    }
 
    if (args.bytes_written) {
@@ -101,8 +157,8 @@ _crypto_aes_256_ctr_encrypt_decrypt_via_ecb (
    ret = true;
 
 cleanup:
-   _mongocrypt_buffer_cleanup (&ctr);
-   _mongocrypt_buffer_cleanup (&tmp);
+   _mongocrypt_buffer_cleanup (&ctrs);
+   _mongocrypt_buffer_cleanup (&keystream);
    return ret;
 }
 
@@ -143,6 +199,56 @@ _crypto_aes_256_cbc_encrypt (_mongocrypt_crypto_t *crypto, aes_256_args_t args)
    return _native_crypto_aes_256_cbc_encrypt (args);
 }
 
+/* The most segments passed to a scatter/gather hook. */
+#define MAX_HOOK_SEGMENTS 3
+
+/* Calls the scatter/gather AES-256-CBC encrypt hook on the concatenation of
+ * the @num_in buffers in @in. */
+static bool
+_crypto_aes_256_cbc_encrypt_iov (_mongocrypt_crypto_t *crypto,
+                                 const _mongocrypt_buffer_t *key,
+                                 const _mongocrypt_buffer_t *iv,
+                                 const _mongocrypt_buffer_t *in,
+                                 uint32_t num_in,
+                                 _mongocrypt_buffer_t *out,
+                                 uint32_t *bytes_written,
+                                 mongocrypt_status_t *status)
+{
+   mongocrypt_binary_t enc_key_bin, iv_bin, out_bin;
+   mongocrypt_binary_t in_bins[MAX_HOOK_SEGMENTS];
+   mongocrypt_binary_t *in_ptrs[MAX_HOOK_SEGMENTS];
+   uint32_t i;
+
+   BSON_ASSERT (num_in <= MAX_HOOK_SEGMENTS);
+
+   if (key->len != MONGOCRYPT_ENC_KEY_LEN) {
+      CLIENT_ERR ("invalid encryption key length");
+      return false;
+   }
+
+   if (iv->len != MONGOCRYPT_IV_LEN) {
+      CLIENT_ERR ("invalid iv length");
+      return false;
+   }
+
+   _mongocrypt_buffer_to_binary (key, &enc_key_bin);
+   _mongocrypt_buffer_to_binary (iv, &iv_bin);
+   _mongocrypt_buffer_to_binary (out, &out_bin);
+   for (i = 0; i < num_in; i++) {
+      _mongocrypt_buffer_to_binary (&in[i], &in_bins[i]);
+      in_ptrs[i] = &in_bins[i];
+   }
+
+   return crypto->aes_256_cbc_encrypt_iov (crypto->iov_ctx,
+                                           &enc_key_bin,
+                                           &iv_bin,
+                                           in_ptrs,
+                                           num_in,
+                                           &out_bin,
+                                           bytes_written,
+                                           status);
+}
+
 static bool
 _crypto_aes_256_ctr_encrypt (_mongocrypt_crypto_t *crypto, aes_256_args_t args)
 {
@@ -250,10 +356,75 @@ _crypto_aes_256_ctr_decrypt (_mongocrypt_crypto_t *crypto, aes_256_args_t args)
    return _native_crypto_aes_256_ctr_decrypt (args);
 }
 
+/* Calls a one-shot HMAC hook on the concatenation of the @num_in buffers in
+ * @in. Hooks take a single input, so the parts are only copied into one buffer
+ * when there is more than one. */
+static bool
+_crypto_hmac_hook (_mongocrypt_crypto_t *crypto,
+                   mongocrypt_hmac_fn hmac_fn,
+                   const _mongocrypt_buffer_t *hmac_key,
+                   const _mongocrypt_buffer_t *in,
+                   uint32_t num_in,
+                   _mongocrypt_buffer_t *out,
+                   mongocrypt_status_t *status)
+{
+   mongocrypt_binary_t hmac_key_bin, out_bin, in_bin;
+   _mongocrypt_buffer_t to_hmac;
+   bool ret;
+
+   _mongocrypt_buffer_init (&to_hmac);
+   if (num_in == 1) {
+      _mongocrypt_buffer_to_binary (in, &in_bin);
+   } else {
+      if (!_mongocrypt_buffer_concat (&to_hmac, in, num_in)) {
+         CLIENT_ERR ("failed to allocate buffer");
+         return false;
+      }
+      _mongocrypt_buffer_to_binary (&to_hmac, &in_bin);
+   }
+
+   _mongocrypt_buffer_to_binary (hmac_key, &hmac_key_bin);
+   _mongocrypt_buffer_to_binary (out, &out_bin);
+
+   ret = hmac_fn (crypto->ctx, &hmac_key_bin, &in_bin, &out_bin, status);
+   _mongocrypt_buffer_cleanup (&to_hmac);
+   return ret;
+}
+
+/* Calls a scatter/gather HMAC hook on the @num_in buffers in @in. */
+static bool
+_crypto_hmac_iov_hook (_mongocrypt_crypto_t *crypto,
+                       mongocrypt_hmac_iov_fn hmac_fn,
+                       const _mongocrypt_buffer_t *hmac_key,
+                       const _mongocrypt_buffer_t *in,
+                       uint32_t num_in,
+                       _mongocrypt_buffer_t *out,
+                       mongocrypt_status_t *status)
+{
+   mongocrypt_binary_t hmac_key_bin, out_bin;
+   mongocrypt_binary_t in_bins[MAX_HOOK_SEGMENTS];
+   mongocrypt_binary_t *in_ptrs[MAX_HOOK_SEGMENTS];
+   uint32_t i;
+
+   BSON_ASSERT (num_in <= MAX_HOOK_SEGMENTS);
+
+   _mongocrypt_buffer_to_binary (hmac_key, &hmac_key_bin);
+   _mongocrypt_buffer_to_binary (out, &out_bin);
+   for (i = 0; i < num_in; i++) {
+      _mongocrypt_buffer_to_binary (&in[i], &in_bins[i]);
+      in_ptrs[i] = &in_bins[i];
+   }
+
+   return hmac_fn (
+      crypto->iov_ctx, &hmac_key_bin, in_ptrs, num_in, &out_bin, status);
+}
+
 static bool
 _crypto_hmac_sha_512 (_mongocrypt_crypto_t *crypto,
                       const _mongocrypt_buffer_t *hmac_key,
+                      const _native_crypto_hmac_key_t *native_key,
                       const _mongocrypt_buffer_t *in,
+                      uint32_t num_in,
                       _mongocrypt_buffer_t *out,
                       mongocrypt_status_t *status)
 {
@@ -268,18 +439,51 @@ _crypto_hmac_sha_512 (_mongocrypt_crypto_t *crypto,
    }
 
    if (crypto->hooks_enabled) {
-      mongocrypt_binary_t hmac_key_bin, out_bin, in_bin;
-      bool ret;
+      if (crypto->hmac_sha_512_iov) {
+         return _crypto_hmac_iov_hook (crypto,
+                                       crypto->hmac_sha_512_iov,
+                                       hmac_key,
+                                       in,
+                                       num_in,
+                                       out,
+                                       status);
+      }
+      return _crypto_hmac_hook (
+         crypto, crypto->hmac_sha_512, hmac_key, in, num_in, out, status);
+   }
+   if (native_key) {
+      return _native_crypto_hmac_sha_512_with_key (
+         native_key, in, num_in, out, status);
+   }
+   return _native_crypto_hmac_sha_512_parts (
+      hmac_key, in, num_in, out, status);
+}
 
-      _mongocrypt_buffer_to_binary (hmac_key, &hmac_key_bin);
-      _mongocrypt_buffer_to_binary (out, &out_bin);
-      _mongocrypt_buffer_to_binary (in, &in_bin);
+static bool
+_crypto_hmac_sha_256 (_mongocrypt_crypto_t *crypto,
+                      const _mongocrypt_buffer_t *key,
+                      const _mongocrypt_buffer_t *in,
+                      uint32_t num_in,
+                      _mongocrypt_buffer_t *out,
+                      mongocrypt_status_t *status)
+{
+   if (key->len != MONGOCRYPT_MAC_KEY_LEN) {
+      CLIENT_ERR ("invalid hmac_sha_256 key length. Got %" PRIu32
+                  ", expected: %" PRIu32,
+                  key->len,
+                  MONGOCRYPT_MAC_KEY_LEN);
+      return false;
+   }
 
-      ret = crypto->hmac_sha_512 (
-         crypto->ctx, &hmac_key_bin, &in_bin, &out_bin, status);
-      return ret;
+   if (crypto->hooks_enabled) {
+      if (crypto->hmac_sha_256_iov) {
+         return _crypto_hmac_iov_hook (
+            crypto, crypto->hmac_sha_256_iov, key, in, num_in, out, status);
+      }
+      return _crypto_hmac_hook (
+         crypto, crypto->hmac_sha_256, key, in, num_in, out, status);
    }
-   return _native_crypto_hmac_sha_512 (hmac_key, in, out, status);
+   return _native_crypto_hmac_sha_256_parts (key, in, num_in, out, status);
 }
 
 
@@ -400,6 +604,70 @@ _mongocrypt_fle2_calculate_plaintext_len (uint32_t ciphertext_len)
    return ciphertext_len - MONGOCRYPT_IV_LEN;
 }
 
+/* [MCGREW]: Step 1. "MAC_KEY consists of the initial MAC_KEY_LEN octets of K,
+ * in order. ENC_KEY consists of the final ENC_KEY_LEN octets of K, in order."
+ * The IV key used for deterministic encryption follows ENC_KEY. */
+static void
+_key_state_init (_mongocrypt_key_state_t *key_state,
+                 const _mongocrypt_buffer_t *key)
+{
+   BSON_ASSERT (key->len == MONGOCRYPT_KEY_LEN);
+
+   memset (key_state, 0, sizeof (*key_state));
+   key_state->mac_key.data = (uint8_t *) key->data;
+   key_state->mac_key.len = MONGOCRYPT_MAC_KEY_LEN;
+   key_state->enc_key.data = (uint8_t *) key->data + MONGOCRYPT_MAC_KEY_LEN;
+   key_state->enc_key.len = MONGOCRYPT_ENC_KEY_LEN;
+   key_state->iv_key.data =
+      (uint8_t *) key->data + MONGOCRYPT_MAC_KEY_LEN + MONGOCRYPT_ENC_KEY_LEN;
+   key_state->iv_key.len = MONGOCRYPT_IV_KEY_LEN;
+}
+
+
+_mongocrypt_key_state_t *
+_mongocrypt_key_state_new (_mongocrypt_crypto_t *crypto,
+                           const _mongocrypt_buffer_t *key)
+{
+   _mongocrypt_key_state_t *key_state;
+
+   BSON_ASSERT_PARAM (crypto);
+   BSON_ASSERT_PARAM (key);
+
+   if (key->len != MONGOCRYPT_KEY_LEN) {
+      return NULL;
+   }
+
+   key_state = bson_malloc (sizeof (*key_state));
+   BSON_ASSERT (key_state);
+   _key_state_init (key_state, key);
+
+   /* Hooks are given the raw key, so there is nothing to precompute. */
+   if (!crypto->hooks_enabled) {
+      key_state->native_enc_key =
+         _native_crypto_aes_256_cbc_key_new (&key_state->enc_key);
+      key_state->native_mac_key =
+         _native_crypto_hmac_sha_512_key_new (&key_state->mac_key);
+      key_state->native_iv_key =
+         _native_crypto_hmac_sha_512_key_new (&key_state->iv_key);
+   }
+   return key_state;
+}
+
+
+void
+_mongocrypt_key_state_destroy (_mongocrypt_key_state_t *key_state)
+{
+   if (!key_state) {
+      return;
+   }
+
+   _native_crypto_aes_256_cbc_key_destroy (key_state->native_enc_key);
+   _native_crypto_hmac_sha_512_key_destroy (key_state->native_mac_key);
+   _native_crypto_hmac_sha_512_key_destroy (key_state->native_iv_key);
+   bson_free (key_state);
+}
+
+
 /* ----------------------------------------------------------------------------
  *
  * _aes256_cbc_encrypt --
@@ -409,6 +677,7 @@ _mongocrypt_fle2_calculate_plaintext_len (uint32_t ciphertext_len)
  * Parameters:
  *    @iv a 16 byte IV.
  *    @enc_key a 32 byte key.
+ *    @native_enc_key the precomputed state of @enc_key. May be NULL.
  *    @plaintext the plaintext to encrypt.
  *    @ciphertext the resulting ciphertext.
  *    @bytes_written a location for the resulting number of bytes written into
@@ -432,19 +701,19 @@ static bool
 _encrypt_step (_mongocrypt_crypto_t *crypto,
                const _mongocrypt_buffer_t *iv,
                const _mongocrypt_buffer_t *enc_key,
+               const _native_crypto_aes_key_t *native_enc_key,
                const _mongocrypt_buffer_t *plaintext,
                _mongocrypt_buffer_t *ciphertext,
                uint32_t *bytes_written,
                mongocrypt_status_t *status)
 {
    uint32_t unaligned;
+   uint32_t aligned_len;
    uint32_t padding_byte;
-   _mongocrypt_buffer_t intermediates[2];
-   _mongocrypt_buffer_t to_encrypt;
+   uint32_t final_bytes_written = 0;
+   _mongocrypt_buffer_t aligned_in, aligned_out;
+   _mongocrypt_buffer_t final_iv, final_in, final_out;
    uint8_t final_block_storage[MONGOCRYPT_BLOCK_SIZE];
-   bool ret = false;
-
-   _mongocrypt_buffer_init (&to_encrypt);
 
    BSON_ASSERT (bytes_written);
    *bytes_written = 0;
@@ -453,75 +722,155 @@ _encrypt_step (_mongocrypt_crypto_t *crypto,
       CLIENT_ERR ("IV should have length %d, but has length %d",
                   MONGOCRYPT_IV_LEN,
                   iv->len);
-      goto done;
+      return false;
    }
 
    if (MONGOCRYPT_ENC_KEY_LEN != enc_key->len) {
       CLIENT_ERR ("Encryption key should have length %d, but has length %d",
                   MONGOCRYPT_ENC_KEY_LEN,
                   enc_key->len);
-      goto done;
+      return false;
    }
 
    /* calculate how many extra bytes there are after a block boundary */
    unaligned = plaintext->len % MONGOCRYPT_BLOCK_SIZE;
+   aligned_len = plaintext->len - unaligned;
 
-   /* Some crypto providers disallow variable length inputs, and require
-    * the input to be a multiple of the block size. So add everything up
-    * to but excluding the last block if not block aligned, then add
-    * the last block with padding. */
-   _mongocrypt_buffer_init (&intermediates[0]);
-   _mongocrypt_buffer_init (&intermediates[1]);
-   intermediates[0].data = (uint8_t *) plaintext->data;
-   intermediates[0].len = plaintext->len - unaligned;
-   intermediates[1].data = final_block_storage;
-   intermediates[1].len = sizeof (final_block_storage);
+   if (ciphertext->len < aligned_len + MONGOCRYPT_BLOCK_SIZE) {
+      CLIENT_ERR ("output ciphertext should have at least %" PRIu32 " bytes",
+                  aligned_len + MONGOCRYPT_BLOCK_SIZE);
+      return false;
+   }
 
    /* [MCGREW]: "Prior to CBC encryption, the plaintext P is padded by appending
     * a padding string PS to that data, to ensure that len(P || PS) is a
     * multiple of 128". This is also known as PKCS #7 padding. */
+   _mongocrypt_buffer_init (&final_in);
+   final_in.data = final_block_storage;
+   final_in.len = sizeof (final_block_storage);
    if (unaligned) {
       /* Copy the unaligned bytes. */
-      memcpy (intermediates[1].data,
-              plaintext->data + (plaintext->len - unaligned),
-              unaligned);
+      memcpy (final_in.data, plaintext->data + aligned_len, unaligned);
       /* Fill the rest with the padding byte. */
       padding_byte = MONGOCRYPT_BLOCK_SIZE - unaligned;
-      memset (intermediates[1].data + unaligned, padding_byte, padding_byte);
+      memset (final_in.data + unaligned, padding_byte, padding_byte);
    } else {
       /* Fill the rest with the padding byte. */
       padding_byte = MONGOCRYPT_BLOCK_SIZE;
-      memset (intermediates[1].data, padding_byte, padding_byte);
-   }
+      memset (final_in.data, padding_byte, padding_byte);
+   }
+
+   _mongocrypt_buffer_init (&aligned_in);
+   aligned_in.data = plaintext->data;
+   aligned_in.len = aligned_len;
+   _mongocrypt_buffer_init (&aligned_out);
+   aligned_out.data = ciphertext->data;
+   aligned_out.len = aligned_len;
+
+   if (crypto->hooks_enabled && crypto->aes_256_cbc_encrypt_iov) {
+      /* Pass the plaintext and the padded last block as separate segments. */
+      _mongocrypt_buffer_t segments[2] = {aligned_in, final_in};
+
+      aligned_out.len = aligned_len + MONGOCRYPT_BLOCK_SIZE;
+      if (!_crypto_aes_256_cbc_encrypt_iov (crypto,
+                                            enc_key,
+                                            iv,
+                                            aligned_len > 0 ? segments
+                                                            : &final_in,
+                                            aligned_len > 0 ? 2 : 1,
+                                            &aligned_out,
+                                            bytes_written,
+                                            status)) {
+         return false;
+      }
+   } else if (crypto->hooks_enabled && aligned_len > 0) {
+      /* Hooks are called once per value. Pass them the padded plaintext in
+       * one buffer. */
+      _mongocrypt_buffer_t intermediates[2] = {aligned_in, final_in};
+      _mongocrypt_buffer_t to_encrypt;
+      bool ret;
 
-   if (!_mongocrypt_buffer_concat (&to_encrypt, intermediates, 2)) {
-      CLIENT_ERR ("failed to allocate buffer");
-      goto done;
-   }
+      _mongocrypt_buffer_init (&to_encrypt);
+      if (!_mongocrypt_buffer_concat (&to_encrypt, intermediates, 2)) {
+         CLIENT_ERR ("failed to allocate buffer");
+         return false;
+      }
+      aligned_out.len = to_encrypt.len;
+      ret = _crypto_aes_256_cbc_encrypt (
+         crypto,
+         (aes_256_args_t){.key = enc_key,
+                          .iv = iv,
+                          .in = &to_encrypt,
+                          .out = &aligned_out,
+                          .bytes_written = bytes_written,
+                          .status = status,
+                          .native_key = native_enc_key});
+      _mongocrypt_buffer_cleanup (&to_encrypt);
+      if (!ret) {
+         return false;
+      }
+   } else {
+      /* Some crypto providers disallow variable length inputs, and require
+       * the input to be a multiple of the block size. Encrypt everything up
+       * to but excluding the last block directly from the plaintext, then
+       * encrypt the padded last block chained on the last ciphertext block.
+       * With CBC this is identical to encrypting the padded plaintext in one
+       * call, without copying the plaintext. */
+      _mongocrypt_buffer_init (&final_iv);
+      final_iv.data = iv->data;
+      final_iv.len = iv->len;
+
+      if (aligned_len > 0) {
+         if (!_crypto_aes_256_cbc_encrypt (
+                crypto,
+                (aes_256_args_t){.key = enc_key,
+                                 .iv = iv,
+                                 .in = &aligned_in,
+                                 .out = &aligned_out,
+                                 .bytes_written = bytes_written,
+                                 .status = status,
+                                 .native_key = native_enc_key})) {
+            return false;
+         }
+
+         if (*bytes_written != aligned_len) {
+            CLIENT_ERR ("encryption failure, wrote %d bytes, expected %d",
+                        *bytes_written,
+                        aligned_len);
+            return false;
+         }
+
+         final_iv.data =
+            ciphertext->data + aligned_len - MONGOCRYPT_BLOCK_SIZE;
+      }
 
-   if (!_crypto_aes_256_cbc_encrypt (
-          crypto,
-          (aes_256_args_t){.key = enc_key,
-                           .iv = iv,
-                           .in = &to_encrypt,
-                           .out = ciphertext,
-                           .bytes_written = bytes_written,
-                           .status = status})) {
-      goto done;
-   }
+      _mongocrypt_buffer_init (&final_out);
+      final_out.data = ciphertext->data + aligned_len;
+      final_out.len = MONGOCRYPT_BLOCK_SIZE;
+
+      if (!_crypto_aes_256_cbc_encrypt (
+             crypto,
+             (aes_256_args_t){.key = enc_key,
+                              .iv = &final_iv,
+                              .in = &final_in,
+                              .out = &final_out,
+                              .bytes_written = &final_bytes_written,
+                              .status = status,
+                              .native_key = native_enc_key})) {
+         return false;
+      }
 
+      *bytes_written += final_bytes_written;
+   }
 
    if (*bytes_written % MONGOCRYPT_BLOCK_SIZE != 0) {
       CLIENT_ERR ("encryption failure, wrote %d bytes, not a multiple of %d",
                   *bytes_written,
                   MONGOCRYPT_BLOCK_SIZE);
-      goto done;
+      return false;
    }
 
-   ret = true;
-done:
-   _mongocrypt_buffer_cleanup (&to_encrypt);
-   return ret;
+   return true;
 }
 
 
@@ -533,6 +882,7 @@ done:
  *
  * Parameters:
  *    @mac_key a 32 byte key.
+ *    @native_mac_key the precomputed state of @mac_key. May be NULL.
  *    @associated_data associated data to add into the HMAC. This may be
  *    an empty buffer.
  *    @ciphertext the ciphertext to add into the HMAC.
@@ -553,28 +903,25 @@ done:
 static bool
 _hmac_step (_mongocrypt_crypto_t *crypto,
             const _mongocrypt_buffer_t *mac_key,
+            const _native_crypto_hmac_key_t *native_mac_key,
             const _mongocrypt_buffer_t *associated_data,
             const _mongocrypt_buffer_t *ciphertext,
             _mongocrypt_buffer_t *out,
             mongocrypt_status_t *status)
 {
    _mongocrypt_buffer_t intermediates[3];
-   _mongocrypt_buffer_t to_hmac;
    uint64_t associated_data_len_be;
    uint8_t tag_storage[64];
    _mongocrypt_buffer_t tag;
-   bool ret = false;
-
-   _mongocrypt_buffer_init (&to_hmac);
 
    if (MONGOCRYPT_MAC_KEY_LEN != mac_key->len) {
       CLIENT_ERR ("HMAC key wrong length: %d", mac_key->len);
-      goto done;
+      return false;
    }
 
    if (out->len != MONGOCRYPT_HMAC_LEN) {
       CLIENT_ERR ("out wrong length: %d", out->len);
-      goto done;
+      return false;
    }
 
    /* [MCGREW]:
@@ -606,21 +953,15 @@ _hmac_step (_mongocrypt_crypto_t *crypto,
    tag.data = tag_storage;
    tag.len = sizeof (tag_storage);
 
-
-   if (!_mongocrypt_buffer_concat (&to_hmac, intermediates, 3)) {
-      CLIENT_ERR ("failed to allocate buffer");
-      goto done;
-   }
-   if (!_crypto_hmac_sha_512 (crypto, mac_key, &to_hmac, &tag, status)) {
-      goto done;
+   /* MAC the parts in place, rather than copying them into one buffer. */
+   if (!_crypto_hmac_sha_512 (
+          crypto, mac_key, native_mac_key, intermediates, 3, &tag, status)) {
+      return false;
    }
 
    /* [MCGREW 2.7] "The HMAC-SHA-512 value is truncated to T_LEN=32 octets" */
    memcpy (out->data, tag.data, MONGOCRYPT_HMAC_LEN);
-   ret = true;
-done:
-   _mongocrypt_buffer_cleanup (&to_hmac);
-   return ret;
+   return true;
 }
 
 /* ----------------------------------------------------------------------------
@@ -661,14 +1002,47 @@ _mongocrypt_do_encryption (_mongocrypt_crypto_t *crypto,
                            uint32_t *bytes_written,
                            mongocrypt_status_t *status)
 {
-   _mongocrypt_buffer_t mac_key = {0}, enc_key = {0}, intermediate = {0},
-                        intermediate_hmac = {0}, empty_buffer = {0};
+   _mongocrypt_key_state_t key_state;
+
+   BSON_ASSERT (key);
+   if (MONGOCRYPT_KEY_LEN != key->len) {
+      CLIENT_ERR ("key should have length %d, but has length %d",
+                  MONGOCRYPT_KEY_LEN,
+                  key->len);
+      return false;
+   }
+
+   _key_state_init (&key_state, key);
+   return _mongocrypt_do_encryption_with_key_state (crypto,
+                                                    iv,
+                                                    associated_data,
+                                                    &key_state,
+                                                    plaintext,
+                                                    ciphertext,
+                                                    bytes_written,
+                                                    status);
+}
+
+
+bool
+_mongocrypt_do_encryption_with_key_state (
+   _mongocrypt_crypto_t *crypto,
+   const _mongocrypt_buffer_t *iv,
+   const _mongocrypt_buffer_t *associated_data,
+   const _mongocrypt_key_state_t *key_state,
+   const _mongocrypt_buffer_t *plaintext,
+   _mongocrypt_buffer_t *ciphertext,
+   uint32_t *bytes_written,
+   mongocrypt_status_t *status)
+{
+   _mongocrypt_buffer_t intermediate = {0}, intermediate_hmac = {0},
+                        empty_buffer = {0};
    uint32_t intermediate_bytes_written = 0;
 
    memset (ciphertext->data, 0, ciphertext->len);
 
    BSON_ASSERT (iv);
-   BSON_ASSERT (key);
+   BSON_ASSERT (key_state);
    BSON_ASSERT (plaintext);
    BSON_ASSERT (ciphertext);
    if (ciphertext->len !=
@@ -686,24 +1060,10 @@ _mongocrypt_do_encryption (_mongocrypt_crypto_t *crypto,
                   iv->len);
       return false;
    }
-   if (MONGOCRYPT_KEY_LEN != key->len) {
-      CLIENT_ERR ("key should have length %d, but has length %d",
-                  MONGOCRYPT_KEY_LEN,
-                  key->len);
-      return false;
-   }
 
    intermediate.len = ciphertext->len;
    intermediate.data = ciphertext->data;
 
-   /* [MCGREW]: Step 1. "MAC_KEY consists of the initial MAC_KEY_LEN octets of
-    * K, in order. ENC_KEY consists of the final ENC_KEY_LEN octets of K, in
-    * order." */
-   mac_key.data = (uint8_t *) key->data;
-   mac_key.len = MONGOCRYPT_MAC_KEY_LEN;
-   enc_key.data = (uint8_t *) key->data + MONGOCRYPT_MAC_KEY_LEN;
-   enc_key.len = MONGOCRYPT_ENC_KEY_LEN;
-
    /* Prepend the IV. */
    memcpy (intermediate.data, iv->data, iv->len);
    intermediate.data += iv->len;
@@ -713,7 +1073,8 @@ _mongocrypt_do_encryption (_mongocrypt_crypto_t *crypto,
    /* [MCGREW]: Steps 2 & 3. */
    if (!_encrypt_step (crypto,
                        iv,
-                       &enc_key,
+                       &key_state->enc_key,
+                       key_state->native_enc_key,
                        plaintext,
                        &intermediate,
                        &intermediate_bytes_written,
@@ -732,7 +1093,8 @@ _mongocrypt_do_encryption (_mongocrypt_crypto_t *crypto,
 
    /* [MCGREW]: Steps 4 & 5, compute the HMAC. */
    if (!_hmac_step (crypto,
-                    &mac_key,
+                    &key_state->mac_key,
+                    key_state->native_mac_key,
                     associated_data ? associated_data : &empty_buffer,
                     &intermediate,
                     &intermediate_hmac,
@@ -753,6 +1115,7 @@ _mongocrypt_do_encryption (_mongocrypt_crypto_t *crypto,
  *
  * Parameters:
  *    @enc_key a 32 byte key.
+ *    @native_enc_key the precomputed state of @enc_key. May be NULL.
  *    @ciphertext the ciphertext to decrypt.
  *    @plaintext the resulting plaintext.
  *    @bytes_written a location for the resulting number of bytes written into
@@ -777,6 +1140,7 @@ static bool
 _decrypt_step (_mongocrypt_crypto_t *crypto,
                const _mongocrypt_buffer_t *iv,
                const _mongocrypt_buffer_t *enc_key,
+               const _native_crypto_aes_key_t *native_enc_key,
                const _mongocrypt_buffer_t *ciphertext,
                _mongocrypt_buffer_t *plaintext,
                uint32_t *bytes_written,
@@ -813,7 +1177,8 @@ _decrypt_step (_mongocrypt_crypto_t *crypto,
                            .in = ciphertext,
                            .out = plaintext,
                            .bytes_written = bytes_written,
-                           .status = status})) {
+                           .status = status,
+                           .native_key = native_enc_key})) {
       return false;
    }
 
@@ -863,13 +1228,46 @@ _mongocrypt_do_decryption (_mongocrypt_crypto_t *crypto,
                            _mongocrypt_buffer_t *plaintext,
                            uint32_t *bytes_written,
                            mongocrypt_status_t *status)
+{
+   _mongocrypt_key_state_t key_state;
+
+   BSON_ASSERT (key);
+   BSON_ASSERT (status);
+
+   if (MONGOCRYPT_KEY_LEN != key->len) {
+      CLIENT_ERR ("key should have length %d, but has length %d",
+                  MONGOCRYPT_KEY_LEN,
+                  key->len);
+      return false;
+   }
+
+   _key_state_init (&key_state, key);
+   return _mongocrypt_do_decryption_with_key_state (crypto,
+                                                    associated_data,
+                                                    &key_state,
+                                                    ciphertext,
+                                                    plaintext,
+                                                    bytes_written,
+                                                    status);
+}
+
+
+bool
+_mongocrypt_do_decryption_with_key_state (
+   _mongocrypt_crypto_t *crypto,
+   const _mongocrypt_buffer_t *associated_data,
+   const _mongocrypt_key_state_t *key_state,
+   const _mongocrypt_buffer_t *ciphertext,
+   _mongocrypt_buffer_t *plaintext,
+   uint32_t *bytes_written,
+   mongocrypt_status_t *status)
 {
    bool ret = false;
-   _mongocrypt_buffer_t mac_key = {0}, enc_key = {0}, intermediate = {0},
-                        hmac_tag = {0}, iv = {0}, empty_buffer = {0};
+   _mongocrypt_buffer_t intermediate = {0}, hmac_tag = {0}, iv = {0},
+                        empty_buffer = {0};
    uint8_t hmac_tag_storage[MONGOCRYPT_HMAC_LEN];
 
-   BSON_ASSERT (key);
+   BSON_ASSERT (key_state);
    BSON_ASSERT (ciphertext);
    BSON_ASSERT (plaintext);
    BSON_ASSERT (bytes_written);
@@ -884,13 +1282,6 @@ _mongocrypt_do_decryption (_mongocrypt_crypto_t *crypto,
       return false;
    }
 
-   if (MONGOCRYPT_KEY_LEN != key->len) {
-      CLIENT_ERR ("key should have length %d, but has length %d",
-                  MONGOCRYPT_KEY_LEN,
-                  key->len);
-      return false;
-   }
-
    if (ciphertext->len <
        MONGOCRYPT_HMAC_LEN + MONGOCRYPT_IV_LEN + MONGOCRYPT_BLOCK_SIZE) {
       CLIENT_ERR ("corrupt ciphertext - must be > %d bytes",
@@ -899,11 +1290,6 @@ _mongocrypt_do_decryption (_mongocrypt_crypto_t *crypto,
       goto done;
    }
 
-   mac_key.data = (uint8_t *) key->data;
-   mac_key.len = MONGOCRYPT_MAC_KEY_LEN;
-   enc_key.data = (uint8_t *) key->data + MONGOCRYPT_MAC_KEY_LEN;
-   enc_key.len = MONGOCRYPT_ENC_KEY_LEN;
-
    iv.data = ciphertext->data;
    iv.len = MONGOCRYPT_IV_LEN;
 
@@ -915,7 +1301,8 @@ _mongocrypt_do_decryption (_mongocrypt_crypto_t *crypto,
 
    /* [MCGREW 2.2]: Step 3: HMAC check. */
    if (!_hmac_step (crypto,
-                    &mac_key,
+                    &key_state->mac_key,
+                    key_state->native_mac_key,
                     associated_data ? associated_data : &empty_buffer,
                     &intermediate,
                     &hmac_tag,
@@ -939,7 +1326,8 @@ _mongocrypt_do_decryption (_mongocrypt_crypto_t *crypto,
 
    if (!_decrypt_step (crypto,
                        &iv,
-                       &enc_key,
+                       &key_state->enc_key,
+                       key_state->native_enc_key,
                        &intermediate,
                        plaintext,
                        bytes_written,
@@ -1020,40 +1408,52 @@ _mongocrypt_calculate_deterministic_iv (
    const _mongocrypt_buffer_t *associated_data,
    _mongocrypt_buffer_t *out,
    mongocrypt_status_t *status)
+{
+   _mongocrypt_key_state_t key_state;
+
+   BSON_ASSERT (key);
+   BSON_ASSERT (status);
+
+   if (MONGOCRYPT_KEY_LEN != key->len) {
+      CLIENT_ERR ("key should have length %d, but has length %d\n",
+                  MONGOCRYPT_KEY_LEN,
+                  key->len);
+      return false;
+   }
+
+   _key_state_init (&key_state, key);
+   return _mongocrypt_calculate_deterministic_iv_with_key_state (
+      crypto, &key_state, plaintext, associated_data, out, status);
+}
+
+
+bool
+_mongocrypt_calculate_deterministic_iv_with_key_state (
+   _mongocrypt_crypto_t *crypto,
+   const _mongocrypt_key_state_t *key_state,
+   const _mongocrypt_buffer_t *plaintext,
+   const _mongocrypt_buffer_t *associated_data,
+   _mongocrypt_buffer_t *out,
+   mongocrypt_status_t *status)
 {
    _mongocrypt_buffer_t intermediates[3];
-   _mongocrypt_buffer_t to_hmac;
-   _mongocrypt_buffer_t iv_key;
    uint64_t associated_data_len_be;
    uint8_t tag_storage[64];
    _mongocrypt_buffer_t tag;
-   bool ret = false;
-
-   _mongocrypt_buffer_init (&to_hmac);
 
-   BSON_ASSERT (key);
+   BSON_ASSERT (key_state);
    BSON_ASSERT (plaintext);
    BSON_ASSERT (associated_data);
    BSON_ASSERT (out);
    BSON_ASSERT (status);
 
-   if (MONGOCRYPT_KEY_LEN != key->len) {
-      CLIENT_ERR ("key should have length %d, but has length %d\n",
-                  MONGOCRYPT_KEY_LEN,
-                  key->len);
-      goto done;
-   }
    if (MONGOCRYPT_IV_LEN != out->len) {
       CLIENT_ERR ("out should have length %d, but has length %d\n",
                   MONGOCRYPT_IV_LEN,
                   out->len);
-      goto done;
+      return false;
    }
 
-   _mongocrypt_buffer_init (&iv_key);
-   iv_key.data = key->data + MONGOCRYPT_ENC_KEY_LEN + MONGOCRYPT_MAC_KEY_LEN;
-   iv_key.len = MONGOCRYPT_IV_KEY_LEN;
-
    _mongocrypt_buffer_init (&intermediates[0]);
    _mongocrypt_buffer_init (&intermediates[1]);
    _mongocrypt_buffer_init (&intermediates[2]);
@@ -1072,22 +1472,19 @@ _mongocrypt_calculate_deterministic_iv (
    tag.data = tag_storage;
    tag.len = sizeof (tag_storage);
 
-   if (!_mongocrypt_buffer_concat (&to_hmac, intermediates, 3)) {
-      CLIENT_ERR ("failed to allocate buffer");
-      goto done;
-   }
-
-   if (!_crypto_hmac_sha_512 (crypto, &iv_key, &to_hmac, &tag, status)) {
-      goto done;
+   if (!_crypto_hmac_sha_512 (crypto,
+                              &key_state->iv_key,
+                              key_state->native_iv_key,
+                              intermediates,
+                              3,
+                              &tag,
+                              status)) {
+      return false;
    }
 
    /* Truncate to IV length */
    memcpy (out->data, tag.data, MONGOCRYPT_IV_LEN);
-
-   ret = true;
-done:
-   _mongocrypt_buffer_cleanup (&to_hmac);
-   return ret;
+   return true;
 }
 
 bool
@@ -1177,24 +1574,7 @@ _mongocrypt_hmac_sha_256 (_mongocrypt_crypto_t *crypto,
                           _mongocrypt_buffer_t *out,
                           mongocrypt_status_t *status)
 {
-   if (key->len != MONGOCRYPT_MAC_KEY_LEN) {
-      CLIENT_ERR ("invalid hmac_sha_256 key length. Got %" PRIu32
-                  ", expected: %" PRIu32,
-                  key->len,
-                  MONGOCRYPT_MAC_KEY_LEN);
-      return false;
-   }
-
-   if (crypto->hooks_enabled) {
-      mongocrypt_binary_t key_bin, out_bin, in_bin;
-      _mongocrypt_buffer_to_binary (key, &key_bin);
-      _mongocrypt_buffer_to_binary (out, &out_bin);
-      _mongocrypt_buffer_to_binary (in, &in_bin);
-
-      return crypto->hmac_sha_256 (
-         crypto->ctx, &key_bin, &in_bin, &out_bin, status);
-   }
-   return _native_crypto_hmac_sha_256 (key, in, out, status);
+   return _crypto_hmac_sha_256 (crypto, key, in, 1, out, status);
 }
 
 bool
@@ -1321,13 +1701,9 @@ _mongocrypt_fle2aead_do_encryption (_mongocrypt_crypto_t *crypto,
    /* Compute T = HMAC-SHA256(Km, AD || IV || S). */
    {
       _mongocrypt_buffer_t hmac_inputs[] = {AD, IV, S};
-      _mongocrypt_buffer_t hmac_input = {0};
-      _mongocrypt_buffer_concat (&hmac_input, hmac_inputs, 3);
-      if (!_mongocrypt_hmac_sha_256 (crypto, &Km, &hmac_input, &T, status)) {
-         _mongocrypt_buffer_cleanup (&hmac_input);
+      if (!_crypto_hmac_sha_256 (crypto, &Km, hmac_inputs, 3, &T, status)) {
          return false;
       }
-      _mongocrypt_buffer_cleanup (&hmac_input);
    }
 
    /* Output C = IV || S || T. */
@@ -1447,21 +1823,16 @@ _mongocrypt_fle2aead_do_decryption (_mongocrypt_crypto_t *crypto,
     * ciphertext T. */
    {
       _mongocrypt_buffer_t hmac_inputs[] = {AD, IV, S};
-      _mongocrypt_buffer_t hmac_input = {0};
-      _mongocrypt_buffer_concat (&hmac_input, hmac_inputs, 3);
       _mongocrypt_buffer_resize (&Tp, MONGOCRYPT_HMAC_LEN);
-      if (!_mongocrypt_hmac_sha_256 (crypto, &Km, &hmac_input, &Tp, status)) {
-         _mongocrypt_buffer_cleanup (&hmac_input);
+      if (!_crypto_hmac_sha_256 (crypto, &Km, hmac_inputs, 3, &Tp, status)) {
          _mongocrypt_buffer_cleanup (&Tp);
          return false;
       }
       if (0 != _mongocrypt_buffer_cmp (&T, &Tp)) {
          CLIENT_ERR ("decryption error");
-         _mongocrypt_buffer_cleanup (&hmac_input);
          _mongocrypt_buffer_cleanup (&Tp);
          return false;
       }
-      _mongocrypt_buffer_cleanup (&hmac_input);
       _mongocrypt_buffer_cleanup (&Tp);
    }
 
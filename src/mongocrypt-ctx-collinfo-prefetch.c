@@ -0,0 +1,280 @@
+/*
+ * Copyright 2022-present MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mongocrypt-ctx-private.h"
+
+/* Construct the listCollections filter to send. */
+static bool
+_mongo_op_collinfo (mongocrypt_ctx_t *ctx, mongocrypt_binary_t *out)
+{
+   _mongocrypt_ctx_collinfo_prefetch_t *pctx;
+   bson_t *cmd;
+
+   pctx = (_mongocrypt_ctx_collinfo_prefetch_t *) ctx;
+   if (_mongocrypt_buffer_empty (&pctx->list_collections_filter)) {
+      bson_t names;
+      bson_t in;
+      uint32_t i;
+
+      cmd = bson_new ();
+      if (pctx->coll_names) {
+         BSON_APPEND_DOCUMENT_BEGIN (cmd, "name", &in);
+         BSON_APPEND_ARRAY_BEGIN (&in, "$in", &names);
+         for (i = 0; i < pctx->num_coll_names; i++) {
+            char *key = bson_strdup_printf ("%" PRIu32, i);
+
+            BSON_APPEND_UTF8 (&names, key, pctx->coll_names[i]);
+            bson_free (key);
+         }
+         bson_append_array_end (&in, &names);
+         bson_append_document_end (cmd, &in);
+      }
+      CRYPT_TRACEF (&ctx->crypt->log, "constructed: %s\n", tmp_json (cmd));
+      _mongocrypt_buffer_steal_from_bson (&pctx->list_collections_filter, cmd);
+   }
+   out->data = pctx->list_collections_filter.data;
+   out->len = pctx->list_collections_filter.len;
+   return true;
+}
+
+
+static bool
+_cache_collinfo (mongocrypt_ctx_t *ctx,
+                 const char *coll_name,
+                 const bson_t *collinfo)
+{
+   _mongocrypt_ctx_collinfo_prefetch_t *pctx;
+   char *ns;
+   bool ret;
+
+   pctx = (_mongocrypt_ctx_collinfo_prefetch_t *) ctx;
+   ns = bson_strdup_printf ("%s.%s", pctx->db_name, coll_name);
+   ret = _mongocrypt_cache_collinfo_add (
+      &ctx->crypt->cache_collinfo,
+      ns,
+      collinfo,
+      ctx->crypt->opts.plaintext_collinfo_expiration_ms,
+      ctx->status);
+   bson_free (ns);
+   if (!ret) {
+      return _mongocrypt_ctx_fail (ctx);
+   }
+   return true;
+}
+
+
+static bool
+_mongo_feed_collinfo (mongocrypt_ctx_t *ctx, mongocrypt_binary_t *in)
+{
+   _mongocrypt_ctx_collinfo_prefetch_t *pctx;
+   bson_t as_bson;
+   bson_iter_t iter;
+   const char *coll_name;
+   uint32_t i;
+
+   pctx = (_mongocrypt_ctx_collinfo_prefetch_t *) ctx;
+   if (!bson_init_static (&as_bson, in->data, in->len)) {
+      return _mongocrypt_ctx_fail_w_msg (ctx, "BSON malformed");
+   }
+
+   if (!bson_iter_init_find (&iter, &as_bson, "name") ||
+       !BSON_ITER_HOLDS_UTF8 (&iter)) {
+      return _mongocrypt_ctx_fail_w_msg (
+         ctx, "collection info must contain a 'name' string");
+   }
+   coll_name = bson_iter_utf8 (&iter, NULL);
+
+   if (!_cache_collinfo (ctx, coll_name, &as_bson)) {
+      return false;
+   }
+
+   for (i = 0; i < pctx->num_coll_names; i++) {
+      if (0 == strcmp (pctx->coll_names[i], coll_name)) {
+         pctx->coll_fed[i] = true;
+      }
+   }
+   return true;
+}
+
+
+static bool
+_mongo_done_collinfo (mongocrypt_ctx_t *ctx)
+{
+   _mongocrypt_ctx_collinfo_prefetch_t *pctx;
+   uint32_t i;
+
+   pctx = (_mongocrypt_ctx_collinfo_prefetch_t *) ctx;
+
+   /* Cache an empty collinfo for requested collections that do not exist, as
+    * an encrypt context would. */
+   for (i = 0; i < pctx->num_coll_names; i++) {
+      bson_t empty_collinfo = BSON_INITIALIZER;
+      bool ret;
+
+      if (pctx->coll_fed[i]) {
+         continue;
+      }
+      ret = _cache_collinfo (ctx, pctx->coll_names[i], &empty_collinfo);
+      bson_destroy (&empty_collinfo);
+      if (!ret) {
+         return false;
+      }
+   }
+
+   ctx->state = MONGOCRYPT_CTX_READY;
+   return true;
+}
+
+
+static void
+_cleanup (mongocrypt_ctx_t *ctx)
+{
+   _mongocrypt_ctx_collinfo_prefetch_t *pctx;
+   uint32_t i;
+
+   if (!ctx) {
+      return;
+   }
+
+   pctx = (_mongocrypt_ctx_collinfo_prefetch_t *) ctx;
+   bson_free (pctx->db_name);
+   for (i = 0; i < pctx->num_coll_names; i++) {
+      bson_free (pctx->coll_names[i]);
+   }
+   bson_free (pctx->coll_names);
+   bson_free (pctx->coll_fed);
+   _mongocrypt_buffer_cleanup (&pctx->list_collections_filter);
+}
+
+
+/* Copies the collection names from @collections, of the form:
+ * { "v": [ (UTF-8 string), ... ] } */
+static bool
+_parse_coll_names (mongocrypt_ctx_t *ctx, mongocrypt_binary_t *collections)
+{
+   _mongocrypt_ctx_collinfo_prefetch_t *pctx;
+   bson_t as_bson;
+   bson_iter_t iter;
+   bson_iter_t elem;
+   uint32_t count = 0;
+
+   pctx = (_mongocrypt_ctx_collinfo_prefetch_t *) ctx;
+   if (!_mongocrypt_binary_to_bson (collections, &as_bson)) {
+      return _mongocrypt_ctx_fail_w_msg (ctx, "malformed bson");
+   }
+
+   if (!bson_iter_init_find (&iter, &as_bson, "v")) {
+      return _mongocrypt_ctx_fail_w_msg (
+         ctx, "invalid collections, must contain 'v'");
+   }
+
+   if (!BSON_ITER_HOLDS_ARRAY (&iter)) {
+      return _mongocrypt_ctx_fail_w_msg (
+         ctx, "invalid collections, 'v' must contain an array");
+   }
+
+   if (!bson_iter_recurse (&iter, &elem)) {
+      return _mongocrypt_ctx_fail_w_msg (ctx, "malformed bson");
+   }
+
+   while (bson_iter_next (&elem)) {
+      uint32_t len = 0;
+
+      if (BSON_ITER_HOLDS_UTF8 (&elem)) {
+         (void) bson_iter_utf8 (&elem, &len);
+      }
+      if (len == 0) {
+         return _mongocrypt_ctx_fail_w_msg (
+            ctx, "invalid collections, 'v' elements must be non-empty strings");
+      }
+      count++;
+   }
+
+   if (count == 0) {
+      return _mongocrypt_ctx_fail_w_msg (
+         ctx, "invalid collections, 'v' must not be empty");
+   }
+
+   pctx->coll_names = bson_malloc0 (count * sizeof (char *));
+   pctx->coll_fed = bson_malloc0 (count * sizeof (bool));
+   BSON_ASSERT (bson_iter_recurse (&iter, &elem));
+   while (bson_iter_next (&elem)) {
+      pctx->coll_names[pctx->num_coll_names++] =
+         bson_strdup (bson_iter_utf8 (&elem, NULL));
+   }
+   return true;
+}
+
+
+bool
+mongocrypt_ctx_collinfo_prefetch_init (mongocrypt_ctx_t *ctx,
+                                       const char *db,
+                                       int32_t db_len,
+                                       mongocrypt_binary_t *collections)
+{
+   _mongocrypt_ctx_collinfo_prefetch_t *pctx;
+   _mongocrypt_ctx_opts_spec_t opts_spec;
+
+   if (!ctx) {
+      return false;
+   }
+
+   memset (&opts_spec, 0, sizeof (opts_spec));
+   if (!_mongocrypt_ctx_init (ctx, &opts_spec)) {
+      return false;
+   }
+
+   pctx = (_mongocrypt_ctx_collinfo_prefetch_t *) ctx;
+   ctx->type = _MONGOCRYPT_TYPE_COLLINFO_PREFETCH;
+   ctx->vtable.mongo_op_collinfo = _mongo_op_collinfo;
+   ctx->vtable.mongo_feed_collinfo = _mongo_feed_collinfo;
+   ctx->vtable.mongo_done_collinfo = _mongo_done_collinfo;
+   /* The results are stored in the collinfo cache. */
+   ctx->vtable.finalize = _mongocrypt_ctx_finalize_empty;
+   ctx->vtable.cleanup = _cleanup;
+
+   if (!_mongocrypt_validate_and_copy_string (db, db_len, &pctx->db_name) ||
+       0 == strlen (pctx->db_name)) {
+      return _mongocrypt_ctx_fail_w_msg (ctx, "invalid db");
+   }
+
+   if (collections && !_parse_coll_names (ctx, collections)) {
+      return false;
+   }
+
+   if (ctx->crypt->log.trace_enabled) {
+      char *collections_val = NULL;
+
+      if (collections) {
+         collections_val =
+            _mongocrypt_new_json_string_from_binary (collections);
+      }
+      _mongocrypt_log (&ctx->crypt->log,
+                       MONGOCRYPT_LOG_LEVEL_TRACE,
+                       "%s (%s=\"%s\", %s=%d, %s=\"%s\")",
+                       BSON_FUNC,
+                       "db",
+                       pctx->db_name,
+                       "db_len",
+                       db_len,
+                       "collections",
+                       collections_val ? collections_val : "(null)");
+      bson_free (collections_val);
+   }
+
+   ctx->state = MONGOCRYPT_CTX_NEED_MONGO_COLLINFO;
+   return true;
+}
@@ -17,54 +17,83 @@
 #include "mongocrypt-ciphertext-private.h"
 #include "mongocrypt-crypto-private.h"
 #include "mongocrypt-ctx-private.h"
+#include "mongocrypt-parallel-private.h"
 #include "mongocrypt-traverse-util-private.h"
 #include "mc-fle2-payload-ieev-private.h"
 #include "mc-fle-blob-subtype-private.h"
 #include "mc-fle2-payload-uev-private.h"
 #include "mc-fle2-insert-update-payload-private.h"
 
+/* The work to decrypt one FLE1 ciphertext. The key lookup is done by
+ * _decrypt_job_prepare, so _decrypt_job_run may run on another thread. */
+typedef struct {
+   _mongocrypt_ciphertext_t ciphertext;
+   _mongocrypt_buffer_t key_material;
+   /* The precomputed state of key_material. May be NULL. */
+   const _mongocrypt_key_state_t *key_state;
+   _mongocrypt_buffer_t associated_data;
+   _mongocrypt_buffer_t plaintext;
+   /* Only used by parallel finalize. */
+   mongocrypt_status_t *status;
+   bool ok;
+} _decrypt_job_t;
+
+
+/* A ciphertext of original_doc. It is recorded and parsed once by the
+ * traversal in mongocrypt_ctx_decrypt_init. _finalize splices its plaintext
+ * into the decrypted document at the same location. */
+struct __mongocrypt_ctx_decrypt_ciphertext_t {
+   /* The binary data of the value. Points into original_doc. */
+   _mongocrypt_buffer_t in;
+   /* The parsed value. Only the member for the subtype in.data[0] is set. */
+   _decrypt_job_t job;
+   mc_FLE2IndexedEqualityEncryptedValue_t *ieev;
+   mc_FLE2UnindexedEncryptedValue_t *uev;
+   mc_FLE2InsertUpdatePayload_t iup;
+   /* Set for ieev once S_Key is added. Owned by ieev. */
+   const _mongocrypt_buffer_t *K_KeyId;
+   /* Set by _finalize. Owned by the parsed value. */
+   const _mongocrypt_buffer_t *plaintext;
+   uint8_t plaintext_type;
+};
+
+
 static bool
-_replace_FLE2IndexedEqualityEncryptedValue_with_plaintext (
-   void *ctx,
-   _mongocrypt_buffer_t *in,
-   bson_value_t *out,
-   mongocrypt_status_t *status)
+_is_fle2_ciphertext (const _mongocrypt_buffer_t *in)
 {
-   bool ret = false;
-   _mongocrypt_key_broker_t *kb = ctx;
-   mc_FLE2IndexedEqualityEncryptedValue_t *ieev =
-      mc_FLE2IndexedEqualityEncryptedValue_new ();
-   _mongocrypt_buffer_t S_Key = {0};
-   _mongocrypt_buffer_t K_Key = {0};
-
-   if (!mc_FLE2IndexedEqualityEncryptedValue_parse (ieev, in, status)) {
-      goto fail;
-   }
+   return in->data[0] == MC_SUBTYPE_FLE2IndexedEqualityEncryptedValue ||
+          in->data[0] == MC_SUBTYPE_FLE2UnindexedEncryptedValue ||
+          in->data[0] == MC_SUBTYPE_FLE2InsertUpdatePayload;
+}
 
-   const _mongocrypt_buffer_t *S_KeyId =
-      mc_FLE2IndexedEqualityEncryptedValue_get_S_KeyId (ieev, status);
-   if (!S_KeyId) {
-      goto fail;
-   }
 
-   if (!_mongocrypt_key_broker_decrypted_key_by_id (kb, S_KeyId, &S_Key)) {
-      _mongocrypt_key_broker_status (kb, status);
-      goto fail;
-   }
+static void
+_decrypt_ciphertext_cleanup (_mongocrypt_ctx_decrypt_ciphertext_t *ciphertext)
+{
+   _mongocrypt_buffer_cleanup (&ciphertext->job.plaintext);
+   _mongocrypt_buffer_cleanup (&ciphertext->job.associated_data);
+   _mongocrypt_buffer_cleanup (&ciphertext->job.key_material);
+   mongocrypt_status_destroy (ciphertext->job.status);
+   mc_FLE2IndexedEqualityEncryptedValue_destroy (ciphertext->ieev);
+   mc_FLE2UnindexedEncryptedValue_destroy (ciphertext->uev);
+   mc_FLE2InsertUpdatePayload_cleanup (&ciphertext->iup);
+}
 
-   /* Decrypt InnerEncrypted to get K_KeyId. */
-   if (!mc_FLE2IndexedEqualityEncryptedValue_add_S_Key (
-          kb->crypt->crypto, ieev, &S_Key, status)) {
-      goto fail;
-   }
 
-   const _mongocrypt_buffer_t *K_KeyId =
-      mc_FLE2IndexedEqualityEncryptedValue_get_K_KeyId (ieev, status);
-   if (!K_KeyId) {
-      goto fail;
-   }
+static bool
+_decrypt_FLE2IndexedEqualityEncryptedValue (
+   _mongocrypt_key_broker_t *kb,
+   _mongocrypt_ctx_decrypt_ciphertext_t *ciphertext,
+   mongocrypt_status_t *status)
+{
+   bool ret = false;
+   mc_FLE2IndexedEqualityEncryptedValue_t *ieev = ciphertext->ieev;
+   _mongocrypt_buffer_t K_Key = {0};
 
-   if (!_mongocrypt_key_broker_decrypted_key_by_id (kb, K_KeyId, &K_Key)) {
+   /* S_Key was added by _check_for_K_KeyId. */
+   BSON_ASSERT (ciphertext->K_KeyId);
+   if (!_mongocrypt_key_broker_decrypted_key_by_id (
+          kb, ciphertext->K_KeyId, &K_Key)) {
       _mongocrypt_key_broker_status (kb, status);
       goto fail;
    }
@@ -75,50 +104,35 @@ _replace_FLE2IndexedEqualityEncryptedValue_with_plaintext (
       goto fail;
    }
 
-   const _mongocrypt_buffer_t *clientValue =
+   ciphertext->plaintext =
       mc_FLE2IndexedEqualityEncryptedValue_get_ClientValue (ieev, status);
-   if (!clientValue) {
+   if (!ciphertext->plaintext) {
       goto fail;
    }
 
-   uint8_t original_bson_type =
+   ciphertext->plaintext_type =
       mc_FLE2IndexedEqualityEncryptedValue_get_original_bson_type (ieev,
                                                                    status);
-   if (0 == original_bson_type) {
-      goto fail;
-   }
-
-   if (!_mongocrypt_buffer_to_bson_value (
-          (_mongocrypt_buffer_t *) clientValue, original_bson_type, out)) {
-      CLIENT_ERR ("decrypted clientValue is not valid BSON");
+   if (0 == ciphertext->plaintext_type) {
       goto fail;
    }
 
    ret = true;
 fail:
    _mongocrypt_buffer_cleanup (&K_Key);
-   _mongocrypt_buffer_cleanup (&S_Key);
-   mc_FLE2IndexedEqualityEncryptedValue_destroy (ieev);
    return ret;
 }
 
 static bool
-_replace_FLE2UnindexedEncryptedValue_with_plaintext (
-   void *ctx,
-   _mongocrypt_buffer_t *in,
-   bson_value_t *out,
+_decrypt_FLE2UnindexedEncryptedValue (
+   _mongocrypt_key_broker_t *kb,
+   _mongocrypt_ctx_decrypt_ciphertext_t *ciphertext,
    mongocrypt_status_t *status)
 {
    bool ret = false;
-   _mongocrypt_key_broker_t *kb = ctx;
-   mc_FLE2UnindexedEncryptedValue_t *uev =
-      mc_FLE2UnindexedEncryptedValue_new ();
+   mc_FLE2UnindexedEncryptedValue_t *uev = ciphertext->uev;
    _mongocrypt_buffer_t key = {0};
 
-   if (!mc_FLE2UnindexedEncryptedValue_parse (uev, in, status)) {
-      goto fail;
-   }
-
    const _mongocrypt_buffer_t *key_uuid =
       mc_FLE2UnindexedEncryptedValue_get_key_uuid (uev, status);
    if (!key_uuid) {
@@ -131,305 +145,480 @@ _replace_FLE2UnindexedEncryptedValue_with_plaintext (
    }
 
    /* Decrypt ciphertext. */
-   const _mongocrypt_buffer_t *plaintext =
-      mc_FLE2UnindexedEncryptedValue_decrypt (
-         kb->crypt->crypto, uev, &key, status);
-   if (!plaintext) {
+   ciphertext->plaintext = mc_FLE2UnindexedEncryptedValue_decrypt (
+      kb->crypt->crypto, uev, &key, status);
+   if (!ciphertext->plaintext) {
       goto fail;
    }
 
-   uint8_t original_bson_type =
+   ciphertext->plaintext_type =
       mc_FLE2UnindexedEncryptedValue_get_original_bson_type (uev, status);
-   if (0 == original_bson_type) {
-      goto fail;
-   }
-
-   if (!_mongocrypt_buffer_to_bson_value (
-          (_mongocrypt_buffer_t *) plaintext, original_bson_type, out)) {
-      CLIENT_ERR ("decrypted plaintext is not valid BSON");
+   if (0 == ciphertext->plaintext_type) {
       goto fail;
    }
 
    ret = true;
 fail:
    _mongocrypt_buffer_cleanup (&key);
-   mc_FLE2UnindexedEncryptedValue_destroy (uev);
    return ret;
 }
 
 static bool
-_replace_FLE2InsertUpdatePayload_with_plaintext (void *ctx,
-                                                 _mongocrypt_buffer_t *in,
-                                                 bson_value_t *out,
-                                                 mongocrypt_status_t *status)
+_decrypt_FLE2InsertUpdatePayload (
+   _mongocrypt_key_broker_t *kb,
+   _mongocrypt_ctx_decrypt_ciphertext_t *ciphertext,
+   mongocrypt_status_t *status)
 {
    bool ret = false;
-   _mongocrypt_key_broker_t *kb = ctx;
-   mc_FLE2InsertUpdatePayload_t iup;
+   mc_FLE2InsertUpdatePayload_t *iup = &ciphertext->iup;
    _mongocrypt_buffer_t key = {0};
 
-   mc_FLE2InsertUpdatePayload_init (&iup);
-
-   if (!mc_FLE2InsertUpdatePayload_parse (&iup, in, status)) {
-      goto fail;
-   }
-
-   if (!_mongocrypt_key_broker_decrypted_key_by_id (kb, &iup.userKeyId, &key)) {
+   if (!_mongocrypt_key_broker_decrypted_key_by_id (
+          kb, &iup->userKeyId, &key)) {
       _mongocrypt_key_broker_status (kb, status);
       goto fail;
    }
 
    /* Decrypt ciphertext. */
-   const _mongocrypt_buffer_t *plaintext = mc_FLE2InsertUpdatePayload_decrypt (
-      kb->crypt->crypto, &iup, &key, status);
-   if (!plaintext) {
+   ciphertext->plaintext = mc_FLE2InsertUpdatePayload_decrypt (
+      kb->crypt->crypto, iup, &key, status);
+   if (!ciphertext->plaintext) {
       goto fail;
    }
 
-   uint8_t original_bson_type = (uint8_t) iup.valueType;
-
-   if (!_mongocrypt_buffer_to_bson_value (
-          (_mongocrypt_buffer_t *) plaintext, original_bson_type, out)) {
-      CLIENT_ERR ("decrypted plaintext is not valid BSON");
-      goto fail;
-   }
+   ciphertext->plaintext_type = (uint8_t) iup->valueType;
 
    ret = true;
 fail:
    _mongocrypt_buffer_cleanup (&key);
-   mc_FLE2InsertUpdatePayload_cleanup (&iup);
    return ret;
 }
 
+
+/* Always call _decrypt_ciphertext_cleanup on the ciphertext owning @job, even
+ * on failure. */
 static bool
-_replace_ciphertext_with_plaintext (void *ctx,
-                                    _mongocrypt_buffer_t *in,
-                                    bson_value_t *out,
-                                    mongocrypt_status_t *status)
+_decrypt_job_prepare (_mongocrypt_key_broker_t *kb,
+                      _decrypt_job_t *job,
+                      mongocrypt_status_t *status)
 {
-   _mongocrypt_key_broker_t *kb;
-   _mongocrypt_ciphertext_t ciphertext;
-   _mongocrypt_buffer_t plaintext;
-   _mongocrypt_buffer_t key_material;
-   _mongocrypt_buffer_t associated_data;
-   uint32_t bytes_written;
-   bool ret = false;
-
-   BSON_ASSERT (ctx);
-   BSON_ASSERT (in);
-   BSON_ASSERT (out);
-
-   if (in->data[0] == MC_SUBTYPE_FLE2IndexedEqualityEncryptedValue) {
-      return _replace_FLE2IndexedEqualityEncryptedValue_with_plaintext (
-         ctx, in, out, status);
-   }
-
-   if (in->data[0] == MC_SUBTYPE_FLE2UnindexedEncryptedValue) {
-      return _replace_FLE2UnindexedEncryptedValue_with_plaintext (
-         ctx, in, out, status);
-   }
-
-   if (in->data[0] == MC_SUBTYPE_FLE2InsertUpdatePayload) {
-      return _replace_FLE2InsertUpdatePayload_with_plaintext (
-         ctx, in, out, status);
-   }
-
-   _mongocrypt_buffer_init (&plaintext);
-   _mongocrypt_buffer_init (&associated_data);
-   _mongocrypt_buffer_init (&key_material);
-   kb = (_mongocrypt_key_broker_t *) ctx;
-
-   if (!_mongocrypt_ciphertext_parse_unowned (in, &ciphertext, status)) {
-      goto fail;
-   }
-
    /* look up the key */
    if (!_mongocrypt_key_broker_decrypted_key_by_id (
-          kb, &ciphertext.key_id, &key_material)) {
+          kb, &job->ciphertext.key_id, &job->key_material)) {
       CLIENT_ERR ("key not found");
-      goto fail;
+      return false;
    }
+   job->key_state = _mongocrypt_key_broker_decrypted_key_state_by_id (
+      kb, &job->ciphertext.key_id);
 
-   plaintext.len = _mongocrypt_calculate_plaintext_len (ciphertext.data.len);
-   plaintext.data = bson_malloc0 (plaintext.len);
-   BSON_ASSERT (plaintext.data);
+   job->plaintext.len =
+      _mongocrypt_calculate_plaintext_len (job->ciphertext.data.len);
+   job->plaintext.data = bson_malloc0 (job->plaintext.len);
+   BSON_ASSERT (job->plaintext.data);
 
-   plaintext.owned = true;
+   job->plaintext.owned = true;
 
-   if (!_mongocrypt_ciphertext_serialize_associated_data (&ciphertext,
-                                                          &associated_data)) {
+   if (!_mongocrypt_ciphertext_serialize_associated_data (
+          &job->ciphertext, &job->associated_data)) {
       CLIENT_ERR ("could not serialize associated data");
-      goto fail;
+      return false;
    }
 
-   if (!_mongocrypt_do_decryption (kb->crypt->crypto,
-                                   &associated_data,
-                                   &key_material,
-                                   &ciphertext.data,
-                                   &plaintext,
-                                   &bytes_written,
-                                   status)) {
-      goto fail;
-   }
+   return true;
+}
 
-   plaintext.len = bytes_written;
 
-   if (!_mongocrypt_buffer_to_bson_value (
-          &plaintext, ciphertext.original_bson_type, out)) {
-      CLIENT_ERR ("malformed encrypted bson");
-      goto fail;
+static bool
+_decrypt_job_run (_mongocrypt_crypto_t *crypto,
+                  _decrypt_job_t *job,
+                  mongocrypt_status_t *status)
+{
+   uint32_t bytes_written;
+   bool ok;
+
+   if (job->key_state) {
+      ok = _mongocrypt_do_decryption_with_key_state (crypto,
+                                                     &job->associated_data,
+                                                     job->key_state,
+                                                     &job->ciphertext.data,
+                                                     &job->plaintext,
+                                                     &bytes_written,
+                                                     status);
+   } else {
+      ok = _mongocrypt_do_decryption (crypto,
+                                      &job->associated_data,
+                                      &job->key_material,
+                                      &job->ciphertext.data,
+                                      &job->plaintext,
+                                      &bytes_written,
+                                      status);
+   }
+   if (!ok) {
+      return false;
    }
-   ret = true;
 
-fail:
-   _mongocrypt_buffer_cleanup (&plaintext);
-   _mongocrypt_buffer_cleanup (&associated_data);
-   _mongocrypt_buffer_cleanup (&key_material);
-   return ret;
+   job->plaintext.len = bytes_written;
+   return true;
 }
 
 
-static bool
-_finalize (mongocrypt_ctx_t *ctx, mongocrypt_binary_t *out)
+static void
+_run_decrypt_job (void *task_ctx, uint32_t index)
 {
-   bson_t as_bson, final_bson;
-   bson_iter_t iter;
-   _mongocrypt_ctx_decrypt_t *dctx;
-   bool res;
+   _mongocrypt_ctx_decrypt_t *dctx = task_ctx;
+   _mongocrypt_ctx_decrypt_ciphertext_t *ciphertext =
+      &dctx->ciphertexts[index];
+   _decrypt_job_t *job = &ciphertext->job;
 
-   if (!ctx) {
-      return false;
-   }
-
-   if (!out) {
-      return _mongocrypt_ctx_fail_w_msg (ctx, "null out parameter");
+   if (_is_fle2_ciphertext (&ciphertext->in)) {
+      job->ok = true;
+      return;
    }
+   job->ok = _decrypt_job_run (dctx->parent.crypt->crypto, job, job->status);
+}
 
-   dctx = (_mongocrypt_ctx_decrypt_t *) ctx;
 
-   if (ctx->nothing_to_do) {
-      _mongocrypt_buffer_to_binary (&dctx->original_doc, out);
-      ctx->state = MONGOCRYPT_CTX_DONE;
+/* Decrypts every recorded ciphertext. FLE1 ciphertexts are decrypted in
+ * parallel if parallel finalize is enabled. */
+static bool
+_decrypt_ciphertexts (mongocrypt_ctx_t *ctx)
+{
+   _mongocrypt_ctx_decrypt_t *dctx = (_mongocrypt_ctx_decrypt_t *) ctx;
+   bool parallel = _mongocrypt_parallel_finalize_enabled (ctx->crypt);
+   uint32_t i;
+
+   for (i = 0; i < dctx->ciphertexts_len; i++) {
+      _mongocrypt_ctx_decrypt_ciphertext_t *ciphertext = &dctx->ciphertexts[i];
+      bool ok;
+
+      switch (ciphertext->in.data[0]) {
+      case MC_SUBTYPE_FLE2IndexedEqualityEncryptedValue:
+         ok = _decrypt_FLE2IndexedEqualityEncryptedValue (
+            &ctx->kb, ciphertext, ctx->status);
+         break;
+      case MC_SUBTYPE_FLE2UnindexedEncryptedValue:
+         ok = _decrypt_FLE2UnindexedEncryptedValue (
+            &ctx->kb, ciphertext, ctx->status);
+         break;
+      case MC_SUBTYPE_FLE2InsertUpdatePayload:
+         ok = _decrypt_FLE2InsertUpdatePayload (
+            &ctx->kb, ciphertext, ctx->status);
+         break;
+      default:
+         ok = _decrypt_job_prepare (&ctx->kb, &ciphertext->job, ctx->status);
+         if (ok && parallel) {
+            ciphertext->job.status = mongocrypt_status_new ();
+         } else if (ok) {
+            ok = _decrypt_job_run (
+               ctx->crypt->crypto, &ciphertext->job, ctx->status);
+         }
+         ciphertext->plaintext = &ciphertext->job.plaintext;
+         ciphertext->plaintext_type =
+            ciphertext->job.ciphertext.original_bson_type;
+         break;
+      }
+      if (!ok) {
+         return false;
+      }
+   }
+
+   if (!parallel) {
       return true;
    }
 
-   if (!_mongocrypt_buffer_to_bson (&dctx->original_doc, &as_bson)) {
-      return _mongocrypt_ctx_fail_w_msg (ctx, "malformed bson");
-   }
+   _mongocrypt_parallel_for (
+      ctx->crypt, dctx->ciphertexts_len, _run_decrypt_job, dctx);
 
-   bson_iter_init (&iter, &as_bson);
-   bson_init (&final_bson);
-   res = _mongocrypt_transform_binary_in_bson (
-      _replace_ciphertext_with_plaintext,
-      &ctx->kb,
-      TRAVERSE_MATCH_CIPHERTEXT,
-      &iter,
-      &final_bson,
-      ctx->status);
-   if (!res) {
-      return _mongocrypt_ctx_fail (ctx);
-   }
+   for (i = 0; i < dctx->ciphertexts_len; i++) {
+      _decrypt_job_t *job = &dctx->ciphertexts[i].job;
 
-   _mongocrypt_buffer_steal_from_bson (&dctx->decrypted_doc, &final_bson);
-   out->data = dctx->decrypted_doc.data;
-   out->len = dctx->decrypted_doc.len;
-   ctx->state = MONGOCRYPT_CTX_DONE;
+      if (!job->ok) {
+         _mongocrypt_status_copy_to (job->status, ctx->status);
+         return false;
+      }
+   }
    return true;
 }
 
-static bool
-_collect_S_KeyID_from_FLE2IndexedEqualityEncryptedValue (
-   void *ctx, _mongocrypt_buffer_t *in, mongocrypt_status_t *status)
+
+/* Returns the little-endian int32 at @data as unsigned. */
+static uint32_t
+_read_le_uint32 (const uint8_t *data)
 {
-   bool ret = false;
-   _mongocrypt_key_broker_t *kb = ctx;
-   mc_FLE2IndexedEqualityEncryptedValue_t *ieev;
+   uint32_t value;
 
-   ieev = mc_FLE2IndexedEqualityEncryptedValue_new ();
+   memcpy (&value, data, sizeof (value));
+   return BSON_UINT32_FROM_LE (value);
+}
 
-   if (!mc_FLE2IndexedEqualityEncryptedValue_parse (ieev, in, status)) {
-      goto fail;
-   }
 
-   const _mongocrypt_buffer_t *S_KeyId =
-      mc_FLE2IndexedEqualityEncryptedValue_get_S_KeyId (ieev, status);
-   if (!S_KeyId) {
-      goto fail;
-   }
+/* Returns true if the @len bytes at @data are a length-prefixed, NULL
+ * terminated string that fills them exactly. */
+static bool
+_is_string (const uint8_t *data, uint32_t len)
+{
+   return len > sizeof (int32_t) &&
+          _read_le_uint32 (data) == len - sizeof (int32_t) &&
+          data[len - 1] == 0;
+}
 
-   if (!_mongocrypt_key_broker_request_id (kb, S_KeyId)) {
-      _mongocrypt_key_broker_status (kb, status);
-      goto fail;
-   }
 
-   ret = true;
-fail:
-   mc_FLE2IndexedEqualityEncryptedValue_destroy (ieev);
-   return ret;
+/* Returns true if the @len bytes at @data are a valid BSON document that fills
+ * them exactly. */
+static bool
+_is_document (const uint8_t *data, uint32_t len)
+{
+   bson_t bson;
+
+   return bson_init_static (&bson, data, len) &&
+          bson_validate (&bson, BSON_VALIDATE_NONE, NULL);
 }
 
+
+/* Returns true if @plaintext is exactly one well-formed BSON value of @type.
+ * Plaintexts are spliced into the document without copying them into a
+ * bson_value_t, so a value that is malformed or longer than its type allows
+ * must be rejected here. The checks read the plaintext in place. */
 static bool
-_collect_K_KeyID_from_FLE2IndexedEqualityEncryptedValue (
-   void *ctx, _mongocrypt_buffer_t *in, mongocrypt_status_t *status)
+_plaintext_is_single_value (const _mongocrypt_buffer_t *plaintext, uint8_t type)
 {
-   bool ret = false;
-   _mongocrypt_key_broker_t *kb = ctx;
-   mc_FLE2IndexedEqualityEncryptedValue_t *ieev;
-   _mongocrypt_buffer_t S_Key = {0};
-
-   /* Ignore other ciphertext types. */
-   if (in->data[0] != MC_SUBTYPE_FLE2IndexedEqualityEncryptedValue) {
+   const uint8_t *data = plaintext->data;
+   uint32_t len = plaintext->len;
+   const uint8_t *end;
+   uint32_t str_len;
+
+   switch (type) {
+   case BSON_TYPE_UNDEFINED:
+   case BSON_TYPE_NULL:
+   case BSON_TYPE_MINKEY:
+   case BSON_TYPE_MAXKEY:
+      return len == 0;
+   case BSON_TYPE_BOOL:
+      return len == 1 && (data[0] == 0 || data[0] == 1);
+   case BSON_TYPE_INT32:
+      return len == sizeof (int32_t);
+   case BSON_TYPE_DOUBLE:
+   case BSON_TYPE_DATE_TIME:
+   case BSON_TYPE_TIMESTAMP:
+   case BSON_TYPE_INT64:
+      return len == sizeof (int64_t);
+   case BSON_TYPE_OID:
+      return len == sizeof (bson_oid_t);
+   case BSON_TYPE_DECIMAL128:
+      return len == sizeof (bson_decimal128_t);
+   case BSON_TYPE_UTF8:
+   case BSON_TYPE_CODE:
+   case BSON_TYPE_SYMBOL:
+      return _is_string (data, len);
+   case BSON_TYPE_DOCUMENT:
+   case BSON_TYPE_ARRAY:
+      return _is_document (data, len);
+   case BSON_TYPE_BINARY:
+      /* The length, subtype, and data. */
+      if (len < sizeof (int32_t) + 1 ||
+          _read_le_uint32 (data) != len - (sizeof (int32_t) + 1)) {
+         return false;
+      }
+      /* The deprecated subtype repeats the length of the data. */
+      if (data[sizeof (int32_t)] == BSON_SUBTYPE_BINARY_DEPRECATED) {
+         return len >= 2 * sizeof (int32_t) + 1 &&
+                _read_le_uint32 (data + sizeof (int32_t) + 1) ==
+                   len - (2 * sizeof (int32_t) + 1);
+      }
       return true;
+   case BSON_TYPE_REGEX:
+      /* The pattern and options. */
+      end = len ? memchr (data, 0, len) : NULL;
+      if (!end) {
+         return false;
+      }
+      end++;
+      return end < data + len &&
+             memchr (end, 0, (size_t) (data + len - end)) == data + len - 1;
+   case BSON_TYPE_DBPOINTER:
+      /* The collection name and id. */
+      return len > sizeof (bson_oid_t) &&
+             _is_string (data, len - sizeof (bson_oid_t));
+   case BSON_TYPE_CODEWSCOPE:
+      /* The total length, code, and scope. */
+      if (len < 2 * sizeof (int32_t) || _read_le_uint32 (data) != len) {
+         return false;
+      }
+      data += sizeof (int32_t);
+      len -= sizeof (int32_t);
+      str_len = _read_le_uint32 (data);
+      if (str_len > len - sizeof (int32_t)) {
+         return false;
+      }
+      return _is_string (data, sizeof (int32_t) + str_len) &&
+             _is_document (data + sizeof (int32_t) + str_len,
+                           len - sizeof (int32_t) - str_len);
+   default:
+      return false;
    }
+}
 
-   ieev = mc_FLE2IndexedEqualityEncryptedValue_new ();
 
-   if (!mc_FLE2IndexedEqualityEncryptedValue_parse (ieev, in, status)) {
-      goto fail;
+/* Writes the document @doc to @out with every recorded ciphertext in it
+ * replaced by its plaintext, and advances @out past it. @next is the index of
+ * the first ciphertext not yet written. Only the elements on the path to a
+ * ciphertext are iterated. The byte ranges between them are copied whole. */
+static bool
+_splice_plaintexts (_mongocrypt_ctx_decrypt_t *dctx,
+                    const uint8_t *doc,
+                    uint32_t doc_len,
+                    uint32_t *next,
+                    uint8_t **out,
+                    mongocrypt_status_t *status)
+{
+   bson_t bson;
+   bson_iter_t iter;
+   uint8_t *start = *out;
+   const uint8_t *copied = doc + sizeof (int32_t);
+   uint32_t written;
+
+   if (!bson_init_static (&bson, doc, doc_len) ||
+       !bson_iter_init (&iter, &bson)) {
+      CLIENT_ERR ("malformed bson");
+      return false;
    }
+   /* The length is written last. */
+   *out += sizeof (int32_t);
+
+   while (*next < dctx->ciphertexts_len &&
+          dctx->ciphertexts[*next].in.data < doc + doc_len) {
+      _mongocrypt_ctx_decrypt_ciphertext_t *ciphertext =
+         &dctx->ciphertexts[*next];
+      const uint8_t *element;
+      const uint8_t *value;
+      uint32_t value_len = 0;
+      uint32_t header_len;
+
+      /* Find the element holding the ciphertext. */
+      do {
+         if (!bson_iter_next (&iter)) {
+            CLIENT_ERR ("malformed bson");
+            return false;
+         }
+      } while (iter.raw + iter.next_off <= ciphertext->in.data);
+
+      element = iter.raw + iter.off;
+      memcpy (*out, copied, (size_t) (element - copied));
+      *out += element - copied;
+      copied = iter.raw + iter.next_off;
+
+      /* The element type, key, and NULL byte. */
+      header_len = 1 + bson_iter_key_len (&iter) + 1;
+
+      if (BSON_ITER_HOLDS_BINARY (&iter)) {
+         bson_iter_binary (&iter, NULL, &value_len, &value);
+         if (value != ciphertext->in.data) {
+            CLIENT_ERR ("unexpected ciphertext location");
+            return false;
+         }
+         **out = ciphertext->plaintext_type;
+         memcpy (*out + 1, element + 1, header_len - 1);
+         *out += header_len;
+         memcpy (*out, ciphertext->plaintext->data, ciphertext->plaintext->len);
+         *out += ciphertext->plaintext->len;
+         (*next)++;
+         continue;
+      }
+
+      if (BSON_ITER_HOLDS_DOCUMENT (&iter)) {
+         bson_iter_document (&iter, &value_len, &value);
+      } else if (BSON_ITER_HOLDS_ARRAY (&iter)) {
+         bson_iter_array (&iter, &value_len, &value);
+      } else {
+         CLIENT_ERR ("unexpected ciphertext location");
+         return false;
+      }
+      memcpy (*out, element, header_len);
+      *out += header_len;
+      if (!_splice_plaintexts (dctx, value, value_len, next, out, status)) {
+         return false;
+      }
+   }
+
+   memcpy (*out, copied, (size_t) (doc + doc_len - copied));
+   *out += doc + doc_len - copied;
+
+   written = BSON_UINT32_TO_LE ((uint32_t) (*out - start));
+   memcpy (start, &written, sizeof (written));
+   return true;
+}
 
-   const _mongocrypt_buffer_t *S_KeyId =
-      mc_FLE2IndexedEqualityEncryptedValue_get_S_KeyId (ieev, status);
-   if (!S_KeyId) {
-      goto fail;
+
+static bool
+_finalize (mongocrypt_ctx_t *ctx, mongocrypt_binary_t *out)
+{
+   _mongocrypt_ctx_decrypt_t *dctx;
+   int64_t len;
+   uint32_t next = 0;
+   uint8_t *written;
+   uint32_t i;
+
+   if (!ctx) {
+      return false;
    }
 
-   if (!_mongocrypt_key_broker_decrypted_key_by_id (kb, S_KeyId, &S_Key)) {
-      _mongocrypt_key_broker_status (kb, status);
-      goto fail;
+   if (!out) {
+      return _mongocrypt_ctx_fail_w_msg (ctx, "null out parameter");
    }
 
-   /* Decrypt InnerEncrypted to get K_KeyId. */
-   if (!mc_FLE2IndexedEqualityEncryptedValue_add_S_Key (
-          kb->crypt->crypto, ieev, &S_Key, status)) {
-      goto fail;
+   dctx = (_mongocrypt_ctx_decrypt_t *) ctx;
+
+   if (ctx->nothing_to_do) {
+      _mongocrypt_buffer_to_binary (&dctx->original_doc, out);
+      ctx->state = MONGOCRYPT_CTX_DONE;
+      return true;
    }
 
-   /* Add request for K_KeyId. */
-   const _mongocrypt_buffer_t *K_KeyId =
-      mc_FLE2IndexedEqualityEncryptedValue_get_K_KeyId (ieev, status);
-   if (!K_KeyId) {
-      goto fail;
+   if (!_decrypt_ciphertexts (ctx)) {
+      return _mongocrypt_ctx_fail (ctx);
    }
 
-   if (!_mongocrypt_key_broker_request_id (kb, K_KeyId)) {
-      _mongocrypt_key_broker_status (kb, status);
-      goto fail;
+   /* Each binary value, with its length and subtype, becomes a plaintext. */
+   len = dctx->original_doc.len;
+   for (i = 0; i < dctx->ciphertexts_len; i++) {
+      if (!_plaintext_is_single_value (dctx->ciphertexts[i].plaintext,
+                                       dctx->ciphertexts[i].plaintext_type)) {
+         return _mongocrypt_ctx_fail_w_msg (ctx, "malformed decrypted value");
+      }
+      len += (int64_t) dctx->ciphertexts[i].plaintext->len -
+             (int64_t) (sizeof (int32_t) + 1 + dctx->ciphertexts[i].in.len);
+   }
+   if (len > INT32_MAX) {
+      return _mongocrypt_ctx_fail_w_msg (ctx, "decrypted document too large");
+   }
+
+   _mongocrypt_buffer_resize (&dctx->decrypted_doc, (uint32_t) len);
+   written = dctx->decrypted_doc.data;
+   if (!_splice_plaintexts (dctx,
+                            dctx->original_doc.data,
+                            dctx->original_doc.len,
+                            &next,
+                            &written,
+                            ctx->status)) {
+      return _mongocrypt_ctx_fail (ctx);
    }
+   BSON_ASSERT (next == dctx->ciphertexts_len);
+   BSON_ASSERT (written == dctx->decrypted_doc.data + len);
 
-   ret = true;
-fail:
-   _mongocrypt_buffer_cleanup (&S_Key);
-   mc_FLE2IndexedEqualityEncryptedValue_destroy (ieev);
-   return ret;
+   out->data = dctx->decrypted_doc.data;
+   out->len = dctx->decrypted_doc.len;
+   ctx->state = MONGOCRYPT_CTX_DONE;
+   return true;
 }
 
-
 /* _check_for_K_KeyId must be called after requests for all S_KeyId are
  * satisfied. */
 static bool
 _check_for_K_KeyId (mongocrypt_ctx_t *ctx)
 {
+   _mongocrypt_ctx_decrypt_t *dctx = (_mongocrypt_ctx_decrypt_t *) ctx;
+   uint32_t i;
+
    if (ctx->kb.state != KB_DONE) {
       return true;
    }
@@ -439,22 +628,52 @@ _check_for_K_KeyId (mongocrypt_ctx_t *ctx)
       return _mongocrypt_ctx_fail (ctx);
    }
 
-   bson_t as_bson;
-   bson_iter_t iter;
-   _mongocrypt_ctx_decrypt_t *dctx = (_mongocrypt_ctx_decrypt_t *) ctx;
-   if (!_mongocrypt_buffer_to_bson (&dctx->original_doc, &as_bson)) {
-      return _mongocrypt_ctx_fail_w_msg (
-         ctx, "error converting original_doc to bson");
-   }
-   bson_iter_init (&iter, &as_bson);
-
-   if (!_mongocrypt_traverse_binary_in_bson (
-          _collect_K_KeyID_from_FLE2IndexedEqualityEncryptedValue,
-          &ctx->kb,
-          TRAVERSE_MATCH_CIPHERTEXT,
-          &iter,
-          ctx->status)) {
-      return _mongocrypt_ctx_fail (ctx);
+   for (i = 0; i < dctx->ciphertexts_len; i++) {
+      _mongocrypt_ctx_decrypt_ciphertext_t *ciphertext = &dctx->ciphertexts[i];
+      mongocrypt_status_t *status = ctx->status;
+
+      if (!ciphertext->ieev) {
+         continue;
+      }
+
+      if (!ciphertext->K_KeyId) {
+         _mongocrypt_buffer_t S_Key = {0};
+         const _mongocrypt_buffer_t *S_KeyId =
+            mc_FLE2IndexedEqualityEncryptedValue_get_S_KeyId (ciphertext->ieev,
+                                                              status);
+         bool ok;
+
+         if (!S_KeyId) {
+            return _mongocrypt_ctx_fail (ctx);
+         }
+
+         if (!_mongocrypt_key_broker_decrypted_key_by_id (
+                &ctx->kb, S_KeyId, &S_Key)) {
+            _mongocrypt_key_broker_status (&ctx->kb, status);
+            return _mongocrypt_ctx_fail (ctx);
+         }
+
+         /* Decrypt InnerEncrypted to get K_KeyId. */
+         ok = mc_FLE2IndexedEqualityEncryptedValue_add_S_Key (
+            ctx->crypt->crypto, ciphertext->ieev, &S_Key, status);
+         _mongocrypt_buffer_cleanup (&S_Key);
+         if (!ok) {
+            return _mongocrypt_ctx_fail (ctx);
+         }
+
+         ciphertext->K_KeyId =
+            mc_FLE2IndexedEqualityEncryptedValue_get_K_KeyId (ciphertext->ieev,
+                                                              status);
+         if (!ciphertext->K_KeyId) {
+            return _mongocrypt_ctx_fail (ctx);
+         }
+      }
+
+      /* Add request for K_KeyId. */
+      if (!_mongocrypt_key_broker_request_id (&ctx->kb, ciphertext->K_KeyId)) {
+         _mongocrypt_key_broker_status (&ctx->kb, status);
+         return _mongocrypt_ctx_fail (ctx);
+      }
    }
 
    if (!_mongocrypt_key_broker_requests_done (&ctx->kb)) {
@@ -464,96 +683,74 @@ _check_for_K_KeyId (mongocrypt_ctx_t *ctx)
    return true;
 }
 
-static bool
-_collect_key_uuid_from_FLE2UnindexedEncryptedValue (void *ctx,
-                                                    _mongocrypt_buffer_t *in,
-                                                    mongocrypt_status_t *status)
-{
-   bool ret = false;
-   _mongocrypt_key_broker_t *kb = ctx;
-   mc_FLE2UnindexedEncryptedValue_t *uev;
-
-   uev = mc_FLE2UnindexedEncryptedValue_new ();
-
-   if (!mc_FLE2UnindexedEncryptedValue_parse (uev, in, status)) {
-      goto fail;
-   }
-
-   const _mongocrypt_buffer_t *key_uuid =
-      mc_FLE2UnindexedEncryptedValue_get_key_uuid (uev, status);
-   if (!key_uuid) {
-      goto fail;
-   }
-
-   if (!_mongocrypt_key_broker_request_id (kb, key_uuid)) {
-      _mongocrypt_key_broker_status (kb, status);
-      goto fail;
-   }
-
-   ret = true;
-fail:
-   mc_FLE2UnindexedEncryptedValue_destroy (uev);
-   return ret;
-}
-
-static bool
-_collect_key_uuid_from_FLE2InsertUpdatePayload (void *ctx,
-                                                _mongocrypt_buffer_t *in,
-                                                mongocrypt_status_t *status)
-{
-   bool ret = false;
-   _mongocrypt_key_broker_t *kb = ctx;
-   mc_FLE2InsertUpdatePayload_t iup;
-
-   mc_FLE2InsertUpdatePayload_init (&iup);
-
-   if (!mc_FLE2InsertUpdatePayload_parse (&iup, in, status)) {
-      goto fail;
-   }
-
-   if (!_mongocrypt_key_broker_request_id (kb, &iup.userKeyId)) {
-      _mongocrypt_key_broker_status (kb, status);
-      goto fail;
-   }
-
-   ret = true;
-fail:
-   mc_FLE2InsertUpdatePayload_cleanup (&iup);
-   return ret;
-}
-
+/* Records the ciphertext @in, parses it, and requests the key needed first to
+ * decrypt it. */
 static bool
 _collect_key_from_ciphertext (void *ctx,
                               _mongocrypt_buffer_t *in,
                               mongocrypt_status_t *status)
 {
-   _mongocrypt_ciphertext_t ciphertext;
+   _mongocrypt_ctx_decrypt_t *dctx;
+   _mongocrypt_ctx_decrypt_ciphertext_t *ciphertext;
    _mongocrypt_key_broker_t *kb;
+   const _mongocrypt_buffer_t *key_id;
 
    BSON_ASSERT (ctx);
    BSON_ASSERT (in);
 
-   kb = (_mongocrypt_key_broker_t *) ctx;
-
-   if (in->data[0] == MC_SUBTYPE_FLE2IndexedEqualityEncryptedValue) {
-      return _collect_S_KeyID_from_FLE2IndexedEqualityEncryptedValue (
-         ctx, in, status);
-   }
-
-   if (in->data[0] == MC_SUBTYPE_FLE2UnindexedEncryptedValue) {
-      return _collect_key_uuid_from_FLE2UnindexedEncryptedValue (
-         ctx, in, status);
-   }
-
-   if (in->data[0] == MC_SUBTYPE_FLE2InsertUpdatePayload) {
-      return _collect_key_uuid_from_FLE2InsertUpdatePayload (ctx, in, status);
-   }
-
-   if (!_mongocrypt_ciphertext_parse_unowned (in, &ciphertext, status)) {
+   dctx = (_mongocrypt_ctx_decrypt_t *) ctx;
+   kb = &dctx->parent.kb;
+
+   if (dctx->ciphertexts_len == dctx->ciphertexts_cap) {
+      dctx->ciphertexts_cap =
+         dctx->ciphertexts_cap ? dctx->ciphertexts_cap * 2 : 8;
+      dctx->ciphertexts =
+         bson_realloc (dctx->ciphertexts,
+                       sizeof (*ciphertext) * dctx->ciphertexts_cap);
+   }
+   ciphertext = &dctx->ciphertexts[dctx->ciphertexts_len++];
+   memset (ciphertext, 0, sizeof (*ciphertext));
+   mc_FLE2InsertUpdatePayload_init (&ciphertext->iup);
+   _mongocrypt_buffer_set_to (in, &ciphertext->in);
+
+   switch (in->data[0]) {
+   case MC_SUBTYPE_FLE2IndexedEqualityEncryptedValue:
+      ciphertext->ieev = mc_FLE2IndexedEqualityEncryptedValue_new ();
+      if (!mc_FLE2IndexedEqualityEncryptedValue_parse (
+             ciphertext->ieev, in, status)) {
+         return false;
+      }
+      key_id = mc_FLE2IndexedEqualityEncryptedValue_get_S_KeyId (
+         ciphertext->ieev, status);
+      break;
+   case MC_SUBTYPE_FLE2UnindexedEncryptedValue:
+      ciphertext->uev = mc_FLE2UnindexedEncryptedValue_new ();
+      if (!mc_FLE2UnindexedEncryptedValue_parse (ciphertext->uev, in, status)) {
+         return false;
+      }
+      key_id =
+         mc_FLE2UnindexedEncryptedValue_get_key_uuid (ciphertext->uev, status);
+      break;
+   case MC_SUBTYPE_FLE2InsertUpdatePayload:
+      if (!mc_FLE2InsertUpdatePayload_parse (&ciphertext->iup, in, status)) {
+         return false;
+      }
+      key_id = &ciphertext->iup.userKeyId;
+      break;
+   default:
+      if (!_mongocrypt_ciphertext_parse_unowned (
+             in, &ciphertext->job.ciphertext, status)) {
+         return false;
+      }
+      key_id = &ciphertext->job.ciphertext.key_id;
+      break;
+   }
+
+   if (!key_id) {
       return false;
    }
 
-   if (!_mongocrypt_key_broker_request_id (kb, &ciphertext.key_id)) {
+   if (!_mongocrypt_key_broker_request_id (kb, key_id)) {
       return _mongocrypt_key_broker_status (kb, status);
    }
 
@@ -565,8 +762,13 @@ static void
 _cleanup (mongocrypt_ctx_t *ctx)
 {
    _mongocrypt_ctx_decrypt_t *dctx;
+   uint32_t i;
 
    dctx = (_mongocrypt_ctx_decrypt_t *) ctx;
+   for (i = 0; i < dctx->ciphertexts_len; i++) {
+      _decrypt_ciphertext_cleanup (&dctx->ciphertexts[i]);
+   }
+   bson_free (dctx->ciphertexts);
    _mongocrypt_buffer_cleanup (&dctx->original_doc);
    _mongocrypt_buffer_cleanup (&dctx->decrypted_doc);
 }
@@ -622,6 +824,54 @@ mongocrypt_ctx_explicit_decrypt_init (mongocrypt_ctx_t *ctx,
    return true;
 }
 
+bool
+mongocrypt_ctx_decrypt_batch_init (mongocrypt_ctx_t *ctx,
+                                   mongocrypt_binary_t *msg)
+{
+   _mongocrypt_ctx_decrypt_t *dctx;
+   bson_iter_t iter;
+   bson_iter_t elem;
+   bson_t as_bson;
+
+   /* Expect msg to be the BSON a document of the form:
+      { "v" : [ (BSON document or BINARY value of subtype 6), ... ] }
+      Elements are decrypted in place by the same traversal as
+      mongocrypt_ctx_decrypt_init, so the key broker sees the key ids of every
+      element at once and fetches each distinct key a single time.
+   */
+   if (!mongocrypt_ctx_decrypt_init (ctx, msg)) {
+      return false;
+   }
+
+   dctx = (_mongocrypt_ctx_decrypt_t *) ctx;
+   if (!_mongocrypt_buffer_to_bson (&dctx->original_doc, &as_bson)) {
+      return _mongocrypt_ctx_fail_w_msg (ctx, "malformed bson");
+   }
+
+   if (!bson_iter_init_find (&iter, &as_bson, "v")) {
+      return _mongocrypt_ctx_fail_w_msg (ctx, "invalid msg, must contain 'v'");
+   }
+
+   if (!BSON_ITER_HOLDS_ARRAY (&iter)) {
+      return _mongocrypt_ctx_fail_w_msg (
+         ctx, "invalid msg, 'v' must contain an array");
+   }
+
+   if (!bson_iter_recurse (&iter, &elem)) {
+      return _mongocrypt_ctx_fail_w_msg (ctx, "malformed bson");
+   }
+
+   while (bson_iter_next (&elem)) {
+      if (!BSON_ITER_HOLDS_DOCUMENT (&elem) &&
+          !BSON_ITER_HOLDS_BINARY (&elem)) {
+         return _mongocrypt_ctx_fail_w_msg (
+            ctx,
+            "invalid msg, 'v' elements must be documents or binary values");
+      }
+   }
+   return true;
+}
+
 static bool
 _mongo_done_keys (mongocrypt_ctx_t *ctx)
 {
@@ -632,6 +882,19 @@ _mongo_done_keys (mongocrypt_ctx_t *ctx)
    return _mongocrypt_ctx_state_from_key_broker (ctx);
 }
 
+static bool
+_wait_done (mongocrypt_ctx_t *ctx)
+{
+   if (!_mongocrypt_key_broker_check_waiting (&ctx->kb)) {
+      BSON_ASSERT (!_mongocrypt_key_broker_status (&ctx->kb, ctx->status));
+      return _mongocrypt_ctx_fail (ctx);
+   }
+   if (!_check_for_K_KeyId (ctx)) {
+      return false;
+   }
+   return _mongocrypt_ctx_state_from_key_broker (ctx);
+}
+
 static bool
 _kms_done (mongocrypt_ctx_t *ctx)
 {
@@ -684,6 +947,7 @@ mongocrypt_ctx_decrypt_init (mongocrypt_ctx_t *ctx, mongocrypt_binary_t *doc)
    ctx->vtable.finalize = _finalize;
    ctx->vtable.cleanup = _cleanup;
    ctx->vtable.mongo_done_keys = _mongo_done_keys;
+   ctx->vtable.wait_done = _wait_done;
    ctx->vtable.kms_done = _kms_done;
 
    _mongocrypt_buffer_copy_from_binary (&dctx->original_doc, doc);
@@ -694,7 +958,7 @@ mongocrypt_ctx_decrypt_init (mongocrypt_ctx_t *ctx, mongocrypt_binary_t *doc)
 
    bson_iter_init (&iter, &as_bson);
    if (!_mongocrypt_traverse_binary_in_bson (_collect_key_from_ciphertext,
-                                             &ctx->kb,
+                                             dctx,
                                              TRAVERSE_MATCH_CIPHERTEXT,
                                              &iter,
                                              ctx->status)) {
@@ -19,6 +19,7 @@
 #include "mongocrypt-ctx-private.h"
 #include "mongocrypt-key-broker-private.h"
 #include "mongocrypt-marking-private.h"
+#include "mongocrypt-parallel-private.h"
 #include "mongocrypt-traverse-util-private.h"
 #include "mc-tokens-private.h"
 
@@ -172,6 +173,139 @@ _fle2_append_encryptionInformation (bson_t *dst,
    return true;
 }
 
+static bson_t *
+generate_delete_tokens (_mongocrypt_key_broker_t *kb,
+                        mc_EncryptedFieldConfig_t *efc,
+                        mongocrypt_status_t *status);
+
+/* _fle2_build_encryptionInformation sets @out to a document containing only
+ * 'encryptionInformation', with 'deleteTokens' if @with_deleteTokens. */
+static bool
+_fle2_build_encryptionInformation (mongocrypt_ctx_t *ctx,
+                                   bool with_deleteTokens,
+                                   _mongocrypt_buffer_t *out)
+{
+   _mongocrypt_ctx_encrypt_t *ectx = (_mongocrypt_ctx_encrypt_t *) ctx;
+   bson_t encrypted_field_config_bson;
+   bson_t *deleteTokens = NULL;
+   bson_t doc = BSON_INITIALIZER;
+
+   if (!_mongocrypt_buffer_to_bson (&ectx->encrypted_field_config,
+                                    &encrypted_field_config_bson)) {
+      return _mongocrypt_ctx_fail_w_msg (
+         ctx, "malformed bson in encrypted_field_config_bson");
+   }
+
+   if (with_deleteTokens) {
+      deleteTokens =
+         generate_delete_tokens (&ctx->kb, &ectx->efc, ctx->status);
+      if (!deleteTokens) {
+         return _mongocrypt_ctx_fail (ctx);
+      }
+   }
+
+   if (!_fle2_append_encryptionInformation (&doc,
+                                            ectx->ns,
+                                            &encrypted_field_config_bson,
+                                            deleteTokens,
+                                            ectx->coll_name,
+                                            ctx->status)) {
+      bson_destroy (&doc);
+      bson_destroy (deleteTokens);
+      return _mongocrypt_ctx_fail (ctx);
+   }
+   bson_destroy (deleteTokens);
+
+   _mongocrypt_buffer_steal_from_bson (out, &doc);
+   return true;
+}
+
+/* _fle2_append_cached_encryptionInformation appends 'encryptionInformation'
+ * to @dst, with 'deleteTokens' if @with_deleteTokens. The document is built
+ * once per namespace and reused until the encryptedFieldConfig changes. The
+ * 'deleteTokens' only depend on the keys named by the encryptedFieldConfig,
+ * whose material never changes. */
+static bool
+_fle2_append_cached_encryptionInformation (mongocrypt_ctx_t *ctx,
+                                           bson_t *dst,
+                                           bool with_deleteTokens)
+{
+   _mongocrypt_ctx_encrypt_t *ectx = (_mongocrypt_ctx_encrypt_t *) ctx;
+   _mongocrypt_cache_t *cache = &ctx->crypt->cache_encryption_information;
+   _mongocrypt_cache_encryption_information_value_t *value = NULL;
+   _mongocrypt_buffer_t ei = {0}, ei_with_delete_tokens = {0};
+   const _mongocrypt_buffer_t *found = NULL;
+   bson_t found_bson;
+   bool ret = false;
+
+   if (!_mongocrypt_cache_get (cache, ectx->ns, (void **) &value)) {
+      return _mongocrypt_ctx_fail_w_msg (
+         ctx, "failed to retrieve from encryptionInformation cache");
+   }
+
+   if (value && 0 != _mongocrypt_buffer_cmp (&value->encrypted_field_config,
+                                             &ectx->encrypted_field_config)) {
+      /* Built from a different encryptedFieldConfig. */
+      _mongocrypt_cache_encryption_information_value_destroy (value);
+      value = NULL;
+   }
+
+   if (value) {
+      if (!with_deleteTokens) {
+         found = &value->encryption_information;
+      } else if (!_mongocrypt_buffer_empty (
+                    &value->encryption_information_with_delete_tokens)) {
+         found = &value->encryption_information_with_delete_tokens;
+      }
+   }
+
+   if (!found) {
+      _mongocrypt_cache_encryption_information_value_t *built;
+
+      if (value) {
+         _mongocrypt_buffer_set_to (&value->encryption_information, &ei);
+      } else if (!_fle2_build_encryptionInformation (ctx, false, &ei)) {
+         goto fail;
+      }
+
+      if (with_deleteTokens &&
+          !_fle2_build_encryptionInformation (
+             ctx, true, &ei_with_delete_tokens)) {
+         goto fail;
+      }
+
+      built = _mongocrypt_cache_encryption_information_value_new (
+         &ectx->encrypted_field_config,
+         &ei,
+         with_deleteTokens ? &ei_with_delete_tokens : NULL);
+      _mongocrypt_cache_encryption_information_value_destroy (value);
+      value = built;
+
+      if (!_mongocrypt_cache_add_copy (cache, ectx->ns, value, ctx->status)) {
+         _mongocrypt_ctx_fail (ctx);
+         goto fail;
+      }
+
+      found = with_deleteTokens
+                 ? &value->encryption_information_with_delete_tokens
+                 : &value->encryption_information;
+   }
+
+   if (!_mongocrypt_buffer_to_bson (found, &found_bson) ||
+       !bson_concat (dst, &found_bson)) {
+      _mongocrypt_ctx_fail_w_msg (ctx,
+                                  "unable to append 'encryptionInformation'");
+      goto fail;
+   }
+
+   ret = true;
+fail:
+   _mongocrypt_buffer_cleanup (&ei);
+   _mongocrypt_buffer_cleanup (&ei_with_delete_tokens);
+   _mongocrypt_cache_encryption_information_value_destroy (value);
+   return ret;
+}
+
 /* Construct the list collections command to send. */
 static bool
 _mongo_op_collinfo (mongocrypt_ctx_t *ctx, mongocrypt_binary_t *out)
@@ -404,22 +538,58 @@ _fle2_collect_keys_for_compact (mongocrypt_ctx_t *ctx)
    return true;
 }
 
+/* Caches @collinfo for the namespace. A collection that needs no encryption is
+ * cached as an empty document, with its own expiration. */
+static bool
+_cache_collinfo (mongocrypt_ctx_t *ctx, const bson_t *collinfo)
+{
+   _mongocrypt_ctx_encrypt_t *ectx = (_mongocrypt_ctx_encrypt_t *) ctx;
+
+   if (!_mongocrypt_cache_collinfo_add (
+          &ctx->crypt->cache_collinfo,
+          ectx->ns,
+          collinfo,
+          ctx->crypt->opts.plaintext_collinfo_expiration_ms,
+          ctx->status)) {
+      return _mongocrypt_ctx_fail (ctx);
+   }
+   return true;
+}
+
+
+/* Returns true if the namespace is known to need no encryption, from the
+ * collinfo fed or cached for it. Query analysis can then be skipped. */
+static bool
+_ns_is_plaintext (mongocrypt_ctx_t *ctx)
+{
+   _mongocrypt_ctx_encrypt_t *ectx = (_mongocrypt_ctx_encrypt_t *) ctx;
+   bson_t schema;
+
+   if (ctx->crypt->opts.plaintext_collinfo_expiration_ms == 0 ||
+       ectx->used_local_schema ||
+       !_mongocrypt_buffer_empty (&ectx->encrypted_field_config)) {
+      return false;
+   }
+   if (_mongocrypt_buffer_empty (&ectx->schema)) {
+      return true;
+   }
+   return _mongocrypt_buffer_to_bson (&ectx->schema, &schema) &&
+          bson_empty (&schema);
+}
+
+
 static bool
 _mongo_feed_collinfo (mongocrypt_ctx_t *ctx, mongocrypt_binary_t *in)
 {
    bson_t as_bson;
 
-   _mongocrypt_ctx_encrypt_t *ectx;
-
-   ectx = (_mongocrypt_ctx_encrypt_t *) ctx;
    if (!bson_init_static (&as_bson, in->data, in->len)) {
       return _mongocrypt_ctx_fail_w_msg (ctx, "BSON malformed");
    }
 
    /* Cache the received collinfo. */
-   if (!_mongocrypt_cache_add_copy (
-          &ctx->crypt->cache_collinfo, ectx->ns, &as_bson, ctx->status)) {
-      return _mongocrypt_ctx_fail (ctx);
+   if (!_cache_collinfo (ctx, &as_bson)) {
+      return false;
    }
 
    if (!_set_schema_from_collinfo (ctx, &as_bson)) {
@@ -430,7 +600,7 @@ _mongo_feed_collinfo (mongocrypt_ctx_t *ctx, mongocrypt_binary_t *in)
 }
 
 static bool
-_try_run_csfle_marking (mongocrypt_ctx_t *ctx);
+_try_run_local_marking (mongocrypt_ctx_t *ctx);
 
 static bool
 _mongo_done_collinfo (mongocrypt_ctx_t *ctx)
@@ -442,16 +612,19 @@ _mongo_done_collinfo (mongocrypt_ctx_t *ctx)
       bson_t empty_collinfo = BSON_INITIALIZER;
 
       /* If no collinfo was fed, cache an empty collinfo. */
-      if (!_mongocrypt_cache_add_copy (&ctx->crypt->cache_collinfo,
-                                       ectx->ns,
-                                       &empty_collinfo,
-                                       ctx->status)) {
+      if (!_cache_collinfo (ctx, &empty_collinfo)) {
          bson_destroy (&empty_collinfo);
-         return _mongocrypt_ctx_fail (ctx);
+         return false;
       }
       bson_destroy (&empty_collinfo);
    }
 
+   if (_ns_is_plaintext (ctx)) {
+      ctx->nothing_to_do = true;
+      ctx->state = MONGOCRYPT_CTX_READY;
+      return true;
+   }
+
    if (!_fle2_collect_keys_for_deleteTokens (ctx)) {
       return false;
    }
@@ -467,7 +640,7 @@ _mongo_done_collinfo (mongocrypt_ctx_t *ctx)
       return _mongocrypt_ctx_state_from_key_broker (ctx);
    }
    ectx->parent.state = MONGOCRYPT_CTX_NEED_MONGO_MARKINGS;
-   return _try_run_csfle_marking (ctx);
+   return _try_run_local_marking (ctx);
 }
 
 
@@ -475,8 +648,7 @@ static bool
 _fle2_mongo_op_markings (mongocrypt_ctx_t *ctx, bson_t *out)
 {
    _mongocrypt_ctx_encrypt_t *ectx;
-   bson_t cmd_bson = BSON_INITIALIZER,
-          encrypted_field_config_bson = BSON_INITIALIZER;
+   bson_t cmd_bson = BSON_INITIALIZER;
    ectx = (_mongocrypt_ctx_encrypt_t *) ctx;
 
    BSON_ASSERT (ctx->state == MONGOCRYPT_CTX_NEED_MONGO_MARKINGS);
@@ -488,19 +660,9 @@ _fle2_mongo_op_markings (mongocrypt_ctx_t *ctx, bson_t *out)
    }
    bson_copy_to (&cmd_bson, out);
 
-   if (!_mongocrypt_buffer_to_bson (&ectx->encrypted_field_config,
-                                    &encrypted_field_config_bson)) {
-      return _mongocrypt_ctx_fail_w_msg (
-         ctx, "unable to convert encrypted_field_config to BSON");
-   }
-
-   if (!_fle2_append_encryptionInformation (out,
-                                            ectx->ns,
-                                            &encrypted_field_config_bson,
-                                            NULL /* deleteTokens */,
-                                            ectx->coll_name,
-                                            ctx->status)) {
-      return _mongocrypt_ctx_fail (ctx);
+   if (!_fle2_append_cached_encryptionInformation (
+          ctx, out, false /* deleteTokens */)) {
+      return false;
    }
 
    return true;
@@ -583,11 +745,14 @@ _collect_key_from_marking (void *ctx,
                            _mongocrypt_buffer_t *in,
                            mongocrypt_status_t *status)
 {
+   _mongocrypt_ctx_encrypt_t *ectx;
    _mongocrypt_marking_t marking;
    _mongocrypt_key_broker_t *kb;
    bool res;
 
-   kb = (_mongocrypt_key_broker_t *) ctx;
+   ectx = (_mongocrypt_ctx_encrypt_t *) ctx;
+   kb = &ectx->parent.kb;
+   ectx->num_markings++;
 
    if (!_mongocrypt_marking_parse_unowned (in, &marking, status)) {
       _mongocrypt_marking_cleanup (&marking);
@@ -617,20 +782,16 @@ _collect_key_from_marking (void *ctx,
 }
 
 
+/* Consumes a query analysis reply. */
 static bool
-_mongo_feed_markings (mongocrypt_ctx_t *ctx, mongocrypt_binary_t *in)
+_mongo_feed_markings_reply (mongocrypt_ctx_t *ctx, const bson_t *as_bson)
 {
    /* Find keys. */
-   bson_t as_bson;
    bson_iter_t iter;
    _mongocrypt_ctx_encrypt_t *ectx;
 
    ectx = (_mongocrypt_ctx_encrypt_t *) ctx;
-   if (!_mongocrypt_binary_to_bson (in, &as_bson)) {
-      return _mongocrypt_ctx_fail_w_msg (ctx, "malformed BSON");
-   }
-
-   if (bson_iter_init_find (&iter, &as_bson, "schemaRequiresEncryption") &&
+   if (bson_iter_init_find (&iter, as_bson, "schemaRequiresEncryption") &&
        !bson_iter_as_bool (&iter)) {
       /* TODO: update cache: this schema does not require encryption. */
 
@@ -653,12 +814,12 @@ _mongo_feed_markings (mongocrypt_ctx_t *ctx, mongocrypt_binary_t *in)
       }
    }
 
-   if (bson_iter_init_find (&iter, &as_bson, "hasEncryptedPlaceholders") &&
+   if (bson_iter_init_find (&iter, as_bson, "hasEncryptedPlaceholders") &&
        !bson_iter_as_bool (&iter)) {
       return true;
    }
 
-   if (!bson_iter_init_find (&iter, &as_bson, "result")) {
+   if (!bson_iter_init_find (&iter, as_bson, "result")) {
       return _mongocrypt_ctx_fail_w_msg (ctx, "malformed marking, no 'result'");
    }
 
@@ -672,7 +833,7 @@ _mongo_feed_markings (mongocrypt_ctx_t *ctx, mongocrypt_binary_t *in)
          ctx, "malformed marking, could not recurse into 'result'");
    }
    if (!_mongocrypt_traverse_binary_in_bson (_collect_key_from_marking,
-                                             (void *) &ctx->kb,
+                                             (void *) ectx,
                                              TRAVERSE_MATCH_MARKING,
                                              &iter,
                                              ctx->status)) {
@@ -683,6 +844,38 @@ _mongo_feed_markings (mongocrypt_ctx_t *ctx, mongocrypt_binary_t *in)
 }
 
 
+static bool
+_mongo_feed_markings (mongocrypt_ctx_t *ctx, mongocrypt_binary_t *in)
+{
+   bson_t as_bson;
+   _mongocrypt_ctx_encrypt_t *ectx;
+
+   ectx = (_mongocrypt_ctx_encrypt_t *) ctx;
+   if (!_mongocrypt_binary_to_bson (in, &as_bson)) {
+      return _mongocrypt_ctx_fail_w_msg (ctx, "malformed BSON");
+   }
+
+   if (!_mongo_feed_markings_reply (ctx, &as_bson)) {
+      return false;
+   }
+
+   /* Record the reply for commands that differ only in their values.
+    * mongocryptd_cmd is the command analyzed. */
+   if (ctx->crypt->opts.marking_cache_max_entries > 0 &&
+       !_mongocrypt_buffer_empty (&ectx->mongocryptd_cmd)) {
+      if (!_mongocrypt_cache_marking_plan_add (&ctx->crypt->cache_marking_plan,
+                                               ectx->ns,
+                                               &ectx->mongocryptd_cmd,
+                                               &as_bson,
+                                               ctx->status)) {
+         return _mongocrypt_ctx_fail (ctx);
+      }
+   }
+
+   return true;
+}
+
+
 static bool
 _mongo_done_markings (mongocrypt_ctx_t *ctx)
 {
@@ -730,13 +923,20 @@ _try_run_csfle_marking (mongocrypt_ctx_t *ctx)
    }
 
    _mcr_csfle_v1_vtable csfle = ctx->crypt->csfle;
-   mongo_csfle_v1_lib *csfle_lib = ctx->crypt->csfle_lib;
-   BSON_ASSERT (csfle_lib);
+   BSON_ASSERT (ctx->crypt->csfle_lib);
    bool okay = false;
 
-   // Obtain the command for markings
+   // Obtain the command for markings. Keep it in mongocryptd_cmd, so the
+   // reply can be recorded in the marking cache.
    bson_t cmd = BSON_INITIALIZER;
-   if (!_create_markings_cmd_bson (ctx, &cmd)) {
+   mongocrypt_binary_t cmd_bin;
+   bson_t cmd_view;
+   if (!_mongo_op_markings (ctx, &cmd_bin)) {
+      goto fail_create_cmd;
+   }
+   if (!_mongocrypt_binary_to_bson (&cmd_bin, &cmd_view) ||
+       !bson_concat (&cmd, &cmd_view)) {
+      _mongocrypt_ctx_fail_w_msg (ctx, "invalid BSON markings command");
       goto fail_create_cmd;
    }
 
@@ -765,8 +965,10 @@ _try_run_csfle_marking (mongocrypt_ctx_t *ctx)
    mongo_csfle_v1_status *status = csfle.status_create ();
    BSON_ASSERT (status);
 
+   /* An analyzer that reported an error is not returned to the pool. */
+   bool analyzed = false;
    mongo_csfle_v1_query_analyzer *qa =
-      csfle.query_analyzer_create (csfle_lib, status);
+      _mongocrypt_csfle_query_analyzer_acquire (ctx->crypt, status);
    CHECK_CSFLE_ERROR ("query_analyzer_create", fail_qa_create);
 
    uint32_t marked_bson_len = 0;
@@ -777,6 +979,7 @@ _try_run_csfle_marking (mongocrypt_ctx_t *ctx)
                                                &marked_bson_len,
                                                status);
    CHECK_CSFLE_ERROR ("analyze_query", fail_analyze_query);
+   analyzed = true;
 
    // Copy out the marked document.
    mongocrypt_binary_t *marked =
@@ -797,7 +1000,7 @@ fail_feed_markings:
    mongocrypt_binary_destroy (marked);
    csfle.bson_free (marked_bson);
 fail_analyze_query:
-   csfle.query_analyzer_destroy (qa);
+   _mongocrypt_csfle_query_analyzer_release (ctx->crypt, qa, analyzed);
 fail_qa_create:
    csfle.status_destroy (status);
 fail_create_cmd:
@@ -806,6 +1009,111 @@ fail_create_cmd:
 }
 
 
+/**
+ * @brief Attempt to generate markings from a query analysis reply recorded in
+ * the marking cache.
+ *
+ * @param ctx A context which has state NEED_MONGO_MARKINGS
+ * @param hit Set to true if markings were generated.
+ * @return true On success
+ * @return false On error.
+ *
+ * On a hit, the state is changed via @ref _mongo_done_markings().
+ */
+static bool
+_try_marking_cache (mongocrypt_ctx_t *ctx, bool *hit)
+{
+   _mongocrypt_ctx_encrypt_t *ectx = (_mongocrypt_ctx_encrypt_t *) ctx;
+   mongocrypt_binary_t cmd_bin;
+   bson_t reply;
+   bool okay;
+
+   *hit = false;
+   if (ctx->crypt->opts.marking_cache_max_entries == 0) {
+      return true;
+   }
+
+   if (!_mongo_op_markings (ctx, &cmd_bin)) {
+      return false;
+   }
+
+   if (!_mongocrypt_cache_marking_plan_get (&ctx->crypt->cache_marking_plan,
+                                            ectx->ns,
+                                            &ectx->mongocryptd_cmd,
+                                            hit,
+                                            &reply,
+                                            ctx->status)) {
+      return _mongocrypt_ctx_fail (ctx);
+   }
+   if (!*hit) {
+      return true;
+   }
+
+   okay = _mongo_feed_markings_reply (ctx, &reply) &&
+          _mongo_done_markings (ctx);
+   bson_destroy (&reply);
+   return okay;
+}
+
+
+/**
+ * @brief Attempt to generate markings without returning to the driver: from
+ * the marking cache, or else with the csfle library.
+ *
+ * @param ctx A context which has state NEED_MONGO_MARKINGS
+ * @return true On success
+ * @return false On error.
+ */
+static bool
+_try_run_local_marking (mongocrypt_ctx_t *ctx)
+{
+   bool hit;
+
+   if (!_try_marking_cache (ctx, &hit)) {
+      return false;
+   }
+   if (hit) {
+      return true;
+   }
+   return _try_run_csfle_marking (ctx);
+}
+
+
+static bool
+_ciphertext_to_bson_value (_mongocrypt_ciphertext_t *ciphertext,
+                           bson_value_t *out,
+                           mongocrypt_status_t *status)
+{
+   _mongocrypt_buffer_t serialized_ciphertext = {0};
+
+   BSON_ASSERT (out);
+
+   if ((ciphertext->blob_subtype == MC_SUBTYPE_FLE2InsertUpdatePayload) ||
+       (ciphertext->blob_subtype == MC_SUBTYPE_FLE2FindEqualityPayload)) {
+      /* ciphertext_data is already a BSON object, just need to prepend
+       * blob_subtype */
+      _mongocrypt_buffer_init_size (&serialized_ciphertext,
+                                    ciphertext->data.len + 1);
+      serialized_ciphertext.data[0] = ciphertext->blob_subtype;
+      memcpy (serialized_ciphertext.data + 1,
+              ciphertext->data.data,
+              ciphertext->data.len);
+
+   } else if (!_mongocrypt_serialize_ciphertext (ciphertext,
+                                                 &serialized_ciphertext)) {
+      CLIENT_ERR ("malformed ciphertext");
+      return false;
+   };
+
+   /* ownership of serialized_ciphertext is transferred to caller. */
+   out->value_type = BSON_TYPE_BINARY;
+   out->value.v_binary.data = serialized_ciphertext.data;
+   out->value.v_binary.data_len = serialized_ciphertext.len;
+   out->value.v_binary.subtype = (bson_subtype_t) 6;
+   return true;
+}
+
+
 static bool
 _marking_to_bson_value (void *ctx,
                         _mongocrypt_marking_t *marking,
@@ -813,7 +1121,6 @@ _marking_to_bson_value (void *ctx,
                         mongocrypt_status_t *status)
 {
    _mongocrypt_ciphertext_t ciphertext;
-   _mongocrypt_buffer_t serialized_ciphertext = {0};
    bool ret = false;
 
    BSON_ASSERT (out);
@@ -824,48 +1131,236 @@ _marking_to_bson_value (void *ctx,
       goto fail;
    }
 
-   if ((ciphertext.blob_subtype == MC_SUBTYPE_FLE2InsertUpdatePayload) ||
-       (ciphertext.blob_subtype == MC_SUBTYPE_FLE2FindEqualityPayload)) {
-      /* ciphertext_data is already a BSON object, just need to prepend
-       * blob_subtype */
-      _mongocrypt_buffer_init_size (&serialized_ciphertext,
-                                    ciphertext.data.len + 1);
-      serialized_ciphertext.data[0] = ciphertext.blob_subtype;
-      memcpy (serialized_ciphertext.data + 1,
-              ciphertext.data.data,
-              ciphertext.data.len);
+   if (!_ciphertext_to_bson_value (&ciphertext, out, status)) {
+      goto fail;
+   }
+
+   ret = true;
+
+fail:
+   _mongocrypt_ciphertext_cleanup (&ciphertext);
+   return ret;
+}
+
+
+static bool
+_replace_marking_with_ciphertext (void *ctx,
+                                  _mongocrypt_buffer_t *in,
+                                  bson_value_t *out,
+                                  mongocrypt_status_t *status)
+{
+   _mongocrypt_marking_t marking;
+   bool ret;
+
+   BSON_ASSERT (in);
+
+   memset (&marking, 0, sizeof (marking));
+
+   if (!_mongocrypt_marking_parse_unowned (in, &marking, status)) {
+      _mongocrypt_marking_cleanup (&marking);
+      return false;
+   }
+
+   ret = _marking_to_bson_value (ctx, &marking, out, status);
+   _mongocrypt_marking_cleanup (&marking);
+   return ret;
+}
+
+
+/* Counts the markings replaced by _fle2_transform_markings. */
+typedef struct {
+   _mongocrypt_key_broker_t *kb;
+   uint32_t replaced;
+} _replace_markings_t;
+
+
+static bool
+_replace_marking_at_path (void *ctx,
+                          _mongocrypt_buffer_t *in,
+                          bson_value_t *out,
+                          mongocrypt_status_t *status)
+{
+   _replace_markings_t *replace = ctx;
+
+   replace->replaced++;
+   return _replace_marking_with_ciphertext (replace->kb, in, out, status);
+}
+
+
+/* Replaces the markings of @as_bson with ciphertexts in @out. For an insert,
+ * only the encrypted field paths of the inserted documents are traversed. If
+ * that misses a marking, the whole command is traversed instead. */
+static bool
+_fle2_transform_markings (mongocrypt_ctx_t *ctx, bson_t *as_bson, bson_t *out)
+{
+   _mongocrypt_ctx_encrypt_t *ectx = (_mongocrypt_ctx_encrypt_t *) ctx;
+   const char *command_name;
+   bson_iter_t iter;
+
+   command_name = get_command_name (&ectx->original_cmd, ctx->status);
+   if (!command_name) {
+      return false;
+   }
+
+   if (0 == strcmp (command_name, "insert") && ectx->efc.fields) {
+      _mongocrypt_path_trie_t *paths = _mongocrypt_path_trie_new ();
+      _replace_markings_t replace = {&ctx->kb, 0};
+      mc_EncryptedField_t *field;
+      bool ok;
+
+      for (field = ectx->efc.fields; field; field = field->next) {
+         char *path = bson_strdup_printf ("documents.%s", field->path);
+
+         _mongocrypt_path_trie_add (paths, path);
+         bson_free (path);
+      }
+
+      bson_iter_init (&iter, as_bson);
+      ok = _mongocrypt_transform_binary_in_bson_at_paths (
+         _replace_marking_at_path,
+         &replace,
+         TRAVERSE_MATCH_MARKING,
+         paths,
+         &iter,
+         out,
+         ctx->status);
+      _mongocrypt_path_trie_destroy (paths);
+      if (!ok) {
+         return false;
+      }
+      if (replace.replaced == ectx->num_markings) {
+         return true;
+      }
+      bson_reinit (out);
+   }
+
+   bson_iter_init (&iter, as_bson);
+   return _mongocrypt_transform_binary_in_bson (
+      _replace_marking_with_ciphertext,
+      &ctx->kb,
+      TRAVERSE_MATCH_MARKING,
+      &iter,
+      out,
+      ctx->status);
+}
+
+
+/* The work to encrypt one FLE1 marking, for parallel finalize. */
+typedef struct {
+   _mongocrypt_ciphertext_t ciphertext;
+   _mongocrypt_fle1_job_t work;
+   mongocrypt_status_t *status;
+   bool ok;
+} _encrypt_job_t;
+
+
+/* The FLE1 markings of a command or batch, in traversal order. */
+typedef struct {
+   _mongocrypt_key_broker_t *kb;
+   _encrypt_job_t *jobs;
+   uint32_t len;
+   uint32_t cap;
+   /* The next job to consume when building the output. */
+   uint32_t next;
+} _encrypt_jobs_t;
+
+
+static bool
+_encrypt_jobs_add (_encrypt_jobs_t *jobs,
+                   _mongocrypt_marking_t *marking,
+                   mongocrypt_status_t *status)
+{
+   _encrypt_job_t *job;
+
+   if (jobs->len == jobs->cap) {
+      jobs->cap = jobs->cap ? jobs->cap * 2 : 8;
+      jobs->jobs = bson_realloc (jobs->jobs, sizeof (*job) * jobs->cap);
+   }
+   job = &jobs->jobs[jobs->len++];
+   memset (job, 0, sizeof (*job));
+   _mongocrypt_ciphertext_init (&job->ciphertext);
+   job->status = mongocrypt_status_new ();
+   return _mongocrypt_fle1_job_prepare (
+      jobs->kb, marking, &job->ciphertext, &job->work, status);
+}
+
+
+static void
+_run_encrypt_job (void *task_ctx, uint32_t index)
+{
+   _encrypt_jobs_t *jobs = task_ctx;
+   _encrypt_job_t *job = &jobs->jobs[index];
+
+   job->ok = _mongocrypt_fle1_job_run (
+      jobs->kb->crypt->crypto, &job->ciphertext, &job->work, job->status);
+}
+
+
+static bool
+_encrypt_jobs_next_value (_encrypt_jobs_t *jobs,
+                          bson_value_t *out,
+                          mongocrypt_status_t *status)
+{
+   _encrypt_job_t *job;
+
+   BSON_ASSERT (jobs->next < jobs->len);
+   job = &jobs->jobs[jobs->next++];
+   if (!job->ok) {
+      _mongocrypt_status_copy_to (job->status, status);
+      return false;
+   }
+   return _ciphertext_to_bson_value (&job->ciphertext, out, status);
+}
+
+
+static void
+_encrypt_jobs_cleanup (_encrypt_jobs_t *jobs)
+{
+   uint32_t i;
+
+   for (i = 0; i < jobs->len; i++) {
+      _mongocrypt_ciphertext_cleanup (&jobs->jobs[i].ciphertext);
+      _mongocrypt_fle1_job_cleanup (&jobs->jobs[i].work);
+      mongocrypt_status_destroy (jobs->jobs[i].status);
+   }
+   bson_free (jobs->jobs);
+}
 
-   } else if (!_mongocrypt_serialize_ciphertext (&ciphertext,
-                                                 &serialized_ciphertext)) {
-      CLIENT_ERR ("malformed ciphertext");
-      goto fail;
-   };
 
-   /* ownership of serialized_ciphertext is transferred to caller. */
-   out->value_type = BSON_TYPE_BINARY;
-   out->value.v_binary.data = serialized_ciphertext.data;
-   out->value.v_binary.data_len = serialized_ciphertext.len;
-   out->value.v_binary.subtype = (bson_subtype_t) 6;
+static bool
+_collect_encrypt_job (void *ctx,
+                      _mongocrypt_buffer_t *in,
+                      mongocrypt_status_t *status)
+{
+   _mongocrypt_marking_t marking;
+   bool ret = true;
 
-   ret = true;
+   memset (&marking, 0, sizeof (marking));
 
-fail:
-   _mongocrypt_ciphertext_cleanup (&ciphertext);
+   if (!_mongocrypt_marking_parse_unowned (in, &marking, status)) {
+      _mongocrypt_marking_cleanup (&marking);
+      return false;
+   }
+
+   /* FLE2 markings are encrypted when building the output. */
+   if (marking.type != MONGOCRYPT_MARKING_FLE2_ENCRYPTION) {
+      ret = _encrypt_jobs_add (ctx, &marking, status);
+   }
+   _mongocrypt_marking_cleanup (&marking);
    return ret;
 }
 
 
 static bool
-_replace_marking_with_ciphertext (void *ctx,
+_replace_marking_with_job_result (void *ctx,
                                   _mongocrypt_buffer_t *in,
                                   bson_value_t *out,
                                   mongocrypt_status_t *status)
 {
+   _encrypt_jobs_t *jobs = ctx;
    _mongocrypt_marking_t marking;
    bool ret;
 
-   BSON_ASSERT (in);
-
    memset (&marking, 0, sizeof (marking));
 
    if (!_mongocrypt_marking_parse_unowned (in, &marking, status)) {
@@ -873,17 +1368,59 @@ _replace_marking_with_ciphertext (void *ctx,
       return false;
    }
 
-   ret = _marking_to_bson_value (ctx, &marking, out, status);
+   if (marking.type == MONGOCRYPT_MARKING_FLE2_ENCRYPTION) {
+      ret = _marking_to_bson_value (jobs->kb, &marking, out, status);
+   } else {
+      ret = _encrypt_jobs_next_value (jobs, out, status);
+   }
    _mongocrypt_marking_cleanup (&marking);
    return ret;
 }
 
 
+/* Encrypts the FLE1 markings of @as_bson in parallel, then builds @out in a
+ * second traversal. */
+static bool
+_transform_parallel (mongocrypt_ctx_t *ctx, bson_t *as_bson, bson_t *out)
+{
+   _encrypt_jobs_t jobs = {0};
+   bson_iter_t iter;
+   bool ret = false;
+
+   jobs.kb = &ctx->kb;
+
+   bson_iter_init (&iter, as_bson);
+   if (!_mongocrypt_traverse_binary_in_bson (_collect_encrypt_job,
+                                             &jobs,
+                                             TRAVERSE_MATCH_MARKING,
+                                             &iter,
+                                             ctx->status)) {
+      goto fail;
+   }
+
+   _mongocrypt_parallel_for (ctx->crypt, jobs.len, _run_encrypt_job, &jobs);
+
+   bson_iter_init (&iter, as_bson);
+   if (!_mongocrypt_transform_binary_in_bson (_replace_marking_with_job_result,
+                                              &jobs,
+                                              TRAVERSE_MATCH_MARKING,
+                                              &iter,
+                                              out,
+                                              ctx->status)) {
+      goto fail;
+   }
+
+   ret = true;
+fail:
+   _encrypt_jobs_cleanup (&jobs);
+   return ret;
+}
+
+
 /* generate_delete_tokens generates the 'deleteTokens' document to be appended
  * to 'encryptionInformation'. */
 static bson_t *
-generate_delete_tokens (_mongocrypt_crypto_t *crypto,
-                        _mongocrypt_key_broker_t *kb,
+generate_delete_tokens (_mongocrypt_key_broker_t *kb,
                         mc_EncryptedFieldConfig_t *efc,
                         mongocrypt_status_t *status)
 {
@@ -892,49 +1429,22 @@ generate_delete_tokens (_mongocrypt_crypto_t *crypto,
    mc_EncryptedField_t *ef;
 
    for (ef = efc->fields; ef != NULL; ef = ef->next) {
-      _mongocrypt_buffer_t IndexKey = {0};
-      _mongocrypt_buffer_t TokenKey = {0};
-      mc_ServerDataEncryptionLevel1Token_t *sdel1t = NULL;
-      mc_CollectionsLevel1Token_t *cl1t = NULL;
-      mc_ECOCToken_t *ecoc = NULL;
+      const mc_IndexKeyTokens_t *tokens;
+      const mc_ServerDataEncryptionLevel1Token_t *sdel1t;
+      const mc_ECOCToken_t *ecoc;
       bool loop_ok = false;
       /* deleteTokens are only necessary for indexed fields. */
       if (!ef->has_queries) {
          goto loop_continue;
       }
 
-      if (!_mongocrypt_key_broker_decrypted_key_by_id (
-             kb, &ef->keyId, &IndexKey)) {
-         _mongocrypt_key_broker_status (kb, status);
-         goto loop_fail;
-      }
-
-      /* Get the TokenKey from the last 32 bytes of IndexKey */
-      if (!_mongocrypt_buffer_from_subrange (&TokenKey,
-                                             &IndexKey,
-                                             IndexKey.len -
-                                                MONGOCRYPT_TOKEN_KEY_LEN,
-                                             MONGOCRYPT_TOKEN_KEY_LEN)) {
-         CLIENT_ERR (
-            "generate_delete_tokens unable to parse TokenKey from IndexKey");
-         goto loop_fail;
-      }
-
-      sdel1t =
-         mc_ServerDataEncryptionLevel1Token_new (crypto, &TokenKey, status);
-      if (!sdel1t) {
-         goto loop_fail;
-      }
-
-      cl1t = mc_CollectionsLevel1Token_new (crypto, &TokenKey, status);
-      if (!cl1t) {
-         goto loop_fail;
-      }
-
-      ecoc = mc_ECOCToken_new (crypto, cl1t, status);
-      if (!ecoc) {
+      tokens = _mongocrypt_key_broker_decrypted_key_tokens_by_id (
+         kb, &ef->keyId, status);
+      if (!tokens) {
          goto loop_fail;
       }
+      sdel1t = tokens->serverDataEncryptionLevel1Token;
+      ecoc = tokens->ecocToken;
 
       bson_t field_bson;
       if (!BSON_APPEND_DOCUMENT_BEGIN (out, ef->path, &field_bson)) {
@@ -971,11 +1481,6 @@ generate_delete_tokens (_mongocrypt_crypto_t *crypto,
    loop_continue:
       loop_ok = true;
    loop_fail:
-      _mongocrypt_buffer_cleanup (&IndexKey);
-      _mongocrypt_buffer_cleanup (&TokenKey);
-      mc_ServerDataEncryptionLevel1Token_destroy (sdel1t);
-      mc_CollectionsLevel1Token_destroy (cl1t);
-      mc_ECOCToken_destroy (ecoc);
       if (!loop_ok) {
          goto fail;
       }
@@ -1069,8 +1574,7 @@ must_omit_encryptionInformation (const char *command_name,
 /* _fle2_append_compactionTokens appends compactionTokens if command_name is
  * "compactStructuredEncryptionData" */
 static bool
-_fle2_append_compactionTokens (_mongocrypt_crypto_t *crypto,
-                               _mongocrypt_key_broker_t *kb,
+_fle2_append_compactionTokens (_mongocrypt_key_broker_t *kb,
                                mc_EncryptedFieldConfig_t *efc,
                                const char *command_name,
                                bson_t *out,
@@ -1089,35 +1593,17 @@ _fle2_append_compactionTokens (_mongocrypt_crypto_t *crypto,
    mc_EncryptedField_t *ptr;
    for (ptr = efc->fields; ptr != NULL; ptr = ptr->next) {
       /* Append ECOC token. */
-      _mongocrypt_buffer_t key = {0};
-      _mongocrypt_buffer_t tokenkey = {0};
-      mc_CollectionsLevel1Token_t *cl1t = NULL;
-      mc_ECOCToken_t *ecoct = NULL;
+      const mc_IndexKeyTokens_t *tokens;
       bool ecoc_ok = false;
 
-      if (!_mongocrypt_key_broker_decrypted_key_by_id (kb, &ptr->keyId, &key)) {
-         _mongocrypt_key_broker_status (kb, status);
-         goto ecoc_fail;
-      }
-      /* The last 32 bytes of the user key are the token key. */
-      if (!_mongocrypt_buffer_from_subrange (&tokenkey,
-                                             &key,
-                                             key.len - MONGOCRYPT_TOKEN_KEY_LEN,
-                                             MONGOCRYPT_TOKEN_KEY_LEN)) {
-         CLIENT_ERR ("unable to get TokenKey from Data Encryption Key");
-         goto ecoc_fail;
-      }
-      cl1t = mc_CollectionsLevel1Token_new (crypto, &tokenkey, status);
-      if (!cl1t) {
+      tokens = _mongocrypt_key_broker_decrypted_key_tokens_by_id (
+         kb, &ptr->keyId, status);
+      if (!tokens) {
          goto ecoc_fail;
       }
 
-      ecoct = mc_ECOCToken_new (crypto, cl1t, status);
-      if (!ecoct) {
-         goto ecoc_fail;
-      }
-
-      const _mongocrypt_buffer_t *ecoct_buf = mc_ECOCToken_get (ecoct);
+      const _mongocrypt_buffer_t *ecoct_buf =
+         mc_ECOCToken_get (tokens->ecocToken);
 
       BSON_APPEND_BINARY (&result_compactionTokens,
                           ptr->path,
@@ -1127,9 +1613,6 @@ _fle2_append_compactionTokens (_mongocrypt_crypto_t *crypto,
 
       ecoc_ok = true;
    ecoc_fail:
-      mc_ECOCToken_destroy (ecoct);
-      mc_CollectionsLevel1Token_destroy (cl1t);
-      _mongocrypt_buffer_cleanup (&key);
       if (!ecoc_ok) {
          goto fail;
       }
@@ -1149,7 +1632,6 @@ _fle2_finalize (mongocrypt_ctx_t *ctx, mongocrypt_binary_t *out)
 {
    bson_t converted;
    _mongocrypt_ctx_encrypt_t *ectx;
-   bson_t encrypted_field_config_bson;
 
    ectx = (_mongocrypt_ctx_encrypt_t *) ctx;
 
@@ -1161,12 +1643,6 @@ _fle2_finalize (mongocrypt_ctx_t *ctx, mongocrypt_binary_t *out)
          ctx, "explicit encryption is not yet supported. See MONGOCRYPT-409.");
    }
 
-   if (!_mongocrypt_buffer_to_bson (&ectx->encrypted_field_config,
-                                    &encrypted_field_config_bson)) {
-      return _mongocrypt_ctx_fail_w_msg (
-         ctx, "malformed bson in encrypted_field_config_bson");
-   }
-
    /* If marked_cmd buffer is empty, there are no markings to encrypt. */
    if (_mongocrypt_buffer_empty (&ectx->marked_cmd)) {
       bson_t original_cmd_bson;
@@ -1182,21 +1658,14 @@ _fle2_finalize (mongocrypt_ctx_t *ctx, mongocrypt_binary_t *out)
       bson_copy_to (&original_cmd_bson, &converted);
    } else {
       bson_t as_bson;
-      bson_iter_t iter;
 
       if (!_mongocrypt_buffer_to_bson (&ectx->marked_cmd, &as_bson)) {
          return _mongocrypt_ctx_fail_w_msg (ctx, "malformed bson");
       }
 
-      bson_iter_init (&iter, &as_bson);
       bson_init (&converted);
-      if (!_mongocrypt_transform_binary_in_bson (
-             _replace_marking_with_ciphertext,
-             &ctx->kb,
-             TRAVERSE_MATCH_MARKING,
-             &iter,
-             &converted,
-             ctx->status)) {
+      if (!_fle2_transform_markings (ctx, &as_bson, &converted)) {
+         bson_destroy (&converted);
          return _mongocrypt_ctx_fail (ctx);
       }
    }
@@ -1222,16 +1691,6 @@ _fle2_finalize (mongocrypt_ctx_t *ctx, mongocrypt_binary_t *out)
       return _mongocrypt_ctx_fail (ctx);
    }
 
-   bson_t *deleteTokens = NULL;
-   if (command_needs_deleteTokens (command_name)) {
-      deleteTokens = generate_delete_tokens (
-         ctx->crypt->crypto, &ctx->kb, &ectx->efc, ctx->status);
-      if (!deleteTokens) {
-         bson_destroy (&converted);
-         return _mongocrypt_ctx_fail (ctx);
-      }
-   }
-
    moe_result result = must_omit_encryptionInformation (command_name, &converted, ctx->status);
    if (!result.ok) {
       return false;
@@ -1239,20 +1698,13 @@ _fle2_finalize (mongocrypt_ctx_t *ctx, mongocrypt_binary_t *out)
 
    /* Append a new 'encryptionInformation'. */
    if (!result.must_omit &&
-       !_fle2_append_encryptionInformation (&converted,
-                                            ectx->ns,
-                                            &encrypted_field_config_bson,
-                                            deleteTokens,
-                                            ectx->coll_name,
-                                            ctx->status)) {
+       !_fle2_append_cached_encryptionInformation (
+          ctx, &converted, command_needs_deleteTokens (command_name))) {
       bson_destroy (&converted);
-      bson_destroy (deleteTokens);
-      return _mongocrypt_ctx_fail (ctx);
+      return false;
    }
-   bson_destroy (deleteTokens);
 
-   if (!_fle2_append_compactionTokens (ctx->crypt->crypto,
-                                       &ctx->kb,
+   if (!_fle2_append_compactionTokens (&ctx->kb,
                                        &ectx->efc,
                                        command_name,
                                        &converted,
@@ -1351,6 +1803,9 @@ fail:
    return ret;
 }
 
+static bool
+_finalize_batch (mongocrypt_ctx_t *ctx, mongocrypt_binary_t *out);
+
 static bool
 _finalize (mongocrypt_ctx_t *ctx, mongocrypt_binary_t *out)
 {
@@ -1361,7 +1816,9 @@ _finalize (mongocrypt_ctx_t *ctx, mongocrypt_binary_t *out)
 
    ectx = (_mongocrypt_ctx_encrypt_t *) ctx;
 
-   if (context_uses_fle2 (ctx)) {
+   if (ectx->batch) {
+      return _finalize_batch (ctx, out);
+   } else if (context_uses_fle2 (ctx)) {
       return _fle2_finalize (ctx, out);
    } else if (ctx->opts.index_type.set) {
       return _fle2_finalize_explicit (ctx, out);
@@ -1377,15 +1834,21 @@ _finalize (mongocrypt_ctx_t *ctx, mongocrypt_binary_t *out)
          return _mongocrypt_ctx_fail_w_msg (ctx, "malformed bson");
       }
 
-      bson_iter_init (&iter, &as_bson);
       bson_init (&converted);
-      if (!_mongocrypt_transform_binary_in_bson (
-             _replace_marking_with_ciphertext,
-             &ctx->kb,
-             TRAVERSE_MATCH_MARKING,
-             &iter,
-             &converted,
-             ctx->status)) {
+      if (_mongocrypt_parallel_finalize_enabled (ctx->crypt)) {
+         res = _transform_parallel (ctx, &as_bson, &converted);
+      } else {
+         bson_iter_init (&iter, &as_bson);
+         res = _mongocrypt_transform_binary_in_bson (
+            _replace_marking_with_ciphertext,
+            &ctx->kb,
+            TRAVERSE_MATCH_MARKING,
+            &iter,
+            &converted,
+            ctx->status);
+      }
+      if (!res) {
+         bson_destroy (&converted);
          return _mongocrypt_ctx_fail (ctx);
       }
    } else {
@@ -1443,6 +1906,7 @@ static void
 _cleanup (mongocrypt_ctx_t *ctx)
 {
    _mongocrypt_ctx_encrypt_t *ectx;
+   uint32_t i;
 
    ectx = (_mongocrypt_ctx_encrypt_t *) ctx;
    bson_free (ectx->ns);
@@ -1456,6 +1920,10 @@ _cleanup (mongocrypt_ctx_t *ctx)
    _mongocrypt_buffer_cleanup (&ectx->marked_cmd);
    _mongocrypt_buffer_cleanup (&ectx->encrypted_cmd);
    mc_EncryptedFieldConfig_cleanup (&ectx->efc);
+   for (i = 0; i < ectx->batch_markings_len; i++) {
+      _mongocrypt_marking_cleanup (&ectx->batch_markings[i]);
+   }
+   bson_free (ectx->batch_markings);
 }
 
 
@@ -1561,9 +2029,15 @@ _try_schema_from_cache (mongocrypt_ctx_t *ctx)
 
    if (collinfo) {
       if (!_set_schema_from_collinfo (ctx, collinfo)) {
+         bson_destroy (collinfo);
          return _mongocrypt_ctx_fail (ctx);
       }
-      ctx->state = MONGOCRYPT_CTX_NEED_MONGO_MARKINGS;
+      if (_ns_is_plaintext (ctx)) {
+         ctx->nothing_to_do = true;
+         ctx->state = MONGOCRYPT_CTX_READY;
+      } else {
+         ctx->state = MONGOCRYPT_CTX_NEED_MONGO_MARKINGS;
+      }
    } else {
       /* we need to get it. */
       ctx->state = MONGOCRYPT_CTX_NEED_MONGO_COLLINFO;
@@ -1781,6 +2255,284 @@ mongocrypt_ctx_explicit_encrypt_init (mongocrypt_ctx_t *ctx,
    return _mongocrypt_ctx_state_from_key_broker (ctx);
 }
 
+
+/* Parse one batch element into a marking. An element is a document:
+ * { v: <value>, keyId: <UUID>, keyAltName: <string>, algorithm: <string> }
+ * Only 'v' is required. The other fields default to the context options.
+ * The marking views @elem, which must outlive it. */
+static bool
+_batch_element_to_marking (mongocrypt_ctx_t *ctx,
+                           bson_iter_t *elem,
+                           _mongocrypt_marking_t *marking)
+{
+   bson_iter_t iter;
+   bool has_v = false;
+   bool has_key = false;
+
+   _mongocrypt_marking_init (marking);
+   marking->algorithm = ctx->opts.algorithm;
+
+   if (!BSON_ITER_HOLDS_DOCUMENT (elem) || !bson_iter_recurse (elem, &iter)) {
+      return _mongocrypt_ctx_fail_w_msg (ctx,
+                                         "batch element must be a document");
+   }
+
+   while (bson_iter_next (&iter)) {
+      const char *field = bson_iter_key (&iter);
+
+      if (0 == strcmp (field, "v")) {
+         if (has_v) {
+            return _mongocrypt_ctx_fail_w_msg (
+               ctx, "batch element must contain 'v' only once");
+         }
+         memcpy (&marking->v_iter, &iter, sizeof (bson_iter_t));
+         has_v = true;
+      } else if (0 == strcmp (field, "keyId")) {
+         if (has_key) {
+            return _mongocrypt_ctx_fail_w_msg (
+               ctx, "batch element cannot have both keyId and keyAltName");
+         }
+         if (!_mongocrypt_buffer_from_uuid_iter (&marking->key_id, &iter)) {
+            return _mongocrypt_ctx_fail_w_msg (
+               ctx, "batch element keyId must be a UUID");
+         }
+         has_key = true;
+      } else if (0 == strcmp (field, "keyAltName")) {
+         if (has_key) {
+            return _mongocrypt_ctx_fail_w_msg (
+               ctx, "batch element cannot have both keyId and keyAltName");
+         }
+         if (!BSON_ITER_HOLDS_UTF8 (&iter)) {
+            return _mongocrypt_ctx_fail_w_msg (
+               ctx, "batch element keyAltName must be a string");
+         }
+         bson_value_copy (bson_iter_value (&iter), &marking->key_alt_name);
+         marking->type = MONGOCRYPT_MARKING_FLE1_BY_ALTNAME;
+         has_key = true;
+      } else if (0 == strcmp (field, "algorithm")) {
+         const char *algorithm;
+         uint32_t len;
+
+         if (!BSON_ITER_HOLDS_UTF8 (&iter)) {
+            return _mongocrypt_ctx_fail_w_msg (
+               ctx, "batch element algorithm must be a string");
+         }
+         algorithm = bson_iter_utf8 (&iter, &len);
+         if (len == ALGORITHM_DETERMINISTIC_LEN &&
+             0 == strncmp (algorithm, ALGORITHM_DETERMINISTIC, len)) {
+            marking->algorithm = MONGOCRYPT_ENCRYPTION_ALGORITHM_DETERMINISTIC;
+         } else if (len == ALGORITHM_RANDOM_LEN &&
+                    0 == strncmp (algorithm, ALGORITHM_RANDOM, len)) {
+            marking->algorithm = MONGOCRYPT_ENCRYPTION_ALGORITHM_RANDOM;
+         } else {
+            return _mongocrypt_ctx_fail_w_msg (ctx, "unsupported algorithm");
+         }
+      } else {
+         return _mongocrypt_ctx_fail_w_msg (
+            ctx, "unrecognized field in batch element");
+      }
+   }
+
+   if (!has_v) {
+      return _mongocrypt_ctx_fail_w_msg (ctx,
+                                         "batch element must contain 'v'");
+   }
+
+   if (!has_key) {
+      if (ctx->opts.key_alt_names) {
+         bson_value_copy (&ctx->opts.key_alt_names->value,
+                          &marking->key_alt_name);
+         marking->type = MONGOCRYPT_MARKING_FLE1_BY_ALTNAME;
+      } else if (!_mongocrypt_buffer_empty (&ctx->opts.key_id)) {
+         _mongocrypt_buffer_set_to (&ctx->opts.key_id, &marking->key_id);
+      } else {
+         return _mongocrypt_ctx_fail_w_msg (
+            ctx, "batch element requires keyId or keyAltName");
+      }
+   }
+
+   if (marking->algorithm == MONGOCRYPT_ENCRYPTION_ALGORITHM_NONE) {
+      return _mongocrypt_ctx_fail_w_msg (ctx,
+                                         "batch element requires algorithm");
+   }
+
+   if (!_permitted_for_encryption (
+          &marking->v_iter, marking->algorithm, ctx->status)) {
+      return _mongocrypt_ctx_fail (ctx);
+   }
+   return true;
+}
+
+
+static bool
+_finalize_batch (mongocrypt_ctx_t *ctx, mongocrypt_binary_t *out)
+{
+   _mongocrypt_ctx_encrypt_t *ectx = (_mongocrypt_ctx_encrypt_t *) ctx;
+   _encrypt_jobs_t jobs = {0};
+   bson_t converted, array;
+   uint32_t idx;
+
+   /* Look up keys first, so the cipher work can run in parallel. */
+   jobs.kb = &ctx->kb;
+   for (idx = 0; idx < ectx->batch_markings_len; idx++) {
+      if (!_encrypt_jobs_add (
+             &jobs, &ectx->batch_markings[idx], ctx->status)) {
+         _encrypt_jobs_cleanup (&jobs);
+         return _mongocrypt_ctx_fail (ctx);
+      }
+   }
+
+   _mongocrypt_parallel_for (ctx->crypt, jobs.len, _run_encrypt_job, &jobs);
+
+   bson_init (&converted);
+   BSON_ASSERT (
+      bson_append_array_begin (&converted, MONGOCRYPT_STR_AND_LEN ("v"), &array));
+   for (idx = 0; idx < jobs.len; idx++) {
+      bson_value_t value;
+      const char *key;
+      char buf[16];
+      size_t key_len;
+      bool res;
+
+      memset (&value, 0, sizeof (value));
+      res = _encrypt_jobs_next_value (&jobs, &value, ctx->status);
+      if (res) {
+         key_len = bson_uint32_to_string (idx, &key, buf, sizeof (buf));
+         res = bson_append_value (&array, key, (int) key_len, &value);
+      }
+      bson_value_destroy (&value);
+
+      if (!res) {
+         bson_destroy (&converted);
+         _encrypt_jobs_cleanup (&jobs);
+         if (mongocrypt_status_ok (ctx->status)) {
+            return _mongocrypt_ctx_fail_w_msg (ctx, "unable to append value");
+         }
+         return _mongocrypt_ctx_fail (ctx);
+      }
+   }
+   BSON_ASSERT (bson_append_array_end (&converted, &array));
+   _encrypt_jobs_cleanup (&jobs);
+
+   _mongocrypt_buffer_steal_from_bson (&ectx->encrypted_cmd, &converted);
+   _mongocrypt_buffer_to_binary (&ectx->encrypted_cmd, out);
+   ctx->state = MONGOCRYPT_CTX_DONE;
+   return true;
+}
+
+
+bool
+mongocrypt_ctx_explicit_encrypt_batch_init (mongocrypt_ctx_t *ctx,
+                                            mongocrypt_binary_t *msg)
+{
+   _mongocrypt_ctx_encrypt_t *ectx;
+   _mongocrypt_ctx_opts_spec_t opts_spec;
+   bson_t as_bson;
+   bson_iter_t iter, elem;
+   uint32_t count = 0;
+
+   if (!ctx) {
+      return false;
+   }
+   memset (&opts_spec, 0, sizeof (opts_spec));
+   opts_spec.key_descriptor = OPT_OPTIONAL;
+   opts_spec.algorithm = OPT_OPTIONAL;
+
+   if (!_mongocrypt_ctx_init (ctx, &opts_spec)) {
+      return false;
+   }
+
+   if (ctx->opts.index_type.set || ctx->opts.contention_factor.set ||
+       ctx->opts.query_type.set ||
+       !_mongocrypt_buffer_empty (&ctx->opts.index_key_id)) {
+      return _mongocrypt_ctx_fail_w_msg (
+         ctx, "batch encryption does not support FLE 2 options");
+   }
+
+   if (ctx->opts.key_alt_names) {
+      if (!_mongocrypt_buffer_empty (&ctx->opts.key_id)) {
+         return _mongocrypt_ctx_fail_w_msg (
+            ctx, "cannot have both key id and key alt name");
+      }
+      if (ctx->opts.key_alt_names->next) {
+         return _mongocrypt_ctx_fail_w_msg (
+            ctx, "must not specify multiple key alt names");
+      }
+   }
+
+   ectx = (_mongocrypt_ctx_encrypt_t *) ctx;
+   ctx->type = _MONGOCRYPT_TYPE_ENCRYPT;
+   ectx->explicit = true;
+   ectx->batch = true;
+   ctx->vtable.finalize = _finalize;
+   ctx->vtable.cleanup = _cleanup;
+
+   if (!msg || !msg->data) {
+      return _mongocrypt_ctx_fail_w_msg (
+         ctx, "msg required for explicit encryption");
+   }
+
+   _mongocrypt_buffer_copy_from_binary (&ectx->original_cmd, msg);
+   if (!_mongocrypt_buffer_to_bson (&ectx->original_cmd, &as_bson)) {
+      return _mongocrypt_ctx_fail_w_msg (ctx, "msg must be bson");
+   }
+
+   if (ctx->crypt->log.trace_enabled) {
+      char *cmd_val;
+      cmd_val = _mongocrypt_new_json_string_from_binary (msg);
+      _mongocrypt_log (&ctx->crypt->log,
+                       MONGOCRYPT_LOG_LEVEL_TRACE,
+                       "%s (%s=\"%s\")",
+                       BSON_FUNC,
+                       "msg",
+                       cmd_val);
+      bson_free (cmd_val);
+   }
+
+   if (!bson_iter_init_find (&iter, &as_bson, "v") ||
+       !BSON_ITER_HOLDS_ARRAY (&iter) || !bson_iter_recurse (&iter, &elem)) {
+      return _mongocrypt_ctx_fail_w_msg (
+         ctx, "invalid msg, must contain array 'v'");
+   }
+
+   iter = elem;
+   while (bson_iter_next (&iter)) {
+      count++;
+   }
+   if (count > 0) {
+      ectx->batch_markings =
+         bson_malloc0 (count * sizeof (*ectx->batch_markings));
+      BSON_ASSERT (ectx->batch_markings);
+   }
+
+   /* Parse every element once, keeping the markings for finalize, and request
+    * its key. The key broker deduplicates requests, so each key is fetched
+    * once for the whole batch. */
+   while (bson_iter_next (&elem)) {
+      _mongocrypt_marking_t *marking;
+      bool res;
+
+      BSON_ASSERT (ectx->batch_markings_len < count);
+      marking = &ectx->batch_markings[ectx->batch_markings_len++];
+      if (!_batch_element_to_marking (ctx, &elem, marking)) {
+         return false;
+      }
+      if (marking->type == MONGOCRYPT_MARKING_FLE1_BY_ALTNAME) {
+         res = _mongocrypt_key_broker_request_name (&ctx->kb,
+                                                    &marking->key_alt_name);
+      } else {
+         res = _mongocrypt_key_broker_request_id (&ctx->kb, &marking->key_id);
+      }
+      if (!res) {
+         _mongocrypt_key_broker_status (&ctx->kb, ctx->status);
+         return _mongocrypt_ctx_fail (ctx);
+      }
+   }
+
+   (void) _mongocrypt_key_broker_requests_done (&ctx->kb);
+   return _mongocrypt_ctx_state_from_key_broker (ctx);
+}
+
 static bool
 _check_cmd_for_auto_encrypt (mongocrypt_binary_t *cmd,
                              bool *bypass,
@@ -2077,7 +2829,7 @@ mongocrypt_ctx_encrypt_init (mongocrypt_ctx_t *ctx,
          return _mongocrypt_ctx_state_from_key_broker (ctx);
       }
       // We're ready for markings. Try to generate them ourself.
-      return _try_run_csfle_marking (ctx);
+      return _try_run_local_marking (ctx);
    } else {
       // Other state, return to caller.
       return true;
@@ -0,0 +1,141 @@
+/*
+ * Copyright 2022-present MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mongocrypt-ctx-private.h"
+
+static bool
+_finalize (mongocrypt_ctx_t *ctx, mongocrypt_binary_t *out)
+{
+   _mongocrypt_ctx_key_cache_snapshot_t *sctx;
+
+   BSON_ASSERT_PARAM (ctx);
+
+   sctx = (_mongocrypt_ctx_key_cache_snapshot_t *) ctx;
+   _mongocrypt_buffer_to_binary (&sctx->snapshot, out);
+   ctx->state = MONGOCRYPT_CTX_DONE;
+   return true;
+}
+
+
+static void
+_cleanup (mongocrypt_ctx_t *ctx)
+{
+   _mongocrypt_ctx_key_cache_snapshot_t *sctx;
+
+   if (!ctx) {
+      return;
+   }
+
+   sctx = (_mongocrypt_ctx_key_cache_snapshot_t *) ctx;
+   _mongocrypt_buffer_cleanup (&sctx->snapshot);
+}
+
+
+/* Common initialization of export and import contexts. */
+static bool
+_init (mongocrypt_ctx_t *ctx,
+       _mongocrypt_ctx_type_t type,
+       mongocrypt_binary_t *kek,
+       _mongocrypt_buffer_t *kek_buf)
+{
+   _mongocrypt_ctx_opts_spec_t opts_spec;
+
+   memset (&opts_spec, 0, sizeof (opts_spec));
+   if (!_mongocrypt_ctx_init (ctx, &opts_spec)) {
+      return false;
+   }
+
+   ctx->type = type;
+   ctx->vtable.finalize = _finalize;
+   ctx->vtable.cleanup = _cleanup;
+
+   if (!kek || mongocrypt_binary_len (kek) != MONGOCRYPT_KEY_LEN) {
+      return _mongocrypt_ctx_fail_w_msg (
+         ctx, "key encryption key must be 96 bytes");
+   }
+   _mongocrypt_buffer_from_binary (kek_buf, kek);
+   return true;
+}
+
+
+bool
+mongocrypt_ctx_key_cache_export_init (mongocrypt_ctx_t *ctx,
+                                      mongocrypt_binary_t *kek)
+{
+   _mongocrypt_ctx_key_cache_snapshot_t *sctx;
+   _mongocrypt_buffer_t kek_buf;
+   bson_t snapshot;
+
+   if (!ctx) {
+      return false;
+   }
+
+   if (!_init (ctx, _MONGOCRYPT_TYPE_KEY_CACHE_EXPORT, kek, &kek_buf)) {
+      return false;
+   }
+
+   sctx = (_mongocrypt_ctx_key_cache_snapshot_t *) ctx;
+   if (!_mongocrypt_cache_key_export (&ctx->crypt->cache_key,
+                                      ctx->crypt->crypto,
+                                      &kek_buf,
+                                      &snapshot,
+                                      ctx->status)) {
+      bson_destroy (&snapshot);
+      return _mongocrypt_ctx_fail (ctx);
+   }
+   _mongocrypt_buffer_steal_from_bson (&sctx->snapshot, &snapshot);
+
+   ctx->state = MONGOCRYPT_CTX_READY;
+   return true;
+}
+
+
+bool
+mongocrypt_ctx_key_cache_import_init (mongocrypt_ctx_t *ctx,
+                                      mongocrypt_binary_t *kek,
+                                      mongocrypt_binary_t *snapshot)
+{
+   _mongocrypt_buffer_t kek_buf;
+   bson_t as_bson;
+   uint32_t imported;
+
+   if (!ctx) {
+      return false;
+   }
+
+   if (!_init (ctx, _MONGOCRYPT_TYPE_KEY_CACHE_IMPORT, kek, &kek_buf)) {
+      return false;
+   }
+   ctx->vtable.finalize = _mongocrypt_ctx_finalize_empty;
+
+   if (!snapshot || !_mongocrypt_binary_to_bson (snapshot, &as_bson)) {
+      return _mongocrypt_ctx_fail_w_msg (ctx, "malformed snapshot");
+   }
+
+   if (!_mongocrypt_cache_key_import (&ctx->crypt->cache_key,
+                                      ctx->crypt->crypto,
+                                      &kek_buf,
+                                      &as_bson,
+                                      &imported,
+                                      ctx->status)) {
+      return _mongocrypt_ctx_fail (ctx);
+   }
+
+   CRYPT_TRACEF (&ctx->crypt->log, "imported %" PRIu32 " keys\n", imported);
+
+   ctx->state = MONGOCRYPT_CTX_READY;
+   return true;
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright 2022-present MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mongocrypt-ctx-private.h"
+
+bool
+mongocrypt_ctx_needs_key_refresh (mongocrypt_ctx_t *ctx)
+{
+   if (!ctx || !ctx->initialized) {
+      return false;
+   }
+   return ctx->kb.key_refreshes != NULL;
+}
+
+
+bool
+mongocrypt_ctx_key_refresh_init (mongocrypt_ctx_t *ctx,
+                                 mongocrypt_ctx_t *stale_ctx)
+{
+   _mongocrypt_ctx_opts_spec_t opts_spec;
+   key_request_t *iter;
+
+   if (!ctx) {
+      return false;
+   }
+
+   memset (&opts_spec, 0, sizeof (opts_spec));
+   if (!_mongocrypt_ctx_init (ctx, &opts_spec)) {
+      return false;
+   }
+
+   ctx->type = _MONGOCRYPT_TYPE_KEY_REFRESH;
+   /* The key broker stores the refreshed keys in the key cache. */
+   ctx->vtable.finalize = _mongocrypt_ctx_finalize_empty;
+
+   if (!stale_ctx || !stale_ctx->initialized) {
+      return _mongocrypt_ctx_fail_w_msg (ctx,
+                                         "stale context NULL or uninitialized");
+   }
+
+   if (stale_ctx->crypt != ctx->crypt) {
+      return _mongocrypt_ctx_fail_w_msg (
+         ctx, "stale context must be created from the same mongocrypt_t");
+   }
+
+   for (iter = stale_ctx->kb.key_refreshes; NULL != iter; iter = iter->next) {
+      if (!_mongocrypt_key_broker_refresh_id (&ctx->kb, &iter->id)) {
+         _mongocrypt_key_broker_status (&ctx->kb, ctx->status);
+         return _mongocrypt_ctx_fail (ctx);
+      }
+   }
+
+   (void) _mongocrypt_key_broker_requests_done (&ctx->kb);
+   return _mongocrypt_ctx_state_from_key_broker (ctx);
+}
@@ -0,0 +1,144 @@
+/*
+ * Copyright 2022-present MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mongocrypt-ctx-private.h"
+
+/* Without requests, the key broker accepts any key. Fetch every key in the key
+ * vault collection. */
+static bool
+_mongo_op_keys_any (mongocrypt_ctx_t *ctx, mongocrypt_binary_t *out)
+{
+   static const uint8_t empty_doc[] = {5, 0, 0, 0, 0};
+
+   BSON_ASSERT_PARAM (ctx);
+   BSON_ASSERT_PARAM (out);
+
+   out->data = (uint8_t *) empty_doc;
+   out->len = sizeof (empty_doc);
+   return true;
+}
+
+
+/* Requests the keys listed in @keys, of the form:
+ * { "v": [ (UUID binary or UTF-8 keyAltName), ... ] } */
+static bool
+_request_keys (mongocrypt_ctx_t *ctx, mongocrypt_binary_t *keys)
+{
+   bson_t as_bson;
+   bson_iter_t iter;
+   bson_iter_t elem;
+   bool empty = true;
+
+   if (!_mongocrypt_binary_to_bson (keys, &as_bson)) {
+      return _mongocrypt_ctx_fail_w_msg (ctx, "malformed bson");
+   }
+
+   if (!bson_iter_init_find (&iter, &as_bson, "v")) {
+      return _mongocrypt_ctx_fail_w_msg (ctx, "invalid keys, must contain 'v'");
+   }
+
+   if (!BSON_ITER_HOLDS_ARRAY (&iter)) {
+      return _mongocrypt_ctx_fail_w_msg (
+         ctx, "invalid keys, 'v' must contain an array");
+   }
+
+   if (!bson_iter_recurse (&iter, &elem)) {
+      return _mongocrypt_ctx_fail_w_msg (ctx, "malformed bson");
+   }
+
+   while (bson_iter_next (&elem)) {
+      empty = false;
+      if (BSON_ITER_HOLDS_UTF8 (&elem)) {
+         if (!_mongocrypt_key_broker_request_name (&ctx->kb,
+                                                   bson_iter_value (&elem))) {
+            _mongocrypt_key_broker_status (&ctx->kb, ctx->status);
+            return _mongocrypt_ctx_fail (ctx);
+         }
+      } else if (BSON_ITER_HOLDS_BINARY (&elem)) {
+         _mongocrypt_buffer_t key_id;
+
+         if (!_mongocrypt_buffer_from_uuid_iter (&key_id, &elem)) {
+            return _mongocrypt_ctx_fail_w_msg (
+               ctx, "invalid keys, key ids must be UUIDs");
+         }
+         if (!_mongocrypt_key_broker_request_id (&ctx->kb, &key_id)) {
+            _mongocrypt_key_broker_status (&ctx->kb, ctx->status);
+            return _mongocrypt_ctx_fail (ctx);
+         }
+      } else {
+         return _mongocrypt_ctx_fail_w_msg (
+            ctx, "invalid keys, 'v' elements must be UUIDs or strings");
+      }
+   }
+
+   if (empty) {
+      return _mongocrypt_ctx_fail_w_msg (ctx,
+                                         "invalid keys, 'v' must not be empty");
+   }
+   return true;
+}
+
+
+bool
+mongocrypt_ctx_keys_prefetch_init (mongocrypt_ctx_t *ctx,
+                                   mongocrypt_binary_t *keys)
+{
+   _mongocrypt_ctx_opts_spec_t opts_spec;
+
+   if (!ctx) {
+      return false;
+   }
+
+   memset (&opts_spec, 0, sizeof (opts_spec));
+   if (!_mongocrypt_ctx_init (ctx, &opts_spec)) {
+      return false;
+   }
+
+   ctx->type = _MONGOCRYPT_TYPE_KEYS_PREFETCH;
+   /* The key broker stores the keys in the key cache. */
+   ctx->vtable.finalize = _mongocrypt_ctx_finalize_empty;
+
+   if (ctx->crypt->log.trace_enabled) {
+      char *keys_val = NULL;
+
+      if (keys) {
+         keys_val = _mongocrypt_new_json_string_from_binary (keys);
+      }
+      _mongocrypt_log (&ctx->crypt->log,
+                       MONGOCRYPT_LOG_LEVEL_TRACE,
+                       "%s (%s=\"%s\")",
+                       BSON_FUNC,
+                       "keys",
+                       keys_val ? keys_val : "(null)");
+      bson_free (keys_val);
+   }
+
+   if (!keys) {
+      ctx->vtable.mongo_op_keys = _mongo_op_keys_any;
+      if (!_mongocrypt_key_broker_request_any (&ctx->kb)) {
+         _mongocrypt_key_broker_status (&ctx->kb, ctx->status);
+         return _mongocrypt_ctx_fail (ctx);
+      }
+      return _mongocrypt_ctx_state_from_key_broker (ctx);
+   }
+
+   if (!_request_keys (ctx, keys)) {
+      return false;
+   }
+
+   (void) _mongocrypt_key_broker_requests_done (&ctx->kb);
+   return _mongocrypt_ctx_state_from_key_broker (ctx);
+}
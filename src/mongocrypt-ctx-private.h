@@ -22,9 +22,15 @@
 #include "mongocrypt-buffer-private.h"
 #include "mongocrypt-key-broker-private.h"
 #include "mongocrypt-key-private.h"
+#include "mongocrypt-marking-private.h"
 #include "mongocrypt-endpoint-private.h"
 #include "mc-efc-private.h"
 
+#define ALGORITHM_DETERMINISTIC "AEAD_AES_256_CBC_HMAC_SHA_512-Deterministic"
+#define ALGORITHM_DETERMINISTIC_LEN 43
+#define ALGORITHM_RANDOM "AEAD_AES_256_CBC_HMAC_SHA_512-Random"
+#define ALGORITHM_RANDOM_LEN 36
+
 typedef enum {
    _MONGOCRYPT_TYPE_NONE,
    _MONGOCRYPT_TYPE_ENCRYPT,
@@ -32,6 +38,11 @@ typedef enum {
    _MONGOCRYPT_TYPE_CREATE_DATA_KEY,
    _MONGOCRYPT_TYPE_REWRAP_MANY_DATAKEY,
    _MONGOCRYPT_TYPE_COMPACT,
+   _MONGOCRYPT_TYPE_KEY_REFRESH,
+   _MONGOCRYPT_TYPE_COLLINFO_PREFETCH,
+   _MONGOCRYPT_TYPE_KEYS_PREFETCH,
+   _MONGOCRYPT_TYPE_KEY_CACHE_EXPORT,
+   _MONGOCRYPT_TYPE_KEY_CACHE_IMPORT,
 } _mongocrypt_ctx_type_t;
 
 /* Option values are validated when set.
@@ -71,6 +82,7 @@ typedef struct {
    bool (*mongo_op_keys) (mongocrypt_ctx_t *ctx, mongocrypt_binary_t *out);
    bool (*mongo_feed_keys) (mongocrypt_ctx_t *ctx, mongocrypt_binary_t *in);
    bool (*mongo_done_keys) (mongocrypt_ctx_t *ctx);
+   bool (*wait_done) (mongocrypt_ctx_t *ctx);
    bool (*after_kms_credentials_provided) (mongocrypt_ctx_t *ctx);
    mongocrypt_kms_ctx_t *(*next_kms_ctx) (mongocrypt_ctx_t *ctx);
    bool (*kms_done) (mongocrypt_ctx_t *ctx);
@@ -95,6 +107,7 @@ struct _mongocrypt_ctx_t {
     * 1. No keys are requested
     * 2. The command is bypassed for automatic encryption (e.g. ping).
     * 3. bypass_query_analysis is true.
+    * 4. The namespace is known to need no encryption.
     * TODO (MONGOCRYPT-422) replace nothing_to_do.
     */
    bool nothing_to_do;
@@ -151,9 +164,21 @@ typedef struct {
    /* bypass_query_analysis is set to true to skip the
     * MONGOCRYPT_CTX_NEED_MONGO_MARKINGS state. */
    bool bypass_query_analysis;
+   /* batch is true for mongocrypt_ctx_explicit_encrypt_batch_init.
+    * original_cmd is then {v: [<element>, ...]}. */
+   bool batch;
+   /* num_markings is the number of markings in marked_cmd. */
+   uint32_t num_markings;
+   /* batch_markings are the parsed elements of a batch. They view
+    * original_cmd. */
+   _mongocrypt_marking_t *batch_markings;
+   uint32_t batch_markings_len;
 } _mongocrypt_ctx_encrypt_t;
 
 
+typedef struct __mongocrypt_ctx_decrypt_ciphertext_t
+   _mongocrypt_ctx_decrypt_ciphertext_t;
+
 typedef struct {
    mongocrypt_ctx_t parent;
    /* TODO CDRIVER-3150: audit + rename these buffers.
@@ -162,6 +187,10 @@ typedef struct {
     * */
    _mongocrypt_buffer_t original_doc;
    _mongocrypt_buffer_t decrypted_doc;
+   /* The ciphertexts of original_doc in document order. */
+   _mongocrypt_ctx_decrypt_ciphertext_t *ciphertexts;
+   uint32_t ciphertexts_len;
+   uint32_t ciphertexts_cap;
 } _mongocrypt_ctx_decrypt_t;
 
 
@@ -202,6 +231,23 @@ typedef struct {
    mc_EncryptedFieldConfig_t efc;
 } _mongocrypt_ctx_compact_t;
 
+typedef struct {
+   mongocrypt_ctx_t parent;
+   char *db_name;
+   /* coll_names are the requested collections, or NULL to prefetch every
+    * collection in db_name. coll_fed[i] is set once coll_names[i] is fed. */
+   char **coll_names;
+   bool *coll_fed;
+   uint32_t num_coll_names;
+   _mongocrypt_buffer_t list_collections_filter;
+} _mongocrypt_ctx_collinfo_prefetch_t;
+
+typedef struct {
+   mongocrypt_ctx_t parent;
+   /* snapshot is the exported key cache, or an empty document for import. */
+   _mongocrypt_buffer_t snapshot;
+} _mongocrypt_ctx_key_cache_snapshot_t;
+
 
 /* Used for option validation. True means required. False means prohibited. */
 typedef enum {
@@ -230,6 +276,12 @@ bool
 _mongocrypt_ctx_state_from_key_broker (mongocrypt_ctx_t *ctx)
    MONGOCRYPT_WARN_UNUSED_RESULT;
 
+/* A finalize function for contexts that store their results in a cache and
+ * have nothing to return to the driver. Outputs an empty document. */
+bool
+_mongocrypt_ctx_finalize_empty (mongocrypt_ctx_t *ctx,
+                                mongocrypt_binary_t *out);
+
 /* Get the KMS providers for the current context, fall back to the ones
  * from mongocrypt_t if none are provided for the context specifically. */
 _mongocrypt_opts_kms_providers_t *
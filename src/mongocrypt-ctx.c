@@ -19,10 +19,6 @@
 #include "mongocrypt-ctx-private.h"
 #include "mongocrypt-key-broker-private.h"
 
-#define ALGORITHM_DETERMINISTIC "AEAD_AES_256_CBC_HMAC_SHA_512-Deterministic"
-#define ALGORITHM_DETERMINISTIC_LEN 43
-#define ALGORITHM_RANDOM "AEAD_AES_256_CBC_HMAC_SHA_512-Random"
-#define ALGORITHM_RANDOM_LEN 36
 
 bool
 _mongocrypt_ctx_fail_w_msg (mongocrypt_ctx_t *ctx, const char *msg)
@@ -382,6 +378,16 @@ _mongo_done_keys (mongocrypt_ctx_t *ctx)
    return _mongocrypt_ctx_state_from_key_broker (ctx);
 }
 
+static bool
+_wait_done (mongocrypt_ctx_t *ctx)
+{
+   if (!_mongocrypt_key_broker_check_waiting (&ctx->kb)) {
+      BSON_ASSERT (!_mongocrypt_key_broker_status (&ctx->kb, ctx->status));
+      return _mongocrypt_ctx_fail (ctx);
+   }
+   return _mongocrypt_ctx_state_from_key_broker (ctx);
+}
+
 static mongocrypt_kms_ctx_t *
 _next_kms_ctx (mongocrypt_ctx_t *ctx)
 {
@@ -498,6 +504,27 @@ mongocrypt_ctx_mongo_done (mongocrypt_ctx_t *ctx)
 }
 
 
+bool
+mongocrypt_ctx_wait_done (mongocrypt_ctx_t *ctx)
+{
+   if (!ctx) {
+      return false;
+   }
+   if (!ctx->initialized) {
+      return _mongocrypt_ctx_fail_w_msg (ctx, "ctx NULL or uninitialized");
+   }
+
+   switch (ctx->state) {
+   case MONGOCRYPT_CTX_WAITING_ON_KEYS:
+      CHECK_AND_CALL (wait_done, ctx);
+   case MONGOCRYPT_CTX_ERROR:
+      return false;
+   default:
+      return _mongocrypt_ctx_fail_w_msg (ctx, "wrong state");
+   }
+}
+
+
 mongocrypt_ctx_state_t
 mongocrypt_ctx_state (mongocrypt_ctx_t *ctx)
 {
@@ -805,6 +832,7 @@ _mongocrypt_ctx_init (mongocrypt_ctx_t *ctx,
    ctx->vtable.mongo_op_keys = _mongo_op_keys;
    ctx->vtable.mongo_feed_keys = _mongo_feed_keys;
    ctx->vtable.mongo_done_keys = _mongo_done_keys;
+   ctx->vtable.wait_done = _wait_done;
    ctx->vtable.next_kms_ctx = _next_kms_ctx;
    ctx->vtable.kms_done = _kms_done;
 
@@ -883,6 +911,20 @@ _mongocrypt_ctx_init (mongocrypt_ctx_t *ctx,
    return true;
 }
 
+bool
+_mongocrypt_ctx_finalize_empty (mongocrypt_ctx_t *ctx, mongocrypt_binary_t *out)
+{
+   static const uint8_t empty_doc[] = {5, 0, 0, 0, 0};
+
+   BSON_ASSERT_PARAM (ctx);
+   BSON_ASSERT_PARAM (out);
+
+   out->data = (uint8_t *) empty_doc;
+   out->len = sizeof (empty_doc);
+   ctx->state = MONGOCRYPT_CTX_DONE;
+   return true;
+}
+
 bool
 _mongocrypt_ctx_state_from_key_broker (mongocrypt_ctx_t *ctx)
 {
@@ -916,6 +958,12 @@ _mongocrypt_ctx_state_from_key_broker (mongocrypt_ctx_t *ctx)
       }
       ret = true;
       break;
+   case KB_WAITING:
+      /* Another context is fetching a key. The driver calls
+       * mongocrypt_ctx_wait_done to check for it again. */
+      new_state = MONGOCRYPT_CTX_WAITING_ON_KEYS;
+      ret = true;
+      break;
    case KB_ADDING_DOCS_ANY:
       /* Assume KMS credentials have been provided. */
       new_state = MONGOCRYPT_CTX_NEED_MONGO_KEYS;
@@ -33,10 +33,12 @@
  * Each encrypt/decrypt request has one key broker. Key brokers are not shared.
  * It is responsible for:
  * - keeping track of requested keys (either by id or keyAltName)
- * - copying keys from the cache to satisfy those requests
+ * - pinning keys from the cache to satisfy those requests
  * - generating find cmd filters to fetch keys that aren't cached or are expired
  * - generating KMS decrypt requests on newly fetched keys
  * - adding newly fetched keys back to the cache
+ * - noting cached keys that are due for a refresh (see
+ *   mongocrypt_setopt_key_cache_refresh_window)
  *
  * Notes:
  * - any key request that is satisfied stays satisfied.
@@ -57,6 +59,9 @@ typedef enum {
    KB_ADDING_DOCS,
    /* Accept any key document fetched from the key vault collection. */
    KB_ADDING_DOCS_ANY,
+   /* Another key broker of the same mongocrypt_t is fetching a requested key.
+    * Wait for it to be cached. */
+   KB_WAITING,
    /* Getting oauth token(s) from KMS providers. */
    KB_AUTHENTICATING,
    /* Accept KMS replies to decrypt key material in each key document. */
@@ -75,10 +80,15 @@ typedef struct _key_request_t {
    struct _key_request_t *next;
 } key_request_t;
 
-/* Represents a single key supplied from the driver or cache. */
+/* Represents a single key supplied from the driver or cache.
+ * A key from the cache pins the cache value rather than copying it. Then @doc
+ * and @decrypted_key_material are non-owning views into @cache_value.
+ * @tokens is only used by keys without a @cache_value. */
 typedef struct _key_returned_t {
    _mongocrypt_key_doc_t *doc;
    _mongocrypt_buffer_t decrypted_key_material;
+   _mongocrypt_cache_key_value_t *cache_value;
+   mc_IndexKeyTokens_t *tokens;
 
    mongocrypt_kms_ctx_t kms;
    bool decrypted;
@@ -88,6 +98,16 @@ typedef struct _key_returned_t {
    struct _key_returned_t *next;
 } key_returned_t;
 
+/* Represents a key being fetched by a key broker. Other key brokers requesting
+ * the same key wait for it to be cached rather than fetching it again. The id
+ * and alt_name are copied from a key_request_t. */
+typedef struct _key_fetch_t {
+   _mongocrypt_buffer_t id;
+   _mongocrypt_key_alt_name_t *alt_name;
+   const void *owner; /* the fetching key broker. */
+   struct _key_fetch_t *next;
+} key_fetch_t;
+
 typedef struct _auth_request_t {
    mongocrypt_kms_ctx_t kms;
    bool returned;
@@ -106,6 +126,15 @@ typedef struct {
     */
    key_returned_t *keys_returned;
    key_returned_t *keys_cached;
+   /* Ids of keys satisfied from the cache which this key broker was told are
+    * due for a refresh. Only the id of each is set. */
+   key_request_t *key_refreshes;
+   /* Ids of keys this key broker is refreshing. The refresh reported for each
+    * is released if the key broker fails or is cleaned up before storing the
+    * refreshed key, so another context is told to refresh it. */
+   key_request_t *refresh_claims;
+   /* True if this key broker has entries in crypt->key_fetches. */
+   bool fetching;
    _mongocrypt_buffer_t filter;
    mongocrypt_t *crypt;
 
@@ -124,6 +153,13 @@ _mongocrypt_key_broker_request_id (_mongocrypt_key_broker_t *kb,
    MONGOCRYPT_WARN_UNUSED_RESULT;
 
 
+/* Add a request for a key by UUID, bypassing the cache. Used to replace a
+ * cached key before it expires. */
+bool
+_mongocrypt_key_broker_refresh_id (_mongocrypt_key_broker_t *kb,
+                                   const _mongocrypt_buffer_t *key_id)
+   MONGOCRYPT_WARN_UNUSED_RESULT;
+
 /* Add keyAltName into the key broker.
    Key is added as KEY_EMPTY. */
 bool
@@ -136,9 +172,19 @@ bool
 _mongocrypt_key_broker_request_any (_mongocrypt_key_broker_t *kb)
    MONGOCRYPT_WARN_UNUSED_RESULT;
 
+/* Finish adding requests. If the waiting-on-keys state is enabled and another
+ * key broker is fetching a requested key, transitions to KB_WAITING. */
 bool
 _mongocrypt_key_broker_requests_done (_mongocrypt_key_broker_t *kb);
 
+/* Check whether the keys waited on in KB_WAITING have been cached. Transitions
+ * to KB_DONE if all requests are satisfied, to KB_ADDING_DOCS if no other key
+ * broker is still fetching a requested key, or otherwise stays in KB_WAITING.
+ */
+bool
+_mongocrypt_key_broker_check_waiting (_mongocrypt_key_broker_t *kb)
+   MONGOCRYPT_WARN_UNUSED_RESULT;
+
 /* Get the find command filter. */
 bool
 _mongocrypt_key_broker_filter (_mongocrypt_key_broker_t *kb,
@@ -187,6 +233,24 @@ _mongocrypt_key_broker_decrypted_key_by_name (_mongocrypt_key_broker_t *kb,
                                               _mongocrypt_buffer_t *key_id_out)
    MONGOCRYPT_WARN_UNUSED_RESULT;
 
+/* Returns the precomputed crypto state of a decrypted key, or NULL if there is
+ * none. Unlike _mongocrypt_key_broker_decrypted_key_by_id, this does not fail
+ * @kb. The state remains valid until @kb is cleaned up. */
+const _mongocrypt_key_state_t *
+_mongocrypt_key_broker_decrypted_key_state_by_id (
+   _mongocrypt_key_broker_t *kb, const _mongocrypt_buffer_t *key_id);
+
+/* Returns the FLE2 tokens of a decrypted index key that do not depend on a
+ * value. They are derived once per key, and shared through the key cache.
+ * Returns NULL and sets @status on error. Unlike
+ * _mongocrypt_key_broker_decrypted_key_by_id, this does not fail @kb. The
+ * tokens remain valid until @kb is cleaned up. */
+const mc_IndexKeyTokens_t *
+_mongocrypt_key_broker_decrypted_key_tokens_by_id (
+   _mongocrypt_key_broker_t *kb,
+   const _mongocrypt_buffer_t *key_id,
+   mongocrypt_status_t *status);
+
 
 bool
 _mongocrypt_key_broker_status (_mongocrypt_key_broker_t *kb,
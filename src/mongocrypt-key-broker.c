@@ -56,6 +56,40 @@ _key_returned_prepend (_mongocrypt_key_broker_t *kb,
    return key_returned;
 }
 
+/*
+ * Creates a new key_returned_t pinning a cache value and prepends it to a list.
+ * Takes ownership of the reference to @cache_value.
+ *
+ * Side effects:
+ * - updates *list to point to a new head.
+ */
+static key_returned_t *
+_key_returned_prepend_cached (_mongocrypt_key_broker_t *kb,
+                              key_returned_t **list,
+                              _mongocrypt_cache_key_value_t *cache_value)
+{
+   key_returned_t *key_returned;
+
+   BSON_ASSERT (cache_value);
+
+   key_returned = bson_malloc0 (sizeof (*key_returned));
+   BSON_ASSERT (key_returned);
+
+   key_returned->cache_value = cache_value;
+   key_returned->doc = cache_value->key_doc;
+   _mongocrypt_buffer_set_to (&cache_value->decrypted_key_material,
+                              &key_returned->decrypted_key_material);
+   key_returned->decrypted = true;
+
+   /* Prepend and update the head of the list. */
+   key_returned->next = *list;
+   *list = key_returned;
+
+   /* Update the head of the decrypting iter. */
+   kb->decryptor_iter = kb->keys_returned;
+   return key_returned;
+}
+
 /* Find the first (if any) key_returned_t matching either a key_id or a list of
  * key_alt_names (both are NULLable) */
 static key_returned_t *
@@ -124,11 +158,122 @@ _all_key_requests_satisfied (_mongocrypt_key_broker_t *kb)
    return true;
 }
 
+/*
+ * Claims every unsatisfied request in crypt->key_fetches, unless another key
+ * broker is already fetching one of them. Claiming all or none keeps a key
+ * broker in a single state.
+ *
+ * Returns true if the requests were claimed, false if the caller must wait.
+ */
+static bool
+_claim_key_fetches (_mongocrypt_key_broker_t *kb)
+{
+   mongocrypt_t *crypt = kb->crypt;
+   key_request_t *req;
+   key_fetch_t *fetch;
+
+   _mongocrypt_mutex_lock (&crypt->mutex);
+   for (req = kb->key_requests; NULL != req; req = req->next) {
+      if (req->satisfied) {
+         continue;
+      }
+      for (fetch = crypt->key_fetches; NULL != fetch; fetch = fetch->next) {
+         if (fetch->owner == kb) {
+            continue;
+         }
+         if ((!_mongocrypt_buffer_empty (&req->id) &&
+              0 == _mongocrypt_buffer_cmp (&req->id, &fetch->id)) ||
+             _mongocrypt_key_alt_name_intersects (req->alt_name,
+                                                  fetch->alt_name)) {
+            _mongocrypt_mutex_unlock (&crypt->mutex);
+            return false;
+         }
+      }
+   }
+
+   for (req = kb->key_requests; NULL != req; req = req->next) {
+      if (req->satisfied) {
+         continue;
+      }
+      fetch = bson_malloc0 (sizeof *fetch);
+      BSON_ASSERT (fetch);
+      _mongocrypt_buffer_copy_to (&req->id, &fetch->id);
+      fetch->alt_name = _mongocrypt_key_alt_name_copy_all (req->alt_name);
+      fetch->owner = kb;
+      fetch->next = crypt->key_fetches;
+      crypt->key_fetches = fetch;
+   }
+   kb->fetching = true;
+   _mongocrypt_mutex_unlock (&crypt->mutex);
+   return true;
+}
+
+/* Removes this key broker's entries from crypt->key_fetches, so waiting key
+ * brokers check the cache again. */
+static void
+_release_key_fetches (_mongocrypt_key_broker_t *kb)
+{
+   mongocrypt_t *crypt = kb->crypt;
+   key_fetch_t **link;
+
+   if (!kb->fetching) {
+      return;
+   }
+
+   _mongocrypt_mutex_lock (&crypt->mutex);
+   link = &crypt->key_fetches;
+   while (*link) {
+      key_fetch_t *fetch = *link;
+
+      if (fetch->owner != kb) {
+         link = &fetch->next;
+         continue;
+      }
+      *link = fetch->next;
+      _mongocrypt_buffer_cleanup (&fetch->id);
+      _mongocrypt_key_alt_name_destroy_all (fetch->alt_name);
+      bson_free (fetch);
+   }
+   kb->fetching = false;
+   _mongocrypt_mutex_unlock (&crypt->mutex);
+}
+
+/* Releases the refreshes this key broker did not complete. If @key_id is
+ * non-NULL, only the claim for @key_id is dropped, without releasing it,
+ * because the refreshed key replaced the cache entry. */
+static void
+_release_refresh_claims (_mongocrypt_key_broker_t *kb,
+                         const _mongocrypt_buffer_t *key_id)
+{
+   key_request_t **link = &kb->refresh_claims;
+
+   while (*link) {
+      key_request_t *claim = *link;
+
+      if (key_id && 0 != _mongocrypt_buffer_cmp (key_id, &claim->id)) {
+         link = &claim->next;
+         continue;
+      }
+      if (!key_id) {
+         _mongocrypt_cache_key_attr_t *attr;
+
+         attr = _mongocrypt_cache_key_attr_new (&claim->id, NULL);
+         _mongocrypt_cache_release_refresh (&kb->crypt->cache_key, attr);
+         _mongocrypt_cache_key_attr_destroy (attr);
+      }
+      *link = claim->next;
+      _mongocrypt_buffer_cleanup (&claim->id);
+      bson_free (claim);
+   }
+}
+
 static bool
 _key_broker_fail_w_msg (_mongocrypt_key_broker_t *kb, const char *msg)
 {
    mongocrypt_status_t *status;
 
+   _release_key_fetches (kb);
+   _release_refresh_claims (kb, NULL);
    kb->state = KB_ERROR;
    status = kb->status;
    CLIENT_ERR (msg);
@@ -142,6 +287,8 @@ _key_broker_fail (_mongocrypt_key_broker_t *kb)
       return _key_broker_fail_w_msg (
          kb, "unexpected, failing but no error status set");
    }
+   _release_key_fetches (kb);
+   _release_refresh_claims (kb, NULL);
    kb->state = KB_ERROR;
    return false;
 }
@@ -151,23 +298,24 @@ _try_satisfying_from_cache (_mongocrypt_key_broker_t *kb, key_request_t *req)
 {
    _mongocrypt_cache_key_attr_t *attr = NULL;
    _mongocrypt_cache_key_value_t *value = NULL;
+   bool refresh_due = false;
    bool ret = false;
 
-   if (kb->state != KB_REQUESTING && kb->state != KB_ADDING_DOCS_ANY) {
+   if (kb->state != KB_REQUESTING && kb->state != KB_ADDING_DOCS_ANY &&
+       kb->state != KB_WAITING) {
       _key_broker_fail_w_msg (
          kb, "trying to retrieve key from cache in invalid state");
       goto cleanup;
    }
 
    attr = _mongocrypt_cache_key_attr_new (&req->id, req->alt_name);
-   if (!_mongocrypt_cache_get (&kb->crypt->cache_key, attr, (void **) &value)) {
+   if (!_mongocrypt_cache_get_refresh (
+          &kb->crypt->cache_key, attr, (void **) &value, &refresh_due)) {
       _key_broker_fail_w_msg (kb, "failed to retrieve from cache");
       goto cleanup;
    }
 
    if (value) {
-      key_returned_t *key_returned;
-
       req->satisfied = true;
       if (_mongocrypt_buffer_empty (&value->decrypted_key_material)) {
          _key_broker_fail_w_msg (
@@ -175,17 +323,24 @@ _try_satisfying_from_cache (_mongocrypt_key_broker_t *kb, key_request_t *req)
          goto cleanup;
       }
 
-      /* Add the cached key to our locally copied list.
+      if (refresh_due) {
+         /* The key is still usable. Record it so the driver can refresh it
+          * off the hot path. */
+         key_request_t *refresh = bson_malloc0 (sizeof *refresh);
+
+         BSON_ASSERT (refresh);
+         _mongocrypt_buffer_copy_to (&value->key_doc->id, &refresh->id);
+         refresh->next = kb->key_refreshes;
+         kb->key_refreshes = refresh;
+      }
+
+      /* Pin the cached key in our local list. The list takes our reference.
        * Note, we deduplicate requests, but *not* keys from the cache,
        * because the state of the cache may change between each call to
        * _mongocrypt_cache_get.
        */
-      key_returned =
-         _key_returned_prepend (kb, &kb->keys_cached, value->key_doc);
-      _mongocrypt_buffer_init (&key_returned->decrypted_key_material);
-      _mongocrypt_buffer_copy_to (&value->decrypted_key_material,
-                                  &key_returned->decrypted_key_material);
-      key_returned->decrypted = true;
+      _key_returned_prepend_cached (kb, &kb->keys_cached, value);
+      value = NULL;
    }
 
    ret = true;
@@ -214,12 +369,23 @@ _store_to_cache (_mongocrypt_key_broker_t *kb, key_returned_t *key_returned)
    }
    value = _mongocrypt_cache_key_value_new (
       key_returned->doc, &key_returned->decrypted_key_material);
-   ret = _mongocrypt_cache_add_stolen (
+
+   /* Pin the value in place of our copy, so the key's precomputed crypto state
+    * is shared with other users of the cache. The list takes our reference. */
+   _mongocrypt_key_destroy (key_returned->doc);
+   _mongocrypt_buffer_cleanup (&key_returned->decrypted_key_material);
+   key_returned->cache_value = value;
+   key_returned->doc = value->key_doc;
+   _mongocrypt_buffer_set_to (&value->decrypted_key_material,
+                              &key_returned->decrypted_key_material);
+
+   ret = _mongocrypt_cache_add_copy (
       &kb->crypt->cache_key, attr, value, kb->status);
    _mongocrypt_cache_key_attr_destroy (attr);
    if (!ret) {
       return _key_broker_fail (kb);
    }
+   _release_refresh_claims (kb, &key_returned->doc->id);
    return true;
 }
 
@@ -255,6 +421,42 @@ _mongocrypt_key_broker_request_id (_mongocrypt_key_broker_t *kb,
 }
 
 
+bool
+_mongocrypt_key_broker_refresh_id (_mongocrypt_key_broker_t *kb,
+                                   const _mongocrypt_buffer_t *key_id)
+{
+   key_request_t *req;
+
+   if (kb->state != KB_REQUESTING) {
+      return _key_broker_fail_w_msg (
+         kb, "attempting to refresh a key id, but in wrong state");
+   }
+
+   if (!_mongocrypt_buffer_is_uuid ((_mongocrypt_buffer_t *) key_id)) {
+      return _key_broker_fail_w_msg (kb, "expected UUID for key id");
+   }
+
+   if (_key_request_find_one (kb, key_id, NULL)) {
+      return true;
+   }
+
+   req = bson_malloc0 (sizeof *req);
+   BSON_ASSERT (req);
+   _mongocrypt_buffer_copy_to (key_id, &req->id);
+   req->next = kb->refresh_claims;
+   kb->refresh_claims = req;
+
+   req = bson_malloc0 (sizeof *req);
+   BSON_ASSERT (req);
+
+   _mongocrypt_buffer_copy_to (key_id, &req->id);
+   req->next = kb->key_requests;
+   kb->key_requests = req;
+   /* Do not try the cache. The fetched key replaces the cached key. */
+   return true;
+}
+
+
 bool
 _mongocrypt_key_broker_request_name (_mongocrypt_key_broker_t *kb,
                                      const bson_value_t *key_alt_name_value)
@@ -316,6 +518,9 @@ _mongocrypt_key_broker_requests_done (_mongocrypt_key_broker_t *kb)
    if (kb->key_requests) {
       if (_all_key_requests_satisfied (kb)) {
          kb->state = KB_DONE;
+      } else if (kb->crypt->opts.use_waiting_on_keys_state &&
+                 !_claim_key_fetches (kb)) {
+         kb->state = KB_WAITING;
       } else {
          kb->state = KB_ADDING_DOCS;
       }
@@ -325,6 +530,35 @@ _mongocrypt_key_broker_requests_done (_mongocrypt_key_broker_t *kb)
    return true;
 }
 
+bool
+_mongocrypt_key_broker_check_waiting (_mongocrypt_key_broker_t *kb)
+{
+   key_request_t *req;
+
+   if (kb->state != KB_WAITING) {
+      return _key_broker_fail_w_msg (
+         kb, "attempting to check waiting keys, but in wrong state");
+   }
+
+   for (req = kb->key_requests; NULL != req; req = req->next) {
+      if (req->satisfied) {
+         continue;
+      }
+      if (!_try_satisfying_from_cache (kb, req)) {
+         return false;
+      }
+   }
+
+   if (_all_key_requests_satisfied (kb)) {
+      kb->state = KB_DONE;
+   } else if (_claim_key_fetches (kb)) {
+      /* The other key broker finished without caching every key we need,
+       * e.g. because it failed. Fetch them ourselves. */
+      kb->state = KB_ADDING_DOCS;
+   }
+   return true;
+}
+
 bool
 _mongocrypt_key_broker_filter (_mongocrypt_key_broker_t *kb,
                                mongocrypt_binary_t *out)
@@ -694,6 +928,7 @@ _mongocrypt_key_broker_docs_done (_mongocrypt_key_broker_t *kb)
    } else if (needs_decryption) {
       kb->state = KB_DECRYPTING_KEY_MATERIAL;
    } else {
+      _release_key_fetches (kb);
       kb->state = KB_DONE;
    }
    return true;
@@ -921,6 +1156,7 @@ _mongocrypt_key_broker_kms_done (
       }
    }
 
+   _release_key_fetches (kb);
    kb->state = KB_DONE;
    return true;
 }
@@ -1001,6 +1237,79 @@ _mongocrypt_key_broker_decrypted_key_by_name (
    return ret;
 }
 
+const _mongocrypt_key_state_t *
+_mongocrypt_key_broker_decrypted_key_state_by_id (
+   _mongocrypt_key_broker_t *kb, const _mongocrypt_buffer_t *key_id)
+{
+   key_returned_t *key_returned;
+
+   BSON_ASSERT_PARAM (kb);
+   BSON_ASSERT_PARAM (key_id);
+
+   /* Search in the same order as _get_decrypted_key_material. */
+   key_returned = _key_returned_find_one (
+      kb->keys_returned, (_mongocrypt_buffer_t *) key_id, NULL);
+   if (!key_returned) {
+      key_returned = _key_returned_find_one (
+         kb->keys_cached, (_mongocrypt_buffer_t *) key_id, NULL);
+   }
+
+   if (!key_returned || !key_returned->decrypted ||
+       !key_returned->cache_value) {
+      return NULL;
+   }
+
+   return _mongocrypt_cache_key_value_key_state (key_returned->cache_value,
+                                                 kb->crypt->crypto);
+}
+
+const mc_IndexKeyTokens_t *
+_mongocrypt_key_broker_decrypted_key_tokens_by_id (
+   _mongocrypt_key_broker_t *kb,
+   const _mongocrypt_buffer_t *key_id,
+   mongocrypt_status_t *status)
+{
+   key_returned_t *key_returned;
+
+   BSON_ASSERT_PARAM (kb);
+   BSON_ASSERT_PARAM (key_id);
+
+   if (kb->state != KB_DONE && kb->state != KB_REQUESTING) {
+      CLIENT_ERR (
+         "attempting retrieve decrypted key material, but in wrong state");
+      return NULL;
+   }
+
+   /* Search in the same order as _get_decrypted_key_material. */
+   key_returned = _key_returned_find_one (
+      kb->keys_returned, (_mongocrypt_buffer_t *) key_id, NULL);
+   if (!key_returned) {
+      key_returned = _key_returned_find_one (
+         kb->keys_cached, (_mongocrypt_buffer_t *) key_id, NULL);
+   }
+
+   if (!key_returned) {
+      CLIENT_ERR ("could not find key");
+      return NULL;
+   }
+
+   if (!key_returned->decrypted) {
+      CLIENT_ERR ("unexpected, key not decrypted");
+      return NULL;
+   }
+
+   if (key_returned->cache_value) {
+      return _mongocrypt_cache_key_value_tokens (
+         key_returned->cache_value, kb->crypt->crypto, status);
+   }
+
+   if (!key_returned->tokens) {
+      key_returned->tokens = mc_IndexKeyTokens_new (
+         kb->crypt->crypto, &key_returned->decrypted_key_material, status);
+   }
+   return key_returned->tokens;
+}
+
 bool
 _mongocrypt_key_broker_status (_mongocrypt_key_broker_t *kb,
                                mongocrypt_status_t *out)
@@ -1040,8 +1349,14 @@ _destroy_keys_returned (key_returned_t *head)
    while (head) {
       tmp = head->next;
 
-      _mongocrypt_key_destroy (head->doc);
-      _mongocrypt_buffer_cleanup (&head->decrypted_key_material);
+      if (head->cache_value) {
+         /* doc and decrypted_key_material are views into the cache value. */
+         _mongocrypt_cache_key_value_destroy (head->cache_value);
+      } else {
+         _mongocrypt_key_destroy (head->doc);
+         _mongocrypt_buffer_cleanup (&head->decrypted_key_material);
+      }
+      mc_IndexKeyTokens_destroy (head->tokens);
       _mongocrypt_kms_ctx_cleanup (&head->kms);
 
       bson_free (head);
@@ -1052,12 +1367,15 @@ _destroy_keys_returned (key_returned_t *head)
 void
 _mongocrypt_key_broker_cleanup (_mongocrypt_key_broker_t *kb)
 {
+   _release_key_fetches (kb);
+   _release_refresh_claims (kb, NULL);
    mongocrypt_status_destroy (kb->status);
    _mongocrypt_buffer_cleanup (&kb->filter);
    /* Delete all linked lists */
    _destroy_keys_returned (kb->keys_returned);
    _destroy_keys_returned (kb->keys_cached);
    _destroy_key_requests (kb->key_requests);
+   _destroy_key_requests (kb->key_refreshes);
    _mongocrypt_kms_ctx_cleanup (&kb->auth_request_azure.kms);
    _mongocrypt_kms_ctx_cleanup (&kb->auth_request_gcp.kms);
 }
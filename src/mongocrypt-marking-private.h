@@ -20,6 +20,8 @@
 #include "mc-fle2-encryption-placeholder-private.h"
 #include "mongocrypt-private.h"
 #include "mongocrypt-ciphertext-private.h"
+#include "mongocrypt-crypto-private.h"
+#include "mongocrypt-key-broker-private.h"
 
 typedef enum {
    MONGOCRYPT_MARKING_FLE1_BY_ID,
@@ -64,5 +66,38 @@ _mongocrypt_marking_to_ciphertext (void *ctx,
                                    mongocrypt_status_t *status)
    MONGOCRYPT_WARN_UNUSED_RESULT;
 
+/* The work to encrypt one FLE1 marking, split so the cipher work can run on
+ * another thread. _mongocrypt_fle1_job_prepare looks up the key and generates
+ * any random iv. _mongocrypt_fle1_job_run does only the cipher work and reads
+ * no shared state besides the crypto hooks. */
+typedef struct {
+   mongocrypt_encryption_algorithm_t algorithm;
+   _mongocrypt_buffer_t plaintext;
+   _mongocrypt_buffer_t iv;
+   _mongocrypt_buffer_t associated_data;
+   _mongocrypt_buffer_t key_material;
+   /* The precomputed state of key_material. May be NULL. */
+   const _mongocrypt_key_state_t *key_state;
+} _mongocrypt_fle1_job_t;
+
+/* Always call _mongocrypt_fle1_job_cleanup on @job, even on failure. */
+bool
+_mongocrypt_fle1_job_prepare (_mongocrypt_key_broker_t *kb,
+                              _mongocrypt_marking_t *marking,
+                              _mongocrypt_ciphertext_t *ciphertext,
+                              _mongocrypt_fle1_job_t *job,
+                              mongocrypt_status_t *status)
+   MONGOCRYPT_WARN_UNUSED_RESULT;
+
+bool
+_mongocrypt_fle1_job_run (_mongocrypt_crypto_t *crypto,
+                          _mongocrypt_ciphertext_t *ciphertext,
+                          _mongocrypt_fle1_job_t *job,
+                          mongocrypt_status_t *status)
+   MONGOCRYPT_WARN_UNUSED_RESULT;
+
+void
+_mongocrypt_fle1_job_cleanup (_mongocrypt_fle1_job_t *job);
+
 
 #endif /* MONGOCRYPT_MARKING_PRIVATE_H */
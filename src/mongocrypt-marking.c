@@ -189,14 +189,15 @@ _mongocrypt_marking_cleanup (_mongocrypt_marking_t *marking)
 
 /**
  * Calculates:
- * E?CToken = HMAC(collectionLevel1Token, n)
  * E?CDerivedFromDataToken = HMAC(E?CToken, value)
  * E?CDerivedFromDataTokenAndCounter = HMAC(E?CDerivedFromDataToken, c)
  *
  * E?C = EDC|ESC|ECC
- * n = 1 for EDC, 2 for ESC, 3 for ECC
  * c = maxContentionCounter
  *
+ * E?CToken does not depend on the value, and is taken from the index key's
+ * mc_IndexKeyTokens_t.
+ *
  * E?CDerivedFromDataTokenAndCounter is saved to out,
  * which is initialized even on failure.
  */
@@ -204,7 +205,7 @@ _mongocrypt_marking_cleanup (_mongocrypt_marking_t *marking)
    static bool _fle2_derive_##Name##_token (                                   \
       _mongocrypt_crypto_t *crypto,                                            \
       _mongocrypt_buffer_t *out,                                               \
-      const mc_CollectionsLevel1Token_t *level1Token,                          \
+      const mc_##Name##Token_t *token,                                         \
       const _mongocrypt_buffer_t *value,                                       \
       bool useCounter,                                                         \
       int64_t counter,                                                         \
@@ -212,15 +213,8 @@ _mongocrypt_marking_cleanup (_mongocrypt_marking_t *marking)
    {                                                                           \
       _mongocrypt_buffer_init (out);                                           \
                                                                                \
-      mc_##Name##Token_t *token =                                              \
-         mc_##Name##Token_new (crypto, level1Token, status);                   \
-      if (!token) {                                                            \
-         return false;                                                         \
-      }                                                                        \
-                                                                               \
       mc_##Name##DerivedFromDataToken_t *fromDataToken =                       \
          mc_##Name##DerivedFromDataToken_new (crypto, token, value, status);   \
-      mc_##Name##Token_destroy (token);                                        \
       if (!fromDataToken) {                                                    \
          return false;                                                         \
       }                                                                        \
@@ -332,8 +326,7 @@ _fle2_placeholder_aead_encrypt (_mongocrypt_key_broker_t *kb,
 
 // Field derivations shared by both INSERT and FIND payloads.
 typedef struct {
-   _mongocrypt_buffer_t tokenKey;
-   mc_CollectionsLevel1Token_t *collectionsLevel1Token;
+   const mc_IndexKeyTokens_t *tokens; /* owned by the key broker */
    _mongocrypt_buffer_t edcDerivedToken;
    _mongocrypt_buffer_t escDerivedToken;
    _mongocrypt_buffer_t eccDerivedToken;
@@ -342,8 +335,6 @@ typedef struct {
 static void
 _FLE2EncryptedPayloadCommon_cleanup (_FLE2EncryptedPayloadCommon_t *common)
 {
-   _mongocrypt_buffer_cleanup (&common->tokenKey);
-   mc_CollectionsLevel1Token_destroy (common->collectionsLevel1Token);
    _mongocrypt_buffer_cleanup (&common->edcDerivedToken);
    _mongocrypt_buffer_cleanup (&common->escDerivedToken);
    _mongocrypt_buffer_cleanup (&common->eccDerivedToken);
@@ -361,43 +352,17 @@ _mongocrypt_fle2_placeholder_common (_mongocrypt_key_broker_t *kb,
                                      mongocrypt_status_t *status)
 {
    _mongocrypt_crypto_t *crypto = kb->crypt->crypto;
-   _mongocrypt_buffer_t indexKey = {0};
    memset (ret, 0, sizeof (*ret));
 
-   if (!_mongocrypt_key_broker_decrypted_key_by_id (
-          kb, indexKeyId, &indexKey)) {
-      CLIENT_ERR ("unable to retreive key");
-      goto fail;
-   }
-
-   if (indexKey.len != MONGOCRYPT_KEY_LEN) {
-      CLIENT_ERR ("invalid indexKey, expected len=%" PRIu32
-                  ", got len=%" PRIu32,
-                  MONGOCRYPT_KEY_LEN,
-                  indexKey.len);
-      goto fail;
-   }
-
-   // indexKey is 3 equal sized keys: [Ke][Km][TokenKey]
-   BSON_ASSERT (MONGOCRYPT_KEY_LEN == (3 * MONGOCRYPT_TOKEN_KEY_LEN));
-   if (!_mongocrypt_buffer_copy_from_data_and_size (
-          &ret->tokenKey,
-          indexKey.data + (2 * MONGOCRYPT_TOKEN_KEY_LEN),
-          MONGOCRYPT_TOKEN_KEY_LEN)) {
-      CLIENT_ERR ("failed allocating memory for token key");
-      goto fail;
-   }
-
-   ret->collectionsLevel1Token =
-      mc_CollectionsLevel1Token_new (crypto, &ret->tokenKey, status);
-   if (!ret->collectionsLevel1Token) {
-      CLIENT_ERR ("unable to derive collectionLevel1Token");
+   ret->tokens = _mongocrypt_key_broker_decrypted_key_tokens_by_id (
+      kb, indexKeyId, status);
+   if (!ret->tokens) {
       goto fail;
    }
 
    if (!_fle2_derive_EDC_token (crypto,
                                 &ret->edcDerivedToken,
-                                ret->collectionsLevel1Token,
+                                ret->tokens->edcToken,
                                 value,
                                 useCounter,
                                 maxContentionCounter,
@@ -407,7 +372,7 @@ _mongocrypt_fle2_placeholder_common (_mongocrypt_key_broker_t *kb,
 
    if (!_fle2_derive_ESC_token (crypto,
                                 &ret->escDerivedToken,
-                                ret->collectionsLevel1Token,
+                                ret->tokens->escToken,
                                 value,
                                 useCounter,
                                 maxContentionCounter,
@@ -417,7 +382,7 @@ _mongocrypt_fle2_placeholder_common (_mongocrypt_key_broker_t *kb,
 
    if (!_fle2_derive_ECC_token (crypto,
                                 &ret->eccDerivedToken,
-                                ret->collectionsLevel1Token,
+                                ret->tokens->eccToken,
                                 value,
                                 useCounter,
                                 maxContentionCounter,
@@ -425,12 +390,10 @@ _mongocrypt_fle2_placeholder_common (_mongocrypt_key_broker_t *kb,
       goto fail;
    }
 
-   _mongocrypt_buffer_cleanup (&indexKey);
    return true;
 
 fail:
    _FLE2EncryptedPayloadCommon_cleanup (ret);
-   _mongocrypt_buffer_cleanup (&indexKey);
    return false;
 }
 
@@ -443,7 +406,7 @@ _mongocrypt_fle2_placeholder_to_insert_update_ciphertext (
    mongocrypt_status_t *status)
 {
    _mongocrypt_crypto_t *crypto = kb->crypt->crypto;
-   _FLE2EncryptedPayloadCommon_t common = {{0}};
+   _FLE2EncryptedPayloadCommon_t common = {0};
    _mongocrypt_buffer_t value = {0};
    mc_FLE2EncryptionPlaceholder_t *placeholder = &marking->fle2;
    mc_FLE2InsertUpdatePayload_t payload;
@@ -494,19 +457,13 @@ _mongocrypt_fle2_placeholder_to_insert_update_ciphertext (
                                        payload.eccDerivedToken};
       _mongocrypt_buffer_t p;
       _mongocrypt_buffer_concat (&p, tokens, 2);
-      mc_ECOCToken_t *ecocToken =
-         mc_ECOCToken_new (crypto, common.collectionsLevel1Token, status);
-      if (!ecocToken) {
-         _mongocrypt_buffer_cleanup (&p);
-         goto fail;
-      }
-      res = _fle2_placeholder_aes_ctr_encrypt (kb,
-                                               mc_ECOCToken_get (ecocToken),
-                                               &p,
-                                               &payload.encryptedTokens,
-                                               status);
+      res = _fle2_placeholder_aes_ctr_encrypt (
+         kb,
+         mc_ECOCToken_get (common.tokens->ecocToken),
+         &p,
+         &payload.encryptedTokens,
+         status);
       _mongocrypt_buffer_cleanup (&p);
-      mc_ECOCToken_destroy (ecocToken);
       if (!res) {
          goto fail;
       }
@@ -531,18 +488,10 @@ _mongocrypt_fle2_placeholder_to_insert_update_ciphertext (
    }
 
    // e := collectionLevel1Token
-   {
-      mc_ServerDataEncryptionLevel1Token_t *serverToken =
-         mc_ServerDataEncryptionLevel1Token_new (
-            crypto, &common.tokenKey, status);
-      if (!serverToken) {
-         goto fail;
-      }
-      _mongocrypt_buffer_copy_to (
-         mc_ServerDataEncryptionLevel1Token_get (serverToken),
-         &payload.serverEncryptionToken);
-      mc_ServerDataEncryptionLevel1Token_destroy (serverToken);
-   }
+   _mongocrypt_buffer_copy_to (
+      mc_ServerDataEncryptionLevel1Token_get (
+         common.tokens->serverDataEncryptionLevel1Token),
+      &payload.serverEncryptionToken);
 
    {
       bson_t out;
@@ -572,7 +521,7 @@ _mongocrypt_fle2_placeholder_to_find_ciphertext (
    _mongocrypt_ciphertext_t *ciphertext,
    mongocrypt_status_t *status)
 {
-   _FLE2EncryptedPayloadCommon_t common = {{0}};
+   _FLE2EncryptedPayloadCommon_t common = {0};
    _mongocrypt_buffer_t value = {0};
    mc_FLE2EncryptionPlaceholder_t *placeholder = &marking->fle2;
    mc_FLE2FindEqualityPayload_t payload;
@@ -671,37 +620,35 @@ fail:
    return res;
 }
 
-static bool
-_mongocrypt_fle1_marking_to_ciphertext (_mongocrypt_key_broker_t *kb,
-                                        _mongocrypt_marking_t *marking,
-                                        _mongocrypt_ciphertext_t *ciphertext,
-                                        mongocrypt_status_t *status)
+bool
+_mongocrypt_fle1_job_prepare (_mongocrypt_key_broker_t *kb,
+                              _mongocrypt_marking_t *marking,
+                              _mongocrypt_ciphertext_t *ciphertext,
+                              _mongocrypt_fle1_job_t *job,
+                              mongocrypt_status_t *status)
 {
-   _mongocrypt_buffer_t plaintext;
-   _mongocrypt_buffer_t iv;
-   _mongocrypt_buffer_t associated_data;
-   _mongocrypt_buffer_t key_material;
    _mongocrypt_buffer_t key_id;
    bool ret = false;
    bool key_found;
-   uint32_t bytes_written;
 
    BSON_ASSERT ((marking->type == MONGOCRYPT_MARKING_FLE1_BY_ID) ||
                 (marking->type == MONGOCRYPT_MARKING_FLE1_BY_ALTNAME));
 
-   _mongocrypt_buffer_init (&plaintext);
-   _mongocrypt_buffer_init (&associated_data);
-   _mongocrypt_buffer_init (&iv);
+   _mongocrypt_buffer_init (&job->plaintext);
+   _mongocrypt_buffer_init (&job->associated_data);
+   _mongocrypt_buffer_init (&job->iv);
+   _mongocrypt_buffer_init (&job->key_material);
    _mongocrypt_buffer_init (&key_id);
-   _mongocrypt_buffer_init (&key_material);
+   job->algorithm = marking->algorithm;
+   job->key_state = NULL;
 
    /* Get the decrypted key for this marking. */
    if (marking->type == MONGOCRYPT_MARKING_FLE1_BY_ALTNAME) {
       key_found = _mongocrypt_key_broker_decrypted_key_by_name (
-         kb, &marking->key_alt_name, &key_material, &key_id);
+         kb, &marking->key_alt_name, &job->key_material, &key_id);
    } else if (!_mongocrypt_buffer_empty (&marking->key_id)) {
       key_found = _mongocrypt_key_broker_decrypted_key_by_id (
-         kb, &marking->key_id, &key_material);
+         kb, &marking->key_id, &job->key_material);
       _mongocrypt_buffer_copy_to (&marking->key_id, &key_id);
    } else {
       CLIENT_ERR ("marking must have either key_id or key_alt_name");
@@ -713,6 +660,9 @@ _mongocrypt_fle1_marking_to_ciphertext (_mongocrypt_key_broker_t *kb,
       goto fail;
    }
 
+   job->key_state =
+      _mongocrypt_key_broker_decrypted_key_state_by_id (kb, &key_id);
+
    _mongocrypt_ciphertext_init (ciphertext);
    ciphertext->original_bson_type = (uint8_t) bson_iter_type (&marking->v_iter);
    if (marking->algorithm == MONGOCRYPT_ENCRYPTION_ALGORITHM_DETERMINISTIC) {
@@ -723,58 +673,33 @@ _mongocrypt_fle1_marking_to_ciphertext (_mongocrypt_key_broker_t *kb,
       ciphertext->blob_subtype = MC_SUBTYPE_FLE1RandomEncryptedValue;
    }
    _mongocrypt_buffer_copy_to (&key_id, &ciphertext->key_id);
-   if (!_mongocrypt_ciphertext_serialize_associated_data (ciphertext,
-                                                          &associated_data)) {
+   if (!_mongocrypt_ciphertext_serialize_associated_data (
+          ciphertext, &job->associated_data)) {
       CLIENT_ERR ("could not serialize associated data");
       goto fail;
    }
 
-   _mongocrypt_buffer_from_iter (&plaintext, &marking->v_iter);
-   ciphertext->data.len = _mongocrypt_calculate_ciphertext_len (plaintext.len);
+   _mongocrypt_buffer_from_iter (&job->plaintext, &marking->v_iter);
+   ciphertext->data.len =
+      _mongocrypt_calculate_ciphertext_len (job->plaintext.len);
    ciphertext->data.data = bson_malloc (ciphertext->data.len);
    BSON_ASSERT (ciphertext->data.data);
 
    ciphertext->data.owned = true;
 
+   _mongocrypt_buffer_resize (&job->iv, MONGOCRYPT_IV_LEN);
    switch (marking->algorithm) {
    case MONGOCRYPT_ENCRYPTION_ALGORITHM_DETERMINISTIC:
-      /* Use deterministic encryption. */
-      _mongocrypt_buffer_resize (&iv, MONGOCRYPT_IV_LEN);
-      ret = _mongocrypt_calculate_deterministic_iv (kb->crypt->crypto,
-                                                    &key_material,
-                                                    &plaintext,
-                                                    &associated_data,
-                                                    &iv,
-                                                    status);
-      if (!ret) {
-         goto fail;
-      }
-
-      ret = _mongocrypt_do_encryption (kb->crypt->crypto,
-                                       &iv,
-                                       &associated_data,
-                                       &key_material,
-                                       &plaintext,
-                                       &ciphertext->data,
-                                       &bytes_written,
-                                       status);
+      /* The deterministic iv is derived from the plaintext by
+       * _mongocrypt_fle1_job_run. */
       break;
    case MONGOCRYPT_ENCRYPTION_ALGORITHM_RANDOM:
       /* Use randomized encryption.
        * In this case, we must generate a new, random iv. */
-      _mongocrypt_buffer_resize (&iv, MONGOCRYPT_IV_LEN);
       if (!_mongocrypt_random (
-             kb->crypt->crypto, &iv, MONGOCRYPT_IV_LEN, status)) {
+             kb->crypt->crypto, &job->iv, MONGOCRYPT_IV_LEN, status)) {
          goto fail;
       }
-      ret = _mongocrypt_do_encryption (kb->crypt->crypto,
-                                       &iv,
-                                       &associated_data,
-                                       &key_material,
-                                       &plaintext,
-                                       &ciphertext->data,
-                                       &bytes_written,
-                                       status);
       break;
    default:
       /* Error. */
@@ -782,20 +707,100 @@ _mongocrypt_fle1_marking_to_ciphertext (_mongocrypt_key_broker_t *kb,
       goto fail;
    }
 
-   if (!ret) {
-      goto fail;
+   ret = true;
+
+fail:
+   _mongocrypt_buffer_cleanup (&key_id);
+   return ret;
+}
+
+
+bool
+_mongocrypt_fle1_job_run (_mongocrypt_crypto_t *crypto,
+                          _mongocrypt_ciphertext_t *ciphertext,
+                          _mongocrypt_fle1_job_t *job,
+                          mongocrypt_status_t *status)
+{
+   uint32_t bytes_written;
+   bool ok;
+
+   if (job->algorithm == MONGOCRYPT_ENCRYPTION_ALGORITHM_DETERMINISTIC) {
+      /* Use deterministic encryption. */
+      if (job->key_state) {
+         ok = _mongocrypt_calculate_deterministic_iv_with_key_state (
+            crypto,
+            job->key_state,
+            &job->plaintext,
+            &job->associated_data,
+            &job->iv,
+            status);
+      } else {
+         ok = _mongocrypt_calculate_deterministic_iv (crypto,
+                                                      &job->key_material,
+                                                      &job->plaintext,
+                                                      &job->associated_data,
+                                                      &job->iv,
+                                                      status);
+      }
+      if (!ok) {
+         return false;
+      }
+   }
+
+   if (job->key_state) {
+      ok = _mongocrypt_do_encryption_with_key_state (crypto,
+                                                     &job->iv,
+                                                     &job->associated_data,
+                                                     job->key_state,
+                                                     &job->plaintext,
+                                                     &ciphertext->data,
+                                                     &bytes_written,
+                                                     status);
+   } else {
+      ok = _mongocrypt_do_encryption (crypto,
+                                      &job->iv,
+                                      &job->associated_data,
+                                      &job->key_material,
+                                      &job->plaintext,
+                                      &ciphertext->data,
+                                      &bytes_written,
+                                      status);
+   }
+   if (!ok) {
+      return false;
    }
 
    BSON_ASSERT (bytes_written == ciphertext->data.len);
+   return true;
+}
 
-   ret = true;
 
-fail:
-   _mongocrypt_buffer_cleanup (&iv);
-   _mongocrypt_buffer_cleanup (&key_id);
-   _mongocrypt_buffer_cleanup (&plaintext);
-   _mongocrypt_buffer_cleanup (&associated_data);
-   _mongocrypt_buffer_cleanup (&key_material);
+void
+_mongocrypt_fle1_job_cleanup (_mongocrypt_fle1_job_t *job)
+{
+   if (!job) {
+      return;
+   }
+
+   _mongocrypt_buffer_cleanup (&job->iv);
+   _mongocrypt_buffer_cleanup (&job->plaintext);
+   _mongocrypt_buffer_cleanup (&job->associated_data);
+   _mongocrypt_buffer_cleanup (&job->key_material);
+}
+
+
+static bool
+_mongocrypt_fle1_marking_to_ciphertext (_mongocrypt_key_broker_t *kb,
+                                        _mongocrypt_marking_t *marking,
+                                        _mongocrypt_ciphertext_t *ciphertext,
+                                        mongocrypt_status_t *status)
+{
+   _mongocrypt_fle1_job_t job;
+   bool ret;
+
+   ret = _mongocrypt_fle1_job_prepare (kb, marking, ciphertext, &job, status) &&
+         _mongocrypt_fle1_job_run (kb->crypt->crypto, ciphertext, &job, status);
+   _mongocrypt_fle1_job_cleanup (&job);
    return ret;
 }
 
@@ -84,7 +84,29 @@ typedef struct {
    mstr csfle_lib_override_path;
 
    bool use_need_kms_credentials_state;
+   bool use_waiting_on_keys_state;
    bool bypass_query_analysis;
+
+   /* Key cache tuning. Zero values keep the cache defaults. */
+   uint64_t key_cache_expiration_ms;
+   uint32_t key_cache_max_entries;
+   uint64_t key_cache_max_bytes;
+   uint64_t key_cache_refresh_window_ms;
+
+   /* Parallel finalize. At most one of these is set. */
+   uint32_t parallel_finalize_threads;
+   mongocrypt_parallel_for_fn parallel_for_fn;
+   void *parallel_for_ctx;
+
+   /* The number of idle csfle query analyzers kept for reuse. */
+   uint32_t csfle_query_analyzer_pool_size;
+
+   /* The number of command shapes in the marking cache. 0 disables it. */
+   uint32_t marking_cache_max_entries;
+
+   /* How long a namespace without a schema is known to need no encryption.
+    * 0 disables the plaintext fast path. */
+   uint64_t plaintext_collinfo_expiration_ms;
 } _mongocrypt_opts_t;
 
 
@@ -224,6 +224,22 @@ _mongocrypt_opts_validate (_mongocrypt_opts_t *opts,
           &opts->encrypted_field_config_map, &opts->schema_map, status)) {
       return false;
    }
+   if (opts->key_cache_refresh_window_ms > 0) {
+      uint64_t expiration_ms = opts->key_cache_expiration_ms
+                                  ? opts->key_cache_expiration_ms
+                                  : CACHE_EXPIRATION_MS;
+
+      if (opts->key_cache_refresh_window_ms >= expiration_ms) {
+         CLIENT_ERR ("key cache refresh window must be less than the key "
+                     "cache expiration");
+         return false;
+      }
+   }
+   if (opts->parallel_finalize_threads > 0 && opts->parallel_for_fn) {
+      CLIENT_ERR ("cannot set both a parallel finalize handler and a parallel "
+                  "finalize thread count");
+      return false;
+   }
    return _mongocrypt_opts_kms_providers_validate (&opts->kms_providers,
                                                    status);
 }
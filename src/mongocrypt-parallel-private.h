@@ -0,0 +1,57 @@
+/*
+ * Copyright 2022-present MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MONGOCRYPT_PARALLEL_PRIVATE_H
+#define MONGOCRYPT_PARALLEL_PRIVATE_H
+
+#include "mongocrypt.h"
+#include "mongocrypt-status-private.h"
+
+/* Below this many tasks, _mongocrypt_parallel_for runs the tasks inline. The
+ * cost of waking workers outweighs the cipher work of a few small values. */
+#define MONGOCRYPT_PARALLEL_MIN_TASKS 4
+
+typedef struct _mongocrypt_thread_pool_t _mongocrypt_thread_pool_t;
+
+/* A fixed set of worker threads that runs one parallel-for at a time. A
+ * parallel-for issued while the pool is busy runs on the calling thread. */
+_mongocrypt_thread_pool_t *
+_mongocrypt_thread_pool_new (uint32_t num_threads, mongocrypt_status_t *status);
+
+void
+_mongocrypt_thread_pool_destroy (_mongocrypt_thread_pool_t *pool);
+
+void
+_mongocrypt_thread_pool_run (_mongocrypt_thread_pool_t *pool,
+                             uint32_t count,
+                             mongocrypt_task_fn task,
+                             void *task_ctx);
+
+/* Returns true if @crypt was configured with a parallel finalize handler or
+ * thread pool. */
+bool
+_mongocrypt_parallel_finalize_enabled (const mongocrypt_t *crypt);
+
+/* Runs @task for every index in [0, @count) with the configured handler or
+ * thread pool, and returns once all tasks finished. Runs the tasks inline if
+ * parallel finalize is not enabled. */
+void
+_mongocrypt_parallel_for (mongocrypt_t *crypt,
+                          uint32_t count,
+                          mongocrypt_task_fn task,
+                          void *task_ctx);
+
+#endif /* MONGOCRYPT_PARALLEL_PRIVATE_H */
@@ -0,0 +1,212 @@
+/*
+ * Copyright 2022-present MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mongocrypt-parallel-private.h"
+#include "mongocrypt-private.h"
+#include "mongocrypt-thread-private.h"
+
+struct _mongocrypt_thread_pool_t {
+   mongocrypt_mutex_t mutex;
+   /* Signaled when a parallel-for starts, or on shutdown. */
+   mongocrypt_cond_t work_cond;
+   /* Signaled when the last task of a parallel-for finishes. */
+   mongocrypt_cond_t done_cond;
+   mongocrypt_thread_t *threads;
+   uint32_t num_threads;
+   bool shutdown;
+
+   /* The running parallel-for, protected by mutex. */
+   bool busy;
+   mongocrypt_task_fn task;
+   void *task_ctx;
+   uint32_t count;
+   /* The next index to claim. */
+   uint32_t next;
+   /* The number of tasks that have returned. */
+   uint32_t finished;
+};
+
+
+/* Claims and runs tasks until none are left. Called with the pool mutex held,
+ * and returns with it held. */
+static void
+_run_tasks (_mongocrypt_thread_pool_t *pool)
+{
+   while (pool->busy && pool->next < pool->count) {
+      uint32_t index = pool->next++;
+      mongocrypt_task_fn task = pool->task;
+      void *task_ctx = pool->task_ctx;
+
+      _mongocrypt_mutex_unlock (&pool->mutex);
+      task (task_ctx, index);
+      _mongocrypt_mutex_lock (&pool->mutex);
+
+      if (++pool->finished == pool->count) {
+         _mongocrypt_cond_signal (&pool->done_cond);
+      }
+   }
+}
+
+
+static void
+_worker (void *arg)
+{
+   _mongocrypt_thread_pool_t *pool = arg;
+
+   _mongocrypt_mutex_lock (&pool->mutex);
+   while (!pool->shutdown) {
+      if (pool->busy && pool->next < pool->count) {
+         _run_tasks (pool);
+         continue;
+      }
+      _mongocrypt_cond_wait (&pool->work_cond, &pool->mutex);
+   }
+   _mongocrypt_mutex_unlock (&pool->mutex);
+}
+
+
+_mongocrypt_thread_pool_t *
+_mongocrypt_thread_pool_new (uint32_t num_threads, mongocrypt_status_t *status)
+{
+   _mongocrypt_thread_pool_t *pool;
+
+   BSON_ASSERT (num_threads > 0);
+
+   pool = bson_malloc0 (sizeof (*pool));
+   BSON_ASSERT (pool);
+   _mongocrypt_mutex_init (&pool->mutex);
+   _mongocrypt_cond_init (&pool->work_cond);
+   _mongocrypt_cond_init (&pool->done_cond);
+   pool->threads = bson_malloc0 (sizeof (mongocrypt_thread_t) * num_threads);
+   BSON_ASSERT (pool->threads);
+
+   for (; pool->num_threads < num_threads; pool->num_threads++) {
+      if (!_mongocrypt_thread_create (
+             &pool->threads[pool->num_threads], _worker, pool)) {
+         CLIENT_ERR ("failed to start parallel finalize thread");
+         _mongocrypt_thread_pool_destroy (pool);
+         return NULL;
+      }
+   }
+
+   return pool;
+}
+
+
+void
+_mongocrypt_thread_pool_destroy (_mongocrypt_thread_pool_t *pool)
+{
+   uint32_t i;
+
+   if (!pool) {
+      return;
+   }
+
+   _mongocrypt_mutex_lock (&pool->mutex);
+   pool->shutdown = true;
+   _mongocrypt_cond_broadcast (&pool->work_cond);
+   _mongocrypt_mutex_unlock (&pool->mutex);
+
+   for (i = 0; i < pool->num_threads; i++) {
+      _mongocrypt_thread_join (pool->threads[i]);
+   }
+
+   _mongocrypt_cond_cleanup (&pool->work_cond);
+   _mongocrypt_cond_cleanup (&pool->done_cond);
+   _mongocrypt_mutex_cleanup (&pool->mutex);
+   bson_free (pool->threads);
+   bson_free (pool);
+}
+
+
+void
+_mongocrypt_thread_pool_run (_mongocrypt_thread_pool_t *pool,
+                             uint32_t count,
+                             mongocrypt_task_fn task,
+                             void *task_ctx)
+{
+   uint32_t i;
+
+   BSON_ASSERT (pool);
+
+   _mongocrypt_mutex_lock (&pool->mutex);
+   if (pool->busy) {
+      /* Another context is using the workers. Do not wait for them. */
+      _mongocrypt_mutex_unlock (&pool->mutex);
+      for (i = 0; i < count; i++) {
+         task (task_ctx, i);
+      }
+      return;
+   }
+
+   pool->busy = true;
+   pool->task = task;
+   pool->task_ctx = task_ctx;
+   pool->count = count;
+   pool->next = 0;
+   pool->finished = 0;
+   _mongocrypt_cond_broadcast (&pool->work_cond);
+
+   /* The calling thread works too. */
+   _run_tasks (pool);
+   while (pool->finished < pool->count) {
+      _mongocrypt_cond_wait (&pool->done_cond, &pool->mutex);
+   }
+
+   pool->busy = false;
+   pool->task = NULL;
+   pool->task_ctx = NULL;
+   _mongocrypt_mutex_unlock (&pool->mutex);
+}
+
+
+bool
+_mongocrypt_parallel_finalize_enabled (const mongocrypt_t *crypt)
+{
+   BSON_ASSERT (crypt);
+
+   return crypt->opts.parallel_for_fn || crypt->thread_pool;
+}
+
+
+void
+_mongocrypt_parallel_for (mongocrypt_t *crypt,
+                          uint32_t count,
+                          mongocrypt_task_fn task,
+                          void *task_ctx)
+{
+   uint32_t i;
+
+   BSON_ASSERT (crypt);
+   BSON_ASSERT (task);
+
+   if (count >= MONGOCRYPT_PARALLEL_MIN_TASKS) {
+      if (crypt->opts.parallel_for_fn) {
+         crypt->opts.parallel_for_fn (
+            crypt->opts.parallel_for_ctx, count, task, task_ctx);
+         return;
+      }
+
+      if (crypt->thread_pool) {
+         _mongocrypt_thread_pool_run (crypt->thread_pool, count, task, task_ctx);
+         return;
+      }
+   }
+
+   for (i = 0; i < count; i++) {
+      task (task_ctx, i);
+   }
+}
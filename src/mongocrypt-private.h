@@ -25,7 +25,10 @@
 #include "mongocrypt-log-private.h"
 #include "mongocrypt-buffer-private.h"
 #include "mongocrypt-cache-private.h"
+#include "mongocrypt-cache-collinfo-private.h"
+#include "mongocrypt-cache-encryption-information-private.h"
 #include "mongocrypt-cache-key-private.h"
+#include "mongocrypt-cache-marking-plan-private.h"
 #include "mongocrypt-mutex-private.h"
 #include "mongocrypt-opts-private.h"
 #include "mongocrypt-crypto-private.h"
@@ -123,17 +126,30 @@ struct _mongocrypt_t {
    /* The collinfo and key cache are protected with an internal mutex. */
    _mongocrypt_cache_t cache_collinfo;
    _mongocrypt_cache_t cache_key;
+   _mongocrypt_cache_t cache_encryption_information;
+   /* Only used if opts.marking_cache_max_entries is nonzero. */
+   _mongocrypt_cache_t cache_marking_plan;
    _mongocrypt_log_t log;
    mongocrypt_status_t *status;
    _mongocrypt_crypto_t *crypto;
    /* A counter, protected by mutex, for generating unique context ids */
    uint32_t ctx_counter;
+   /* Keys being fetched by a context, protected by mutex. Only used with
+    * use_waiting_on_keys_state. Empty once all contexts are destroyed. */
+   struct _key_fetch_t *key_fetches;
+   /* Worker threads for parallel finalize, or NULL. Started by
+    * mongocrypt_init if opts.parallel_finalize_threads is set. */
+   struct _mongocrypt_thread_pool_t *thread_pool;
    _mongocrypt_cache_oauth_t *cache_oauth_azure;
    _mongocrypt_cache_oauth_t *cache_oauth_gcp;
    /// A CSFLE DLL vtable, initialized by mongocrypt_init
    _mcr_csfle_v1_vtable csfle;
    /// Pointer to the global csfle_lib object. Should not be freed directly.
    mongo_csfle_v1_lib *csfle_lib;
+   /* Idle query analyzers created from csfle_lib, protected by mutex. At most
+    * opts.csfle_query_analyzer_pool_size are kept. */
+   mongo_csfle_v1_query_analyzer **csfle_query_analyzers;
+   uint32_t csfle_query_analyzers_len;
 };
 
 typedef enum {
@@ -171,6 +187,27 @@ _mongocrypt_parse_kms_providers (
    mongocrypt_status_t *status,
    _mongocrypt_log_t *log);
 
+/* The default for mongocrypt_setopt_csfle_query_analyzer_pool_size. */
+#define MONGOCRYPT_CSFLE_QUERY_ANALYZER_POOL_SIZE_DEFAULT 4
+
+/* The default for mongocrypt_setopt_plaintext_collinfo_expiration. */
+#define MONGOCRYPT_PLAINTEXT_COLLINFO_EXPIRATION_MS_DEFAULT CACHE_EXPIRATION_MS
+
+/* _mongocrypt_csfle_query_analyzer_acquire returns an idle query analyzer of
+ * @crypt, or creates one. Returns NULL and sets @status on error. Return the
+ * analyzer with _mongocrypt_csfle_query_analyzer_release. */
+mongo_csfle_v1_query_analyzer *
+_mongocrypt_csfle_query_analyzer_acquire (mongocrypt_t *crypt,
+                                          mongo_csfle_v1_status *status);
+
+/* _mongocrypt_csfle_query_analyzer_release keeps @qa for reuse if it is
+ * @reusable and the pool of @crypt has room, and destroys it otherwise. Pass
+ * false for @reusable if an operation on @qa failed. */
+void
+_mongocrypt_csfle_query_analyzer_release (mongocrypt_t *crypt,
+                                          mongo_csfle_v1_query_analyzer *qa,
+                                          bool reusable);
+
 /* _mongocrypt_needs_credentials returns true if @crypt was configured to
  * request credentials for any KMS provider. */
 bool
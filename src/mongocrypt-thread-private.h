@@ -0,0 +1,59 @@
+/*
+ * Copyright 2022-present MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MONGOCRYPT_THREAD_PRIVATE_H
+#define MONGOCRYPT_THREAD_PRIVATE_H
+
+#include "mongocrypt-mutex-private.h"
+
+#if defined(BSON_OS_UNIX)
+#include <pthread.h>
+#define mongocrypt_thread_t pthread_t
+#define mongocrypt_cond_t pthread_cond_t
+#else
+#define mongocrypt_thread_t HANDLE
+#define mongocrypt_cond_t CONDITION_VARIABLE
+#endif
+
+typedef void (*_mongocrypt_thread_fn_t) (void *arg);
+
+/* Returns false if the thread could not be started. */
+bool
+_mongocrypt_thread_create (mongocrypt_thread_t *thread,
+                           _mongocrypt_thread_fn_t fn,
+                           void *arg);
+
+void
+_mongocrypt_thread_join (mongocrypt_thread_t thread);
+
+void
+_mongocrypt_cond_init (mongocrypt_cond_t *cond);
+
+void
+_mongocrypt_cond_cleanup (mongocrypt_cond_t *cond);
+
+/* Atomically unlocks @mutex and waits for @cond to be signaled. @mutex is
+ * locked again on return. Spurious wakeups are possible. */
+void
+_mongocrypt_cond_wait (mongocrypt_cond_t *cond, mongocrypt_mutex_t *mutex);
+
+void
+_mongocrypt_cond_signal (mongocrypt_cond_t *cond);
+
+void
+_mongocrypt_cond_broadcast (mongocrypt_cond_t *cond);
+
+#endif /* MONGOCRYPT_THREAD_PRIVATE_H */
@@ -56,4 +56,33 @@ _mongocrypt_transform_binary_in_bson (_mongocrypt_transform_callback_t cb,
    MONGOCRYPT_WARN_UNUSED_RESULT;
 
 
+/* A set of dotted field paths, like "a.b.c", stored as a trie of path
+ * components. */
+typedef struct __mongocrypt_path_trie_t _mongocrypt_path_trie_t;
+
+_mongocrypt_path_trie_t *
+_mongocrypt_path_trie_new (void);
+
+void
+_mongocrypt_path_trie_add (_mongocrypt_path_trie_t *trie, const char *path);
+
+void
+_mongocrypt_path_trie_destroy (_mongocrypt_path_trie_t *trie);
+
+
+/* Like _mongocrypt_transform_binary_in_bson, but only matches values at or
+ * below one of @paths. Arrays on the way to a path are descended into without
+ * consuming a path component. Elements off the paths are copied whole, without
+ * being iterated. */
+bool
+_mongocrypt_transform_binary_in_bson_at_paths (
+   _mongocrypt_transform_callback_t cb,
+   void *ctx,
+   traversal_match_t match,
+   const _mongocrypt_path_trie_t *paths,
+   bson_iter_t *iter,
+   bson_t *out,
+   mongocrypt_status_t *status) MONGOCRYPT_WARN_UNUSED_RESULT;
+
+
 #endif /* MONGOCRYPT_TRAVERSE_UTIL_H */
@@ -23,6 +23,23 @@
 #include "mongocrypt-traverse-util-private.h"
 #include "mc-fle-blob-subtype-private.h"
 
+/* A scan for byte offsets that may be a matching binary subtype 6 value.
+ * A binary element is laid out as:
+ *
+ *    0x05 <key> 0x00 <int32 length> <subtype> <data>
+ *
+ * So a match has the subtype byte 6, preceded five bytes earlier by the NUL
+ * ending its key, and followed by a matching first byte. Any such offset is a
+ * candidate. A range of bytes without a candidate cannot contain a match, so
+ * it need not be iterated. The scan finds candidates in increasing order with
+ * memchr, which is vectorized by common C libraries. */
+typedef struct {
+   const uint8_t *begin;
+   const uint8_t *end;
+   const uint8_t *next; /* the next candidate, or end if there are none. */
+   traversal_match_t match;
+} _candidate_scan_t;
+
 typedef struct {
    void *ctx;
    bson_iter_t iter;
@@ -33,8 +50,89 @@ typedef struct {
    mongocrypt_status_t *status;
    traversal_match_t match;
    bson_t child;
+   _candidate_scan_t *scan; /* shared by all levels of the recursion. */
+   /* if set, only values on these paths are matched. */
+   const _mongocrypt_path_trie_t *paths;
+   bool in_array; /* array elements do not consume a path component. */
 } _recurse_state_t;
 
+struct __mongocrypt_path_trie_t {
+   char *component; /* NULL for the root. */
+   size_t component_len;
+   /* true if a path ends here. Everything below it is matched. */
+   bool terminal;
+   struct __mongocrypt_path_trie_t *children;
+   struct __mongocrypt_path_trie_t *next;
+};
+
+_mongocrypt_path_trie_t *
+_mongocrypt_path_trie_new (void)
+{
+   return bson_malloc0 (sizeof (_mongocrypt_path_trie_t));
+}
+
+static _mongocrypt_path_trie_t *
+_path_trie_child (const _mongocrypt_path_trie_t *trie,
+                  const char *component,
+                  size_t component_len)
+{
+   _mongocrypt_path_trie_t *child;
+
+   for (child = trie->children; child; child = child->next) {
+      if (child->component_len == component_len &&
+          0 == memcmp (child->component, component, component_len)) {
+         return child;
+      }
+   }
+   return NULL;
+}
+
+void
+_mongocrypt_path_trie_add (_mongocrypt_path_trie_t *trie, const char *path)
+{
+   BSON_ASSERT_PARAM (trie);
+   BSON_ASSERT_PARAM (path);
+
+   while (!trie->terminal) {
+      const char *dot = strchr (path, '.');
+      size_t len = dot ? (size_t) (dot - path) : strlen (path);
+      _mongocrypt_path_trie_t *child = _path_trie_child (trie, path, len);
+
+      if (!child) {
+         child = _mongocrypt_path_trie_new ();
+         child->component = bson_strndup (path, len);
+         child->component_len = len;
+         child->next = trie->children;
+         trie->children = child;
+      }
+      trie = child;
+      if (!dot) {
+         trie->terminal = true;
+         break;
+      }
+      path = dot + 1;
+   }
+}
+
+void
+_mongocrypt_path_trie_destroy (_mongocrypt_path_trie_t *trie)
+{
+   _mongocrypt_path_trie_t *child;
+
+   if (!trie) {
+      return;
+   }
+   child = trie->children;
+   while (child) {
+      _mongocrypt_path_trie_t *next = child->next;
+
+      _mongocrypt_path_trie_destroy (child);
+      child = next;
+   }
+   bson_free (trie->component);
+   bson_free (trie);
+}
+
 static bool
 _check_first_byte (uint8_t byte, traversal_match_t match)
 {
@@ -54,6 +152,60 @@ _check_first_byte (uint8_t byte, traversal_match_t match)
    return false;
 }
 
+/* Sets scan->next to the first candidate at or after @from. */
+static void
+_candidate_scan_from (_candidate_scan_t *scan, const uint8_t *from)
+{
+   const uint8_t *p = from;
+
+   /* The subtype is preceded by at least the document length, the element
+    * type, an empty key, and the binary length. */
+   if (p < scan->begin + 10) {
+      p = scan->begin + 10;
+   }
+
+   /* Leave room for the first byte of data. */
+   while (p + 1 < scan->end) {
+      p = memchr (p, 6, (size_t) (scan->end - 1 - p));
+      if (!p) {
+         break;
+      }
+      if (p[-5] == 0 && _check_first_byte (p[1], scan->match)) {
+         scan->next = p;
+         return;
+      }
+      p++;
+   }
+   scan->next = scan->end;
+}
+
+/* Returns true if @len bytes at @data may contain a match. */
+static bool
+_candidate_scan_range (_candidate_scan_t *scan,
+                       const uint8_t *data,
+                       uint32_t len)
+{
+   if (!data || data < scan->begin || data + len > scan->end) {
+      /* Not part of the scanned document. */
+      return true;
+   }
+   if (scan->next < data) {
+      _candidate_scan_from (scan, data);
+   }
+   return scan->next < data + len;
+}
+
+static void
+_candidate_scan_init (_candidate_scan_t *scan,
+                      const bson_iter_t *iter,
+                      traversal_match_t match)
+{
+   scan->begin = iter->raw;
+   scan->end = iter->raw + iter->len;
+   scan->match = match;
+   _candidate_scan_from (scan, scan->begin);
+}
+
 static bool
 _recurse (_recurse_state_t *state)
 {
@@ -61,7 +213,33 @@ _recurse (_recurse_state_t *state)
 
    status = state->status;
    while (bson_iter_next (&state->iter)) {
-      if (BSON_ITER_HOLDS_BINARY (&state->iter)) {
+      /* The paths to follow below this element, if any. */
+      const _mongocrypt_path_trie_t *child_paths = NULL;
+
+      if (state->paths) {
+         const _mongocrypt_path_trie_t *node = state->paths;
+
+         if (!state->in_array) {
+            node = _path_trie_child (state->paths,
+                                     bson_iter_key (&state->iter),
+                                     bson_iter_key_len (&state->iter));
+         }
+         if (!node) {
+            /* Not on a path. Copy the element whole. */
+            if (state->copy) {
+               bson_append_value (state->copy,
+                                  bson_iter_key (&state->iter),
+                                  bson_iter_key_len (&state->iter),
+                                  bson_iter_value (&state->iter));
+            }
+            continue;
+         }
+         if (!node->terminal) {
+            child_paths = node;
+         }
+      }
+
+      if (BSON_ITER_HOLDS_BINARY (&state->iter) && !child_paths) {
          _mongocrypt_buffer_t value;
 
          BSON_ASSERT (
@@ -94,6 +272,28 @@ _recurse (_recurse_state_t *state)
          /* fall through and copy */
       }
 
+      if (BSON_ITER_HOLDS_ARRAY (&state->iter) ||
+          BSON_ITER_HOLDS_DOCUMENT (&state->iter)) {
+         const uint8_t *data = NULL;
+         uint32_t len = 0;
+
+         if (BSON_ITER_HOLDS_ARRAY (&state->iter)) {
+            bson_iter_array (&state->iter, &len, &data);
+         } else {
+            bson_iter_document (&state->iter, &len, &data);
+         }
+         if (!_candidate_scan_range (state->scan, data, len)) {
+            /* Nothing to match below. Copy the subtree whole. */
+            if (state->copy) {
+               bson_append_value (state->copy,
+                                  bson_iter_key (&state->iter),
+                                  bson_iter_key_len (&state->iter),
+                                  bson_iter_value (&state->iter));
+            }
+            continue;
+         }
+      }
+
       if (BSON_ITER_HOLDS_ARRAY (&state->iter)) {
          _recurse_state_t child_state;
          bool ret;
@@ -103,6 +303,8 @@ _recurse (_recurse_state_t *state)
             CLIENT_ERR ("error recursing into array");
             return false;
          }
+         child_state.paths = child_paths;
+         child_state.in_array = true;
 
          if (state->copy) {
             bson_append_array_begin (state->copy,
@@ -131,6 +333,8 @@ _recurse (_recurse_state_t *state)
             CLIENT_ERR ("error recursing into document");
             return false;
          }
+         child_state.paths = child_paths;
+         child_state.in_array = false;
          /* TODO: check for errors everywhere. */
          if (state->copy) {
             bson_append_document_begin (state->copy,
@@ -165,14 +369,16 @@ _recurse (_recurse_state_t *state)
    return true;
 }
 
-bool
-_mongocrypt_transform_binary_in_bson (_mongocrypt_transform_callback_t cb,
-                                      void *ctx,
-                                      traversal_match_t match,
-                                      bson_iter_t *iter,
-                                      bson_t *out,
-                                      mongocrypt_status_t *status)
+static bool
+_transform (_mongocrypt_transform_callback_t cb,
+            void *ctx,
+            traversal_match_t match,
+            const _mongocrypt_path_trie_t *paths,
+            bson_iter_t *iter,
+            bson_t *out,
+            mongocrypt_status_t *status)
 {
+   _candidate_scan_t scan;
    _recurse_state_t starting_state = {ctx,
                                       *iter,
                                       out /* copy */,
@@ -181,11 +387,40 @@ _mongocrypt_transform_binary_in_bson (_mongocrypt_transform_callback_t cb,
                                       cb,
                                       status,
                                       match,
-                                      {0}};
+                                      {0},
+                                      &scan,
+                                      paths,
+                                      false /* in_array */};
 
+   _candidate_scan_init (&scan, iter, match);
    return _recurse (&starting_state);
 }
 
+bool
+_mongocrypt_transform_binary_in_bson (_mongocrypt_transform_callback_t cb,
+                                      void *ctx,
+                                      traversal_match_t match,
+                                      bson_iter_t *iter,
+                                      bson_t *out,
+                                      mongocrypt_status_t *status)
+{
+   return _transform (cb, ctx, match, NULL /* paths */, iter, out, status);
+}
+
+bool
+_mongocrypt_transform_binary_in_bson_at_paths (
+   _mongocrypt_transform_callback_t cb,
+   void *ctx,
+   traversal_match_t match,
+   const _mongocrypt_path_trie_t *paths,
+   bson_iter_t *iter,
+   bson_t *out,
+   mongocrypt_status_t *status)
+{
+   BSON_ASSERT_PARAM (paths);
+
+   return _transform (cb, ctx, match, paths, iter, out, status);
+}
 
 /*-----------------------------------------------------------------------------
  *
@@ -206,6 +441,7 @@ _mongocrypt_traverse_binary_in_bson (_mongocrypt_traverse_callback_t cb,
                                      bson_iter_t *iter,
                                      mongocrypt_status_t *status)
 {
+   _candidate_scan_t scan;
    _recurse_state_t starting_state = {ctx,
                                       *iter,
                                       NULL /* copy */,
@@ -214,7 +450,15 @@ _mongocrypt_traverse_binary_in_bson (_mongocrypt_traverse_callback_t cb,
                                       NULL /* transform callback */,
                                       status,
                                       match,
-                                      {0}};
+                                      {0},
+                                      &scan,
+                                      NULL /* paths */,
+                                      false /* in_array */};
 
+   _candidate_scan_init (&scan, iter, match);
+   if (scan.next == scan.end) {
+      /* Nothing can match. */
+      return true;
+   }
    return _recurse (&starting_state);
 }
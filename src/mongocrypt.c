@@ -30,6 +30,7 @@
 #include "mongocrypt-log-private.h"
 #include "mongocrypt-mutex-private.h"
 #include "mongocrypt-opts-private.h"
+#include "mongocrypt-parallel-private.h"
 #include "mongocrypt-status-private.h"
 #include "mongocrypt-util-private.h"
 
@@ -126,8 +127,15 @@ mongocrypt_new (void)
    _mongocrypt_mutex_init (&crypt->mutex);
    _mongocrypt_cache_collinfo_init (&crypt->cache_collinfo);
    _mongocrypt_cache_key_init (&crypt->cache_key);
+   _mongocrypt_cache_encryption_information_init (
+      &crypt->cache_encryption_information);
+   _mongocrypt_cache_marking_plan_init (&crypt->cache_marking_plan);
    crypt->status = mongocrypt_status_new ();
    _mongocrypt_opts_init (&crypt->opts);
+   crypt->opts.csfle_query_analyzer_pool_size =
+      MONGOCRYPT_CSFLE_QUERY_ANALYZER_POOL_SIZE_DEFAULT;
+   crypt->opts.plaintext_collinfo_expiration_ms =
+      MONGOCRYPT_PLAINTEXT_COLLINFO_EXPIRATION_MS_DEFAULT;
    _mongocrypt_log_init (&crypt->log);
    crypt->ctx_counter = 1;
    crypt->cache_oauth_azure = _mongocrypt_cache_oauth_new ();
@@ -959,6 +967,26 @@ mongocrypt_init (mongocrypt_t *crypt)
          &crypt->log, crypt->opts.log_fn, crypt->opts.log_ctx);
    }
 
+   if (crypt->opts.key_cache_expiration_ms) {
+      _mongocrypt_cache_set_expiration (&crypt->cache_key,
+                                        crypt->opts.key_cache_expiration_ms);
+   }
+   _mongocrypt_cache_set_limits (&crypt->cache_key,
+                                 crypt->opts.key_cache_max_entries,
+                                 crypt->opts.key_cache_max_bytes);
+   _mongocrypt_cache_set_refresh_window (
+      &crypt->cache_key, crypt->opts.key_cache_refresh_window_ms);
+   _mongocrypt_cache_set_limits (
+      &crypt->cache_marking_plan, crypt->opts.marking_cache_max_entries, 0);
+
+   if (crypt->opts.parallel_finalize_threads > 0) {
+      crypt->thread_pool = _mongocrypt_thread_pool_new (
+         crypt->opts.parallel_finalize_threads, status);
+      if (!crypt->thread_pool) {
+         return false;
+      }
+   }
+
    if (!crypt->crypto) {
 #ifndef MONGOCRYPT_ENABLE_CRYPTO
       CLIENT_ERR ("libmongocrypt built with native crypto disabled. crypto "
@@ -1008,9 +1036,12 @@ mongocrypt_destroy (mongocrypt_t *crypt)
    if (!crypt) {
       return;
    }
+   _mongocrypt_thread_pool_destroy (crypt->thread_pool);
    _mongocrypt_opts_cleanup (&crypt->opts);
    _mongocrypt_cache_cleanup (&crypt->cache_collinfo);
    _mongocrypt_cache_cleanup (&crypt->cache_key);
+   _mongocrypt_cache_cleanup (&crypt->cache_encryption_information);
+   _mongocrypt_cache_cleanup (&crypt->cache_marking_plan);
    _mongocrypt_mutex_cleanup (&crypt->mutex);
    _mongocrypt_log_cleanup (&crypt->log);
    mongocrypt_status_destroy (crypt->status);
@@ -1019,15 +1050,81 @@ mongocrypt_destroy (mongocrypt_t *crypt)
    _mongocrypt_cache_oauth_destroy (crypt->cache_oauth_gcp);
 
    if (crypt->csfle.okay) {
+      uint32_t i;
+
+      /* Query analyzers must be destroyed before the library. */
+      for (i = 0; i < crypt->csfle_query_analyzers_len; i++) {
+         crypt->csfle.query_analyzer_destroy (crypt->csfle_query_analyzers[i]);
+      }
       _csfle_drop_global_ref ();
       crypt->csfle.okay = false;
    }
+   bson_free (crypt->csfle_query_analyzers);
 
 
    bson_free (crypt);
 }
 
 
+mongo_csfle_v1_query_analyzer *
+_mongocrypt_csfle_query_analyzer_acquire (mongocrypt_t *crypt,
+                                          mongo_csfle_v1_status *status)
+{
+   mongo_csfle_v1_query_analyzer *qa = NULL;
+
+   BSON_ASSERT_PARAM (crypt);
+   BSON_ASSERT (crypt->csfle.okay);
+
+   MONGOCRYPT_WITH_MUTEX (crypt->mutex)
+   {
+      if (crypt->csfle_query_analyzers_len > 0) {
+         qa = crypt->csfle_query_analyzers[--crypt->csfle_query_analyzers_len];
+      }
+   }
+   if (qa) {
+      return qa;
+   }
+   return crypt->csfle.query_analyzer_create (crypt->csfle_lib, status);
+}
+
+
+void
+_mongocrypt_csfle_query_analyzer_release (mongocrypt_t *crypt,
+                                          mongo_csfle_v1_query_analyzer *qa,
+                                          bool reusable)
+{
+   bool kept = false;
+
+   BSON_ASSERT_PARAM (crypt);
+
+   if (!qa) {
+      return;
+   }
+
+   if (!reusable) {
+      crypt->csfle.query_analyzer_destroy (qa);
+      return;
+   }
+
+   MONGOCRYPT_WITH_MUTEX (crypt->mutex)
+   {
+      if (crypt->csfle_query_analyzers_len <
+          crypt->opts.csfle_query_analyzer_pool_size) {
+         if (!crypt->csfle_query_analyzers) {
+            crypt->csfle_query_analyzers =
+               bson_malloc (sizeof (mongo_csfle_v1_query_analyzer *) *
+                            crypt->opts.csfle_query_analyzer_pool_size);
+         }
+         crypt->csfle_query_analyzers[crypt->csfle_query_analyzers_len++] = qa;
+         kept = true;
+      }
+   }
+   if (!kept) {
+      crypt->csfle.query_analyzer_destroy (qa);
+   }
+}
+
+
 const char *
 mongocrypt_csfle_version_string (const mongocrypt_t *crypt, uint32_t *len)
 {
@@ -1149,6 +1246,39 @@ mongocrypt_setopt_crypto_hooks (mongocrypt_t *crypt,
    return true;
 }
 
+bool
+mongocrypt_setopt_crypto_hooks_iov (
+   mongocrypt_t *crypt,
+   mongocrypt_crypto_iov_fn aes_256_cbc_encrypt,
+   mongocrypt_hmac_iov_fn hmac_sha_512,
+   mongocrypt_hmac_iov_fn hmac_sha_256,
+   void *ctx)
+{
+   mongocrypt_status_t *status;
+
+   if (!crypt) {
+      return false;
+   }
+
+   status = crypt->status;
+
+   if (crypt->initialized) {
+      CLIENT_ERR ("options cannot be set after initialization");
+      return false;
+   }
+
+   if (!crypt->crypto || !crypt->crypto->hooks_enabled) {
+      CLIENT_ERR ("crypto hooks must be set before scatter/gather hooks");
+      return false;
+   }
+
+   crypt->crypto->aes_256_cbc_encrypt_iov = aes_256_cbc_encrypt;
+   crypt->crypto->hmac_sha_512_iov = hmac_sha_512;
+   crypt->crypto->hmac_sha_256_iov = hmac_sha_256;
+   crypt->crypto->iov_ctx = ctx;
+   return true;
+}
+
 bool
 mongocrypt_setopt_crypto_hook_sign_rsaes_pkcs1_v1_5 (
    mongocrypt_t *crypt,
@@ -1507,6 +1637,13 @@ mongocrypt_setopt_use_need_kms_credentials_state (mongocrypt_t *crypt)
 }
 
 
+void
+mongocrypt_setopt_use_waiting_on_keys_state (mongocrypt_t *crypt)
+{
+   crypt->opts.use_waiting_on_keys_state = true;
+}
+
+
 void
 mongocrypt_setopt_set_csfle_lib_path_override (mongocrypt_t *crypt,
                                                const char *path)
@@ -1514,6 +1651,209 @@ mongocrypt_setopt_set_csfle_lib_path_override (mongocrypt_t *crypt,
    mstr_assign (&crypt->opts.csfle_lib_override_path, mstr_copy_cstr (path));
 }
 
+bool
+mongocrypt_setopt_key_cache_expiration (mongocrypt_t *crypt,
+                                        uint64_t expiration_ms)
+{
+   mongocrypt_status_t *status;
+
+   if (!crypt) {
+      return false;
+   }
+   status = crypt->status;
+
+   if (crypt->initialized) {
+      CLIENT_ERR ("options cannot be set after initialization");
+      return false;
+   }
+
+   if (expiration_ms == 0) {
+      CLIENT_ERR ("key cache expiration must be greater than zero");
+      return false;
+   }
+
+   if (expiration_ms > (uint64_t) INT64_MAX / 2) {
+      CLIENT_ERR ("key cache expiration is too large");
+      return false;
+   }
+
+   crypt->opts.key_cache_expiration_ms = expiration_ms;
+   return true;
+}
+
+
+bool
+mongocrypt_setopt_key_cache_max_entries (mongocrypt_t *crypt,
+                                         uint32_t max_entries)
+{
+   mongocrypt_status_t *status;
+
+   if (!crypt) {
+      return false;
+   }
+   status = crypt->status;
+
+   if (crypt->initialized) {
+      CLIENT_ERR ("options cannot be set after initialization");
+      return false;
+   }
+
+   crypt->opts.key_cache_max_entries = max_entries;
+   return true;
+}
+
+
+bool
+mongocrypt_setopt_key_cache_max_bytes (mongocrypt_t *crypt, uint64_t max_bytes)
+{
+   mongocrypt_status_t *status;
+
+   if (!crypt) {
+      return false;
+   }
+   status = crypt->status;
+
+   if (crypt->initialized) {
+      CLIENT_ERR ("options cannot be set after initialization");
+      return false;
+   }
+
+   crypt->opts.key_cache_max_bytes = max_bytes;
+   return true;
+}
+
+
+bool
+mongocrypt_setopt_key_cache_refresh_window (mongocrypt_t *crypt,
+                                            uint64_t refresh_window_ms)
+{
+   mongocrypt_status_t *status;
+
+   if (!crypt) {
+      return false;
+   }
+   status = crypt->status;
+
+   if (crypt->initialized) {
+      CLIENT_ERR ("options cannot be set after initialization");
+      return false;
+   }
+
+   crypt->opts.key_cache_refresh_window_ms = refresh_window_ms;
+   return true;
+}
+
+
+bool
+mongocrypt_setopt_parallel_finalize (mongocrypt_t *crypt, uint32_t num_threads)
+{
+   mongocrypt_status_t *status;
+
+   if (!crypt) {
+      return false;
+   }
+   status = crypt->status;
+
+   if (crypt->initialized) {
+      CLIENT_ERR ("options cannot be set after initialization");
+      return false;
+   }
+
+   crypt->opts.parallel_finalize_threads = num_threads;
+   return true;
+}
+
+
+bool
+mongocrypt_setopt_parallel_finalize_handler (
+   mongocrypt_t *crypt, mongocrypt_parallel_for_fn parallel_for, void *ctx)
+{
+   mongocrypt_status_t *status;
+
+   if (!crypt) {
+      return false;
+   }
+   status = crypt->status;
+
+   if (crypt->initialized) {
+      CLIENT_ERR ("options cannot be set after initialization");
+      return false;
+   }
+
+   if (!parallel_for) {
+      CLIENT_ERR ("parallel finalize handler must not be NULL");
+      return false;
+   }
+
+   crypt->opts.parallel_for_fn = parallel_for;
+   crypt->opts.parallel_for_ctx = ctx;
+   return true;
+}
+
+
+bool
+mongocrypt_setopt_csfle_query_analyzer_pool_size (mongocrypt_t *crypt,
+                                                  uint32_t pool_size)
+{
+   mongocrypt_status_t *status;
+
+   if (!crypt) {
+      return false;
+   }
+   status = crypt->status;
+
+   if (crypt->initialized) {
+      CLIENT_ERR ("options cannot be set after initialization");
+      return false;
+   }
+
+   crypt->opts.csfle_query_analyzer_pool_size = pool_size;
+   return true;
+}
+
+
+bool
+mongocrypt_setopt_marking_cache_max_entries (mongocrypt_t *crypt,
+                                             uint32_t max_entries)
+{
+   mongocrypt_status_t *status;
+
+   if (!crypt) {
+      return false;
+   }
+   status = crypt->status;
+
+   if (crypt->initialized) {
+      CLIENT_ERR ("options cannot be set after initialization");
+      return false;
+   }
+
+   crypt->opts.marking_cache_max_entries = max_entries;
+   return true;
+}
+
+
+bool
+mongocrypt_setopt_plaintext_collinfo_expiration (mongocrypt_t *crypt,
+                                                 uint64_t expiration_ms)
+{
+   mongocrypt_status_t *status;
+
+   if (!crypt) {
+      return false;
+   }
+   status = crypt->status;
+
+   if (crypt->initialized) {
+      CLIENT_ERR ("options cannot be set after initialization");
+      return false;
+   }
+
+   crypt->opts.plaintext_collinfo_expiration_ms = expiration_ms;
+   return true;
+}
+
+
 bool
 _mongocrypt_needs_credentials (mongocrypt_t *crypt)
 {
@@ -0,0 +1,97 @@
+/*
+ * Copyright 2022-present MongoDB, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../mongocrypt-thread-private.h"
+
+#ifdef _WIN32
+
+typedef struct {
+   _mongocrypt_thread_fn_t fn;
+   void *arg;
+} _thread_start_t;
+
+static DWORD WINAPI
+_thread_start (LPVOID arg)
+{
+   _thread_start_t start = *(_thread_start_t *) arg;
+
+   bson_free (arg);
+   start.fn (start.arg);
+   return 0;
+}
+
+bool
+_mongocrypt_thread_create (mongocrypt_thread_t *thread,
+                           _mongocrypt_thread_fn_t fn,
+                           void *arg)
+{
+   _thread_start_t *start;
+
+   start = bson_malloc (sizeof (*start));
+   BSON_ASSERT (start);
+   start->fn = fn;
+   start->arg = arg;
+   *thread = CreateThread (NULL, 0, _thread_start, start, 0, NULL);
+   if (!*thread) {
+      bson_free (start);
+      return false;
+   }
+   return true;
+}
+
+void
+_mongocrypt_thread_join (mongocrypt_thread_t thread)
+{
+   if (WaitForSingleObject (thread, INFINITE) != WAIT_OBJECT_0) {
+      abort ();
+   }
+   CloseHandle (thread);
+}
+
+void
+_mongocrypt_cond_init (mongocrypt_cond_t *cond)
+{
+   InitializeConditionVariable (cond);
+}
+
+void
+_mongocrypt_cond_cleanup (mongocrypt_cond_t *cond)
+{
+   /* Windows condition variables need no cleanup. */
+   (void) cond;
+}
+
+void
+_mongocrypt_cond_wait (mongocrypt_cond_t *cond, mongocrypt_mutex_t *mutex)
+{
+   if (!SleepConditionVariableCS (cond, mutex, INFINITE)) {
+      abort ();
+   }
+}
+
+void
+_mongocrypt_cond_signal (mongocrypt_cond_t *cond)
+{
+   WakeConditionVariable (cond);
+}
+
+void
+_mongocrypt_cond_broadcast (mongocrypt_cond_t *cond)
+{
+   WakeAllConditionVariable (cond);
+}
+
+#endif /* _WIN32 */
@@ -129,6 +129,47 @@ _test_cache_expiration (_mongocrypt_tester_t *tester)
 }
 
 
+/* Test that adding evicts exactly the expired entries. */
+static void
+_test_cache_evicts_expired (_mongocrypt_tester_t *tester)
+{
+   _mongocrypt_cache_t cache;
+   mongocrypt_status_t *status;
+   bson_t *entry = BCON_NEW ("a", "b");
+   bson_t *tmp = NULL;
+   uint32_t i;
+
+   status = mongocrypt_status_new ();
+
+   _mongocrypt_cache_collinfo_init (&cache);
+   _mongocrypt_cache_set_expiration (&cache, 50);
+   ASSERT_OR_PRINT (_mongocrypt_cache_add_copy (&cache, "1", entry, status),
+                    status);
+   ASSERT_OR_PRINT (_mongocrypt_cache_add_copy (&cache, "2", entry, status),
+                    status);
+
+   /* Sleep for 100 milliseconds */
+   _usleep (1000 * 100);
+
+   ASSERT_OR_PRINT (_mongocrypt_cache_add_copy (&cache, "3", entry, status),
+                    status);
+   BSON_ASSERT (_mongocrypt_cache_num_entries (&cache) == 1);
+   BSON_ASSERT (_mongocrypt_cache_get (&cache, "3", (void **) &tmp));
+   BSON_ASSERT (tmp);
+   bson_destroy (tmp);
+
+   /* The remaining entry is at the root of the expiration heap. */
+   for (i = 0; i < cache.num_pairs; i++) {
+      BSON_ASSERT (cache.heap[i]->heap_index == i);
+   }
+   BSON_ASSERT (0 == strcmp ((char *) cache.heap[0]->attr, "3"));
+
+   _mongocrypt_cache_cleanup (&cache);
+   mongocrypt_status_destroy (status);
+   bson_destroy (entry);
+}
+
+
 static void
 _test_cache_duplicates (_mongocrypt_tester_t *tester)
 {
@@ -255,10 +296,153 @@ _test_cache_duplicates (_mongocrypt_tester_t *tester)
    mongocrypt_status_destroy (status);
    _mongocrypt_cache_cleanup (&cache);
 }
+
+
+/* Test that key cache hits share the stored value instead of copying it. */
+static void
+_test_cache_key_value_shared (_mongocrypt_tester_t *tester)
+{
+   _mongocrypt_cache_t cache;
+   mongocrypt_status_t *status;
+   _mongocrypt_key_doc_t *keydoc;
+   _mongocrypt_cache_key_value_t *value, *tmp1, *tmp2;
+   _mongocrypt_cache_key_attr_t *attr;
+   _mongocrypt_key_alt_name_t *alt_names;
+   _mongocrypt_buffer_t buf;
+
+   status = mongocrypt_status_new ();
+   _mongocrypt_buffer_init (&buf);
+   _mongocrypt_buffer_resize (&buf, MONGOCRYPT_KEY_LEN);
+   memset (buf.data, 1, MONGOCRYPT_KEY_LEN);
+   keydoc = _mongocrypt_key_new ();
+   alt_names = _MONGOCRYPT_KEY_ALT_NAME_CREATE ("a");
+   attr = _mongocrypt_cache_key_attr_new (NULL /* id */, alt_names);
+
+   _mongocrypt_cache_key_init (&cache);
+   value = _mongocrypt_cache_key_value_new (keydoc, &buf);
+   ASSERT_OR_PRINT (_mongocrypt_cache_add_stolen (&cache, attr, value, status),
+                    status);
+   BSON_ASSERT (value->refcount == 1);
+
+   BSON_ASSERT (_mongocrypt_cache_get (&cache, attr, (void **) &tmp1));
+   BSON_ASSERT (_mongocrypt_cache_get (&cache, attr, (void **) &tmp2));
+   BSON_ASSERT (tmp1 == value);
+   BSON_ASSERT (tmp2 == value);
+   BSON_ASSERT (value->refcount == 3);
+
+   /* A pinned value outlives its cache entry. */
+   _mongocrypt_cache_key_value_destroy (tmp1);
+   _mongocrypt_cache_cleanup (&cache);
+   BSON_ASSERT (tmp2->refcount == 1);
+   BSON_ASSERT (0 == memcmp (tmp2->decrypted_key_material.data,
+                             buf.data,
+                             MONGOCRYPT_KEY_LEN));
+   _mongocrypt_cache_key_value_destroy (tmp2);
+
+   _mongocrypt_cache_key_attr_destroy (attr);
+   _mongocrypt_key_alt_name_destroy_all (alt_names);
+   _mongocrypt_key_destroy (keydoc);
+   _mongocrypt_buffer_cleanup (&buf);
+   mongocrypt_status_destroy (status);
+}
+
+
+/* Test that exceeding the entry limit evicts the least recently used. */
+static void
+_test_cache_lru (_mongocrypt_tester_t *tester)
+{
+   _mongocrypt_cache_t cache;
+   mongocrypt_status_t *status;
+   bson_t *entry = BCON_NEW ("a", "b");
+   bson_t *tmp = NULL;
+
+   status = mongocrypt_status_new ();
+
+   _mongocrypt_cache_collinfo_init (&cache);
+   _mongocrypt_cache_set_limits (&cache, 2, 0 /* max_bytes */);
+   ASSERT_OR_PRINT (_mongocrypt_cache_add_copy (&cache, "1", entry, status),
+                    status);
+   ASSERT_OR_PRINT (_mongocrypt_cache_add_copy (&cache, "2", entry, status),
+                    status);
+
+   /* Use "1" so "2" is the least recently used. */
+   BSON_ASSERT (_mongocrypt_cache_get (&cache, "1", (void **) &tmp));
+   BSON_ASSERT (tmp);
+   bson_destroy (tmp);
+
+   ASSERT_OR_PRINT (_mongocrypt_cache_add_copy (&cache, "3", entry, status),
+                    status);
+   BSON_ASSERT (_mongocrypt_cache_num_entries (&cache) == 2);
+   BSON_ASSERT (_mongocrypt_cache_get (&cache, "2", (void **) &tmp));
+   BSON_ASSERT (!tmp);
+   BSON_ASSERT (_mongocrypt_cache_get (&cache, "1", (void **) &tmp));
+   BSON_ASSERT (tmp);
+   bson_destroy (tmp);
+   BSON_ASSERT (_mongocrypt_cache_get (&cache, "3", (void **) &tmp));
+   BSON_ASSERT (tmp);
+   bson_destroy (tmp);
+
+   /* Lowering the limit evicts immediately. */
+   _mongocrypt_cache_set_limits (&cache, 1, 0 /* max_bytes */);
+   BSON_ASSERT (_mongocrypt_cache_num_entries (&cache) == 1);
+
+   _mongocrypt_cache_cleanup (&cache);
+   mongocrypt_status_destroy (status);
+   bson_destroy (entry);
+}
+
+
+/* Test enough entries to grow the hash table. */
+static void
+_test_cache_many_entries (_mongocrypt_tester_t *tester)
+{
+   _mongocrypt_cache_t cache;
+   mongocrypt_status_t *status;
+   bson_t *tmp = NULL;
+   int i;
+
+   status = mongocrypt_status_new ();
+
+   _mongocrypt_cache_collinfo_init (&cache);
+   for (i = 0; i < 1000; i++) {
+      char *ns = bson_strdup_printf ("db.coll%d", i);
+      bson_t *entry = BCON_NEW ("i", BCON_INT32 (i));
+
+      ASSERT_OR_PRINT (_mongocrypt_cache_add_stolen (&cache, ns, entry, status),
+                       status);
+      bson_free (ns);
+   }
+   BSON_ASSERT (_mongocrypt_cache_num_entries (&cache) == 1000);
+   BSON_ASSERT (cache.num_buckets > CACHE_INITIAL_BUCKETS);
+
+   for (i = 0; i < 1000; i++) {
+      char *ns = bson_strdup_printf ("db.coll%d", i);
+      bson_iter_t iter;
+
+      BSON_ASSERT (_mongocrypt_cache_get (&cache, ns, (void **) &tmp));
+      BSON_ASSERT (tmp);
+      BSON_ASSERT (bson_iter_init_find (&iter, tmp, "i"));
+      BSON_ASSERT (bson_iter_int32 (&iter) == i);
+      bson_destroy (tmp);
+      bson_free (ns);
+   }
+
+   BSON_ASSERT (_mongocrypt_cache_get (&cache, "db.missing", (void **) &tmp));
+   BSON_ASSERT (!tmp);
+
+   _mongocrypt_cache_cleanup (&cache);
+   mongocrypt_status_destroy (status);
+}
+
+
 void
 _mongocrypt_tester_install_cache (_mongocrypt_tester_t *tester)
 {
    INSTALL_TEST (_test_cache);
    INSTALL_TEST (_test_cache_expiration);
+   INSTALL_TEST (_test_cache_evicts_expired);
    INSTALL_TEST (_test_cache_duplicates);
+   INSTALL_TEST (_test_cache_many_entries);
+   INSTALL_TEST (_test_cache_lru);
+   INSTALL_TEST (_test_cache_key_value_shared);
 }
\ No newline at end of file
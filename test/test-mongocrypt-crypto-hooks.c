@@ -661,6 +661,222 @@ _test_crypto_hooks_unset (_mongocrypt_tester_t *tester)
 }
 
 
+static void
+_append_segments (mongocrypt_binary_t **in, uint32_t in_count)
+{
+   uint32_t i;
+
+   for (i = 0; i < in_count; i++) {
+      _append_bin ("in", in[i]);
+   }
+}
+
+static bool
+_mock_aes_256_cbc_encrypt_iov (void *ctx,
+                               mongocrypt_binary_t *key,
+                               mongocrypt_binary_t *iv,
+                               mongocrypt_binary_t **in,
+                               uint32_t in_count,
+                               mongocrypt_binary_t *out,
+                               uint32_t *bytes_written,
+                               mongocrypt_status_t *status)
+{
+   uint32_t i;
+
+   BSON_ASSERT (0 == strcmp ("iov", (char *) ctx));
+   bson_string_append_printf (call_history, "call:%s\n", BSON_FUNC);
+   _append_bin ("key", key);
+   _append_bin ("iv", iv);
+   _append_segments (in, in_count);
+   /* append it directly, don't encrypt. */
+   for (i = 0; i < in_count; i++) {
+      memcpy (out->data + *bytes_written, in[i]->data, in[i]->len);
+      *bytes_written += in[i]->len;
+   }
+   bson_string_append_printf (call_history, "ret:%s\n", BSON_FUNC);
+   return true;
+}
+
+static bool
+_hmac_sha_512_iov (void *ctx,
+                   mongocrypt_binary_t *key,
+                   mongocrypt_binary_t **in,
+                   uint32_t in_count,
+                   mongocrypt_binary_t *out,
+                   mongocrypt_status_t *status)
+{
+   _mongocrypt_buffer_t tmp;
+
+   BSON_ASSERT (0 == strcmp ("iov", (char *) ctx));
+   bson_string_append_printf (call_history, "call:%s\n", BSON_FUNC);
+   _append_bin ("key", key);
+   _append_segments (in, in_count);
+   bson_string_append_printf (call_history, "ret:%s\n", BSON_FUNC);
+
+   _mongocrypt_buffer_copy_from_hex (&tmp, HMAC_HEX);
+   memcpy (out->data, tmp.data, tmp.len);
+   _mongocrypt_buffer_cleanup (&tmp);
+   return true;
+}
+
+static bool
+_hmac_sha_256_iov (void *ctx,
+                   mongocrypt_binary_t *key,
+                   mongocrypt_binary_t **in,
+                   uint32_t in_count,
+                   mongocrypt_binary_t *out,
+                   mongocrypt_status_t *status)
+{
+   _mongocrypt_buffer_t tmp;
+
+   BSON_ASSERT (0 == strcmp ("iov", (char *) ctx));
+   bson_string_append_printf (call_history, "call:%s\n", BSON_FUNC);
+   _append_bin ("key", key);
+   _append_segments (in, in_count);
+   bson_string_append_printf (call_history, "ret:%s\n", BSON_FUNC);
+
+   _mongocrypt_buffer_copy_from_hex (&tmp, HASH_HEX);
+   memcpy (out->data, tmp.data, tmp.len);
+   _mongocrypt_buffer_cleanup (&tmp);
+   return true;
+}
+
+#define BLOCK_OF_BB "BBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBB"
+#define PADDED_BB "BB0F0F0F0F0F0F0F0F0F0F0F0F0F0F0F"
+
+static void
+_test_crypto_hooks_iov (_mongocrypt_tester_t *tester)
+{
+   mongocrypt_t *crypt;
+   mongocrypt_status_t *status;
+   _mongocrypt_buffer_t iv, associated_data, key, plaintext, ciphertext;
+   _mongocrypt_buffer_t mac_key, out;
+   uint32_t bytes_written;
+
+   /* Scatter/gather hooks require the crypto hooks. */
+   crypt = mongocrypt_new ();
+   ASSERT_FAILS (
+      mongocrypt_setopt_crypto_hooks_iov (crypt,
+                                          _mock_aes_256_cbc_encrypt_iov,
+                                          _hmac_sha_512_iov,
+                                          _hmac_sha_256_iov,
+                                          "iov"),
+      crypt,
+      "crypto hooks must be set");
+   mongocrypt_destroy (crypt);
+
+   crypt = mongocrypt_new ();
+   ASSERT_OK (
+      mongocrypt_setopt_kms_provider_aws (crypt, "example", -1, "example", -1),
+      crypt);
+   ASSERT_OK (mongocrypt_setopt_crypto_hooks (crypt,
+                                              _mock_aes_256_xxx_encrypt,
+                                              _mock_aes_256_xxx_decrypt,
+                                              _random,
+                                              _hmac_sha_512,
+                                              _hmac_sha_256,
+                                              _sha_256,
+                                              "error_on:none"),
+              crypt);
+   ASSERT_OK (mongocrypt_setopt_crypto_hooks_iov (crypt,
+                                                  _mock_aes_256_cbc_encrypt_iov,
+                                                  _hmac_sha_512_iov,
+                                                  _hmac_sha_256_iov,
+                                                  "iov"),
+              crypt);
+   ASSERT_OK (mongocrypt_init (crypt), crypt);
+   status = mongocrypt_status_new ();
+
+   _mongocrypt_buffer_copy_from_hex (&iv, IV_HEX);
+   _mongocrypt_buffer_copy_from_hex (&associated_data, "AAAA");
+   _mongocrypt_buffer_copy_from_hex (&key, KEY_HEX);
+   /* One full block and one byte. */
+   _mongocrypt_buffer_copy_from_hex (&plaintext, BLOCK_OF_BB "BB");
+
+   /* Encryption passes the aligned plaintext and the padded last block
+    * separately, and MACs the IV and ciphertext without copying. */
+   call_history = bson_string_new (NULL);
+   _mongocrypt_buffer_init (&ciphertext);
+   _mongocrypt_buffer_resize (
+      &ciphertext, _mongocrypt_calculate_ciphertext_len (plaintext.len));
+   ASSERT_OK_STATUS (_mongocrypt_do_encryption (crypt->crypto,
+                                                &iv,
+                                                &associated_data,
+                                                &key,
+                                                &plaintext,
+                                                &ciphertext,
+                                                &bytes_written,
+                                                status),
+                     status);
+   ASSERT_STREQUAL (call_history->str,
+                    "call:_mock_aes_256_cbc_encrypt_iov\n"
+                    "key:" ENCRYPTION_KEY_HEX "\n"
+                    "iv:" IV_HEX "\n"
+                    "in:" BLOCK_OF_BB "\n"
+                    "in:" PADDED_BB "\n"
+                    "ret:_mock_aes_256_cbc_encrypt_iov\n"
+                    "call:_hmac_sha_512_iov\n"
+                    "key:" HMAC_KEY_HEX "\n"
+                    "in:AAAA\n"
+                    "in:" IV_HEX BLOCK_OF_BB PADDED_BB "\n"
+                    "in:0000000000000010\n"
+                    "ret:_hmac_sha_512_iov\n");
+   ciphertext.len = bytes_written;
+   BSON_ASSERT (0 == _mongocrypt_buffer_cmp_hex (
+                        &ciphertext,
+                        IV_HEX BLOCK_OF_BB PADDED_BB HMAC_HEX_TAG));
+   bson_string_free (call_history, true);
+
+   /* Deterministic IV. */
+   call_history = bson_string_new (NULL);
+   _mongocrypt_buffer_init (&out);
+   _mongocrypt_buffer_resize (&out, MONGOCRYPT_IV_LEN);
+   ASSERT_OK_STATUS (_mongocrypt_calculate_deterministic_iv (crypt->crypto,
+                                                             &key,
+                                                             &plaintext,
+                                                             &associated_data,
+                                                             &out,
+                                                             status),
+                     status);
+   ASSERT_STREQUAL (call_history->str,
+                    "call:_hmac_sha_512_iov\n"
+                    "key:" IV_KEY_HEX "\n"
+                    "in:AAAA\n"
+                    "in:0000000000000010\n"
+                    "in:" BLOCK_OF_BB "BB\n"
+                    "ret:_hmac_sha_512_iov\n");
+   _mongocrypt_buffer_cleanup (&out);
+   bson_string_free (call_history, true);
+
+   /* HMAC SHA-256 with a single segment. */
+   call_history = bson_string_new (NULL);
+   _mongocrypt_buffer_copy_from_hex (&mac_key, HMAC_KEY_HEX);
+   _mongocrypt_buffer_init (&out);
+   _mongocrypt_buffer_resize (&out, MONGOCRYPT_HMAC_SHA256_LEN);
+   ASSERT_OK_STATUS (
+      _mongocrypt_hmac_sha_256 (
+         crypt->crypto, &mac_key, &associated_data, &out, status),
+      status);
+   ASSERT_STREQUAL (call_history->str,
+                    "call:_hmac_sha_256_iov\n"
+                    "key:" HMAC_KEY_HEX "\n"
+                    "in:AAAA\n"
+                    "ret:_hmac_sha_256_iov\n");
+   BSON_ASSERT (0 == _mongocrypt_buffer_cmp_hex (&out, HASH_HEX));
+   _mongocrypt_buffer_cleanup (&out);
+   _mongocrypt_buffer_cleanup (&mac_key);
+   bson_string_free (call_history, true);
+
+   _mongocrypt_buffer_cleanup (&ciphertext);
+   _mongocrypt_buffer_cleanup (&plaintext);
+   _mongocrypt_buffer_cleanup (&key);
+   _mongocrypt_buffer_cleanup (&associated_data);
+   _mongocrypt_buffer_cleanup (&iv);
+   mongocrypt_status_destroy (status);
+   mongocrypt_destroy (crypt);
+}
+
+
 /* test a bug fix, that an error on explicit encryption in the crypto hooks sets
  * the context state */
 static void
@@ -809,6 +1025,11 @@ _aes_256_ecb_encrypt (void *ctx,
    aes_256_args_t args = {
       &key_buf, NULL, &in_buf, &out_buf, bytes_written, status};
 
+   if (ctx) {
+      /* Count the calls. */
+      (*(int *) ctx)++;
+   }
+
    return _native_crypto_aes_256_ecb_encrypt (args);
 }
 
@@ -892,6 +1113,89 @@ _test_fle2_crypto_via_ecb_hook (_mongocrypt_tester_t *tester)
    mongocrypt_destroy (crypt_ecb);
    mongocrypt_status_destroy (status);
 }
+
+
+/* Test that the ECB hook is given many counter blocks per call, and that the
+ * counter carries across bytes. */
+void
+_test_fle2_crypto_via_ecb_hook_multi_block (_mongocrypt_tester_t *tester)
+{
+   bool ret;
+   _mongocrypt_buffer_t key;
+   _mongocrypt_buffer_t iv;
+   _mongocrypt_buffer_t plaintext;
+   _mongocrypt_buffer_t ciphertext_reg;
+   _mongocrypt_buffer_t ciphertext_ecb;
+   _mongocrypt_buffer_t plaintext_ecb;
+   uint32_t bytes_written;
+   int calls = 0;
+   mongocrypt_status_t *status = mongocrypt_status_new ();
+
+   /* The low bytes of the counter roll over after the first block. */
+   _mongocrypt_buffer_copy_from_hex (&iv, "0102030405060708090a0bffffffffff");
+   _mongocrypt_buffer_copy_from_hex (&key, ENCRYPTION_KEY_HEX);
+   /* Spans more than one call to the hook, with a partial last block. */
+   _mongocrypt_buffer_init_size (&plaintext, 100001);
+   for (uint32_t i = 0; i < plaintext.len; i++) {
+      plaintext.data[i] = (uint8_t) i;
+   }
+
+   mongocrypt_t *crypt_reg = mongocrypt_new ();
+   _mongocrypt_buffer_init_size (
+      &ciphertext_reg,
+      _mongocrypt_fle2_calculate_ciphertext_len (plaintext.len));
+   ret = _mongocrypt_fle2_do_encryption (crypt_reg->crypto,
+                                         &iv,
+                                         &key,
+                                         &plaintext,
+                                         &ciphertext_reg,
+                                         &bytes_written,
+                                         status);
+   ASSERT_OK (ret, crypt_reg);
+
+   mongocrypt_t *crypt_ecb = mongocrypt_new ();
+   ret =
+      mongocrypt_setopt_aes_256_ecb (crypt_ecb, _aes_256_ecb_encrypt, &calls);
+   ASSERT_OK (ret, crypt_ecb);
+   _mongocrypt_buffer_init_size (
+      &ciphertext_ecb,
+      _mongocrypt_fle2_calculate_ciphertext_len (plaintext.len));
+   ret = _mongocrypt_fle2_do_encryption (crypt_ecb->crypto,
+                                         &iv,
+                                         &key,
+                                         &plaintext,
+                                         &ciphertext_ecb,
+                                         &bytes_written,
+                                         status);
+   ASSERT_OK (ret, crypt_ecb);
+   ASSERT_CMPINT (calls, ==, 2);
+
+   ASSERT (0 == _mongocrypt_buffer_cmp (&ciphertext_reg, &ciphertext_ecb));
+
+   _mongocrypt_buffer_init_size (
+      &plaintext_ecb,
+      _mongocrypt_fle2_calculate_plaintext_len (ciphertext_ecb.len));
+   ret = _mongocrypt_fle2_do_decryption (crypt_ecb->crypto,
+                                         &key,
+                                         &ciphertext_ecb,
+                                         &plaintext_ecb,
+                                         &bytes_written,
+                                         status);
+   ASSERT_OK (ret, crypt_ecb);
+   ASSERT_CMPINT (calls, ==, 4);
+
+   ASSERT (0 == _mongocrypt_buffer_cmp (&plaintext, &plaintext_ecb));
+
+   _mongocrypt_buffer_cleanup (&key);
+   _mongocrypt_buffer_cleanup (&iv);
+   _mongocrypt_buffer_cleanup (&plaintext);
+   _mongocrypt_buffer_cleanup (&ciphertext_reg);
+   _mongocrypt_buffer_cleanup (&ciphertext_ecb);
+   _mongocrypt_buffer_cleanup (&plaintext_ecb);
+   mongocrypt_destroy (crypt_reg);
+   mongocrypt_destroy (crypt_ecb);
+   mongocrypt_status_destroy (status);
+}
 #endif
 
 void
@@ -901,6 +1205,7 @@ _mongocrypt_tester_install_crypto_hooks (_mongocrypt_tester_t *tester)
    INSTALL_TEST_CRYPTO (_test_crypto_hooks_decryption, CRYPTO_OPTIONAL);
    INSTALL_TEST_CRYPTO (_test_crypto_hooks_iv_gen, CRYPTO_OPTIONAL);
    INSTALL_TEST_CRYPTO (_test_crypto_hooks_random, CRYPTO_OPTIONAL);
+   INSTALL_TEST_CRYPTO (_test_crypto_hooks_iov, CRYPTO_OPTIONAL);
    INSTALL_TEST_CRYPTO (_test_kms_request, CRYPTO_OPTIONAL);
    INSTALL_TEST_CRYPTO (_test_crypto_hooks_unset, CRYPTO_PROHIBITED);
    INSTALL_TEST_CRYPTO (_test_crypto_hooks_explicit_err, CRYPTO_OPTIONAL);
@@ -910,5 +1215,6 @@ _mongocrypt_tester_install_crypto_hooks (_mongocrypt_tester_t *tester)
                         CRYPTO_OPTIONAL);
 #ifdef MONGOCRYPT_ENABLE_CRYPTO_LIBCRYPTO
    INSTALL_TEST (_test_fle2_crypto_via_ecb_hook);
+   INSTALL_TEST (_test_fle2_crypto_via_ecb_hook_multi_block);
 #endif
 }
@@ -18,6 +18,7 @@
 #include <mongocrypt-crypto-private.h>
 
 #include "test-mongocrypt.h"
+#include "test-mongocrypt-crypto-std-hooks.h"
 
 static void
 _test_roundtrip (_mongocrypt_tester_t *tester)
@@ -158,9 +159,11 @@ _test_mcgrew (_mongocrypt_tester_t *tester)
    mongocrypt_t *crypt;
    mongocrypt_status_t *status;
    _mongocrypt_buffer_t key, iv, associated_data, plaintext,
-      ciphertext_expected, ciphertext_actual;
+      ciphertext_expected, ciphertext_actual, decrypted;
+   _mongocrypt_key_state_t *key_state;
    uint32_t bytes_written;
    bool ret;
+   int i;
 
    _mongocrypt_buffer_copy_from_hex (
       &key,
@@ -215,6 +218,42 @@ _test_mcgrew (_mongocrypt_tester_t *tester)
                              ciphertext_expected.data,
                              ciphertext_actual.len));
 
+   /* Precomputed key state gives the same result. Run twice to reuse the key
+    * state the first run leaves on this thread. */
+   key_state = _mongocrypt_key_state_new (crypt->crypto, &key);
+   BSON_ASSERT (key_state);
+   for (i = 0; i < 2; i++) {
+      ret = _mongocrypt_do_encryption_with_key_state (crypt->crypto,
+                                                      &iv,
+                                                      &associated_data,
+                                                      key_state,
+                                                      &plaintext,
+                                                      &ciphertext_actual,
+                                                      &bytes_written,
+                                                      status);
+      ASSERT_OR_PRINT (ret, status);
+      ASSERT_CMPBYTES (ciphertext_expected.data,
+                       ciphertext_expected.len,
+                       ciphertext_actual.data,
+                       ciphertext_actual.len);
+   }
+
+   _mongocrypt_buffer_init (&decrypted);
+   _mongocrypt_buffer_resize (
+      &decrypted, _mongocrypt_calculate_plaintext_len (ciphertext_actual.len));
+   ret = _mongocrypt_do_decryption_with_key_state (crypt->crypto,
+                                                   &associated_data,
+                                                   key_state,
+                                                   &ciphertext_actual,
+                                                   &decrypted,
+                                                   &bytes_written,
+                                                   status);
+   ASSERT_OR_PRINT (ret, status);
+   ASSERT_CMPBYTES (
+      plaintext.data, plaintext.len, decrypted.data, bytes_written);
+
+   _mongocrypt_buffer_cleanup (&decrypted);
+   _mongocrypt_key_state_destroy (key_state);
    _mongocrypt_buffer_cleanup (&key);
    _mongocrypt_buffer_cleanup (&iv);
    _mongocrypt_buffer_cleanup (&plaintext);
@@ -470,6 +509,142 @@ _test_mongocrypt_hmac_sha_256_hook (_mongocrypt_tester_t *tester)
    mongocrypt_destroy (crypt);
 }
 
+/* Native crypto encrypts and MACs values in place, while hooks are called once
+ * on a concatenated copy. Check that both give the same result for lengths
+ * around block boundaries. */
+static void
+_test_native_matches_hooks (_mongocrypt_tester_t *tester)
+{
+   mongocrypt_t *crypt;
+   _mongocrypt_crypto_t hooks = {0};
+   _mongocrypt_key_state_t *key_state;
+   _mongocrypt_buffer_t key, iv, associated_data, plaintext;
+   _mongocrypt_buffer_t native_out, hooks_out, div_native, div_hooks;
+   mongocrypt_status_t *status;
+   uint32_t bytes_written;
+   uint32_t len;
+
+   /* Force the crypto stack to initialize with mongocrypt_new */
+   crypt = _mongocrypt_tester_mongocrypt (TESTER_MONGOCRYPT_DEFAULT);
+   status = mongocrypt_status_new ();
+
+   hooks.hooks_enabled = true;
+   hooks.aes_256_cbc_encrypt = _std_hook_native_crypto_aes_256_cbc_encrypt;
+   hooks.aes_256_cbc_decrypt = _std_hook_native_crypto_aes_256_cbc_decrypt;
+   hooks.hmac_sha_512 = _std_hook_native_hmac_sha512;
+   hooks.hmac_sha_256 = _std_hook_native_hmac_sha256;
+
+   _mongocrypt_buffer_init (&key);
+   _mongocrypt_buffer_resize (&key, MONGOCRYPT_KEY_LEN);
+   memset (key.data, 'k', key.len);
+   key.data[0] = 'm'; /* distinguish the mac, encryption, and iv keys. */
+   key.data[MONGOCRYPT_MAC_KEY_LEN] = 'e';
+   key_state = _mongocrypt_key_state_new (crypt->crypto, &key);
+   BSON_ASSERT (key_state);
+
+   _mongocrypt_buffer_init (&iv);
+   _mongocrypt_buffer_resize (&iv, MONGOCRYPT_IV_LEN);
+   memset (iv.data, 'i', iv.len);
+   _mongocrypt_buffer_copy_from_hex (&associated_data, "AAAAAA");
+   _mongocrypt_buffer_init (&div_native);
+   _mongocrypt_buffer_resize (&div_native, MONGOCRYPT_IV_LEN);
+   _mongocrypt_buffer_init (&div_hooks);
+   _mongocrypt_buffer_resize (&div_hooks, MONGOCRYPT_IV_LEN);
+
+   for (len = 1; len <= 3 * MONGOCRYPT_BLOCK_SIZE + 1; len++) {
+      _mongocrypt_buffer_init (&plaintext);
+      _mongocrypt_buffer_resize (&plaintext, len);
+      memset (plaintext.data, (int) len, len);
+
+      /* FLE1 */
+      _mongocrypt_buffer_init (&native_out);
+      _mongocrypt_buffer_resize (&native_out,
+                                 _mongocrypt_calculate_ciphertext_len (len));
+      _mongocrypt_buffer_init (&hooks_out);
+      _mongocrypt_buffer_resize (&hooks_out, native_out.len);
+      ASSERT_OR_PRINT (
+         _mongocrypt_calculate_deterministic_iv_with_key_state (crypt->crypto,
+                                                                key_state,
+                                                                &plaintext,
+                                                                &associated_data,
+                                                                &div_native,
+                                                                status),
+         status);
+      ASSERT_OR_PRINT (_mongocrypt_calculate_deterministic_iv (&hooks,
+                                                               &key,
+                                                               &plaintext,
+                                                               &associated_data,
+                                                               &div_hooks,
+                                                               status),
+                       status);
+      ASSERT_CMPBYTES (
+         div_native.data, div_native.len, div_hooks.data, div_hooks.len);
+      ASSERT_OR_PRINT (
+         _mongocrypt_do_encryption_with_key_state (crypt->crypto,
+                                                   &div_native,
+                                                   &associated_data,
+                                                   key_state,
+                                                   &plaintext,
+                                                   &native_out,
+                                                   &bytes_written,
+                                                   status),
+         status);
+      ASSERT_CMPINT ((int) bytes_written, ==, (int) native_out.len);
+      ASSERT_OR_PRINT (_mongocrypt_do_encryption (&hooks,
+                                                  &div_hooks,
+                                                  &associated_data,
+                                                  &key,
+                                                  &plaintext,
+                                                  &hooks_out,
+                                                  &bytes_written,
+                                                  status),
+                       status);
+      ASSERT_CMPBYTES (
+         native_out.data, native_out.len, hooks_out.data, hooks_out.len);
+      _mongocrypt_buffer_cleanup (&native_out);
+      _mongocrypt_buffer_cleanup (&hooks_out);
+
+      /* FLE2 AEAD. The first 64 bytes of the key are used. */
+      _mongocrypt_buffer_init (&native_out);
+      _mongocrypt_buffer_resize (
+         &native_out, _mongocrypt_fle2aead_calculate_ciphertext_len (len));
+      _mongocrypt_buffer_init (&hooks_out);
+      _mongocrypt_buffer_resize (&hooks_out, native_out.len);
+      ASSERT_OR_PRINT (_mongocrypt_fle2aead_do_encryption (crypt->crypto,
+                                                           &iv,
+                                                           &associated_data,
+                                                           &key,
+                                                           &plaintext,
+                                                           &native_out,
+                                                           &bytes_written,
+                                                           status),
+                       status);
+      ASSERT_OR_PRINT (_mongocrypt_fle2aead_do_encryption (&hooks,
+                                                           &iv,
+                                                           &associated_data,
+                                                           &key,
+                                                           &plaintext,
+                                                           &hooks_out,
+                                                           &bytes_written,
+                                                           status),
+                       status);
+      ASSERT_CMPBYTES (
+         native_out.data, native_out.len, hooks_out.data, hooks_out.len);
+      _mongocrypt_buffer_cleanup (&native_out);
+      _mongocrypt_buffer_cleanup (&hooks_out);
+      _mongocrypt_buffer_cleanup (&plaintext);
+   }
+
+   _mongocrypt_buffer_cleanup (&div_hooks);
+   _mongocrypt_buffer_cleanup (&div_native);
+   _mongocrypt_buffer_cleanup (&associated_data);
+   _mongocrypt_buffer_cleanup (&iv);
+   _mongocrypt_key_state_destroy (key_state);
+   _mongocrypt_buffer_cleanup (&key);
+   mongocrypt_status_destroy (status);
+   mongocrypt_destroy (crypt);
+}
+
 typedef struct {
    const char *testname;
    const char *iv;
@@ -887,6 +1062,7 @@ _mongocrypt_tester_install_crypto (_mongocrypt_tester_t *tester)
    INSTALL_TEST (_test_native_crypto_aes_256_ctr);
    INSTALL_TEST (_test_native_crypto_hmac_sha_256);
    INSTALL_TEST_CRYPTO (_test_mongocrypt_hmac_sha_256_hook, CRYPTO_OPTIONAL);
+   INSTALL_TEST (_test_native_matches_hooks);
    INSTALL_TEST (_test_fle2_aead_roundtrip);
    INSTALL_TEST (_test_fle2_aead_decrypt);
    INSTALL_TEST (_test_fle2_roundtrip);
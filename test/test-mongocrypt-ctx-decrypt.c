@@ -14,7 +14,9 @@
  * limitations under the License.
  */
 
+#include "mongocrypt-ciphertext-private.h"
 #include "mongocrypt-ctx-private.h"
+#include "mongocrypt-parallel-private.h"
 #include "mongocrypt.h"
 #include "test-mongocrypt.h"
 #include "test-mongocrypt-assert-match-bson.h"
@@ -137,6 +139,381 @@ _test_decrypt_ready (_mongocrypt_tester_t *tester)
 }
 
 
+static void
+_test_decrypt_batch (_mongocrypt_tester_t *tester)
+{
+   mongocrypt_t *crypt;
+   mongocrypt_ctx_t *ctx;
+   mongocrypt_binary_t *encrypted, *explicit, *bin;
+   bson_t encrypted_bson, explicit_bson, batch, arr, as_bson, filter;
+   bson_t decrypted_bson, expected;
+   bson_iter_t iter;
+   _mongocrypt_buffer_t ciphertext, decrypted, explicit_decrypted;
+
+   crypt = _mongocrypt_tester_mongocrypt (TESTER_MONGOCRYPT_DEFAULT);
+   encrypted = _mongocrypt_tester_encrypted_doc (tester);
+   explicit = TEST_BSON ("{ 'v': { '$binary': { 'subType': '06', 'base64': "
+                         "'AWFhYWFhYWFhYWFhYWFhYWECRTOW9yZzNDn5dGwuqsrJQNLtgMEK"
+                         "aujhs9aRWRp+7Yo3JK8N8jC8P0Xjll6C1CwLsE/"
+                         "iP5wjOMhVv1KMMyOCSCrHorXRsb2IKPtzl2lKTqQ=' } } }");
+   BSON_ASSERT (_mongocrypt_binary_to_bson (encrypted, &encrypted_bson));
+   BSON_ASSERT (_mongocrypt_binary_to_bson (explicit, &explicit_bson));
+   BSON_ASSERT (bson_iter_init_find (&iter, &explicit_bson, "v"));
+   BSON_ASSERT (_mongocrypt_buffer_from_binary_iter (&ciphertext, &iter));
+
+   /* Decrypt each element alone for the expected result. */
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_decrypt_init (ctx, encrypted), ctx);
+   _mongocrypt_tester_run_ctx_to (tester, ctx, MONGOCRYPT_CTX_READY);
+   bin = mongocrypt_binary_new ();
+   ASSERT_OK (mongocrypt_ctx_finalize (ctx, bin), ctx);
+   _mongocrypt_buffer_copy_from_binary (&decrypted, bin);
+   mongocrypt_binary_destroy (bin);
+   mongocrypt_ctx_destroy (ctx);
+   BSON_ASSERT (_mongocrypt_buffer_to_bson (&decrypted, &decrypted_bson));
+
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_explicit_decrypt_init (ctx, explicit), ctx);
+   _mongocrypt_tester_run_ctx_to (tester, ctx, MONGOCRYPT_CTX_READY);
+   bin = mongocrypt_binary_new ();
+   ASSERT_OK (mongocrypt_ctx_finalize (ctx, bin), ctx);
+   _mongocrypt_buffer_copy_from_binary (&explicit_decrypted, bin);
+   mongocrypt_binary_destroy (bin);
+   mongocrypt_ctx_destroy (ctx);
+   BSON_ASSERT (_mongocrypt_buffer_to_bson (&explicit_decrypted, &as_bson));
+   BSON_ASSERT (bson_iter_init_find (&iter, &as_bson, "v"));
+
+   bson_init (&expected);
+   BSON_ASSERT (BSON_APPEND_ARRAY_BEGIN (&expected, "v", &arr));
+   BSON_ASSERT (BSON_APPEND_DOCUMENT (&arr, "0", &decrypted_bson));
+   BSON_ASSERT (bson_append_iter (&arr, "1", 1, &iter));
+   BSON_ASSERT (BSON_APPEND_DOCUMENT (&arr, "2", &decrypted_bson));
+   BSON_ASSERT (bson_append_array_end (&expected, &arr));
+
+   /* { v: [ <encrypted doc>, <ciphertext>, <encrypted doc> ] } */
+   bson_init (&batch);
+   BSON_ASSERT (BSON_APPEND_ARRAY_BEGIN (&batch, "v", &arr));
+   BSON_ASSERT (BSON_APPEND_DOCUMENT (&arr, "0", &encrypted_bson));
+   BSON_ASSERT (_mongocrypt_buffer_append (&ciphertext, &arr, "1", 1));
+   BSON_ASSERT (BSON_APPEND_DOCUMENT (&arr, "2", &encrypted_bson));
+   BSON_ASSERT (bson_append_array_end (&batch, &arr));
+
+   ctx = mongocrypt_ctx_new (crypt);
+   bin = mongocrypt_binary_new_from_data ((uint8_t *) bson_get_data (&batch),
+                                          batch.len);
+   ASSERT_OK (mongocrypt_ctx_decrypt_batch_init (ctx, bin), ctx);
+   mongocrypt_binary_destroy (bin);
+   BSON_ASSERT (mongocrypt_ctx_state (ctx) == MONGOCRYPT_CTX_NEED_MONGO_KEYS);
+   /* All elements use the same key. It is requested once. */
+   bin = mongocrypt_binary_new ();
+   ASSERT_OK (mongocrypt_ctx_mongo_op (ctx, bin), ctx);
+   BSON_ASSERT (_mongocrypt_binary_to_bson (bin, &filter));
+   BSON_ASSERT (bson_iter_init (&iter, &filter));
+   BSON_ASSERT (bson_iter_find_descendant (&iter, "$or.0._id.$in.0", &iter));
+   BSON_ASSERT (bson_iter_init (&iter, &filter));
+   BSON_ASSERT (!bson_iter_find_descendant (&iter, "$or.0._id.$in.1", &iter));
+   mongocrypt_binary_destroy (bin);
+
+   _mongocrypt_tester_run_ctx_to (tester, ctx, MONGOCRYPT_CTX_READY);
+   bin = mongocrypt_binary_new ();
+   ASSERT_OK (mongocrypt_ctx_finalize (ctx, bin), ctx);
+   BSON_ASSERT (_mongocrypt_binary_to_bson (bin, &as_bson));
+   BSON_ASSERT (bson_equal (&as_bson, &expected));
+
+   BSON_ASSERT (bson_iter_init (&iter, &as_bson));
+   BSON_ASSERT (bson_iter_find_descendant (&iter, "v.0.filter.ssn", &iter));
+   ASSERT_STREQUAL (bson_iter_utf8 (&iter, NULL),
+                    _mongocrypt_tester_plaintext (tester));
+   mongocrypt_binary_destroy (bin);
+   mongocrypt_ctx_destroy (ctx);
+
+   /* Non-array input. */
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_FAILS (mongocrypt_ctx_decrypt_batch_init (ctx, explicit),
+                 ctx,
+                 "'v' must contain an array");
+   mongocrypt_ctx_destroy (ctx);
+
+   /* Elements must be documents or binary values. */
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_FAILS (
+      mongocrypt_ctx_decrypt_batch_init (ctx, TEST_BSON ("{'v': [{}, 1]}")),
+      ctx,
+      "'v' elements must be documents or binary values");
+   mongocrypt_ctx_destroy (ctx);
+
+   bson_destroy (&expected);
+   bson_destroy (&batch);
+   _mongocrypt_buffer_cleanup (&explicit_decrypted);
+   _mongocrypt_buffer_cleanup (&decrypted);
+   mongocrypt_binary_destroy (encrypted);
+   mongocrypt_destroy (crypt);
+}
+
+
+/* Runs tasks in reverse, to catch a dependence on order. */
+static void
+_reverse_parallel_for (void *ctx,
+                       uint32_t count,
+                       mongocrypt_task_fn task,
+                       void *task_ctx)
+{
+   uint32_t i;
+
+   *(int *) ctx += 1;
+   for (i = count; i > 0; i--) {
+      task (task_ctx, i - 1);
+   }
+}
+
+
+static void
+_decrypt_with (_mongocrypt_tester_t *tester,
+               mongocrypt_t *crypt,
+               mongocrypt_binary_t *msg,
+               _mongocrypt_buffer_t *out)
+{
+   mongocrypt_ctx_t *ctx;
+   mongocrypt_binary_t *bin;
+
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_decrypt_batch_init (ctx, msg), ctx);
+   _mongocrypt_tester_run_ctx_to (tester, ctx, MONGOCRYPT_CTX_READY);
+   bin = mongocrypt_binary_new ();
+   ASSERT_OK (mongocrypt_ctx_finalize (ctx, bin), ctx);
+   _mongocrypt_buffer_copy_from_binary (out, bin);
+   mongocrypt_binary_destroy (bin);
+   mongocrypt_ctx_destroy (ctx);
+}
+
+
+static void
+_test_decrypt_parallel (_mongocrypt_tester_t *tester)
+{
+   mongocrypt_t *crypt;
+   mongocrypt_binary_t *encrypted, *msg;
+   bson_t encrypted_bson, batch, arr;
+   _mongocrypt_buffer_t serial, parallel;
+   uint32_t i;
+   int calls = 0;
+
+   /* A batch with more ciphertexts than MONGOCRYPT_PARALLEL_MIN_TASKS. */
+   encrypted = _mongocrypt_tester_encrypted_doc (tester);
+   BSON_ASSERT (_mongocrypt_binary_to_bson (encrypted, &encrypted_bson));
+   bson_init (&batch);
+   BSON_ASSERT (BSON_APPEND_ARRAY_BEGIN (&batch, "v", &arr));
+   for (i = 0; i < 2 * MONGOCRYPT_PARALLEL_MIN_TASKS; i++) {
+      char buf[16];
+      const char *key;
+      size_t key_len;
+
+      key_len = bson_uint32_to_string (i, &key, buf, sizeof (buf));
+      BSON_ASSERT (
+         bson_append_document (&arr, key, (int) key_len, &encrypted_bson));
+   }
+   BSON_ASSERT (bson_append_array_end (&batch, &arr));
+   msg = mongocrypt_binary_new_from_data ((uint8_t *) bson_get_data (&batch),
+                                          batch.len);
+
+   crypt = _mongocrypt_tester_mongocrypt (TESTER_MONGOCRYPT_DEFAULT);
+   _decrypt_with (tester, crypt, msg, &serial);
+   mongocrypt_destroy (crypt);
+
+   /* Internal thread pool. */
+   crypt = _mongocrypt_tester_mongocrypt (
+      TESTER_MONGOCRYPT_WITH_PARALLEL_FINALIZE);
+   _decrypt_with (tester, crypt, msg, &parallel);
+   ASSERT_CMPBUF (serial, parallel);
+   _mongocrypt_buffer_cleanup (&parallel);
+   mongocrypt_destroy (crypt);
+
+   /* User-supplied parallel-for. */
+   crypt = mongocrypt_new ();
+   ASSERT_OK (
+      mongocrypt_setopt_kms_provider_aws (crypt, "example", -1, "example", -1),
+      crypt);
+   ASSERT_OK (mongocrypt_setopt_parallel_finalize_handler (
+                 crypt, _reverse_parallel_for, &calls),
+              crypt);
+   ASSERT_OK (mongocrypt_init (crypt), crypt);
+   _decrypt_with (tester, crypt, msg, &parallel);
+   ASSERT_CMPBUF (serial, parallel);
+   ASSERT_CMPINT (calls, ==, 1);
+   _mongocrypt_buffer_cleanup (&parallel);
+   mongocrypt_destroy (crypt);
+
+   _mongocrypt_buffer_cleanup (&serial);
+   mongocrypt_binary_destroy (msg);
+   bson_destroy (&batch);
+   mongocrypt_binary_destroy (encrypted);
+}
+
+
+/* Appends { v: [ { a: 1, b: @doc, c: [ @doc, {} ], d: "d" }, @doc ] } to
+ * @out. */
+static void
+_append_nested (bson_t *out, const bson_t *doc)
+{
+   bson_t arr, elem, child;
+   bson_t empty = BSON_INITIALIZER;
+
+   BSON_ASSERT (BSON_APPEND_ARRAY_BEGIN (out, "v", &arr));
+   BSON_ASSERT (BSON_APPEND_DOCUMENT_BEGIN (&arr, "0", &elem));
+   BSON_ASSERT (BSON_APPEND_INT32 (&elem, "a", 1));
+   BSON_ASSERT (BSON_APPEND_DOCUMENT (&elem, "b", doc));
+   BSON_ASSERT (BSON_APPEND_ARRAY_BEGIN (&elem, "c", &child));
+   BSON_ASSERT (BSON_APPEND_DOCUMENT (&child, "0", doc));
+   BSON_ASSERT (BSON_APPEND_DOCUMENT (&child, "1", &empty));
+   BSON_ASSERT (bson_append_array_end (&elem, &child));
+   BSON_ASSERT (BSON_APPEND_UTF8 (&elem, "d", "d"));
+   BSON_ASSERT (bson_append_document_end (&arr, &elem));
+   BSON_ASSERT (BSON_APPEND_DOCUMENT (&arr, "1", doc));
+   BSON_ASSERT (bson_append_array_end (out, &arr));
+}
+
+
+/* Plaintexts are spliced into the original document. The elements around
+ * them are kept, and the lengths of the enclosing documents are updated. */
+static void
+_test_decrypt_splice (_mongocrypt_tester_t *tester)
+{
+   mongocrypt_t *crypt;
+   mongocrypt_binary_t *encrypted, *msg;
+   bson_t encrypted_bson, decrypted_bson, nested, expected, as_bson;
+   bson_iter_t iter;
+   _mongocrypt_buffer_t decrypted, out;
+   const uint8_t *data;
+   uint32_t len;
+
+   crypt = _mongocrypt_tester_mongocrypt (TESTER_MONGOCRYPT_DEFAULT);
+   encrypted = _mongocrypt_tester_encrypted_doc (tester);
+   BSON_ASSERT (_mongocrypt_binary_to_bson (encrypted, &encrypted_bson));
+
+   /* Decrypt the document alone. */
+   bson_init (&nested);
+   BSON_ASSERT (BSON_APPEND_ARRAY_BEGIN (&nested, "v", &as_bson));
+   BSON_ASSERT (BSON_APPEND_DOCUMENT (&as_bson, "0", &encrypted_bson));
+   BSON_ASSERT (bson_append_array_end (&nested, &as_bson));
+   msg = mongocrypt_binary_new_from_data ((uint8_t *) bson_get_data (&nested),
+                                          nested.len);
+   _decrypt_with (tester, crypt, msg, &decrypted);
+   mongocrypt_binary_destroy (msg);
+   bson_destroy (&nested);
+   BSON_ASSERT (_mongocrypt_buffer_to_bson (&decrypted, &as_bson));
+   BSON_ASSERT (bson_iter_init (&iter, &as_bson));
+   BSON_ASSERT (bson_iter_find_descendant (&iter, "v.0", &iter));
+   bson_iter_document (&iter, &len, &data);
+   BSON_ASSERT (bson_init_static (&decrypted_bson, data, len));
+
+   /* Decrypt it nested at several depths. */
+   bson_init (&nested);
+   _append_nested (&nested, &encrypted_bson);
+   bson_init (&expected);
+   _append_nested (&expected, &decrypted_bson);
+   msg = mongocrypt_binary_new_from_data ((uint8_t *) bson_get_data (&nested),
+                                          nested.len);
+   _decrypt_with (tester, crypt, msg, &out);
+   BSON_ASSERT (_mongocrypt_buffer_to_bson (&out, &as_bson));
+   BSON_ASSERT (bson_equal (&as_bson, &expected));
+
+   _mongocrypt_buffer_cleanup (&out);
+   _mongocrypt_buffer_cleanup (&decrypted);
+   mongocrypt_binary_destroy (msg);
+   bson_destroy (&expected);
+   bson_destroy (&nested);
+   mongocrypt_binary_destroy (encrypted);
+   mongocrypt_destroy (crypt);
+}
+
+/* A plaintext must be exactly one value of its BSON type. An 8 byte plaintext
+ * tagged as an int32 is rejected rather than spliced into the document. */
+static void
+_test_decrypt_splice_overlong_plaintext (_mongocrypt_tester_t *tester)
+{
+   mongocrypt_t *crypt;
+   mongocrypt_ctx_t *ctx;
+   mongocrypt_binary_t *encrypted, *msg, *out;
+   mongocrypt_status_t *status;
+   _mongocrypt_ciphertext_t original, crafted;
+   _mongocrypt_buffer_t in, key_material, iv, associated_data, plaintext,
+      serialized;
+   bson_t as_bson, doc;
+   bson_iter_t iter;
+   uint32_t bytes_written;
+   const uint8_t overlong[] = {1, 0, 0, 0, 2, 0, 0, 0};
+
+   crypt = _mongocrypt_tester_mongocrypt (TESTER_MONGOCRYPT_DEFAULT);
+   status = mongocrypt_status_new ();
+   encrypted = _mongocrypt_tester_encrypted_doc (tester);
+   BSON_ASSERT (_mongocrypt_binary_to_bson (encrypted, &as_bson));
+   BSON_ASSERT (bson_iter_init (&iter, &as_bson));
+   BSON_ASSERT (bson_iter_find_descendant (&iter, "filter.ssn", &iter));
+   BSON_ASSERT (_mongocrypt_buffer_from_binary_iter (&in, &iter));
+   _mongocrypt_ciphertext_init (&original);
+   ASSERT_OK_STATUS (
+      _mongocrypt_ciphertext_parse_unowned (&in, &original, status), status);
+
+   /* Decrypt the document once to obtain the key material. */
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_decrypt_init (ctx, encrypted), ctx);
+   _mongocrypt_tester_run_ctx_to (tester, ctx, MONGOCRYPT_CTX_READY);
+   BSON_ASSERT (_mongocrypt_key_broker_decrypted_key_by_id (
+      &ctx->kb, &original.key_id, &key_material));
+   mongocrypt_ctx_destroy (ctx);
+
+   /* Encrypt the overlong plaintext with the same key. */
+   _mongocrypt_ciphertext_init (&crafted);
+   _mongocrypt_buffer_copy_to (&original.key_id, &crafted.key_id);
+   crafted.blob_subtype = MC_SUBTYPE_FLE1RandomEncryptedValue;
+   crafted.original_bson_type = BSON_TYPE_INT32;
+   BSON_ASSERT (_mongocrypt_ciphertext_serialize_associated_data (
+      &crafted, &associated_data));
+   _mongocrypt_buffer_copy_from_hex (&iv, "00112233445566778899AABBCCDDEEFF");
+   _mongocrypt_buffer_init (&plaintext);
+   plaintext.data = (uint8_t *) overlong;
+   plaintext.len = sizeof (overlong);
+   _mongocrypt_buffer_resize (
+      &crafted.data, _mongocrypt_calculate_ciphertext_len (plaintext.len));
+   ASSERT_OK_STATUS (_mongocrypt_do_encryption (crypt->crypto,
+                                                &iv,
+                                                &associated_data,
+                                                &key_material,
+                                                &plaintext,
+                                                &crafted.data,
+                                                &bytes_written,
+                                                status),
+                     status);
+   crafted.data.len = bytes_written;
+   BSON_ASSERT (_mongocrypt_serialize_ciphertext (&crafted, &serialized));
+
+   bson_init (&doc);
+   BSON_ASSERT (BSON_APPEND_BINARY (
+      &doc, "v", BSON_SUBTYPE_ENCRYPTED, serialized.data, serialized.len));
+   msg = mongocrypt_binary_new_from_data ((uint8_t *) bson_get_data (&doc),
+                                          doc.len);
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_decrypt_init (ctx, msg), ctx);
+   _mongocrypt_tester_run_ctx_to (tester, ctx, MONGOCRYPT_CTX_READY);
+   out = mongocrypt_binary_new ();
+   ASSERT_FAILS (
+      mongocrypt_ctx_finalize (ctx, out), ctx, "malformed decrypted value");
+
+   mongocrypt_binary_destroy (out);
+   mongocrypt_ctx_destroy (ctx);
+   mongocrypt_binary_destroy (msg);
+   bson_destroy (&doc);
+   _mongocrypt_buffer_cleanup (&serialized);
+   _mongocrypt_buffer_cleanup (&iv);
+   _mongocrypt_buffer_cleanup (&associated_data);
+   _mongocrypt_ciphertext_cleanup (&crafted);
+   _mongocrypt_buffer_cleanup (&key_material);
+   _mongocrypt_ciphertext_cleanup (&original);
+   mongocrypt_binary_destroy (encrypted);
+   mongocrypt_status_destroy (status);
+   mongocrypt_destroy (crypt);
+}
+
+
 /* Test with empty AWS credentials. */
 void
 _test_decrypt_empty_aws (_mongocrypt_tester_t *tester)
@@ -855,6 +1232,10 @@ _mongocrypt_tester_install_ctx_decrypt (_mongocrypt_tester_t *tester)
    INSTALL_TEST (_test_decrypt_init);
    INSTALL_TEST (_test_decrypt_need_keys);
    INSTALL_TEST (_test_decrypt_ready);
+   INSTALL_TEST (_test_decrypt_batch);
+   INSTALL_TEST (_test_decrypt_parallel);
+   INSTALL_TEST (_test_decrypt_splice);
+   INSTALL_TEST (_test_decrypt_splice_overlong_plaintext);
    INSTALL_TEST (_test_decrypt_empty_aws);
    INSTALL_TEST (_test_decrypt_empty_binary);
    INSTALL_TEST (_test_decrypt_per_ctx_credentials);
@@ -485,10 +485,9 @@ _test_encrypt_need_collinfo (_mongocrypt_tester_t *tester)
               ctx);
    _mongocrypt_tester_run_ctx_to (
       tester, ctx, MONGOCRYPT_CTX_NEED_MONGO_COLLINFO);
-   /* No call to ctx_mongo_feed. */
+   /* No call to ctx_mongo_feed. The collection needs no encryption. */
    ASSERT_OK (mongocrypt_ctx_mongo_done (ctx), ctx);
-   BSON_ASSERT (mongocrypt_ctx_state (ctx) ==
-                MONGOCRYPT_CTX_NEED_MONGO_MARKINGS);
+   BSON_ASSERT (mongocrypt_ctx_state (ctx) == MONGOCRYPT_CTX_READY);
    mongocrypt_ctx_destroy (ctx);
    mongocrypt_destroy (crypt); /* recreate crypt because of caching. */
 
@@ -661,6 +660,353 @@ _test_encrypt_csfle_no_needs_markings (_mongocrypt_tester_t *tester)
    mongocrypt_destroy (crypt);
 }
 
+static void
+_csfle_run_to_need_keys (_mongocrypt_tester_t *tester, mongocrypt_t *crypt)
+{
+   mongocrypt_ctx_t *ctx = mongocrypt_ctx_new (crypt);
+
+   ASSERT_OK (mongocrypt_ctx_encrypt_init (
+                 ctx, "test", -1, TEST_FILE ("./test/example/cmd.json")),
+              ctx);
+   _mongocrypt_tester_run_ctx_to (tester, ctx, MONGOCRYPT_CTX_NEED_MONGO_KEYS);
+   mongocrypt_ctx_destroy (ctx);
+}
+
+
+static void
+_test_encrypt_csfle_query_analyzer_pool (_mongocrypt_tester_t *tester)
+{
+   mongocrypt_t *crypt;
+   mongocrypt_ctx_t *ctx;
+
+   /* The pool size cannot change after initialization. */
+   crypt = _mongocrypt_tester_mongocrypt (TESTER_MONGOCRYPT_DEFAULT);
+   ASSERT_FAILS (mongocrypt_setopt_csfle_query_analyzer_pool_size (crypt, 1),
+                 crypt,
+                 "options cannot be set after initialization");
+   mongocrypt_destroy (crypt);
+
+   if (!TEST_MONGOCRYPT_HAVE_REAL_CSFLE) {
+      fputs ("No 'real' csfle library is available. The "
+             "_test_encrypt_csfle_query_analyzer_pool test is a no-op.",
+             stderr);
+      return;
+   }
+
+   /* Sequential contexts reuse one analyzer. */
+   crypt = _mongocrypt_tester_mongocrypt (TESTER_MONGOCRYPT_WITH_CSFLE_LIB);
+   _csfle_run_to_need_keys (tester, crypt);
+   ASSERT_CMPINT ((int) crypt->csfle_query_analyzers_len, ==, 1);
+   _csfle_run_to_need_keys (tester, crypt);
+   ASSERT_CMPINT ((int) crypt->csfle_query_analyzers_len, ==, 1);
+   mongocrypt_destroy (crypt);
+
+   /* An analyzer that failed analysis is destroyed, not kept. */
+   crypt = _mongocrypt_tester_mongocrypt (TESTER_MONGOCRYPT_WITH_CSFLE_LIB);
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_encrypt_init (
+                 ctx,
+                 "test",
+                 -1,
+                 TEST_BSON ("{'find': 'test', 'filter': {'$invalid': 1}}")),
+              ctx);
+   _mongocrypt_tester_run_ctx_to (tester, ctx, MONGOCRYPT_CTX_ERROR);
+   ASSERT_CMPINT ((int) crypt->csfle_query_analyzers_len, ==, 0);
+   mongocrypt_ctx_destroy (ctx);
+   mongocrypt_destroy (crypt);
+
+   /* With a pool size of 0, no analyzer is kept. */
+   crypt = mongocrypt_new ();
+   ASSERT_OK (
+      mongocrypt_setopt_kms_provider_aws (crypt, "example", -1, "example", -1),
+      crypt);
+   mongocrypt_setopt_append_csfle_search_path (crypt, "$ORIGIN");
+   ASSERT_OK (mongocrypt_setopt_csfle_query_analyzer_pool_size (crypt, 0),
+              crypt);
+   ASSERT_OK (mongocrypt_init (crypt), crypt);
+   _csfle_run_to_need_keys (tester, crypt);
+   ASSERT_CMPINT ((int) crypt->csfle_query_analyzers_len, ==, 0);
+   mongocrypt_destroy (crypt);
+}
+
+
+/* Asserts the marking at 'filter.ssn' of the marked command encrypts @ssn. */
+static void
+_assert_marked_ssn (mongocrypt_ctx_t *ctx, const char *ssn)
+{
+   _mongocrypt_ctx_encrypt_t *ectx = (_mongocrypt_ctx_encrypt_t *) ctx;
+   _mongocrypt_buffer_t buf;
+   _mongocrypt_marking_t marking;
+   bson_t marked;
+   bson_iter_t iter;
+   bson_iter_t ssn_iter;
+
+   BSON_ASSERT (_mongocrypt_buffer_to_bson (&ectx->marked_cmd, &marked));
+   BSON_ASSERT (bson_iter_init (&iter, &marked));
+   BSON_ASSERT (bson_iter_find_descendant (&iter, "filter.ssn", &ssn_iter));
+   BSON_ASSERT (_mongocrypt_buffer_from_binary_iter (&buf, &ssn_iter));
+   ASSERT_OK_STATUS (
+      _mongocrypt_marking_parse_unowned (&buf, &marking, ctx->status),
+      ctx->status);
+   ASSERT_STREQUAL (bson_iter_utf8 (&marking.v_iter, NULL), ssn);
+   _mongocrypt_marking_cleanup (&marking);
+}
+
+
+static void
+_test_encrypt_marking_cache (_mongocrypt_tester_t *tester)
+{
+   mongocrypt_t *crypt;
+   mongocrypt_ctx_t *ctx;
+
+   crypt = mongocrypt_new ();
+   ASSERT_OK (
+      mongocrypt_setopt_kms_provider_aws (crypt, "example", -1, "example", -1),
+      crypt);
+   ASSERT_OK (mongocrypt_setopt_marking_cache_max_entries (crypt, 16), crypt);
+   ASSERT_OK (mongocrypt_init (crypt), crypt);
+   ASSERT_FAILS (mongocrypt_setopt_marking_cache_max_entries (crypt, 1),
+                 crypt,
+                 "options cannot be set after initialization");
+
+   /* The first command is analyzed, and the reply is recorded. */
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_encrypt_init (
+                 ctx, "test", -1, TEST_FILE ("./test/example/cmd.json")),
+              ctx);
+   _mongocrypt_tester_run_ctx_to (
+      tester, ctx, MONGOCRYPT_CTX_NEED_MONGO_MARKINGS);
+   _mongocrypt_tester_run_ctx_to (tester, ctx, MONGOCRYPT_CTX_NEED_MONGO_KEYS);
+   _assert_marked_ssn (ctx, "457-55-5462");
+   mongocrypt_ctx_destroy (ctx);
+
+   /* Another value of the same type is marked from the recorded reply. */
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_encrypt_init (
+                 ctx,
+                 "test",
+                 -1,
+                 TEST_BSON ("{'find': 'test', 'filter': {'ssn': 'abc'}}")),
+              ctx);
+   ASSERT_STATE_EQUAL (mongocrypt_ctx_state (ctx),
+                       MONGOCRYPT_CTX_NEED_MONGO_KEYS);
+   _assert_marked_ssn (ctx, "abc");
+   _mongocrypt_tester_run_ctx_to (tester, ctx, MONGOCRYPT_CTX_READY);
+   mongocrypt_ctx_destroy (ctx);
+
+   /* A value of another type needs query analysis. */
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_encrypt_init (
+                 ctx,
+                 "test",
+                 -1,
+                 TEST_BSON ("{'find': 'test', 'filter': {'ssn': 123}}")),
+              ctx);
+   ASSERT_STATE_EQUAL (mongocrypt_ctx_state (ctx),
+                       MONGOCRYPT_CTX_NEED_MONGO_MARKINGS);
+   mongocrypt_ctx_destroy (ctx);
+
+   /* A value the reply does not echo must be equal. */
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_encrypt_init (
+                 ctx,
+                 "test",
+                 -1,
+                 TEST_BSON ("{'find': 'test', 'filter': {'ssn': "
+                            "'457-55-5462', 'name': 'a'}}")),
+              ctx);
+   _mongocrypt_tester_run_ctx_to (tester, ctx, MONGOCRYPT_CTX_NEED_MONGO_KEYS);
+   mongocrypt_ctx_destroy (ctx);
+
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_encrypt_init (
+                 ctx,
+                 "test",
+                 -1,
+                 TEST_BSON ("{'find': 'test', 'filter': {'ssn': 'def', "
+                            "'name': 'a'}}")),
+              ctx);
+   ASSERT_STATE_EQUAL (mongocrypt_ctx_state (ctx),
+                       MONGOCRYPT_CTX_NEED_MONGO_KEYS);
+   _assert_marked_ssn (ctx, "def");
+   mongocrypt_ctx_destroy (ctx);
+
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_encrypt_init (
+                 ctx,
+                 "test",
+                 -1,
+                 TEST_BSON ("{'find': 'test', 'filter': {'ssn': 'def', "
+                            "'name': 'b'}}")),
+              ctx);
+   ASSERT_STATE_EQUAL (mongocrypt_ctx_state (ctx),
+                       MONGOCRYPT_CTX_NEED_MONGO_MARKINGS);
+   mongocrypt_ctx_destroy (ctx);
+
+   /* A value the reply echoes may differ, and is replayed from the command. */
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_encrypt_init (
+                 ctx,
+                 "test",
+                 -1,
+                 TEST_BSON ("{'find': 'test', 'filter': {'ssn': "
+                            "'457-55-5462', 'age': 30}}")),
+              ctx);
+   ASSERT_STATE_EQUAL (mongocrypt_ctx_state (ctx),
+                       MONGOCRYPT_CTX_NEED_MONGO_MARKINGS);
+   ASSERT_OK (
+      mongocrypt_ctx_mongo_feed (
+         ctx,
+         TEST_BSON (
+            "{'schemaRequiresEncryption': true, 'hasEncryptedPlaceholders': "
+            "true, 'ok': 1, 'result': {'find': 'test', 'filter': {'ssn': "
+            "{'$binary': {'base64': 'ADgAAAAQYQABAAAABWtpABAAAAAEYWFhYWFhYWFh"
+            "YWFhYWFhYQJ2AAwAAAA0NTctNTUtNTQ2MgAA', 'subType': '06'}}, "
+            "'age': 30}}}")),
+      ctx);
+   ASSERT_OK (mongocrypt_ctx_mongo_done (ctx), ctx);
+   ASSERT_STATE_EQUAL (mongocrypt_ctx_state (ctx),
+                       MONGOCRYPT_CTX_NEED_MONGO_KEYS);
+   mongocrypt_ctx_destroy (ctx);
+
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_encrypt_init (
+                 ctx,
+                 "test",
+                 -1,
+                 TEST_BSON ("{'find': 'test', 'filter': {'ssn': 'jkl', "
+                            "'age': 31}}")),
+              ctx);
+   ASSERT_STATE_EQUAL (mongocrypt_ctx_state (ctx),
+                       MONGOCRYPT_CTX_NEED_MONGO_KEYS);
+   _assert_marked_ssn (ctx, "jkl");
+   {
+      _mongocrypt_ctx_encrypt_t *ectx = (_mongocrypt_ctx_encrypt_t *) ctx;
+      bson_t marked;
+      bson_iter_t iter;
+      bson_iter_t field;
+
+      BSON_ASSERT (_mongocrypt_buffer_to_bson (&ectx->marked_cmd, &marked));
+      BSON_ASSERT (bson_iter_init (&iter, &marked));
+      BSON_ASSERT (bson_iter_find_descendant (&iter, "filter.age", &field));
+      BSON_ASSERT (bson_iter_int32 (&field) == 31);
+   }
+   mongocrypt_ctx_destroy (ctx);
+
+   /* Session fields may differ. The reply echoes those of the command. */
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (
+      mongocrypt_ctx_encrypt_init (
+         ctx,
+         "test",
+         -1,
+         TEST_BSON ("{'find': 'test', 'filter': {'ssn': '457-55-5462'}, "
+                    "'lsid': {'id': {'$binary': {'base64': "
+                    "'AAAAAAAAAAAAAAAAAAAAAA==', 'subType': '04'}}}, "
+                    "'txnNumber': {'$numberLong': '1'}}")),
+      ctx);
+   ASSERT_STATE_EQUAL (mongocrypt_ctx_state (ctx),
+                       MONGOCRYPT_CTX_NEED_MONGO_MARKINGS);
+   ASSERT_OK (
+      mongocrypt_ctx_mongo_feed (
+         ctx,
+         TEST_BSON (
+            "{'schemaRequiresEncryption': true, 'hasEncryptedPlaceholders': "
+            "true, 'ok': 1, 'result': {'find': 'test', 'filter': {'ssn': "
+            "{'$binary': {'base64': 'ADgAAAAQYQABAAAABWtpABAAAAAEYWFhYWFhYWFh"
+            "YWFhYWFhYQJ2AAwAAAA0NTctNTUtNTQ2MgAA', 'subType': '06'}}}, "
+            "'lsid': {'id': {'$binary': {'base64': "
+            "'AAAAAAAAAAAAAAAAAAAAAA==', 'subType': '04'}}}, "
+            "'txnNumber': {'$numberLong': '1'}}}")),
+      ctx);
+   ASSERT_OK (mongocrypt_ctx_mongo_done (ctx), ctx);
+   ASSERT_STATE_EQUAL (mongocrypt_ctx_state (ctx),
+                       MONGOCRYPT_CTX_NEED_MONGO_KEYS);
+   mongocrypt_ctx_destroy (ctx);
+
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (
+      mongocrypt_ctx_encrypt_init (
+         ctx,
+         "test",
+         -1,
+         TEST_BSON ("{'find': 'test', 'filter': {'ssn': 'ghi'}, "
+                    "'lsid': {'id': {'$binary': {'base64': "
+                    "'EREREREREREREREREREREQ==', 'subType': '04'}}}, "
+                    "'txnNumber': {'$numberLong': '2'}}")),
+      ctx);
+   ASSERT_STATE_EQUAL (mongocrypt_ctx_state (ctx),
+                       MONGOCRYPT_CTX_NEED_MONGO_KEYS);
+   _assert_marked_ssn (ctx, "ghi");
+   {
+      _mongocrypt_ctx_encrypt_t *ectx = (_mongocrypt_ctx_encrypt_t *) ctx;
+      bson_t marked;
+      bson_iter_t iter;
+      bson_iter_t field;
+      const uint8_t *data;
+      uint32_t len;
+
+      BSON_ASSERT (_mongocrypt_buffer_to_bson (&ectx->marked_cmd, &marked));
+      BSON_ASSERT (bson_iter_init (&iter, &marked));
+      BSON_ASSERT (bson_iter_find_descendant (&iter, "lsid.id", &field));
+      bson_iter_binary (&field, NULL, &len, &data);
+      BSON_ASSERT (len == 16 && data[0] == 0x11 && data[15] == 0x11);
+      BSON_ASSERT (bson_iter_init_find (&iter, &marked, "txnNumber"));
+      BSON_ASSERT (bson_iter_int64 (&iter) == 2);
+   }
+   mongocrypt_ctx_destroy (ctx);
+
+   mongocrypt_destroy (crypt);
+
+   /* Replies for a schema with a JSON pointer keyId are not recorded. */
+   crypt = mongocrypt_new ();
+   ASSERT_OK (
+      mongocrypt_setopt_kms_provider_aws (crypt, "example", -1, "example", -1),
+      crypt);
+   ASSERT_OK (mongocrypt_setopt_marking_cache_max_entries (crypt, 16), crypt);
+   ASSERT_OK (
+      mongocrypt_setopt_schema_map (
+         crypt,
+         TEST_BSON ("{'test.test': {'bsonType': 'object', 'properties': "
+                    "{'ssn': {'encrypt': {'keyId': '/name', 'bsonType': "
+                    "'string', 'algorithm': "
+                    "'AEAD_AES_256_CBC_HMAC_SHA_512-Deterministic'}}}}}")),
+      crypt);
+   ASSERT_OK (mongocrypt_init (crypt), crypt);
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_encrypt_init (
+                 ctx, "test", -1, TEST_FILE ("./test/example/cmd.json")),
+              ctx);
+   _mongocrypt_tester_run_ctx_to (tester, ctx, MONGOCRYPT_CTX_NEED_MONGO_KEYS);
+   mongocrypt_ctx_destroy (ctx);
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_encrypt_init (
+                 ctx, "test", -1, TEST_FILE ("./test/example/cmd.json")),
+              ctx);
+   ASSERT_STATE_EQUAL (mongocrypt_ctx_state (ctx),
+                       MONGOCRYPT_CTX_NEED_MONGO_MARKINGS);
+   mongocrypt_ctx_destroy (ctx);
+   mongocrypt_destroy (crypt);
+
+   /* Disabled by default. */
+   crypt = _mongocrypt_tester_mongocrypt (TESTER_MONGOCRYPT_DEFAULT);
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_encrypt_init (
+                 ctx, "test", -1, TEST_FILE ("./test/example/cmd.json")),
+              ctx);
+   _mongocrypt_tester_run_ctx_to (tester, ctx, MONGOCRYPT_CTX_NEED_MONGO_KEYS);
+   mongocrypt_ctx_destroy (ctx);
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_encrypt_init (
+                 ctx, "test", -1, TEST_FILE ("./test/example/cmd.json")),
+              ctx);
+   ASSERT_STATE_EQUAL (mongocrypt_ctx_state (ctx),
+                       MONGOCRYPT_CTX_NEED_MONGO_MARKINGS);
+   mongocrypt_ctx_destroy (ctx);
+   mongocrypt_destroy (crypt);
+}
+
+
 
 static void
 _test_encrypt_need_keys (_mongocrypt_tester_t *tester)
@@ -1391,6 +1737,209 @@ _test_explicit_encryption (_mongocrypt_tester_t *tester)
    mongocrypt_destroy (crypt);
 }
 
+static void
+_test_explicit_encryption_batch (_mongocrypt_tester_t *tester)
+{
+   mongocrypt_t *crypt, *batch_crypt;
+   mongocrypt_ctx_t *ctx;
+   mongocrypt_kms_ctx_t *kms;
+   mongocrypt_binary_t *bin, *key_id;
+   bson_t as_bson;
+   bson_iter_t iter;
+   _mongocrypt_buffer_t single, batched;
+   char *deterministic = "AEAD_AES_256_CBC_HMAC_SHA_512-Deterministic";
+
+   crypt = _mongocrypt_tester_mongocrypt (TESTER_MONGOCRYPT_DEFAULT);
+   key_id = mongocrypt_binary_new_from_data (
+      MONGOCRYPT_DATA_AND_LEN ("aaaaaaaaaaaaaaaa"));
+
+   /* Encrypt one value for comparison. */
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_setopt_algorithm (ctx, deterministic, -1), ctx);
+   ASSERT_OK (mongocrypt_ctx_setopt_key_id (ctx, key_id), ctx);
+   ASSERT_OK (
+      mongocrypt_ctx_explicit_encrypt_init (ctx, TEST_BSON ("{'v': 123}")),
+      ctx);
+   _mongocrypt_tester_run_ctx_to (tester, ctx, MONGOCRYPT_CTX_READY);
+   bin = mongocrypt_binary_new ();
+   ASSERT_OK (mongocrypt_ctx_finalize (ctx, bin), ctx);
+   BSON_ASSERT (_mongocrypt_binary_to_bson (bin, &as_bson));
+   BSON_ASSERT (bson_iter_init_find (&iter, &as_bson, "v"));
+   BSON_ASSERT (_mongocrypt_buffer_copy_from_binary_iter (&single, &iter));
+   mongocrypt_binary_destroy (bin);
+   mongocrypt_ctx_destroy (ctx);
+
+   /* Elements use the context options by default. Both keys refer to the
+    * same key document, so it is fetched in one round with one KMS request.
+    * Use another mongocrypt_t, so the key is not cached. */
+   batch_crypt = _mongocrypt_tester_mongocrypt (TESTER_MONGOCRYPT_DEFAULT);
+   ctx = mongocrypt_ctx_new (batch_crypt);
+   ASSERT_OK (mongocrypt_ctx_setopt_algorithm (ctx, deterministic, -1), ctx);
+   ASSERT_OK (mongocrypt_ctx_setopt_key_id (ctx, key_id), ctx);
+   ASSERT_OK (mongocrypt_ctx_explicit_encrypt_batch_init (
+                 ctx,
+                 TEST_BSON ("{'v': [{'v': 123}, {'v': 'abc', 'keyAltName': "
+                            "'keyDocumentName', 'algorithm': "
+                            "'AEAD_AES_256_CBC_HMAC_SHA_512-Random'}, "
+                            "{'v': 123, 'keyAltName': 'keyDocumentName'}]}")),
+              ctx);
+   ASSERT_STATE_EQUAL (mongocrypt_ctx_state (ctx),
+                       MONGOCRYPT_CTX_NEED_MONGO_KEYS);
+   ASSERT_OK (mongocrypt_ctx_mongo_feed (
+                 ctx, TEST_FILE ("./test/example/key-document.json")),
+              ctx);
+   ASSERT_OK (mongocrypt_ctx_mongo_done (ctx), ctx);
+   ASSERT_STATE_EQUAL (mongocrypt_ctx_state (ctx), MONGOCRYPT_CTX_NEED_KMS);
+   kms = mongocrypt_ctx_next_kms_ctx (ctx);
+   BSON_ASSERT (kms);
+   _mongocrypt_tester_satisfy_kms (tester, kms);
+   BSON_ASSERT (!mongocrypt_ctx_next_kms_ctx (ctx));
+   ASSERT_OK (mongocrypt_ctx_kms_done (ctx), ctx);
+   ASSERT_STATE_EQUAL (mongocrypt_ctx_state (ctx), MONGOCRYPT_CTX_READY);
+   bin = mongocrypt_binary_new ();
+   ASSERT_OK (mongocrypt_ctx_finalize (ctx, bin), ctx);
+   BSON_ASSERT (_mongocrypt_binary_to_bson (bin, &as_bson));
+   {
+      bson_iter_t elem;
+
+      BSON_ASSERT (bson_iter_init (&iter, &as_bson));
+      BSON_ASSERT (bson_iter_find_descendant (&iter, "v.0", &elem));
+      BSON_ASSERT (_mongocrypt_buffer_from_binary_iter (&batched, &elem));
+      ASSERT_CMPBUF (single, batched);
+
+      BSON_ASSERT (bson_iter_init (&iter, &as_bson));
+      BSON_ASSERT (bson_iter_find_descendant (&iter, "v.1", &elem));
+      BSON_ASSERT (BSON_ITER_HOLDS_BINARY (&elem));
+
+      BSON_ASSERT (bson_iter_init (&iter, &as_bson));
+      BSON_ASSERT (bson_iter_find_descendant (&iter, "v.2", &elem));
+      BSON_ASSERT (_mongocrypt_buffer_from_binary_iter (&batched, &elem));
+      ASSERT_CMPBUF (single, batched);
+
+      BSON_ASSERT (bson_iter_init (&iter, &as_bson));
+      BSON_ASSERT (!bson_iter_find_descendant (&iter, "v.3", &elem));
+   }
+   mongocrypt_binary_destroy (bin);
+   mongocrypt_ctx_destroy (ctx);
+   mongocrypt_destroy (batch_crypt);
+
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_setopt_algorithm (ctx, deterministic, -1), ctx);
+   ASSERT_OK (mongocrypt_ctx_setopt_key_id (ctx, key_id), ctx);
+   ASSERT_FAILS (mongocrypt_ctx_explicit_encrypt_batch_init (
+                    ctx, TEST_BSON ("{'v': [{'v': 123, 'v': 'abc'}]}")),
+                 ctx,
+                 "batch element must contain 'v' only once");
+   mongocrypt_ctx_destroy (ctx);
+
+   /* Elements without a key fail if the context has no key. */
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_setopt_algorithm (ctx, deterministic, -1), ctx);
+   ASSERT_FAILS (mongocrypt_ctx_explicit_encrypt_batch_init (
+                    ctx, TEST_BSON ("{'v': [{'v': 123}]}")),
+                 ctx,
+                 "batch element requires keyId or keyAltName");
+   mongocrypt_ctx_destroy (ctx);
+
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_setopt_key_id (ctx, key_id), ctx);
+   ASSERT_FAILS (mongocrypt_ctx_explicit_encrypt_batch_init (
+                    ctx, TEST_BSON ("{'v': [{'v': 123}]}")),
+                 ctx,
+                 "batch element requires algorithm");
+   mongocrypt_ctx_destroy (ctx);
+
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_setopt_key_id (ctx, key_id), ctx);
+   ASSERT_FAILS (mongocrypt_ctx_explicit_encrypt_batch_init (
+                    ctx, TEST_BSON ("{'v': [{'x': 123}]}")),
+                 ctx,
+                 "unrecognized field in batch element");
+   mongocrypt_ctx_destroy (ctx);
+
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_setopt_key_id (ctx, key_id), ctx);
+   ASSERT_FAILS (
+      mongocrypt_ctx_explicit_encrypt_batch_init (ctx, TEST_BSON ("{'v': 1}")),
+      ctx,
+      "must contain array 'v'");
+   mongocrypt_ctx_destroy (ctx);
+
+   _mongocrypt_buffer_cleanup (&single);
+   mongocrypt_binary_destroy (key_id);
+   mongocrypt_destroy (crypt);
+}
+
+
+static void
+_encrypt_batch_with (_mongocrypt_tester_t *tester,
+                     mongocrypt_t *crypt,
+                     mongocrypt_binary_t *msg,
+                     _mongocrypt_buffer_t *out)
+{
+   mongocrypt_ctx_t *ctx;
+   mongocrypt_binary_t *bin;
+
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_setopt_algorithm (
+                 ctx, "AEAD_AES_256_CBC_HMAC_SHA_512-Deterministic", -1),
+              ctx);
+   ASSERT_OK (mongocrypt_ctx_setopt_key_alt_name (
+                 ctx, TEST_BSON ("{'keyAltName': 'keyDocumentName'}")),
+              ctx);
+   ASSERT_OK (mongocrypt_ctx_explicit_encrypt_batch_init (ctx, msg), ctx);
+   _mongocrypt_tester_run_ctx_to (tester, ctx, MONGOCRYPT_CTX_READY);
+   bin = mongocrypt_binary_new ();
+   ASSERT_OK (mongocrypt_ctx_finalize (ctx, bin), ctx);
+   _mongocrypt_buffer_copy_from_binary (out, bin);
+   mongocrypt_binary_destroy (bin);
+   mongocrypt_ctx_destroy (ctx);
+}
+
+
+static void
+_test_encrypt_parallel (_mongocrypt_tester_t *tester)
+{
+   mongocrypt_t *crypt;
+   mongocrypt_ctx_t *ctx;
+   mongocrypt_binary_t *msg, *bin;
+   _mongocrypt_buffer_t serial, parallel;
+   bson_t as_bson;
+   bson_iter_t iter;
+
+   /* Deterministic encryption gives the same result on any thread. */
+   msg = TEST_BSON ("{'v': [{'v': 1}, {'v': 'two'}, {'v': 3.0}, {'v': [4]}, "
+                    "{'v': {'five': 5}}, {'v': 6}, {'v': 'seven'}, {'v': 8}]}");
+
+   crypt = _mongocrypt_tester_mongocrypt (TESTER_MONGOCRYPT_DEFAULT);
+   _encrypt_batch_with (tester, crypt, msg, &serial);
+   mongocrypt_destroy (crypt);
+
+   crypt = _mongocrypt_tester_mongocrypt (
+      TESTER_MONGOCRYPT_WITH_PARALLEL_FINALIZE);
+   _encrypt_batch_with (tester, crypt, msg, &parallel);
+   ASSERT_CMPBUF (serial, parallel);
+   _mongocrypt_buffer_cleanup (&parallel);
+
+   /* Automatic encryption takes the parallel path too. */
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_encrypt_init (
+                 ctx, "test", -1, TEST_FILE ("./test/example/cmd.json")),
+              ctx);
+   _mongocrypt_tester_run_ctx_to (tester, ctx, MONGOCRYPT_CTX_READY);
+   bin = mongocrypt_binary_new ();
+   ASSERT_OK (mongocrypt_ctx_finalize (ctx, bin), ctx);
+   BSON_ASSERT (_mongocrypt_binary_to_bson (bin, &as_bson));
+   BSON_ASSERT (bson_iter_init (&iter, &as_bson));
+   BSON_ASSERT (bson_iter_find_descendant (&iter, "filter.ssn", &iter));
+   BSON_ASSERT (BSON_ITER_HOLDS_BINARY (&iter));
+   mongocrypt_binary_destroy (bin);
+   mongocrypt_ctx_destroy (ctx);
+   mongocrypt_destroy (crypt);
+
+   _mongocrypt_buffer_cleanup (&serial);
+}
+
 /* Test with empty AWS credentials. */
 void
 _test_encrypt_empty_aws (_mongocrypt_tester_t *tester)
@@ -1595,8 +2144,7 @@ _test_encrypt_caches_empty_collinfo (_mongocrypt_tester_t *tester)
    ASSERT_OK (mongocrypt_ctx_encrypt_init (
                  ctx, "test", -1, TEST_FILE ("./test/example/cmd.json")),
               ctx);
-   ASSERT_STATE_EQUAL (mongocrypt_ctx_state (ctx),
-                       MONGOCRYPT_CTX_NEED_MONGO_MARKINGS);
+   ASSERT_STATE_EQUAL (mongocrypt_ctx_state (ctx), MONGOCRYPT_CTX_READY);
    _mongocrypt_tester_run_ctx_to (tester, ctx, MONGOCRYPT_CTX_DONE);
    mongocrypt_ctx_destroy (ctx);
 
@@ -1621,8 +2169,7 @@ _test_encrypt_caches_collinfo_without_jsonschema (_mongocrypt_tester_t *tester)
          ctx, TEST_FILE ("./test/data/collection-info-no-validator.json")),
       ctx);
    ASSERT_OK (mongocrypt_ctx_mongo_done (ctx), ctx);
-   ASSERT_STATE_EQUAL (mongocrypt_ctx_state (ctx),
-                       MONGOCRYPT_CTX_NEED_MONGO_MARKINGS);
+   ASSERT_STATE_EQUAL (mongocrypt_ctx_state (ctx), MONGOCRYPT_CTX_READY);
    _mongocrypt_tester_run_ctx_to (tester, ctx, MONGOCRYPT_CTX_DONE);
    mongocrypt_ctx_destroy (ctx);
 
@@ -1632,9 +2179,160 @@ _test_encrypt_caches_collinfo_without_jsonschema (_mongocrypt_tester_t *tester)
    ASSERT_OK (mongocrypt_ctx_encrypt_init (
                  ctx, "test", -1, TEST_FILE ("./test/example/cmd.json")),
               ctx);
+   ASSERT_STATE_EQUAL (mongocrypt_ctx_state (ctx), MONGOCRYPT_CTX_READY);
+   _mongocrypt_tester_run_ctx_to (tester, ctx, MONGOCRYPT_CTX_DONE);
+   mongocrypt_ctx_destroy (ctx);
+
+   mongocrypt_destroy (crypt);
+}
+
+static void
+_test_encrypt_plaintext_collinfo (_mongocrypt_tester_t *tester)
+{
+   mongocrypt_t *crypt;
+   mongocrypt_ctx_t *ctx;
+   mongocrypt_binary_t *out;
+
+   crypt = mongocrypt_new ();
+   ASSERT_OK (
+      mongocrypt_setopt_kms_provider_aws (crypt, "example", -1, "example", -1),
+      crypt);
+   ASSERT_OK (mongocrypt_setopt_plaintext_collinfo_expiration (crypt, 1234),
+              crypt);
+   ASSERT_OK (mongocrypt_init (crypt), crypt);
+   ASSERT_FAILS (mongocrypt_setopt_plaintext_collinfo_expiration (crypt, 1),
+                 crypt,
+                 "options cannot be set after initialization");
+
+   /* A collection without a schema is cached as plaintext, with its own
+    * expiration. The command is not modified. */
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_encrypt_init (
+                 ctx, "test", -1, TEST_FILE ("./test/example/cmd.json")),
+              ctx);
+   ASSERT_OK (
+      mongocrypt_ctx_mongo_feed (
+         ctx, TEST_FILE ("./test/data/collection-info-no-validator.json")),
+      ctx);
+   ASSERT_OK (mongocrypt_ctx_mongo_done (ctx), ctx);
+   ASSERT_STATE_EQUAL (mongocrypt_ctx_state (ctx), MONGOCRYPT_CTX_READY);
+   BSON_ASSERT (crypt->cache_collinfo.pair->expiration == 1234);
+   out = mongocrypt_binary_new ();
+   ASSERT_OK (mongocrypt_ctx_finalize (ctx, out), ctx);
+   ASSERT_MONGOCRYPT_BINARY_EQUAL_BSON (TEST_FILE ("./test/example/cmd.json"),
+                                        out);
+   mongocrypt_binary_destroy (out);
+   mongocrypt_ctx_destroy (ctx);
+
+   /* The next command on the namespace is ready after init. */
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_encrypt_init (
+                 ctx, "test", -1, TEST_FILE ("./test/example/cmd.json")),
+              ctx);
+   ASSERT_STATE_EQUAL (mongocrypt_ctx_state (ctx), MONGOCRYPT_CTX_READY);
+   out = mongocrypt_binary_new ();
+   ASSERT_OK (mongocrypt_ctx_finalize (ctx, out), ctx);
+   ASSERT_MONGOCRYPT_BINARY_EQUAL_BSON (TEST_FILE ("./test/example/cmd.json"),
+                                        out);
+   mongocrypt_binary_destroy (out);
+   mongocrypt_ctx_destroy (ctx);
+
+   /* A collection with a schema uses the expiration of the cache. */
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_encrypt_init (
+                 ctx, "test", -1, TEST_BSON ("{'find': 'other'}")),
+              ctx);
+   ASSERT_OK (mongocrypt_ctx_mongo_feed (
+                 ctx, TEST_FILE ("./test/example/collection-info.json")),
+              ctx);
+   ASSERT_OK (mongocrypt_ctx_mongo_done (ctx), ctx);
    ASSERT_STATE_EQUAL (mongocrypt_ctx_state (ctx),
                        MONGOCRYPT_CTX_NEED_MONGO_MARKINGS);
-   _mongocrypt_tester_run_ctx_to (tester, ctx, MONGOCRYPT_CTX_DONE);
+   BSON_ASSERT (crypt->cache_collinfo.pair->expiration == 0);
+   mongocrypt_ctx_destroy (ctx);
+
+   mongocrypt_destroy (crypt);
+}
+
+static void
+_test_encrypt_collinfo_prefetch (_mongocrypt_tester_t *tester)
+{
+   mongocrypt_t *crypt;
+   mongocrypt_ctx_t *ctx;
+   mongocrypt_binary_t *out;
+
+   crypt = _mongocrypt_tester_mongocrypt (TESTER_MONGOCRYPT_DEFAULT);
+
+   /* One listCollections filter covers all requested collections. */
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_collinfo_prefetch_init (
+                 ctx, "test", -1, TEST_BSON ("{'v': ['test', 'missing']}")),
+              ctx);
+   ASSERT_STATE_EQUAL (mongocrypt_ctx_state (ctx),
+                       MONGOCRYPT_CTX_NEED_MONGO_COLLINFO);
+   out = mongocrypt_binary_new ();
+   ASSERT_OK (mongocrypt_ctx_mongo_op (ctx, out), ctx);
+   ASSERT_MONGOCRYPT_BINARY_EQUAL_BSON (
+      TEST_BSON ("{'name': {'$in': ['test', 'missing']}}"), out);
+   mongocrypt_binary_destroy (out);
+   ASSERT_OK (mongocrypt_ctx_mongo_feed (
+                 ctx, TEST_FILE ("./test/example/collection-info.json")),
+              ctx);
+   ASSERT_OK (mongocrypt_ctx_mongo_done (ctx), ctx);
+   ASSERT_STATE_EQUAL (mongocrypt_ctx_state (ctx), MONGOCRYPT_CTX_READY);
+   out = mongocrypt_binary_new ();
+   ASSERT_OK (mongocrypt_ctx_finalize (ctx, out), ctx);
+   ASSERT_MONGOCRYPT_BINARY_EQUAL_BSON (TEST_BSON ("{}"), out);
+   mongocrypt_binary_destroy (out);
+   ASSERT_STATE_EQUAL (mongocrypt_ctx_state (ctx), MONGOCRYPT_CTX_DONE);
+   mongocrypt_ctx_destroy (ctx);
+
+   /* Encrypt contexts on both collections skip listCollections. */
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_encrypt_init (
+                 ctx, "test", -1, TEST_FILE ("./test/example/cmd.json")),
+              ctx);
+   ASSERT_STATE_EQUAL (mongocrypt_ctx_state (ctx),
+                       MONGOCRYPT_CTX_NEED_MONGO_MARKINGS);
+   mongocrypt_ctx_destroy (ctx);
+
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_encrypt_init (
+                 ctx, "test", -1, TEST_BSON ("{'find': 'missing'}")),
+              ctx);
+   ASSERT_STATE_EQUAL (mongocrypt_ctx_state (ctx), MONGOCRYPT_CTX_READY);
+   mongocrypt_ctx_destroy (ctx);
+
+   /* Without collection names, every collection in the database is fetched. */
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_collinfo_prefetch_init (ctx, "db", -1, NULL), ctx);
+   out = mongocrypt_binary_new ();
+   ASSERT_OK (mongocrypt_ctx_mongo_op (ctx, out), ctx);
+   ASSERT_MONGOCRYPT_BINARY_EQUAL_BSON (TEST_BSON ("{}"), out);
+   mongocrypt_binary_destroy (out);
+   ASSERT_FAILS (mongocrypt_ctx_mongo_feed (ctx, TEST_BSON ("{'type': 'x'}")),
+                 ctx,
+                 "collection info must contain a 'name' string");
+   mongocrypt_ctx_destroy (ctx);
+
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_FAILS (mongocrypt_ctx_collinfo_prefetch_init (
+                    ctx, "db", -1, TEST_BSON ("{'v': ['a', 1]}")),
+                 ctx,
+                 "'v' elements must be non-empty strings");
+   mongocrypt_ctx_destroy (ctx);
+
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_FAILS (mongocrypt_ctx_collinfo_prefetch_init (
+                    ctx, "db", -1, TEST_BSON ("{'v': []}")),
+                 ctx,
+                 "'v' must not be empty");
+   mongocrypt_ctx_destroy (ctx);
+
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_FAILS (mongocrypt_ctx_collinfo_prefetch_init (ctx, "", -1, NULL),
+                 ctx,
+                 "invalid db");
    mongocrypt_ctx_destroy (ctx);
 
    mongocrypt_destroy (crypt);
@@ -1744,7 +2442,7 @@ _test_encrypt_with_encrypted_field_config_map_bypassed (
 
 /* Test that an empty jsonSchema document is appended to the command sent to
  * mongocryptd when no encryptedFieldConfig or jsonSchema is found for the
- * collection.
+ * collection, and the plaintext fast path is disabled.
  *
  * This is a regression test for PYTHON-3188. */
 static void
@@ -1753,7 +2451,13 @@ _test_encrypt_no_schema (_mongocrypt_tester_t *tester)
    mongocrypt_t *crypt;
    mongocrypt_ctx_t *ctx;
 
-   crypt = _mongocrypt_tester_mongocrypt (TESTER_MONGOCRYPT_DEFAULT);
+   crypt = mongocrypt_new ();
+   ASSERT_OK (
+      mongocrypt_setopt_kms_provider_aws (crypt, "example", -1, "example", -1),
+      crypt);
+   ASSERT_OK (mongocrypt_setopt_plaintext_collinfo_expiration (crypt, 0),
+              crypt);
+   ASSERT_OK (mongocrypt_init (crypt), crypt);
    ctx = mongocrypt_ctx_new (crypt);
    ASSERT_OK (
       mongocrypt_ctx_encrypt_init (
@@ -2865,6 +3569,96 @@ _test_encrypt_applies_default_state_collections (_mongocrypt_tester_t *tester)
    }
 }
 
+/* Run an empty 'delete' command through @crypt. Collection info and keys are
+ * only fed if the context requests them. */
+static void
+_fle2_delete_empty (_mongocrypt_tester_t *tester, mongocrypt_t *crypt)
+{
+   mongocrypt_ctx_t *ctx = mongocrypt_ctx_new (crypt);
+
+   ASSERT_OK (
+      mongocrypt_ctx_encrypt_init (
+         ctx, "db", -1, TEST_FILE ("./test/data/fle2-delete/empty/cmd.json")),
+      ctx);
+
+   if (mongocrypt_ctx_state (ctx) == MONGOCRYPT_CTX_NEED_MONGO_COLLINFO) {
+      ASSERT_OK (
+         mongocrypt_ctx_mongo_feed (
+            ctx, TEST_FILE ("./test/data/fle2-delete/empty/collinfo.json")),
+         ctx);
+      ASSERT_OK (mongocrypt_ctx_mongo_done (ctx), ctx);
+   }
+
+   ASSERT_STATE_EQUAL (mongocrypt_ctx_state (ctx),
+                       MONGOCRYPT_CTX_NEED_MONGO_MARKINGS);
+   ASSERT_OK (
+      mongocrypt_ctx_mongo_feed (
+         ctx,
+         TEST_FILE ("./test/data/fle2-delete/empty/mongocryptd-reply.json")),
+      ctx);
+   ASSERT_OK (mongocrypt_ctx_mongo_done (ctx), ctx);
+
+   if (mongocrypt_ctx_state (ctx) == MONGOCRYPT_CTX_NEED_MONGO_KEYS) {
+      ASSERT_OK (mongocrypt_ctx_mongo_feed (
+                    ctx,
+                    TEST_FILE ("./test/data/keys/"
+                               "12345678123498761234123456789012-local-"
+                               "document.json")),
+                 ctx);
+      ASSERT_OK (mongocrypt_ctx_mongo_feed (
+                    ctx,
+                    TEST_FILE ("./test/data/keys/"
+                               "12345678123498761234123456789013-local-"
+                               "document.json")),
+                 ctx);
+      ASSERT_OK (mongocrypt_ctx_mongo_done (ctx), ctx);
+   }
+
+   ASSERT_STATE_EQUAL (mongocrypt_ctx_state (ctx), MONGOCRYPT_CTX_READY);
+   {
+      mongocrypt_binary_t *out = mongocrypt_binary_new ();
+      ASSERT_OK (mongocrypt_ctx_finalize (ctx, out), ctx);
+      ASSERT_MONGOCRYPT_BINARY_EQUAL_BSON (
+         TEST_FILE ("./test/data/fle2-delete/empty/encrypted-payload.json"),
+         out);
+      mongocrypt_binary_destroy (out);
+   }
+
+   mongocrypt_ctx_destroy (ctx);
+}
+
+/* Test that 'encryptionInformation' is cached per namespace, and that the
+ * cached document matches a freshly built one. */
+static void
+_test_encrypt_fle2_cached_encryptionInformation (_mongocrypt_tester_t *tester)
+{
+   mongocrypt_t *crypt =
+      _mongocrypt_tester_mongocrypt (TESTER_MONGOCRYPT_DEFAULT);
+   _mongocrypt_cache_encryption_information_value_t *value;
+   _mongocrypt_cache_encryption_information_value_t *reused;
+
+   _fle2_delete_empty (tester, crypt);
+   ASSERT_CMPINT (
+      _mongocrypt_cache_num_entries (&crypt->cache_encryption_information),
+      ==,
+      1);
+   ASSERT (_mongocrypt_cache_get (
+      &crypt->cache_encryption_information, "db.test", (void **) &value));
+   ASSERT (value);
+   ASSERT (!_mongocrypt_buffer_empty (
+      &value->encryption_information_with_delete_tokens));
+
+   /* Reuse the cached document. A rebuilt document would be a new value. */
+   _fle2_delete_empty (tester, crypt);
+   ASSERT (_mongocrypt_cache_get (
+      &crypt->cache_encryption_information, "db.test", (void **) &reused));
+   ASSERT (reused == value);
+   _mongocrypt_cache_encryption_information_value_destroy (reused);
+   _mongocrypt_cache_encryption_information_value_destroy (value);
+
+   mongocrypt_destroy (crypt);
+}
+
 /* Test encrypting an empty 'delete' command without values to be encrypted.
  * Expect deleteTokens to be applied. */
 static void
@@ -3354,6 +4148,8 @@ _mongocrypt_tester_install_ctx_encrypt (_mongocrypt_tester_t *tester)
    INSTALL_TEST (_test_encrypt_need_collinfo);
    INSTALL_TEST (_test_encrypt_need_markings);
    INSTALL_TEST (_test_encrypt_csfle_no_needs_markings);
+   INSTALL_TEST (_test_encrypt_csfle_query_analyzer_pool);
+   INSTALL_TEST (_test_encrypt_marking_cache);
    INSTALL_TEST (_test_encrypt_need_keys);
    INSTALL_TEST (_test_encrypt_ready);
    INSTALL_TEST (_test_key_missing_region);
@@ -3369,11 +4165,15 @@ _mongocrypt_tester_install_ctx_encrypt (_mongocrypt_tester_t *tester)
    INSTALL_TEST (_test_encrypt_dupe_jsonschema);
    INSTALL_TEST (_test_encrypting_with_explicit_encryption);
    INSTALL_TEST (_test_explicit_encryption);
+   INSTALL_TEST (_test_explicit_encryption_batch);
+   INSTALL_TEST (_test_encrypt_parallel);
    INSTALL_TEST (_test_encrypt_empty_aws);
    INSTALL_TEST (_test_encrypt_custom_endpoint);
    INSTALL_TEST (_test_encrypt_with_aws_session_token);
    INSTALL_TEST (_test_encrypt_caches_empty_collinfo);
    INSTALL_TEST (_test_encrypt_caches_collinfo_without_jsonschema);
+   INSTALL_TEST (_test_encrypt_plaintext_collinfo);
+   INSTALL_TEST (_test_encrypt_collinfo_prefetch);
    INSTALL_TEST (_test_encrypt_per_ctx_credentials);
    INSTALL_TEST (_test_encrypt_per_ctx_credentials_local);
    INSTALL_TEST (_test_encrypt_with_encrypted_field_config_map);
@@ -3388,5 +4188,6 @@ _mongocrypt_tester_install_ctx_encrypt (_mongocrypt_tester_t *tester)
    INSTALL_TEST (_test_encrypt_fle2_explicit);
    INSTALL_TEST (_test_encrypt_applies_default_state_collections);
    INSTALL_TEST (_test_encrypt_fle2_delete);
+   INSTALL_TEST (_test_encrypt_fle2_cached_encryptionInformation);
    INSTALL_TEST (_test_encrypt_fle2_omits_encryptionInformation);
 }
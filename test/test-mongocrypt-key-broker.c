@@ -1157,6 +1157,351 @@ _test_key_broker_get_decrypted_key_while_requesting (
    mongocrypt_status_destroy (status);
 }
 
+/* Test that the precomputed state of a key is built once and shared through
+ * the key cache. */
+static void
+_test_key_broker_key_state (_mongocrypt_tester_t *tester)
+{
+   mongocrypt_t *crypt;
+   _mongocrypt_buffer_t key_id1, key_id2, key_doc1, key_doc2;
+   _mongocrypt_key_broker_t kb, kb_cached;
+   _mongocrypt_opts_kms_providers_t *kms_providers;
+   mongocrypt_kms_ctx_t *kms;
+   const _mongocrypt_key_state_t *key_state;
+
+   crypt = _mongocrypt_tester_mongocrypt (TESTER_MONGOCRYPT_DEFAULT);
+   kms_providers = &crypt->opts.kms_providers;
+   _gen_uuid_and_key (tester, 1, &key_id1, &key_doc1);
+   _gen_uuid_and_key (tester, 2, &key_id2, &key_doc2);
+
+   _mongocrypt_key_broker_init (&kb, crypt);
+   ASSERT_OK (_mongocrypt_key_broker_request_id (&kb, &key_id1), &kb);
+   ASSERT_OK (_mongocrypt_key_broker_requests_done (&kb), &kb);
+   ASSERT_OK (_mongocrypt_key_broker_add_doc (&kb, kms_providers, &key_doc1),
+              &kb);
+   ASSERT_OK (_mongocrypt_key_broker_docs_done (&kb), &kb);
+   kms = _mongocrypt_key_broker_next_kms (&kb);
+   ASSERT (kms);
+   _mongocrypt_tester_satisfy_kms (tester, kms);
+   ASSERT_OK (_mongocrypt_key_broker_kms_done (&kb, kms_providers), &kb);
+   ASSERT (kb.state == KB_DONE);
+
+   key_state = _mongocrypt_key_broker_decrypted_key_state_by_id (&kb, &key_id1);
+   ASSERT (key_state);
+   /* An unknown key has no state, and does not fail the key broker. */
+   ASSERT (!_mongocrypt_key_broker_decrypted_key_state_by_id (&kb, &key_id2));
+   ASSERT (kb.state == KB_DONE);
+
+   /* Another key broker satisfied from the cache shares the state. */
+   _mongocrypt_key_broker_init (&kb_cached, crypt);
+   ASSERT_OK (_mongocrypt_key_broker_request_id (&kb_cached, &key_id1),
+              &kb_cached);
+   ASSERT_OK (_mongocrypt_key_broker_requests_done (&kb_cached), &kb_cached);
+   ASSERT (kb_cached.state == KB_DONE);
+   ASSERT (key_state == _mongocrypt_key_broker_decrypted_key_state_by_id (
+                           &kb_cached, &key_id1));
+
+   _mongocrypt_key_broker_cleanup (&kb_cached);
+   _mongocrypt_key_broker_cleanup (&kb);
+   _mongocrypt_buffer_cleanup (&key_doc2);
+   _mongocrypt_buffer_cleanup (&key_id2);
+   _mongocrypt_buffer_cleanup (&key_doc1);
+   _mongocrypt_buffer_cleanup (&key_id1);
+   mongocrypt_destroy (crypt);
+}
+
+/* Test that the value independent FLE2 tokens of a key are derived once and
+ * shared through the key cache. */
+static void
+_test_key_broker_tokens (_mongocrypt_tester_t *tester)
+{
+   mongocrypt_t *crypt;
+   _mongocrypt_buffer_t key_id1, key_id2, key_doc1, key_doc2;
+   _mongocrypt_buffer_t key_material, token_key;
+   _mongocrypt_key_broker_t kb, kb_cached, kb_test;
+   _mongocrypt_opts_kms_providers_t *kms_providers;
+   mongocrypt_kms_ctx_t *kms;
+   mongocrypt_status_t *status;
+   const mc_IndexKeyTokens_t *tokens;
+   mc_CollectionsLevel1Token_t *cl1t;
+   mc_ECOCToken_t *ecoc;
+
+   status = mongocrypt_status_new ();
+   crypt = _mongocrypt_tester_mongocrypt (TESTER_MONGOCRYPT_DEFAULT);
+   kms_providers = &crypt->opts.kms_providers;
+   _gen_uuid_and_key (tester, 1, &key_id1, &key_doc1);
+   _gen_uuid_and_key (tester, 2, &key_id2, &key_doc2);
+
+   _mongocrypt_key_broker_init (&kb, crypt);
+   ASSERT_OK (_mongocrypt_key_broker_request_id (&kb, &key_id1), &kb);
+   ASSERT_OK (_mongocrypt_key_broker_requests_done (&kb), &kb);
+   ASSERT_OK (_mongocrypt_key_broker_add_doc (&kb, kms_providers, &key_doc1),
+              &kb);
+   ASSERT_OK (_mongocrypt_key_broker_docs_done (&kb), &kb);
+   kms = _mongocrypt_key_broker_next_kms (&kb);
+   ASSERT (kms);
+   _mongocrypt_tester_satisfy_kms (tester, kms);
+   ASSERT_OK (_mongocrypt_key_broker_kms_done (&kb, kms_providers), &kb);
+   ASSERT (kb.state == KB_DONE);
+
+   tokens =
+      _mongocrypt_key_broker_decrypted_key_tokens_by_id (&kb, &key_id1, status);
+   ASSERT_OK_STATUS (tokens, status);
+   ASSERT (tokens == _mongocrypt_key_broker_decrypted_key_tokens_by_id (
+                        &kb, &key_id1, status));
+
+   /* The tokens match those derived directly from the key. */
+   ASSERT_OK (
+      _mongocrypt_key_broker_decrypted_key_by_id (&kb, &key_id1, &key_material),
+      &kb);
+   ASSERT (_mongocrypt_buffer_from_subrange (&token_key,
+                                             &key_material,
+                                             2 * MONGOCRYPT_TOKEN_KEY_LEN,
+                                             MONGOCRYPT_TOKEN_KEY_LEN));
+   cl1t = mc_CollectionsLevel1Token_new (crypt->crypto, &token_key, status);
+   ASSERT_OK_STATUS (cl1t, status);
+   ecoc = mc_ECOCToken_new (crypt->crypto, cl1t, status);
+   ASSERT_OK_STATUS (ecoc, status);
+   ASSERT_CMPBUF (*mc_CollectionsLevel1Token_get (cl1t),
+                  *mc_CollectionsLevel1Token_get (
+                     tokens->collectionsLevel1Token));
+   ASSERT_CMPBUF (*mc_ECOCToken_get (ecoc),
+                  *mc_ECOCToken_get (tokens->ecocToken));
+
+   /* An unknown key has no tokens, and does not fail the key broker. */
+   ASSERT_FAILS_STATUS (_mongocrypt_key_broker_decrypted_key_tokens_by_id (
+                           &kb, &key_id2, status),
+                        status,
+                        "could not find key");
+   ASSERT (kb.state == KB_DONE);
+   _mongocrypt_status_reset (status);
+
+   /* Another key broker satisfied from the cache shares the tokens. */
+   _mongocrypt_key_broker_init (&kb_cached, crypt);
+   ASSERT_OK (_mongocrypt_key_broker_request_id (&kb_cached, &key_id1),
+              &kb_cached);
+   ASSERT_OK (_mongocrypt_key_broker_requests_done (&kb_cached), &kb_cached);
+   ASSERT (kb_cached.state == KB_DONE);
+   ASSERT (tokens == _mongocrypt_key_broker_decrypted_key_tokens_by_id (
+                        &kb_cached, &key_id1, status));
+
+   /* A key that is not cached keeps its own tokens. */
+   _mongocrypt_key_broker_init (&kb_test, crypt);
+   _mongocrypt_key_broker_add_test_key (&kb_test, &key_id2);
+   tokens = _mongocrypt_key_broker_decrypted_key_tokens_by_id (
+      &kb_test, &key_id2, status);
+   ASSERT_OK_STATUS (tokens, status);
+   ASSERT (tokens == _mongocrypt_key_broker_decrypted_key_tokens_by_id (
+                        &kb_test, &key_id2, status));
+
+   mc_ECOCToken_destroy (ecoc);
+   mc_CollectionsLevel1Token_destroy (cl1t);
+   _mongocrypt_buffer_cleanup (&key_material);
+   _mongocrypt_key_broker_cleanup (&kb_test);
+   _mongocrypt_key_broker_cleanup (&kb_cached);
+   _mongocrypt_key_broker_cleanup (&kb);
+   _mongocrypt_buffer_cleanup (&key_doc2);
+   _mongocrypt_buffer_cleanup (&key_id2);
+   _mongocrypt_buffer_cleanup (&key_doc1);
+   _mongocrypt_buffer_cleanup (&key_id1);
+   mongocrypt_destroy (crypt);
+   mongocrypt_status_destroy (status);
+}
+
+/* Fetch a key through the key broker, bypassing the cache. */
+static void
+_key_broker_fetch (_mongocrypt_tester_t *tester,
+                   mongocrypt_t *crypt,
+                   _mongocrypt_buffer_t *key_id,
+                   _mongocrypt_buffer_t *key_doc)
+{
+   _mongocrypt_key_broker_t kb;
+   _mongocrypt_opts_kms_providers_t *kms_providers;
+   mongocrypt_kms_ctx_t *kms;
+
+   kms_providers = &crypt->opts.kms_providers;
+   _mongocrypt_key_broker_init (&kb, crypt);
+   ASSERT_OK (_mongocrypt_key_broker_refresh_id (&kb, key_id), &kb);
+   ASSERT_OK (_mongocrypt_key_broker_requests_done (&kb), &kb);
+   ASSERT (kb.state == KB_ADDING_DOCS);
+   ASSERT_OK (_mongocrypt_key_broker_add_doc (&kb, kms_providers, key_doc),
+              &kb);
+   ASSERT_OK (_mongocrypt_key_broker_docs_done (&kb), &kb);
+   kms = _mongocrypt_key_broker_next_kms (&kb);
+   ASSERT (kms);
+   _mongocrypt_tester_satisfy_kms (tester, kms);
+   ASSERT_OK (_mongocrypt_key_broker_kms_done (&kb, kms_providers), &kb);
+   ASSERT (kb.state == KB_DONE);
+   _mongocrypt_key_broker_cleanup (&kb);
+}
+
+/* Returns true if requesting @key_id is satisfied from the cache and the key
+ * broker was told the key is due for a refresh. */
+static bool
+_key_broker_refresh_due (mongocrypt_t *crypt, _mongocrypt_buffer_t *key_id)
+{
+   _mongocrypt_key_broker_t kb;
+   bool refresh_due;
+
+   _mongocrypt_key_broker_init (&kb, crypt);
+   ASSERT_OK (_mongocrypt_key_broker_request_id (&kb, key_id), &kb);
+   ASSERT_OK (_mongocrypt_key_broker_requests_done (&kb), &kb);
+   ASSERT (kb.state == KB_DONE);
+   refresh_due = kb.key_refreshes != NULL;
+   if (refresh_due) {
+      ASSERT_CMPBUF (kb.key_refreshes->id, *key_id);
+   }
+   _mongocrypt_key_broker_cleanup (&kb);
+   return refresh_due;
+}
+
+static void
+_test_key_broker_refresh (_mongocrypt_tester_t *tester)
+{
+   mongocrypt_t *crypt;
+   _mongocrypt_buffer_t key_id1, key_doc1;
+
+   crypt = _mongocrypt_tester_mongocrypt (TESTER_MONGOCRYPT_DEFAULT);
+   _gen_uuid_and_key (tester, 1, &key_id1, &key_doc1);
+
+   _key_broker_fetch (tester, crypt, &key_id1, &key_doc1);
+   /* Without a refresh window, nothing is due. */
+   ASSERT (!_key_broker_refresh_due (crypt, &key_id1));
+
+   /* A window as long as the expiration makes every entry due. */
+   _mongocrypt_cache_set_refresh_window (&crypt->cache_key,
+                                         crypt->cache_key.expiration);
+   ASSERT (_key_broker_refresh_due (crypt, &key_id1));
+   /* Only the first key broker is told. */
+   ASSERT (!_key_broker_refresh_due (crypt, &key_id1));
+
+   /* Fetching again replaces the entry, which may be refreshed again. */
+   _key_broker_fetch (tester, crypt, &key_id1, &key_doc1);
+   BSON_ASSERT (_mongocrypt_cache_num_entries (&crypt->cache_key) == 1);
+   ASSERT (_key_broker_refresh_due (crypt, &key_id1));
+
+   _mongocrypt_buffer_cleanup (&key_doc1);
+   _mongocrypt_buffer_cleanup (&key_id1);
+   mongocrypt_destroy (crypt);
+}
+
+/* A refresh that is abandoned or fails releases its claim, so another key
+ * broker is told the key is due. */
+static void
+_test_key_broker_refresh_abandoned (_mongocrypt_tester_t *tester)
+{
+   mongocrypt_t *crypt;
+   _mongocrypt_buffer_t key_id1, key_doc1;
+   _mongocrypt_key_broker_t kb;
+
+   crypt = _mongocrypt_tester_mongocrypt (TESTER_MONGOCRYPT_DEFAULT);
+   _gen_uuid_and_key (tester, 1, &key_id1, &key_doc1);
+
+   _key_broker_fetch (tester, crypt, &key_id1, &key_doc1);
+   _mongocrypt_cache_set_refresh_window (&crypt->cache_key,
+                                         crypt->cache_key.expiration);
+   ASSERT (_key_broker_refresh_due (crypt, &key_id1));
+   ASSERT (!_key_broker_refresh_due (crypt, &key_id1));
+
+   /* Abandon the refresh before any key document is fed. */
+   _mongocrypt_key_broker_init (&kb, crypt);
+   ASSERT_OK (_mongocrypt_key_broker_refresh_id (&kb, &key_id1), &kb);
+   ASSERT_OK (_mongocrypt_key_broker_requests_done (&kb), &kb);
+   ASSERT (kb.state == KB_ADDING_DOCS);
+   _mongocrypt_key_broker_cleanup (&kb);
+   ASSERT (_key_broker_refresh_due (crypt, &key_id1));
+   ASSERT (!_key_broker_refresh_due (crypt, &key_id1));
+
+   /* Fail the refresh by not feeding the key document. While it runs, the
+    * refresh is still claimed. */
+   _mongocrypt_key_broker_init (&kb, crypt);
+   ASSERT_OK (_mongocrypt_key_broker_refresh_id (&kb, &key_id1), &kb);
+   ASSERT_OK (_mongocrypt_key_broker_requests_done (&kb), &kb);
+   ASSERT (!_key_broker_refresh_due (crypt, &key_id1));
+   ASSERT_FAILS (_mongocrypt_key_broker_docs_done (&kb),
+                 &kb,
+                 "not all keys requested were satisfied");
+   ASSERT (_key_broker_refresh_due (crypt, &key_id1));
+   _mongocrypt_key_broker_cleanup (&kb);
+
+   /* A completed refresh replaces the entry and releases nothing. */
+   _key_broker_fetch (tester, crypt, &key_id1, &key_doc1);
+   ASSERT (_key_broker_refresh_due (crypt, &key_id1));
+   ASSERT (!_key_broker_refresh_due (crypt, &key_id1));
+
+   _mongocrypt_buffer_cleanup (&key_doc1);
+   _mongocrypt_buffer_cleanup (&key_id1);
+   mongocrypt_destroy (crypt);
+}
+
+/* Test that a key broker waits for another fetching the same key. */
+static void
+_test_key_broker_waiting (_mongocrypt_tester_t *tester)
+{
+   mongocrypt_t *crypt;
+   _mongocrypt_buffer_t key_id1, key_doc1, key_id2, key_doc2, decrypted;
+   _mongocrypt_key_broker_t kb1, kb2;
+   _mongocrypt_opts_kms_providers_t *kms_providers;
+   mongocrypt_kms_ctx_t *kms;
+
+   crypt = _mongocrypt_tester_mongocrypt (TESTER_MONGOCRYPT_DEFAULT);
+   crypt->opts.use_waiting_on_keys_state = true;
+   kms_providers = &crypt->opts.kms_providers;
+   _gen_uuid_and_key (tester, 1, &key_id1, &key_doc1);
+   _gen_uuid_and_key (tester, 2, &key_id2, &key_doc2);
+
+   /* kb1 fetches key1. kb2 waits for it. */
+   _mongocrypt_key_broker_init (&kb1, crypt);
+   ASSERT_OK (_mongocrypt_key_broker_request_id (&kb1, &key_id1), &kb1);
+   ASSERT_OK (_mongocrypt_key_broker_requests_done (&kb1), &kb1);
+   ASSERT (kb1.state == KB_ADDING_DOCS);
+
+   _mongocrypt_key_broker_init (&kb2, crypt);
+   ASSERT_OK (_mongocrypt_key_broker_request_id (&kb2, &key_id1), &kb2);
+   ASSERT_OK (_mongocrypt_key_broker_request_id (&kb2, &key_id2), &kb2);
+   ASSERT_OK (_mongocrypt_key_broker_requests_done (&kb2), &kb2);
+   ASSERT (kb2.state == KB_WAITING);
+   ASSERT_OK (_mongocrypt_key_broker_check_waiting (&kb2), &kb2);
+   ASSERT (kb2.state == KB_WAITING);
+
+   ASSERT_OK (_mongocrypt_key_broker_add_doc (&kb1, kms_providers, &key_doc1),
+              &kb1);
+   ASSERT_OK (_mongocrypt_key_broker_docs_done (&kb1), &kb1);
+   kms = _mongocrypt_key_broker_next_kms (&kb1);
+   ASSERT (kms);
+   _mongocrypt_tester_satisfy_kms (tester, kms);
+   ASSERT_OK (_mongocrypt_key_broker_kms_done (&kb1, kms_providers), &kb1);
+   ASSERT (kb1.state == KB_DONE);
+
+   /* key1 is cached. kb2 fetches only key2. */
+   ASSERT_OK (_mongocrypt_key_broker_check_waiting (&kb2), &kb2);
+   ASSERT (kb2.state == KB_ADDING_DOCS);
+   ASSERT (_key_broker_num_satisfied (&kb2) == 1);
+   ASSERT_OK (_mongocrypt_key_broker_decrypted_key_by_id (
+                 &kb1, &key_id1, &decrypted),
+              &kb1);
+   _mongocrypt_buffer_cleanup (&decrypted);
+   _mongocrypt_key_broker_cleanup (&kb1);
+
+   /* A key broker that waits on kb2, which is destroyed before fetching,
+    * fetches key2 itself. */
+   _mongocrypt_key_broker_init (&kb1, crypt);
+   ASSERT_OK (_mongocrypt_key_broker_request_id (&kb1, &key_id2), &kb1);
+   ASSERT_OK (_mongocrypt_key_broker_requests_done (&kb1), &kb1);
+   ASSERT (kb1.state == KB_WAITING);
+   _mongocrypt_key_broker_cleanup (&kb2);
+   ASSERT_OK (_mongocrypt_key_broker_check_waiting (&kb1), &kb1);
+   ASSERT (kb1.state == KB_ADDING_DOCS);
+   _mongocrypt_key_broker_cleanup (&kb1);
+   BSON_ASSERT (!crypt->key_fetches);
+
+   _mongocrypt_buffer_cleanup (&key_doc2);
+   _mongocrypt_buffer_cleanup (&key_id2);
+   _mongocrypt_buffer_cleanup (&key_doc1);
+   _mongocrypt_buffer_cleanup (&key_id1);
+   mongocrypt_destroy (crypt);
+}
+
 void
 _mongocrypt_tester_install_key_broker (_mongocrypt_tester_t *tester)
 {
@@ -1171,4 +1516,9 @@ _mongocrypt_tester_install_key_broker (_mongocrypt_tester_t *tester)
    INSTALL_TEST (_test_key_broker_add_any);
    INSTALL_TEST (_test_key_broker_restart);
    INSTALL_TEST (_test_key_broker_get_decrypted_key_while_requesting);
+   INSTALL_TEST (_test_key_broker_key_state);
+   INSTALL_TEST (_test_key_broker_tokens);
+   INSTALL_TEST (_test_key_broker_refresh);
+   INSTALL_TEST (_test_key_broker_refresh_abandoned);
+   INSTALL_TEST (_test_key_broker_waiting);
 }
@@ -468,8 +468,201 @@ _test_key_cache (_mongocrypt_tester_t *tester)
    bson_destroy (&test_file);
 }
 
+/* Feed the key described by @key_description to @ctx. */
+static void
+_feed_key (_mongocrypt_tester_t *tester,
+           mongocrypt_ctx_t *ctx,
+           bson_t *key_description)
+{
+   _mongocrypt_buffer_t buf;
+   bson_t key;
+
+   gen_key (tester, key_description, &key, NULL);
+   _mongocrypt_buffer_from_bson (&buf, &key);
+   ASSERT_OK (
+      mongocrypt_ctx_mongo_feed (ctx, _mongocrypt_buffer_as_binary (&buf)),
+      ctx);
+   bson_destroy (&key);
+}
+
+static void
+_test_keys_prefetch (_mongocrypt_tester_t *tester)
+{
+   mongocrypt_t *crypt;
+   mongocrypt_ctx_t *ctx;
+   mongocrypt_binary_t *out;
+   _mongocrypt_buffer_t key_id;
+   _mongocrypt_buffer_t keys_buf;
+   bson_t keys;
+   bson_t v;
+
+   crypt = _mongocrypt_tester_mongocrypt (TESTER_MONGOCRYPT_DEFAULT);
+
+   lookup_key_id (0, &key_id);
+   bson_init (&keys);
+   BSON_APPEND_ARRAY_BEGIN (&keys, "v", &v);
+   BSON_ASSERT (_mongocrypt_buffer_append (&key_id, &v, "0", 1));
+   BSON_APPEND_UTF8 (&v, "1", "name");
+   bson_append_array_end (&keys, &v);
+   _mongocrypt_buffer_from_bson (&keys_buf, &keys);
+
+   /* Listed keys are fetched and cached. */
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_keys_prefetch_init (
+                 ctx, _mongocrypt_buffer_as_binary (&keys_buf)),
+              ctx);
+   ASSERT_STATE_EQUAL (mongocrypt_ctx_state (ctx),
+                       MONGOCRYPT_CTX_NEED_MONGO_KEYS);
+   _feed_key (tester,
+              ctx,
+              TMP_BSON ("{'_id': 0, 'keyAltNames': ['name'], 'local': true}"));
+   ASSERT_OK (mongocrypt_ctx_mongo_done (ctx), ctx);
+   ASSERT_STATE_EQUAL (mongocrypt_ctx_state (ctx), MONGOCRYPT_CTX_READY);
+   out = mongocrypt_binary_new ();
+   ASSERT_OK (mongocrypt_ctx_finalize (ctx, out), ctx);
+   ASSERT_MONGOCRYPT_BINARY_EQUAL_BSON (TEST_BSON ("{}"), out);
+   mongocrypt_binary_destroy (out);
+   ASSERT_CMPINT (_mongocrypt_cache_num_entries (&crypt->cache_key), ==, 1);
+   mongocrypt_ctx_destroy (ctx);
+
+   /* Cached keys are not fetched again. */
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_keys_prefetch_init (
+                 ctx, _mongocrypt_buffer_as_binary (&keys_buf)),
+              ctx);
+   ASSERT_STATE_EQUAL (mongocrypt_ctx_state (ctx), MONGOCRYPT_CTX_READY);
+   mongocrypt_ctx_destroy (ctx);
+
+   /* Without a list, every key in the key vault is fetched. */
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_keys_prefetch_init (ctx, NULL), ctx);
+   ASSERT_STATE_EQUAL (mongocrypt_ctx_state (ctx),
+                       MONGOCRYPT_CTX_NEED_MONGO_KEYS);
+   out = mongocrypt_binary_new ();
+   ASSERT_OK (mongocrypt_ctx_mongo_op (ctx, out), ctx);
+   ASSERT_MONGOCRYPT_BINARY_EQUAL_BSON (TEST_BSON ("{}"), out);
+   mongocrypt_binary_destroy (out);
+   _feed_key (tester, ctx, TMP_BSON ("{'_id': 1, 'local': true}"));
+   _feed_key (tester, ctx, TMP_BSON ("{'_id': 2, 'local': true}"));
+   ASSERT_OK (mongocrypt_ctx_mongo_done (ctx), ctx);
+   ASSERT_STATE_EQUAL (mongocrypt_ctx_state (ctx), MONGOCRYPT_CTX_READY);
+   ASSERT_CMPINT (_mongocrypt_cache_num_entries (&crypt->cache_key), ==, 3);
+   mongocrypt_ctx_destroy (ctx);
+
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_FAILS (
+      mongocrypt_ctx_keys_prefetch_init (ctx, TEST_BSON ("{'v': [1]}")),
+      ctx,
+      "'v' elements must be UUIDs or strings");
+   mongocrypt_ctx_destroy (ctx);
+
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_FAILS (
+      mongocrypt_ctx_keys_prefetch_init (ctx, TEST_BSON ("{'v': []}")),
+      ctx,
+      "'v' must not be empty");
+   mongocrypt_ctx_destroy (ctx);
+
+   _mongocrypt_buffer_cleanup (&keys_buf);
+   bson_destroy (&keys);
+   _mongocrypt_buffer_cleanup (&key_id);
+   mongocrypt_destroy (crypt);
+}
+
+static void
+_test_key_cache_snapshot (_mongocrypt_tester_t *tester)
+{
+   mongocrypt_t *crypt;
+   mongocrypt_ctx_t *ctx;
+   mongocrypt_binary_t *out;
+   mongocrypt_binary_t *kek;
+   mongocrypt_binary_t *other_kek;
+   _mongocrypt_buffer_t snapshot;
+   uint8_t kek_data[MONGOCRYPT_KEY_LEN];
+   uint8_t other_kek_data[MONGOCRYPT_KEY_LEN];
+
+   memset (kek_data, 1, sizeof (kek_data));
+   memset (other_kek_data, 2, sizeof (other_kek_data));
+   kek = mongocrypt_binary_new_from_data (kek_data, sizeof (kek_data));
+   other_kek = mongocrypt_binary_new_from_data (other_kek_data,
+                                                sizeof (other_kek_data));
+
+   /* Cache two keys and export them. */
+   crypt = _mongocrypt_tester_mongocrypt (TESTER_MONGOCRYPT_DEFAULT);
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_keys_prefetch_init (ctx, NULL), ctx);
+   _feed_key (tester,
+              ctx,
+              TMP_BSON ("{'_id': 0, 'keyAltNames': ['name'], 'local': true}"));
+   _feed_key (tester, ctx, TMP_BSON ("{'_id': 1, 'local': true}"));
+   ASSERT_OK (mongocrypt_ctx_mongo_done (ctx), ctx);
+   ASSERT_STATE_EQUAL (mongocrypt_ctx_state (ctx), MONGOCRYPT_CTX_READY);
+   mongocrypt_ctx_destroy (ctx);
+
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_key_cache_export_init (ctx, kek), ctx);
+   ASSERT_STATE_EQUAL (mongocrypt_ctx_state (ctx), MONGOCRYPT_CTX_READY);
+   out = mongocrypt_binary_new ();
+   ASSERT_OK (mongocrypt_ctx_finalize (ctx, out), ctx);
+   _mongocrypt_buffer_copy_from_binary (&snapshot, out);
+   mongocrypt_binary_destroy (out);
+   mongocrypt_ctx_destroy (ctx);
+   mongocrypt_destroy (crypt);
+
+   /* A new process imports the keys, and needs no key vault or KMS. */
+   crypt = _mongocrypt_tester_mongocrypt (TESTER_MONGOCRYPT_DEFAULT);
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_key_cache_import_init (
+                 ctx, kek, _mongocrypt_buffer_as_binary (&snapshot)),
+              ctx);
+   ASSERT_STATE_EQUAL (mongocrypt_ctx_state (ctx), MONGOCRYPT_CTX_READY);
+   mongocrypt_ctx_destroy (ctx);
+   ASSERT_CMPINT (_mongocrypt_cache_num_entries (&crypt->cache_key), ==, 2);
+
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_OK (mongocrypt_ctx_keys_prefetch_init (
+                 ctx, TEST_BSON ("{'v': ['name']}")),
+              ctx);
+   ASSERT_STATE_EQUAL (mongocrypt_ctx_state (ctx), MONGOCRYPT_CTX_READY);
+   mongocrypt_ctx_destroy (ctx);
+   mongocrypt_destroy (crypt);
+
+   /* The snapshot cannot be read with another KEK, or modified. */
+   crypt = _mongocrypt_tester_mongocrypt (TESTER_MONGOCRYPT_DEFAULT);
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_FAILS (mongocrypt_ctx_key_cache_import_init (
+                    ctx, other_kek, _mongocrypt_buffer_as_binary (&snapshot)),
+                 ctx,
+                 "key cache snapshot failed authentication");
+   mongocrypt_ctx_destroy (ctx);
+
+   /* Flip a bit of the MAC, which ends the document. */
+   snapshot.data[snapshot.len - 2] ^= 1;
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_FAILS (mongocrypt_ctx_key_cache_import_init (
+                    ctx, kek, _mongocrypt_buffer_as_binary (&snapshot)),
+                 ctx,
+                 "key cache snapshot failed authentication");
+   mongocrypt_ctx_destroy (ctx);
+   ASSERT_CMPINT (_mongocrypt_cache_num_entries (&crypt->cache_key), ==, 0);
+
+   ctx = mongocrypt_ctx_new (crypt);
+   ASSERT_FAILS (
+      mongocrypt_ctx_key_cache_export_init (ctx, TEST_BSON ("{}")),
+      ctx,
+      "key encryption key must be 96 bytes");
+   mongocrypt_ctx_destroy (ctx);
+   mongocrypt_destroy (crypt);
+
+   _mongocrypt_buffer_cleanup (&snapshot);
+   mongocrypt_binary_destroy (other_kek);
+   mongocrypt_binary_destroy (kek);
+}
+
 void
 _mongocrypt_tester_install_key_cache (_mongocrypt_tester_t *tester)
 {
    INSTALL_TEST (_test_key_cache);
+   INSTALL_TEST (_test_keys_prefetch);
+   INSTALL_TEST (_test_key_cache_snapshot);
 }
\ No newline at end of file
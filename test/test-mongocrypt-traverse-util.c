@@ -506,6 +506,99 @@ test_mongocrypt_transform_util_nesting (_util_tester_t *tester)
    test_transform (1, 1, 1, 1, 1, TRAVERSE_MATCH_MARKING, tester, 1);
 }
 
+/* Subtrees without a binary subtype 6 value are skipped. Their contents must
+ * still be copied, and values that only resemble one must not match. */
+static void
+test_mongocrypt_traverse_util_skip (_mongocrypt_tester_t *tester)
+{
+   mongocrypt_status_t *status;
+   bson_iter_t iter;
+   bson_iter_t decoys;
+   const uint8_t *data;
+   const uint8_t *decoys_data;
+   uint32_t len;
+   uint32_t decoys_len;
+   bson_t *bson;
+   bson_t out = BSON_INITIALIZER;
+   bson_t child;
+   bson_t grandchild;
+   int matches;
+   int i;
+
+   status = mongocrypt_status_new ();
+   bson = bson_new ();
+
+   /* A large subdocument holding decoys: the byte 6 in numbers and strings,
+    * and subtype 6 values with a first byte matching neither traversal. */
+   BSON_ASSERT (BSON_APPEND_DOCUMENT_BEGIN (bson, "decoys", &child));
+   for (i = 0; i < 100; i++) {
+      char key[16];
+
+      bson_snprintf (key, sizeof (key), "i%d", i);
+      BSON_ASSERT (BSON_APPEND_INT32 (&child, key, 6));
+      bson_snprintf (key, sizeof (key), "s%d", i);
+      BSON_ASSERT (BSON_APPEND_UTF8 (&child, key, "\x06\x01\x06"));
+      bson_snprintf (key, sizeof (key), "b%d", i);
+      _append_ciphertext_with_subtype (&child, key, -1, 6, 99, tester);
+      bson_snprintf (key, sizeof (key), "c%d", i);
+      _append_ciphertext_with_subtype (&child, key, -1, 0, 1, tester);
+   }
+   BSON_ASSERT (bson_append_document_end (bson, &child));
+
+   /* A match nested next to a subdocument without one. */
+   BSON_ASSERT (BSON_APPEND_ARRAY_BEGIN (bson, "nested", &child));
+   BSON_ASSERT (BSON_APPEND_DOCUMENT_BEGIN (&child, "0", &grandchild));
+   BSON_ASSERT (BSON_APPEND_INT32 (&grandchild, "a", 6));
+   BSON_ASSERT (bson_append_document_end (&child, &grandchild));
+   _append_ciphertext_with_subtype (&child, "1", -1, 6, 1, tester);
+   BSON_ASSERT (bson_append_array_end (bson, &child));
+
+   matches = 0;
+   BSON_ASSERT (bson_iter_init (&iter, bson));
+   BSON_ASSERT (_mongocrypt_traverse_binary_in_bson (
+      test_traverse_cb, &matches, TRAVERSE_MATCH_CIPHERTEXT, &iter, status));
+   BSON_ASSERT (matches == 1);
+
+   matches = 0;
+   BSON_ASSERT (bson_iter_init (&iter, bson));
+   BSON_ASSERT (_mongocrypt_traverse_binary_in_bson (
+      test_traverse_cb, &matches, TRAVERSE_MATCH_MARKING, &iter, status));
+   BSON_ASSERT (matches == 0);
+
+   /* Without a match, the transformed document is an exact copy. */
+   matches = 0;
+   BSON_ASSERT (bson_iter_init (&iter, bson));
+   BSON_ASSERT (_mongocrypt_transform_binary_in_bson (test_transform_cb,
+                                                      &matches,
+                                                      TRAVERSE_MATCH_MARKING,
+                                                      &iter,
+                                                      &out,
+                                                      status));
+   BSON_ASSERT (matches == 0);
+   BSON_ASSERT (bson_equal (bson, &out));
+
+   /* Only the match is transformed. */
+   bson_reinit (&out);
+   BSON_ASSERT (bson_iter_init (&iter, bson));
+   BSON_ASSERT (_mongocrypt_transform_binary_in_bson (test_transform_cb,
+                                                      &matches,
+                                                      TRAVERSE_MATCH_CIPHERTEXT,
+                                                      &iter,
+                                                      &out,
+                                                      status));
+   BSON_ASSERT (matches == 1);
+   BSON_ASSERT (bson_iter_init_find (&iter, &out, "decoys"));
+   BSON_ASSERT (bson_iter_init_find (&decoys, bson, "decoys"));
+   bson_iter_document (&iter, &len, &data);
+   bson_iter_document (&decoys, &decoys_len, &decoys_data);
+   BSON_ASSERT (len == decoys_len);
+   BSON_ASSERT (0 == memcmp (data, decoys_data, len));
+
+   bson_destroy (bson);
+   bson_destroy (&out);
+   mongocrypt_status_destroy (status);
+}
+
 static void
 test_mongocrypt_transform_util (_mongocrypt_tester_t *tester)
 {
@@ -523,6 +616,87 @@ test_mongocrypt_transform_util (_mongocrypt_tester_t *tester)
    test_mongocrypt_transform_util_nesting (&ctx);
 }
 
+
+static int
+_transform_at_paths (bson_t *bson, const char *path, const char *path2)
+{
+   mongocrypt_status_t *status;
+   _mongocrypt_path_trie_t *paths;
+   bson_iter_t iter;
+   bson_t out = BSON_INITIALIZER;
+   int matches = 0;
+   int transformed = 0;
+
+   status = mongocrypt_status_new ();
+   paths = _mongocrypt_path_trie_new ();
+   _mongocrypt_path_trie_add (paths, path);
+   if (path2) {
+      _mongocrypt_path_trie_add (paths, path2);
+   }
+
+   BSON_ASSERT (bson_iter_init (&iter, bson));
+   BSON_ASSERT (_mongocrypt_transform_binary_in_bson_at_paths (
+      test_transform_cb,
+      &matches,
+      TRAVERSE_MATCH_MARKING,
+      paths,
+      &iter,
+      &out,
+      status));
+
+   /* Only the matched markings were transformed. */
+   BSON_ASSERT (bson_iter_init (&iter, &out));
+   BSON_ASSERT (
+      _mongocrypt_traverse_binary_in_bson (post_transform_traverse_check,
+                                           &transformed,
+                                           TRAVERSE_MATCH_MARKING,
+                                           &iter,
+                                           status));
+   BSON_ASSERT (transformed == matches);
+   BSON_ASSERT (bson_count_keys (&out) == bson_count_keys (bson));
+
+   _mongocrypt_path_trie_destroy (paths);
+   bson_destroy (&out);
+   mongocrypt_status_destroy (status);
+   return matches;
+}
+
+static void
+test_mongocrypt_transform_util_at_paths (_mongocrypt_tester_t *tester)
+{
+   bson_t *bson;
+   bson_t documents;
+   bson_t doc;
+   bson_t child;
+
+   /* { documents: [ { a: <marking>, b: { c: <marking> }, d: <marking> } ],
+    *   a: <marking> } */
+   bson = bson_new ();
+   BSON_ASSERT (BSON_APPEND_ARRAY_BEGIN (bson, "documents", &documents));
+   BSON_ASSERT (BSON_APPEND_DOCUMENT_BEGIN (&documents, "0", &doc));
+   _append_marking (&doc, "a", -1);
+   BSON_ASSERT (BSON_APPEND_DOCUMENT_BEGIN (&doc, "b", &child));
+   _append_marking (&child, "c", -1);
+   BSON_ASSERT (bson_append_document_end (&doc, &child));
+   _append_marking (&doc, "d", -1);
+   BSON_ASSERT (bson_append_document_end (&documents, &doc));
+   BSON_ASSERT (bson_append_array_end (bson, &documents));
+   _append_marking (bson, "a", -1);
+
+   BSON_ASSERT (_transform_at_paths (bson, "documents.a", NULL) == 1);
+   BSON_ASSERT (_transform_at_paths (bson, "documents.b.c", NULL) == 1);
+   BSON_ASSERT (_transform_at_paths (bson, "documents.a", "documents.b.c") ==
+                2);
+   /* Everything below a path is matched. */
+   BSON_ASSERT (_transform_at_paths (bson, "documents.b", NULL) == 1);
+   BSON_ASSERT (_transform_at_paths (bson, "documents", NULL) == 3);
+   BSON_ASSERT (_transform_at_paths (bson, "documents", "documents.a") == 3);
+   BSON_ASSERT (_transform_at_paths (bson, "a", NULL) == 1);
+   BSON_ASSERT (_transform_at_paths (bson, "b.c", "x") == 0);
+
+   bson_destroy (bson);
+}
+
 static void
 test_mongocrypt_traverse_util (_mongocrypt_tester_t *tester)
 {
@@ -545,4 +719,6 @@ _mongocrypt_tester_install_traverse_util (_mongocrypt_tester_t *tester)
 {
    INSTALL_TEST (test_mongocrypt_traverse_util);
    INSTALL_TEST (test_mongocrypt_transform_util);
+   INSTALL_TEST (test_mongocrypt_traverse_util_skip);
+   INSTALL_TEST (test_mongocrypt_transform_util_at_paths);
 }
@@ -35,6 +35,8 @@ mongocrypt_ctx_state_to_string (mongocrypt_ctx_state_t state)
       return "MONGOCRYPT_CTX_NEED_MONGO_KEYS";
    case MONGOCRYPT_CTX_NEED_KMS_CREDENTIALS:
       return "MONGOCRYPT_CTX_NEED_KMS_CREDENTIALS";
+   case MONGOCRYPT_CTX_WAITING_ON_KEYS:
+      return "MONGOCRYPT_CTX_WAITING_ON_KEYS";
    case MONGOCRYPT_CTX_NEED_KMS:
       return "MONGOCRYPT_CTX_NEED_KMS";
    case MONGOCRYPT_CTX_READY:
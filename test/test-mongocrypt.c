@@ -349,6 +349,11 @@ _mongocrypt_tester_run_ctx_to (_mongocrypt_tester_t *tester,
          bin = TEST_BSON ("{}");
          mongocrypt_ctx_provide_kms_providers (ctx, bin);
          break;
+      case MONGOCRYPT_CTX_WAITING_ON_KEYS:
+         res = mongocrypt_ctx_wait_done (ctx);
+         mongocrypt_ctx_status (ctx, status);
+         ASSERT_OR_PRINT (res, status);
+         break;
       case MONGOCRYPT_CTX_NEED_KMS:
          kms = mongocrypt_ctx_next_kms_ctx (ctx);
          while (kms) {
@@ -533,6 +538,9 @@ _mongocrypt_tester_mongocrypt (tester_mongocrypt_flags flags)
    if (flags & TESTER_MONGOCRYPT_WITH_CSFLE_LIB) {
       mongocrypt_setopt_append_csfle_search_path (crypt, "$ORIGIN");
    }
+   if (flags & TESTER_MONGOCRYPT_WITH_PARALLEL_FINALIZE) {
+      ASSERT_OK (mongocrypt_setopt_parallel_finalize (crypt, 4), crypt);
+   }
    ASSERT_OK (mongocrypt_init (crypt), crypt);
    if (flags & TESTER_MONGOCRYPT_WITH_CSFLE_LIB) {
       if (mongocrypt_csfle_version (crypt) == 0) {
@@ -544,6 +552,58 @@ _mongocrypt_tester_mongocrypt (tester_mongocrypt_flags flags)
 }
 
 
+static void
+_noop_parallel_for (void *ctx,
+                    uint32_t count,
+                    mongocrypt_task_fn task,
+                    void *task_ctx)
+{
+   uint32_t i;
+
+   (void) ctx;
+   for (i = 0; i < count; i++) {
+      task (task_ctx, i);
+   }
+}
+
+
+static void
+_test_setopt_parallel_finalize (_mongocrypt_tester_t *tester)
+{
+   mongocrypt_t *crypt;
+
+   crypt = mongocrypt_new ();
+   ASSERT_FAILS (mongocrypt_setopt_parallel_finalize_handler (crypt, NULL, NULL),
+                 crypt,
+                 "must not be NULL");
+   mongocrypt_destroy (crypt);
+
+   /* A handler and an internal pool are exclusive. */
+   crypt = mongocrypt_new ();
+   ASSERT_OK (mongocrypt_setopt_parallel_finalize (crypt, 2), crypt);
+   ASSERT_OK (mongocrypt_setopt_parallel_finalize_handler (
+                 crypt, _noop_parallel_for, NULL),
+              crypt);
+   ASSERT_OK (
+      mongocrypt_setopt_kms_provider_aws (crypt, "example", -1, "example", -1),
+      crypt);
+   ASSERT_FAILS (mongocrypt_init (crypt), crypt, "cannot set both");
+   mongocrypt_destroy (crypt);
+
+   crypt = mongocrypt_new ();
+   ASSERT_OK (mongocrypt_setopt_parallel_finalize (crypt, 2), crypt);
+   ASSERT_OK (
+      mongocrypt_setopt_kms_provider_aws (crypt, "example", -1, "example", -1),
+      crypt);
+   ASSERT_OK (mongocrypt_init (crypt), crypt);
+   BSON_ASSERT (crypt->thread_pool);
+   ASSERT_FAILS (mongocrypt_setopt_parallel_finalize (crypt, 4),
+                 crypt,
+                 "options cannot be set after initialization");
+   mongocrypt_destroy (crypt);
+}
+
+
 static void
 _test_mongocrypt_bad_init (_mongocrypt_tester_t *tester)
 {
@@ -654,6 +714,59 @@ _test_setopt_schema (_mongocrypt_tester_t *tester)
    mongocrypt_destroy (crypt);
 }
 
+static void
+_test_setopt_key_cache (_mongocrypt_tester_t *tester)
+{
+   mongocrypt_t *crypt;
+
+   crypt = mongocrypt_new ();
+   ASSERT_FAILS (mongocrypt_setopt_key_cache_expiration (crypt, 0),
+                 crypt,
+                 "must be greater than zero");
+   mongocrypt_destroy (crypt);
+
+   crypt = mongocrypt_new ();
+   ASSERT_OK (mongocrypt_setopt_key_cache_expiration (crypt, 1234), crypt);
+   ASSERT_OK (mongocrypt_setopt_key_cache_max_entries (crypt, 10), crypt);
+   ASSERT_OK (mongocrypt_setopt_key_cache_max_bytes (crypt, 4096), crypt);
+   ASSERT_OK (
+      mongocrypt_setopt_kms_provider_aws (crypt, "example", -1, "example", -1),
+      crypt);
+   ASSERT_OK (mongocrypt_init (crypt), crypt);
+   BSON_ASSERT (crypt->cache_key.expiration == 1234);
+   BSON_ASSERT (crypt->cache_key.max_entries == 10);
+   BSON_ASSERT (crypt->cache_key.max_bytes == 4096);
+   /* The collinfo cache is unaffected. */
+   BSON_ASSERT (crypt->cache_collinfo.expiration == CACHE_EXPIRATION_MS);
+   BSON_ASSERT (crypt->cache_collinfo.max_entries == 0);
+   BSON_ASSERT (crypt->cache_key.refresh_window == 0);
+
+   ASSERT_FAILS (mongocrypt_setopt_key_cache_max_entries (crypt, 1),
+                 crypt,
+                 "options cannot be set after initialization");
+   mongocrypt_destroy (crypt);
+
+   /* The refresh window must be less than the expiration. */
+   crypt = mongocrypt_new ();
+   ASSERT_OK (mongocrypt_setopt_key_cache_expiration (crypt, 1000), crypt);
+   ASSERT_OK (mongocrypt_setopt_key_cache_refresh_window (crypt, 1000), crypt);
+   ASSERT_OK (
+      mongocrypt_setopt_kms_provider_aws (crypt, "example", -1, "example", -1),
+      crypt);
+   ASSERT_FAILS (mongocrypt_init (crypt), crypt, "must be less than");
+   mongocrypt_destroy (crypt);
+
+   crypt = mongocrypt_new ();
+   ASSERT_OK (mongocrypt_setopt_key_cache_refresh_window (crypt, 1000), crypt);
+   ASSERT_OK (
+      mongocrypt_setopt_kms_provider_aws (crypt, "example", -1, "example", -1),
+      crypt);
+   ASSERT_OK (mongocrypt_init (crypt), crypt);
+   BSON_ASSERT (crypt->cache_key.refresh_window == 1000);
+   mongocrypt_destroy (crypt);
+}
+
+
 static void
 _test_setopt_encrypted_field_config_map (_mongocrypt_tester_t *tester)
 {
@@ -903,6 +1016,12 @@ main (int argc, char **argv)
    _mongocrypt_tester_install_traverse_util (&tester);
    _mongocrypt_tester_install (
       &tester, "_test_setopt_schema", _test_setopt_schema, CRYPTO_REQUIRED);
+   _mongocrypt_tester_install (
+      &tester, "_test_setopt_key_cache", _test_setopt_key_cache, CRYPTO_OPTIONAL);
+   _mongocrypt_tester_install (&tester,
+                               "_test_setopt_parallel_finalize",
+                               _test_setopt_parallel_finalize,
+                               CRYPTO_OPTIONAL);
    _mongocrypt_tester_install (&tester,
                                "_test_setopt_encrypted_field_config_map",
                                _test_setopt_encrypted_field_config_map,
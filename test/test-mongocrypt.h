@@ -39,6 +39,8 @@ typedef enum tester_mongocrypt_flags {
    /// Create a mongocrypt_t that has the csfle library loaded. A csfle library
    /// must be present in the same directory as the test executable.
    TESTER_MONGOCRYPT_WITH_CSFLE_LIB = 1 << 0,
+   /// Create a mongocrypt_t that finalizes with an internal thread pool.
+   TESTER_MONGOCRYPT_WITH_PARALLEL_FINALIZE = 1 << 1,
 } tester_mongocrypt_flags;
 
 /* Arbitrary max of 1024 instances of temporary test data. Increase as needed.
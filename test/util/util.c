@@ -812,6 +812,8 @@ _state_string (mongocrypt_ctx_state_t state)
       return "MONGOCRYPT_CTX_NEED_MONGO_KEYS";
    case MONGOCRYPT_CTX_NEED_KMS_CREDENTIALS:
       return "MONGOCRYPT_CTX_NEED_KMS_CREDENTIALS";
+   case MONGOCRYPT_CTX_WAITING_ON_KEYS:
+      return "MONGOCRYPT_CTX_WAITING_ON_KEYS";
    case MONGOCRYPT_CTX_NEED_KMS:
       return "MONGOCRYPT_CTX_NEED_KMS";
    case MONGOCRYPT_CTX_READY:
@@ -880,6 +882,13 @@ _state_machine_run (_state_machine_t *state_machine,
             goto fail;
          }
          break;
+      case MONGOCRYPT_CTX_WAITING_ON_KEYS:
+         /* Contexts are run one at a time, so nothing else fetches keys. */
+         mongocrypt_ctx_wait_done (state_machine->ctx);
+         if (!_ctx_check_error (state_machine->ctx, error, false)) {
+            goto fail;
+         }
+         break;
       case MONGOCRYPT_CTX_READY:
          bson_destroy (result);
          if (!_state_ready (state_machine, result, error)) {